@@ -0,0 +1,156 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <random>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "common/io/io.h"
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "storage/buffer/async_io.h"
+#include "storage/buffer/page.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 测试不同IO引擎在不同队列深度下随机读页面的IOPS
+ * @details range(0) 是引擎(0: posix, 1: io_uring)，range(1) 是队列深度，也就是每批提交的请求数。
+ * 尽量使用 O_DIRECT 打开文件，绕过操作系统的page cache，测试的是设备本身的能力。
+ * 文件系统不支持 O_DIRECT 时(比如tmpfs)，测试的结果主要是系统调用的开销。
+ */
+class AsyncIoBenchmark : public Fixture
+{
+public:
+  static constexpr int         PAGE_NUM  = 16 * 1024;  // 128MB
+  static constexpr const char *FILE_NAME = "async_io_performance.data";
+
+  void SetUp(const State &state) override
+  {
+    LoggerFactory::init_default("async_io_performance.log", LOG_LEVEL_WARN);
+
+    prepare_file();
+
+    fd_ = open(FILE_NAME, O_RDONLY | O_DIRECT);
+    if (fd_ < 0) {
+      fd_ = open(FILE_NAME, O_RDONLY);
+    }
+    if (fd_ < 0) {
+      throw runtime_error("failed to open data file");
+    }
+
+    const char *engine = state.range(0) == 0 ? "posix" : "io_uring";
+    const int   depth  = static_cast<int>(state.range(1));
+    RC          rc     = AsyncIo::create(engine, depth, async_io_);
+    if (OB_FAIL(rc)) {
+      throw runtime_error("failed to create io engine");
+    }
+
+    buffers_.resize(depth, nullptr);
+    for (char *&buffer : buffers_) {
+      if (posix_memalign(reinterpret_cast<void **>(&buffer), BP_PAGE_SIZE, BP_PAGE_SIZE) != 0) {
+        throw runtime_error("failed to alloc aligned buffer");
+      }
+    }
+  }
+
+  void TearDown(const State &state) override
+  {
+    for (char *buffer : buffers_) {
+      free(buffer);
+    }
+    buffers_.clear();
+    async_io_.reset();
+    close(fd_);
+    fd_ = -1;
+  }
+
+private:
+  void prepare_file()
+  {
+    int fd = open(FILE_NAME, O_RDONLY);
+    if (fd >= 0) {
+      off_t size = lseek(fd, 0, SEEK_END);
+      close(fd);
+      if (size >= static_cast<off_t>(PAGE_NUM) * BP_PAGE_SIZE) {
+        return;
+      }
+    }
+
+    fd = open(FILE_NAME, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+      throw runtime_error("failed to create data file");
+    }
+
+    Page page;
+    memset(&page, 0, sizeof(page));
+    for (int i = 0; i < PAGE_NUM; i++) {
+      page.lsn = i;
+      if (writen(fd, &page, sizeof(page)) != 0) {
+        close(fd);
+        throw runtime_error("failed to write data file");
+      }
+    }
+    fsync(fd);
+    close(fd);
+  }
+
+protected:
+  int                 fd_ = -1;
+  unique_ptr<AsyncIo> async_io_;
+  vector<char *>      buffers_;
+};
+
+BENCHMARK_DEFINE_F(AsyncIoBenchmark, RandomRead)(State &state)
+{
+  mt19937                    random(0);
+  uniform_int_distribution<> distrib(0, PAGE_NUM - 1);
+
+  const int         depth = static_cast<int>(state.range(1));
+  vector<IoRequest> requests(depth);
+
+  int64_t failed_count = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < depth; i++) {
+      IoRequest &request = requests[i];
+      request.type       = IoRequest::Type::READ;
+      request.fd         = fd_;
+      request.buf        = buffers_[i];
+      request.size       = BP_PAGE_SIZE;
+      request.offset     = static_cast<int64_t>(distrib(random)) * BP_PAGE_SIZE;
+    }
+
+    async_io_->execute(requests);
+
+    for (const IoRequest &request : requests) {
+      if (OB_FAIL(request.rc)) {
+        failed_count++;
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * depth);
+  state.SetLabel(async_io_->name());
+  state.counters["iops"]   = Counter(state.iterations() * depth, Counter::kIsRate);
+  state.counters["failed"] = Counter(failed_count);
+}
+
+BENCHMARK_REGISTER_F(AsyncIoBenchmark, RandomRead)
+    ->ArgNames({"engine", "depth"})
+    ->ArgsProduct({{0, 1}, {1, 4, 16, 64}})
+    ->UseRealTime();
+
+////////////////////////////////////////////////////////////////////////////////
+
+BENCHMARK_MAIN();
@@ -0,0 +1,107 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "storage/buffer/disk_buffer_pool.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 测试 BPFrameManager 在多线程点查场景下的扩展性
+ * @details 所有页面都已经在内存中，每个线程随机地 get 一个页面然后 unpin，
+ * 不涉及磁盘IO，只测试页帧表本身的并发能力。
+ * 参数 range(0) 是页帧表的分区个数，设置为1时相当于只有一把全局锁。
+ */
+class FrameManagerBenchmark : public Fixture
+{
+public:
+  static constexpr int POOL_NUM  = 32;
+  static constexpr int PAGE_NUM  = POOL_NUM * DEFAULT_ITEM_NUM_PER_POOL;
+  static constexpr int BUFFER_ID = 1;
+
+  void SetUp(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    LoggerFactory::init_default("bp_frame_manager_concurrency.log", LOG_LEVEL_WARN);
+
+    frame_manager_ = make_unique<BPFrameManager>("Benchmark");
+    RC rc          = frame_manager_->init(POOL_NUM, static_cast<int>(state.range(0)));
+    if (OB_FAIL(rc)) {
+      throw runtime_error("failed to init frame manager");
+    }
+
+    for (PageNum page_num = 0; page_num < PAGE_NUM; page_num++) {
+      Frame *frame = frame_manager_->alloc(BUFFER_ID, page_num);
+      if (frame == nullptr) {
+        throw runtime_error("failed to alloc frame");
+      }
+      frame->unpin();
+    }
+  }
+
+  void TearDown(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    for (PageNum page_num = 0; page_num < PAGE_NUM; page_num++) {
+      Frame *frame = frame_manager_->get(BUFFER_ID, page_num);
+      if (frame != nullptr) {
+        frame_manager_->free(BUFFER_ID, page_num, frame);
+      }
+    }
+    frame_manager_->cleanup();
+    frame_manager_.reset();
+  }
+
+protected:
+  unique_ptr<BPFrameManager> frame_manager_;
+};
+
+BENCHMARK_DEFINE_F(FrameManagerBenchmark, PointGet)(State &state)
+{
+  mt19937                    random(state.thread_index());
+  uniform_int_distribution<> distrib(0, PAGE_NUM - 1);
+
+  int64_t miss_count = 0;
+  for (auto _ : state) {
+    Frame *frame = frame_manager_->get(BUFFER_ID, distrib(random));
+    if (frame == nullptr) {
+      miss_count++;
+      continue;
+    }
+    frame->unpin();
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["miss"] = Counter(miss_count, Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(FrameManagerBenchmark, PointGet)
+    ->ArgName("partitions")
+    ->Arg(1)
+    ->Arg(BPFrameManager::DEFAULT_PARTITION_NUM)
+    ->Arg(64)
+    ->ThreadRange(1, 32)
+    ->UseRealTime();
+
+////////////////////////////////////////////////////////////////////////////////
+
+BENCHMARK_MAIN();
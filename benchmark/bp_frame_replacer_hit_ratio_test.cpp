@@ -0,0 +1,110 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "storage/buffer/disk_buffer_pool.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 比较不同页帧淘汰策略在 OLTP 点查与分析型扫描混合负载下的命中率
+ * @details 页帧表可以放下 POOL_NUM * DEFAULT_ITEM_NUM_PER_POOL 个页面，热点页面集合只占一半。
+ * 每一轮先做 POINT_NUM 次热点页面上的随机点查，再做一次页面数远超内存的全表扫描。
+ * 不涉及磁盘IO，没有命中时直接淘汰一个页帧。
+ * range(0) 是淘汰策略(0: lru, 1: 2q)。关注的是计数器 point_hit_ratio，即扫描之后点查还能命中多少。
+ */
+class FrameReplacerBenchmark : public Fixture
+{
+public:
+  static constexpr int POOL_NUM  = 8;
+  static constexpr int HOT_NUM   = POOL_NUM * DEFAULT_ITEM_NUM_PER_POOL / 2;
+  static constexpr int SCAN_NUM  = POOL_NUM * DEFAULT_ITEM_NUM_PER_POOL * 4;
+  static constexpr int POINT_NUM = HOT_NUM * 16;
+  static constexpr int BUFFER_ID = 1;
+
+  void SetUp(const State &state) override
+  {
+    LoggerFactory::init_default("bp_frame_replacer_hit_ratio.log", LOG_LEVEL_WARN);
+
+    const char *replacer = state.range(0) == 0 ? "lru" : "2q";
+    frame_manager_       = make_unique<BPFrameManager>("Benchmark");
+    RC rc                = frame_manager_->init(POOL_NUM, BPFrameManager::DEFAULT_PARTITION_NUM, replacer);
+    if (OB_FAIL(rc)) {
+      throw runtime_error("failed to init frame manager");
+    }
+  }
+
+  void TearDown(const State &state) override
+  {
+    for (Frame *frame : frame_manager_->find_list(BUFFER_ID)) {
+      frame_manager_->free(BUFFER_ID, frame->page_num(), frame);
+    }
+    frame_manager_->cleanup();
+    frame_manager_.reset();
+  }
+
+  /**
+   * @brief 访问一个页面，返回是否命中
+   */
+  bool access(PageNum page_num)
+  {
+    Frame *frame = frame_manager_->get(BUFFER_ID, page_num);
+    if (frame != nullptr) {
+      frame->unpin();
+      return true;
+    }
+
+    frame = frame_manager_->alloc(BUFFER_ID, page_num);
+    while (frame == nullptr) {
+      frame_manager_->purge_frames(1, [](Frame *) { return RC::SUCCESS; });
+      frame = frame_manager_->alloc(BUFFER_ID, page_num);
+    }
+    frame->unpin();
+    return false;
+  }
+
+protected:
+  unique_ptr<BPFrameManager> frame_manager_;
+};
+
+BENCHMARK_DEFINE_F(FrameReplacerBenchmark, MixedScan)(State &state)
+{
+  mt19937                    random(0);
+  uniform_int_distribution<> distrib(0, HOT_NUM - 1);
+
+  int64_t point_hits = 0;
+  int64_t points     = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < POINT_NUM; i++) {
+      point_hits += access(distrib(random)) ? 1 : 0;
+    }
+    points += POINT_NUM;
+
+    for (int i = 0; i < SCAN_NUM; i++) {
+      access(HOT_NUM + i);
+    }
+  }
+
+  state.SetLabel(frame_manager_->replacer_name());
+  state.counters["hit_ratio"]       = Counter(frame_manager_->hit_ratio());
+  state.counters["point_hit_ratio"] = Counter(points == 0 ? 0.0 : static_cast<double>(point_hits) / points);
+}
+
+BENCHMARK_REGISTER_F(FrameReplacerBenchmark, MixedScan)->ArgNames({"replacer"})->Arg(0)->Arg(1)->Iterations(20);
+
+////////////////////////////////////////////////////////////////////////////////
+
+BENCHMARK_MAIN();
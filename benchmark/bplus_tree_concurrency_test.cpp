@@ -61,7 +61,7 @@ public:
 
     string log_name       = this->Name() + ".log";
     string btree_filename = this->Name() + ".btree";
-    LoggerFactory::init_default(log_name.c_str(), LOG_LEVEL_TRACE);
+    LoggerFactory::init_default(log_name.c_str(), LOG_LEVEL_WARN);
 
     ::remove(btree_filename.c_str());
 
@@ -294,6 +294,99 @@ BENCHMARK_REGISTER_F(ScanBenchmark, Scan)->Threads(10)->Arg(4 * 10000);
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * @brief 乐观锁和 crabing protocol 的扩展性对比
+ * @details range(0) 决定数据量，range(1) 为1时使用乐观锁，为0时只使用 crabing protocol。
+ * 数据都在内存中。Lookup 只做点查，LookupInsertion 中十分之一的操作是插入新的数据，
+ * 插入的数据分散在所有叶子节点上，大多数不会导致分裂。
+ */
+class LatchScalingBenchmark : public BenchmarkBase
+{
+public:
+  string Name() const override { return "latch_scaling"; }
+
+  void SetUp(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    BenchmarkBase::SetUp(state);
+    handler_.set_optimistic_latch(state.range(1) != 0);
+
+    // 已有的数据都是偶数，插入的都是奇数
+    uint32_t max = GetRangeMax(state);
+    for (uint32_t value = 0; value < max; value += 2) {
+      const char *key = reinterpret_cast<const char *>(&value);
+      RID         rid(value, value);
+
+      [[maybe_unused]] RC rc = handler_.insert_entry(key, &rid);
+      ASSERT(rc == RC::SUCCESS, "failed to insert entry into btree. key=%" PRIu32, value);
+    }
+  }
+
+  void Lookup(uint32_t value, Stat &stat)
+  {
+    const char *key = reinterpret_cast<const char *>(&value);
+    list<RID>   rids;
+    RC          rc = handler_.get_entry(key, sizeof(value), rids);
+    if (rc != RC::SUCCESS) {
+      stat.scan_other_count++;
+    } else if (rids.empty()) {
+      stat.mismatch_count++;
+    } else {
+      stat.scan_success_count++;
+    }
+  }
+};
+
+BENCHMARK_DEFINE_F(LatchScalingBenchmark, Lookup)(State &state)
+{
+  IntegerGenerator generator(0, GetRangeMax(state) / 2 - 1);
+  Stat             stat;
+
+  for (auto _ : state) {
+    Lookup(static_cast<uint32_t>(generator.next()) * 2, stat);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["found"] = Counter(stat.scan_success_count, Counter::kIsRate);
+  state.counters["other"] = Counter(stat.scan_other_count, Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(LatchScalingBenchmark, Lookup)
+    ->ArgsProduct({{10000}, {0, 1}})
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(LatchScalingBenchmark, LookupInsertion)(State &state)
+{
+  IntegerGenerator generator(0, GetRangeMax(state) / 2 - 1);
+  IntegerGenerator operation_generator(0, 9);
+  Stat             stat;
+
+  for (auto _ : state) {
+    uint32_t value = static_cast<uint32_t>(generator.next()) * 2;
+    if (operation_generator.next() == 0) {
+      Insert(value + 1, stat);
+    } else {
+      Lookup(value, stat);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  state.counters["insert_success"] = Counter(stat.insert_success_count, Counter::kIsRate);
+  state.counters["found"]          = Counter(stat.scan_success_count, Counter::kIsRate);
+  state.counters["other"] = Counter(stat.scan_other_count + stat.insert_other_count, Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(LatchScalingBenchmark, LookupInsertion)
+    ->ArgsProduct({{10000}, {0, 1}})
+    ->ThreadRange(1, 16)
+    ->UseRealTime();
+
+////////////////////////////////////////////////////////////////////////////////
+
 struct MixtureBenchmark : public BenchmarkBase
 {
   string Name() const override { return "mixture"; }
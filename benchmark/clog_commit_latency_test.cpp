@@ -0,0 +1,136 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+
+#include "common/lang/atomic.h"
+#include "common/lang/filesystem.h"
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "storage/clog/disk_log_handler.h"
+#include "storage/trx/mvcc_trx_log.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 测试事务提交的延迟
+ * @details 每个线程模拟一个自动提交的连接：写一条日志，然后等待这条日志刷盘，也就是一次提交。
+ * 每次迭代的时间就是一次提交的延迟。线程数越多，每一批刷盘的日志越多，总的提交次数应该几乎线性增长，
+ * 而单次提交的延迟基本不变，这就是组提交的效果。
+ * range(0) 是每条日志的大小。
+ * GroupCommit 把各个线程的提交先在事务层合并成一组，每组只写一条提交日志，range(0) 是组长等待的微秒数。
+ */
+class CommitLatencyBenchmark : public Fixture
+{
+public:
+  static constexpr const char *LOG_DIRECTORY = "clog_commit_latency";
+
+  void SetUp(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    LoggerFactory::init_default("clog_commit_latency.log", LOG_LEVEL_WARN);
+
+    filesystem::remove_all(LOG_DIRECTORY);
+    log_handler_ = make_unique<DiskLogHandler>();
+    RC rc        = log_handler_->init(LOG_DIRECTORY);
+    if (OB_FAIL(rc)) {
+      throw runtime_error("failed to init log handler");
+    }
+
+    rc = log_handler_->start();
+    if (OB_FAIL(rc)) {
+      throw runtime_error("failed to start log handler");
+    }
+
+    // 只有 GroupCommit 用到
+    next_trx_id_ = 1;
+    commit_group_.set_delay_us(static_cast<int>(state.range(0)));
+  }
+
+  void TearDown(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    log_handler_->stop();
+    log_handler_->await_termination();
+    log_handler_.reset();
+    filesystem::remove_all(LOG_DIRECTORY);
+  }
+
+  void commit(State &state)
+  {
+    const int64_t entry_size = state.range(0);
+    for (auto _ : state) {
+      LSN lsn = 0;
+      RC  rc  = log_handler_->append(lsn, LogModule::Id::TRANSACTION, vector<char>(entry_size, 'a'));
+      if (OB_FAIL(rc)) {
+        state.SkipWithError("failed to append log");
+        break;
+      }
+
+      rc = log_handler_->wait_lsn(lsn);
+      if (OB_FAIL(rc)) {
+        state.SkipWithError("failed to wait log");
+        break;
+      }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * entry_size);
+  }
+
+  void group_commit(State &state)
+  {
+    for (auto _ : state) {
+      // 进入循环以后才能保证线程0已经创建好了日志
+      MvccTrxLogHandler trx_log_handler(*log_handler_);
+
+      const int32_t trx_id = next_trx_id_.fetch_add(2);
+      RC            rc     = commit_group_.commit(trx_log_handler, trx_id, trx_id + 1);
+      if (OB_FAIL(rc)) {
+        state.SkipWithError("failed to commit");
+        break;
+      }
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+protected:
+  unique_ptr<DiskLogHandler> log_handler_;
+
+  MvccTrxCommitGroup commit_group_;
+  atomic<int32_t>    next_trx_id_{1};
+};
+
+BENCHMARK_DEFINE_F(CommitLatencyBenchmark, Commit)(State &state) { commit(state); }
+
+BENCHMARK_REGISTER_F(CommitLatencyBenchmark, Commit)
+    ->Arg(64)
+    ->Arg(1024)
+    ->ThreadRange(1, 32)
+    ->UseRealTime()
+    ->Unit(kMicrosecond);
+
+BENCHMARK_DEFINE_F(CommitLatencyBenchmark, GroupCommit)(State &state) { group_commit(state); }
+
+BENCHMARK_REGISTER_F(CommitLatencyBenchmark, GroupCommit)
+    ->Arg(0)
+    ->Arg(100)
+    ->ThreadRange(1, 32)
+    ->UseRealTime()
+    ->Unit(kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,207 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+
+#include "common/lang/filesystem.h"
+#include "common/lang/mutex.h"
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "common/math/integer_generator.h"
+#include "storage/db/db.h"
+#include "storage/table/table.h"
+#include "storage/trx/trx.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 高冲突的更新测试
+ * @details 所有线程反复更新少量几行数据，每个事务更新一行然后提交，遇到写冲突就回滚重试。
+ * 写冲突的事务会等待前一个事务结束，而不是立即失败，所以重试的次数应该很少。
+ * range(0) 是热点数据的行数，越少冲突越多。conflicts 是平均每次成功的更新之前回滚的次数。
+ * 需要打开 CONCURRENCY 编译选项。
+ */
+class MvccUpdateContentionBenchmark : public Fixture
+{
+public:
+  static constexpr const char *DB_DIRECTORY = "mvcc_trx_contention";
+
+  /// 每一行热点数据最新的版本。版本号也保存在记录的第二个字段中，只能增加
+  struct HotRow
+  {
+    RID rid;
+    int version = 0;
+  };
+
+  void SetUp(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    LoggerFactory::init_default("mvcc_trx_contention.log", LOG_LEVEL_WARN);
+
+    filesystem::remove_all(DB_DIRECTORY);
+    filesystem::create_directories(DB_DIRECTORY);
+
+    db_   = make_unique<Db>();
+    RC rc = db_->init("contention", DB_DIRECTORY, "mvcc", "disk");
+    if (OB_FAIL(rc)) {
+      throw runtime_error("failed to init db");
+    }
+
+    vector<AttrInfoSqlNode> attr_infos(2);
+    attr_infos[0].name = "id";
+    attr_infos[1].name = "version";
+    for (AttrInfoSqlNode &attr_info : attr_infos) {
+      attr_info.type   = AttrType::INTS;
+      attr_info.length = 4;
+    }
+    rc = db_->create_table("hot", attr_infos, {});
+    if (OB_FAIL(rc)) {
+      throw runtime_error("failed to create table");
+    }
+    table_ = db_->find_table("hot");
+
+    hot_rows_.clear();
+    hot_rows_.resize(state.range(0));
+    for (int id = 0; id < static_cast<int>(hot_rows_.size()); id++) {
+      Trx   *trx = db_->trx_kit().create_trx(db_->log_handler());
+      Record record;
+      trx->start_if_need();
+      if (OB_FAIL(make_record(id, 0, record)) || OB_FAIL(trx->insert_record(table_, record)) ||
+          OB_FAIL(trx->commit())) {
+        throw runtime_error("failed to insert record");
+      }
+      db_->trx_kit().destroy_trx(trx);
+      hot_rows_[id].rid = record.rid();
+    }
+  }
+
+  void TearDown(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    db_.reset();
+    filesystem::remove_all(DB_DIRECTORY);
+  }
+
+  RC make_record(int id, int version, Record &record)
+  {
+    Value values[2];
+    values[0].set_int(id);
+    values[1].set_int(version);
+    return table_->make_record(2, values, record);
+  }
+
+  /**
+   * @brief 在事务中更新一行数据的版本号
+   * @return 当前事务看不到最新的版本时返回 RECORD_INVISIBLE，和写冲突一样需要重试
+   */
+  RC update(Trx *trx, int id)
+  {
+    HotRow hot_row;
+    {
+      lock_guard guard(hot_rows_lock_);
+      hot_row = hot_rows_[id];
+    }
+
+    Record old_record;
+    RC     rc = table_->get_record(hot_row.rid, old_record);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    // 旧的版本被清理以后，这个位置可能已经放了别的记录
+    const FieldMeta *id_field = table_->table_meta().field("id");
+    if (*reinterpret_cast<const int *>(old_record.data() + id_field->offset()) != id) {
+      return RC::RECORD_INVISIBLE;
+    }
+
+    rc = trx->visit_record(table_, old_record, ReadWriteMode::READ_WRITE);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    Record new_record;
+    rc = make_record(id, hot_row.version + 1, new_record);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    rc = trx->update_record(table_, old_record, new_record);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    rc = trx->commit();
+    if (OB_SUCC(rc)) {
+      lock_guard guard(hot_rows_lock_);
+      if (hot_rows_[id].version < hot_row.version + 1) {
+        hot_rows_[id].rid     = new_record.rid();
+        hot_rows_[id].version = hot_row.version + 1;
+      }
+    }
+    return rc;
+  }
+
+  void update_hot_rows(State &state)
+  {
+    IntegerGenerator id_generator(0, static_cast<int>(state.range(0)) - 1);
+    TrxKit          &trx_kit   = db_->trx_kit();
+    int64_t          conflicts = 0;
+
+    for (auto _ : state) {
+      const int id = id_generator.next();
+      while (true) {
+        Trx *trx = trx_kit.create_trx(db_->log_handler());
+        trx->start_if_need();
+        RC rc = update(trx, id);
+        if (OB_FAIL(rc)) {
+          trx->rollback();
+        }
+        trx_kit.destroy_trx(trx);
+
+        if (OB_SUCC(rc)) {
+          break;
+        }
+        if (rc != RC::LOCKED_CONCURRENCY_CONFLICT && rc != RC::RECORD_INVISIBLE) {
+          state.SkipWithError(strrc(rc));
+          break;
+        }
+        conflicts++;
+      }
+    }
+
+    state.counters["conflicts"] = Counter(conflicts, Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations());
+  }
+
+protected:
+  unique_ptr<Db> db_;
+  Table         *table_ = nullptr;
+  mutex          hot_rows_lock_;
+  vector<HotRow> hot_rows_;
+};
+
+BENCHMARK_DEFINE_F(MvccUpdateContentionBenchmark, Update)(State &state) { update_hot_rows(state); }
+
+BENCHMARK_REGISTER_F(MvccUpdateContentionBenchmark, Update)
+    ->Arg(1)
+    ->Arg(16)
+    ->ThreadRange(1, 16)
+    ->UseRealTime()
+    ->Unit(kMicrosecond);
+
+BENCHMARK_MAIN();
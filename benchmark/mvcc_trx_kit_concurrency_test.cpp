@@ -0,0 +1,115 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+
+#include "common/lang/memory.h"
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "storage/clog/vacuous_log_handler.h"
+#include "storage/trx/mvcc_trx.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 事务开始和提交的吞吐量测试
+ * @details 每个线程模拟一个连接，不停地开始和提交只读事务，测试事务号分配和活跃事务登记的开销。
+ * 不访问任何数据，也不写日志，所有的时间都花在事务管理器上。
+ * 需要打开 CONCURRENCY 编译选项。
+ */
+class MvccTrxKitBenchmark : public Fixture
+{
+public:
+  void SetUp(const State &state) override
+  {
+    // 事务管理器在所有测试之间共享，不释放。线程结束循环以后还要销毁自己的事务对象，
+    // 线程0在 TearDown 中释放事务管理器的话，其它线程可能还在使用
+    if (0 != state.thread_index() || trx_kit_ != nullptr) {
+      return;
+    }
+
+    LoggerFactory::init_default("mvcc_trx_kit_concurrency.log", LOG_LEVEL_WARN);
+
+    trx_kit_ = make_unique<MvccTrxKit>();
+    if (OB_FAIL(trx_kit_->init())) {
+      throw runtime_error("failed to init trx kit");
+    }
+  }
+
+  /// 每个连接一直使用同一个事务对象
+  void begin_commit(State &state)
+  {
+    // 进入循环以后才能保证线程0已经创建好了事务管理器
+    Trx *trx = nullptr;
+    for (auto _ : state) {
+      if (nullptr == trx) {
+        trx = trx_kit_->create_trx(log_handler_);
+      }
+      trx->start_if_need();
+      if (OB_FAIL(trx->commit())) {
+        state.SkipWithError("failed to commit");
+        break;
+      }
+    }
+    if (trx != nullptr) {
+      trx_kit_->destroy_trx(trx);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  /// 每个事务都创建一个新的事务对象
+  void create_begin_commit(State &state)
+  {
+    for (auto _ : state) {
+      Trx *trx = trx_kit_->create_trx(log_handler_);
+      trx->start_if_need();
+      RC rc = trx->commit();
+      trx_kit_->destroy_trx(trx);
+      if (OB_FAIL(rc)) {
+        state.SkipWithError("failed to commit");
+        break;
+      }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  /// 其它线程开始和提交事务的同时，线程0不停地收集活跃事务，就像清理旧版本时一样
+  void begin_commit_with_snapshot(State &state)
+  {
+    if (0 != state.thread_index()) {
+      begin_commit(state);
+      return;
+    }
+
+    vector<int32_t> xids;
+    for (auto _ : state) {
+      DoNotOptimize(trx_kit_->active_xids(xids));
+    }
+  }
+
+protected:
+  static inline unique_ptr<MvccTrxKit> trx_kit_;
+  static inline VacuousLogHandler      log_handler_;
+};
+
+BENCHMARK_DEFINE_F(MvccTrxKitBenchmark, BeginCommit)(State &state) { begin_commit(state); }
+BENCHMARK_REGISTER_F(MvccTrxKitBenchmark, BeginCommit)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_DEFINE_F(MvccTrxKitBenchmark, CreateBeginCommit)(State &state) { create_begin_commit(state); }
+BENCHMARK_REGISTER_F(MvccTrxKitBenchmark, CreateBeginCommit)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK_DEFINE_F(MvccTrxKitBenchmark, BeginCommitWithSnapshot)(State &state) { begin_commit_with_snapshot(state); }
+BENCHMARK_REGISTER_F(MvccTrxKitBenchmark, BeginCommitWithSnapshot)->ThreadRange(2, 64)->UseRealTime();
+
+BENCHMARK_MAIN();
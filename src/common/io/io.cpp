@@ -12,8 +12,10 @@ See the Mulan PSL v2 for more details. */
 // Created by Longda on 2010
 //
 
+#include <algorithm>
 #include <dirent.h>
 #include <iostream>
+#include <limits.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -386,4 +388,95 @@ int readn(int fd, void *buf, int size)
   }
   return 0;
 }
+
+int pwriten(int fd, const void *buf, int size, int64_t offset)
+{
+  const char *tmp = (const char *)buf;
+  while (size > 0) {
+    const ssize_t ret = ::pwrite(fd, tmp, size, offset);
+    if (ret >= 0) {
+      tmp += ret;
+      size -= ret;
+      offset += ret;
+      continue;
+    }
+    const int err = errno;
+    if (EAGAIN != err && EINTR != err)
+      return err;
+  }
+  return 0;
+}
+
+int pwritevn(int fd, struct iovec *iov, int iovcnt, int64_t offset)
+{
+  while (iovcnt > 0) {
+    const ssize_t ret = ::pwritev(fd, iov, std::min(iovcnt, IOV_MAX), offset);
+    if (ret < 0) {
+      const int err = errno;
+      if (EAGAIN != err && EINTR != err)
+        return err;
+      continue;
+    }
+
+    // 跳过已经写完的部分，继续写剩下的
+    offset += ret;
+    size_t written = ret;
+    while (iovcnt > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return 0;
+}
+
+int writevn(int fd, struct iovec *iov, int iovcnt)
+{
+  while (iovcnt > 0) {
+    const ssize_t ret = ::writev(fd, iov, std::min(iovcnt, IOV_MAX));
+    if (ret < 0) {
+      const int err = errno;
+      if (EAGAIN != err && EINTR != err)
+        return err;
+      continue;
+    }
+
+    size_t written = ret;
+    while (iovcnt > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return 0;
+}
+
+int preadn(int fd, void *buf, int size, int64_t offset)
+{
+  char *tmp = (char *)buf;
+  while (size > 0) {
+    const ssize_t ret = ::pread(fd, tmp, size, offset);
+    if (ret > 0) {
+      tmp += ret;
+      size -= ret;
+      offset += ret;
+      continue;
+    }
+    if (0 == ret)
+      return -1;  // end of file
+
+    const int err = errno;
+    if (EAGAIN != err && EINTR != err)
+      return err;
+  }
+  return 0;
+}
 }  // namespace common
@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <sys/uio.h>
 #include <vector>
 
 #include "common/defs.h"
@@ -77,4 +78,47 @@ int writen(int fd, const void *buf, int size);
  */
 int readn(int fd, void *buf, int size);
 
+/**
+ * @brief 从指定的偏移量开始一次性写入所有指定数据
+ * @details 与writen相同，但是使用pwrite，不会修改文件的读写位置，多个线程可以同时对一个文件调用
+ *
+ * @param fd  写入的描述符
+ * @param buf 写入的数据
+ * @param size 写入多少数据
+ * @param offset 文件中的偏移量
+ * @return int 0 表示成功，否则返回errno
+ */
+int pwriten(int fd, const void *buf, int size, int64_t offset);
+
+/**
+ * @brief 从指定的偏移量开始一次性读取指定长度的数据
+ * @details 与readn相同，但是使用pread，不会修改文件的读写位置，多个线程可以同时对一个文件调用
+ *
+ * @param fd  读取的描述符
+ * @param buf 读取到这里
+ * @param size 读取的数据长度
+ * @param offset 文件中的偏移量
+ * @return int 返回0表示成功。-1 表示读取到文件尾，并且没有读到size大小数据，其它表示errno
+ */
+int preadn(int fd, void *buf, int size, int64_t offset);
+
+/**
+ * @brief 从指定的偏移量开始，把多段数据连续地写入文件
+ * @details 与pwriten相同，但是使用pwritev，一次系统调用可以写入多段不连续的内存。
+ * 段数超过IOV_MAX时会分多次写入。写入过程中iov的内容可能会被修改
+ *
+ * @param fd  写入的描述符
+ * @param iov 写入的数据
+ * @param iovcnt 数据的段数
+ * @param offset 文件中的偏移量
+ * @return int 0 表示成功，否则返回errno
+ */
+int pwritevn(int fd, struct iovec *iov, int iovcnt, int64_t offset);
+
+/**
+ * @brief 在文件当前的位置把多段数据连续地写入文件
+ * @details 与pwritevn相同，但是不指定偏移量，适用于以O_APPEND方式打开的文件
+ */
+int writevn(int fd, struct iovec *iov, int iovcnt);
+
 }  // namespace common
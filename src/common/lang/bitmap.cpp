@@ -12,30 +12,14 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai on 2021/5/7.
 //
 
+#include <bit>
+#include <stdint.h>
+
 #include "common/lang/bitmap.h"
+#include "common/lang/algorithm.h"
 
 namespace common {
 
-int find_first_zero(char byte, int start)
-{
-  for (int i = start; i < 8; i++) {
-    if ((byte & (1 << i)) == 0) {
-      return i;
-    }
-  }
-  return -1;
-}
-
-int find_first_setted(char byte, int start)
-{
-  for (int i = start; i < 8; i++) {
-    if ((byte & (1 << i)) != 0) {
-      return i;
-    }
-  }
-  return -1;
-}
-
 int bytes(int size) { return size % 8 == 0 ? size / 8 : size / 8 + 1; }
 
 Bitmap::Bitmap() : bitmap_(nullptr), size_(0) {}
@@ -65,48 +49,40 @@ void Bitmap::clear_bit(int index)
   bits &= ~(1 << (index % 8));
 }
 
-int Bitmap::next_unsetted_bit(int start)
+/**
+ * @brief 从start开始查找第一个值为 value 的位
+ * @details 每次取出8个字节拼成一个64位的字，用 countr_zero 定位字中的位，而不是逐位检查
+ */
+static int find_next_bit(const char *bitmap, int size, int start, bool value)
 {
-  int ret           = -1;
-  int start_in_byte = start % 8;
-  for (int iter = start / 8, end = bytes(size_); iter < end; iter++) {
-    char byte = bitmap_[iter];
-    if (byte != -1) {
-      int index_in_byte = find_first_zero(byte, start_in_byte);
-      if (index_in_byte >= 0) {
-        ret = iter * 8 + index_in_byte;
-        break;
-      }
+  start = max(start, 0);
+
+  const int      byte_num = bytes(size);
+  const uint64_t flip     = value ? 0 : ~0ULL;
+  uint64_t       mask     = ~0ULL << (start % 8);  // 第一个字中start之前的位不在范围内
+  for (int byte = start / 8; byte < byte_num; byte += 8, mask = ~0ULL) {
+    const int n    = min(8, byte_num - byte);
+    uint64_t  word = 0;
+    for (int i = 0; i < n; i++) {
+      word |= static_cast<uint64_t>(static_cast<uint8_t>(bitmap[byte + i])) << (i * 8);
     }
-    start_in_byte = 0;
-  }
-
-  if (ret >= size_) {
-    ret = -1;
-  }
-  return ret;
-}
 
-int Bitmap::next_setted_bit(int start)
-{
-  int ret           = -1;
-  int start_in_byte = start % 8;
-  for (int iter = start / 8, end = bytes(size_); iter < end; iter++) {
-    char byte = bitmap_[iter];
-    if (byte != 0x00) {
-      int index_in_byte = find_first_setted(byte, start_in_byte);
-      if (index_in_byte >= 0) {
-        ret = iter * 8 + index_in_byte;
-        break;
-      }
+    // 转换成查找第一个为1的位
+    word = (word ^ flip) & mask;
+    if (n < 8) {
+      word &= (1ULL << (n * 8)) - 1;
     }
-    start_in_byte = 0;
-  }
 
-  if (ret >= size_) {
-    ret = -1;
+    if (word != 0) {
+      const int ret = byte * 8 + std::countr_zero(word);
+      return ret < size ? ret : -1;
+    }
   }
-  return ret;
+  return -1;
 }
 
+int Bitmap::next_unsetted_bit(int start) { return find_next_bit(bitmap_, size_, start, false); }
+
+int Bitmap::next_setted_bit(int start) { return find_next_bit(bitmap_, size_, start, true); }
+
 }  // namespace common
@@ -35,6 +35,19 @@ int Serializer::write_int64(int64_t value)
   return write(span(p, sizeof(value)));
 }
 
+int Serializer::write_varint32(int32_t value)
+{
+  uint32_t zigzag = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  char     bytes[5];
+  int      size = 0;
+  while (zigzag >= 0x80) {
+    bytes[size++] = static_cast<char>(zigzag | 0x80);
+    zigzag >>= 7;
+  }
+  bytes[size++] = static_cast<char>(zigzag);
+  return write(span<const char>(bytes, size));
+}
+
 int Deserializer::read(span<char> data)
 {
   if (static_cast<int64_t>(data.size()) > remain()) {
@@ -58,4 +71,22 @@ int Deserializer::read_int64(int64_t &value)
   return read(data);
 }
 
+int Deserializer::read_varint32(int32_t &value)
+{
+  uint32_t zigzag = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (remain() <= 0) {
+      return -1;
+    }
+
+    const uint8_t byte = static_cast<uint8_t>(buffer_[position_++]);
+    zigzag |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      value = static_cast<int32_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+      return 0;
+    }
+  }
+  return -1;
+}
+
 }  // namespace common
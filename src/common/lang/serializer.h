@@ -52,6 +52,13 @@ public:
   /// @brief 写入一个int64整数
   int write_int64(int64_t value);
 
+  /**
+   * @brief 使用变长编码写入一个int32整数
+   * @details 先做zigzag编码，让绝对值小的负数(比如-1)也只占用一个字节，然后每个字节存放7位，
+   * 最高位表示后面是否还有数据。小于64的数字只需要一个字节，最多5个字节。
+   */
+  int write_varint32(int32_t value);
+
 private:
   BufferType buffer_;
 };
@@ -84,6 +91,8 @@ public:
   int read_int32(int32_t &value);
   /// @brief 读取一个int64数据
   int read_int64(int64_t &value);
+  /// @brief 读取一个使用 write_varint32 写入的整数
+  int read_varint32(int32_t &value);
 
 private:
   span<const char> buffer_;        ///< 存放数据的buffer
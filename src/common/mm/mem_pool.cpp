@@ -11,9 +11,109 @@ See the Mulan PSL v2 for more details. */
 // Created by Longda on 2022/1/28.
 //
 
+#include <sys/mman.h>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "common/mm/mem_pool.h"
 namespace common {
 
+static constexpr size_t HUGE_PAGE_SIZE = 2UL << 20;
+
+#ifdef __linux__
+/**
+ * @brief 让一段内存在所有在线的NUMA节点之间交错分配
+ * @details 不依赖 libnuma，从 sysfs 读取在线的节点列表(比如 0-3,5)，然后调用 mbind
+ */
+static void interleave_numa_nodes(void *addr, size_t size)
+{
+  FILE *file = fopen("/sys/devices/system/node/online", "r");
+  if (file == nullptr) {
+    LOG_INFO("NUMA is not available, skip interleaving");
+    return;
+  }
+
+  constexpr int MAX_NODE_NUM                = 1024;
+  unsigned long nodemask[MAX_NODE_NUM / 64] = {0};
+  int           node_num                    = 0;
+  int           first                       = 0;
+  int           last                        = 0;
+  char          separator                   = 0;
+  while (fscanf(file, "%d", &first) == 1) {
+    last = first;
+    if (fscanf(file, "%c", &separator) == 1 && separator == '-') {
+      if (fscanf(file, "%d", &last) != 1) {
+        break;
+      }
+      (void)fscanf(file, "%c", &separator);
+    }
+    for (int node = first; node <= last && node < MAX_NODE_NUM; node++) {
+      nodemask[node / 64] |= 1UL << (node % 64);
+      node_num++;
+    }
+  }
+  fclose(file);
+
+  if (node_num <= 1) {
+    LOG_INFO("only %d NUMA node online, skip interleaving", node_num);
+    return;
+  }
+
+  if (syscall(SYS_mbind, addr, size, MPOL_INTERLEAVE, nodemask, MAX_NODE_NUM + 1, 0) != 0) {
+    LOG_WARN("failed to interleave memory across NUMA nodes. error=%s", strerror(errno));
+    return;
+  }
+  LOG_INFO("interleave memory across %d NUMA nodes. size=%zu", node_num, size);
+}
+#endif
+
+void *map_anonymous_memory(size_t &size, bool numa_interleave, bool &huge_page)
+{
+  size      = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  huge_page = false;
+
+  void *addr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (addr != MAP_FAILED) {
+    huge_page = true;
+  } else {
+    LOG_INFO("not enough huge pages reserved, use normal pages instead. size=%zu, error=%s", size, strerror(errno));
+  }
+#endif
+
+  if (addr == MAP_FAILED) {
+    addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+      LOG_ERROR("failed to map anonymous memory. size=%zu, error=%s", size, strerror(errno));
+      return nullptr;
+    }
+#ifdef MADV_HUGEPAGE
+    (void)madvise(addr, size, MADV_HUGEPAGE);
+#endif
+  }
+
+  // 在第一次访问之前设置内存策略，物理页面分配时才会生效
+  if (numa_interleave) {
+#ifdef __linux__
+    interleave_numa_nodes(addr, size);
+#else
+    LOG_INFO("NUMA interleaving is only supported on linux");
+#endif
+  }
+  return addr;
+}
+
+void unmap_anonymous_memory(void *addr, size_t size)
+{
+  if (munmap(addr, size) != 0) {
+    LOG_WARN("failed to unmap memory. addr=%p, size=%zu, error=%s", addr, size, strerror(errno));
+  }
+}
+
 int MemPoolItem::init(int item_size, bool dynamic, int pool_num, int item_num_per_pool)
 {
   if (pools.empty() == false) {
@@ -314,6 +314,120 @@ string MemPoolSimple<T>::to_string()
   return ss.str();
 }
 
+/**
+ * @brief 映射一段匿名内存，优先使用2MB的大页
+ * @details 先尝试 MAP_HUGETLB，系统没有预留足够的大页时，退化成普通的匿名映射，
+ * 并通过 madvise 建议内核使用透明大页。
+ * @param size 需要的内存大小，返回时是按照大页对齐之后实际映射的大小
+ * @param numa_interleave 是否让内存在所有NUMA节点之间交错分配
+ * @param huge_page 返回是否使用了 MAP_HUGETLB 的大页
+ * @return 映射的地址，失败时返回nullptr
+ */
+void *map_anonymous_memory(size_t &size, bool numa_interleave, bool &huge_page);
+void  unmap_anonymous_memory(void *addr, size_t size);
+
+/**
+ * MemPoolMapped reserves the memory of the whole pool up front with `map_anonymous_memory`,
+ * so the pool is backed by huge pages when available and can be interleaved across NUMA nodes.
+ * It can not be extended. The objects are constructed in `init` and destructed in `cleanup`.
+ */
+template <class T>
+class MemPoolMapped : public MemPoolSimple<T>
+{
+public:
+  MemPoolMapped(const char *tag, bool numa_interleave = false)
+      : MemPoolSimple<T>(tag), numa_interleave_(numa_interleave)
+  {}
+
+  virtual ~MemPoolMapped() { cleanup(); }
+
+  /**
+   * reserve pool_num * item_num_per_pool items at once. `dynamic` is ignored
+   * @return 0 for success and others failure
+   */
+  int init(bool dynamic = false, int pool_num = DEFAULT_POOL_NUM, int item_num_per_pool = DEFAULT_ITEM_NUM_PER_POOL);
+
+  void cleanup();
+
+  int extend()
+  {
+    LOG_ERROR("Mapped memory pool can not be extended, this->name:%s", this->name.c_str());
+    return -1;
+  }
+
+  bool   is_huge_page() const { return huge_page_; }
+  size_t get_mapped_size() const { return region_size_; }
+
+private:
+  T     *region_          = nullptr;
+  size_t region_size_     = 0;
+  bool   huge_page_       = false;
+  bool   numa_interleave_ = false;
+};
+
+template <class T>
+int MemPoolMapped<T>::init(bool /*dynamic*/, int pool_num, int item_num_per_pool)
+{
+  if (region_ != nullptr) {
+    LOG_WARN("Memory pool has been initialized, but still begin to be initialized, this->name:%s.", this->name.c_str());
+    return 0;
+  }
+
+  if (pool_num <= 0 || item_num_per_pool <= 0) {
+    LOG_ERROR("Invalid arguments,  pool_num:%d, item_num_per_pool:%d, this->name:%s.",
+              pool_num, item_num_per_pool, this->name.c_str());
+    return -1;
+  }
+
+  const int item_num = pool_num * item_num_per_pool;
+  size_t    size     = sizeof(T) * item_num;
+  void     *addr     = map_anonymous_memory(size, numa_interleave_, huge_page_);
+  if (addr == nullptr) {
+    LOG_ERROR("Failed to map memory pool, size:%zu, this->name:%s.", size, this->name.c_str());
+    return -1;
+  }
+
+  MUTEX_LOCK(&this->mutex);
+  region_      = static_cast<T *>(addr);
+  region_size_ = size;
+  for (int i = 0; i < item_num; i++) {
+    T *item = new (region_ + i) T();
+    this->frees.push_back(item);
+    ASAN_POISON_MEMORY_REGION(item, sizeof(T));
+  }
+  this->item_num_per_pool = item_num_per_pool;
+  this->size              = item_num;
+  this->dynamic           = false;
+  MUTEX_UNLOCK(&this->mutex);
+
+  LOG_INFO("Map memory pool, this->size:%d, mapped size:%zu, huge page:%d, numa interleave:%d, this->name:%s.",
+           this->size, region_size_, huge_page_, numa_interleave_, this->name.c_str());
+  return 0;
+}
+
+template <class T>
+void MemPoolMapped<T>::cleanup()
+{
+  if (region_ == nullptr) {
+    return;
+  }
+
+  MUTEX_LOCK(&this->mutex);
+  ASAN_UNPOISON_MEMORY_REGION(region_, region_size_);
+  for (int i = 0; i < this->size; i++) {
+    region_[i].~T();
+  }
+  this->used.clear();
+  this->frees.clear();
+  this->size = 0;
+
+  unmap_anonymous_memory(region_, region_size_);
+  region_      = nullptr;
+  region_size_ = 0;
+  MUTEX_UNLOCK(&this->mutex);
+  LOG_INFO("Successfully do cleanup, this->name:%s.", this->name.c_str());
+}
+
 class MemPoolItem
 {
 public:
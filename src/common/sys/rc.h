@@ -76,6 +76,7 @@ See the Mulan PSL v2 for more details. */
   DEFINE_RC(LOGBUF_FULL)                 \
   DEFINE_RC(LOG_FILE_FULL)               \
   DEFINE_RC(LOG_ENTRY_INVALID)           \
+  DEFINE_RC(LOG_FILE_VERSION_MISMATCH)   \
   DEFINE_RC(JSON_PARSE_FAILED)           \
   DEFINE_RC(JSON_MEMBER_MISSING)         \
   DEFINE_RC(RANGE_ERROR)                 \
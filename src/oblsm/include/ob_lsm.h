@@ -110,6 +110,19 @@ public:
    */
   virtual RC batch_put(const vector<pair<string, string>> &kvs) = 0;
 
+  /**
+   * @brief Inserts a batch of key-value entries if none of the keys has changed since a snapshot.
+   *
+   * The validation and the write are atomic with respect to other writers. It is used by
+   * `ObLsmTransaction::commit` for optimistic concurrency control: the first transaction to
+   * commit a key wins, and later ones that read an older snapshot fail.
+   *
+   * @param kvs A vector of key-value pairs to insert. An empty value removes the key.
+   * @param snapshot_seq The sequence number of the snapshot the entries are based on.
+   * @return RC::LOCKED_CONCURRENCY_CONFLICT if any key has been written after `snapshot_seq`.
+   */
+  virtual RC batch_put_if_unchanged(const vector<pair<string, string>> &kvs, uint64_t snapshot_seq) = 0;
+
   /**
    * @brief Dumps all SSTables for debugging purposes.
    *
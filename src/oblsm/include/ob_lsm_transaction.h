@@ -20,6 +20,8 @@ See the Mulan PSL v2 for more details. */
 #include "oblsm/util/ob_arena.h"
 #include "oblsm/util/ob_coding.h"
 #include "common/lang/map.h"
+#include "common/lang/memory.h"
+#include "oblsm/util/ob_comparator.h"
 
 namespace oceanbase {
 
@@ -51,13 +53,19 @@ public:
   /*
    * @brief Retrieves the value associated with a given key.
    *
+   * Changes made by this transaction are visible first, then the database as of the
+   * transaction's snapshot. Changes committed by others after the transaction began are invisible.
+   *
    * @param key The key to look up within the database.
    * @param value A pointer to a string where the associated value will be stored, if found.
+   * @return RC::NOT_EXIST if the key does not exist or has been removed.
    */
   RC get(const string_view &key, string *value);
 
   /**
    * @brief Adds or updates a key-value pair within the transaction's in-memory store.
+   *
+   * @note An empty value is treated as a removal, the same as in the database.
    */
   RC put(const string_view &key, const string_view &value);
 
@@ -73,14 +81,24 @@ public:
    * The iterator allows traversal of keys and values within the database. Options can define
    * how data is accessed, such as timestamp.
    *
+   * The iterator merges the transaction's uncommitted changes with the database as of the
+   * transaction's snapshot, so `options.seq` is ignored.
+   *
    * @param options The `ObLsmReadOptions` that define the read behavior of the iterator.
    * @return A pointer to the newly created `ObLsmIterator` object.
+   * @note The iterator must not be used after the transaction is modified.
    */
   ObLsmIterator *new_iterator(ObLsmReadOptions options);
 
   /**
    * @brief Commits the transaction, persisting all transaction changes to the database.
    *
+   * Conflicts are detected optimistically: if any key written by this transaction has been
+   * written by others after the transaction began, the commit fails and nothing is written.
+   * Otherwise all changes are written with a single WAL append and become visible at once.
+   *
+   * @return RC::LOCKED_CONCURRENCY_CONFLICT if a write-write conflict is detected.
+   * @note The transaction can not be used after commit or rollback, even if the commit fails.
    */
   RC commit();
 
@@ -101,6 +119,8 @@ private:
   /**
    * @brief The transaction's unique timestamp.
    *
+   * It is the sequence number of the last entry visible to the transaction, reads see the
+   * database as of this sequence number.
    */
   uint64_t ts_ = 0;
 
@@ -109,7 +129,7 @@ private:
    *
    * This map holds key-value pairs that have been inserted or removed within the
    * transaction scope but not yet committed to the database. It's used to track changes
-   * and ensure atomicity during commit operations.
+   * and ensure atomicity during commit operations. Removed keys have empty values.
    */
   map<string, string> inner_store_;
 };
@@ -117,7 +137,66 @@ private:
 /**
  * @class TrxInnerMapIterator
  * @brief An iterator for traversing the transaction's in-memory store
+ * @details Keys are user keys. Removed keys are also returned, with empty values.
  */
 class TrxInnerMapIterator : public ObLsmIterator
-{};
+{
+public:
+  explicit TrxInnerMapIterator(const map<string, string> &store) : store_(store), iter_(store.end()) {}
+  ~TrxInnerMapIterator() override = default;
+
+  bool valid() const override { return iter_ != store_.end(); }
+  void seek_to_first() override { iter_ = store_.begin(); }
+  void seek_to_last() override;
+  void seek(const string_view &key) override { iter_ = store_.lower_bound(string(key)); }
+  void next() override { ++iter_; }
+
+  string_view key() const override { return iter_->first; }
+  string_view value() const override { return iter_->second; }
+
+private:
+  const map<string, string>          &store_;
+  map<string, string>::const_iterator iter_;
+};
+
+/**
+ * @class TrxIterator
+ * @brief Merges the transaction's in-memory store with the database
+ * @details `left_` iterates the transaction's in-memory store and `right_` the database.
+ * If the two iterators have the same key, only produce the key once and prefer the entry
+ * from left. Keys removed in the transaction are skipped.
+ */
+class TrxIterator : public ObLsmIterator
+{
+public:
+  TrxIterator(ObLsmIterator *left, ObLsmIterator *right) : left_(left), right_(right) {}
+  ~TrxIterator() override = default;
+
+  bool valid() const override { return current_ != nullptr; }
+  void seek_to_first() override;
+
+  /**
+   * @note It takes a full scan, as `right_` is not required to support seek_to_last.
+   */
+  void seek_to_last() override;
+  void seek(const string_view &key) override;
+  void next() override;
+
+  string_view key() const override { return current_->key(); }
+  string_view value() const override { return current_->value(); }
+
+private:
+  /**
+   * @brief Points `current_` to the smaller entry of the two iterators.
+   * @details An entry of `right_` with the same key as `left_` is skipped, and so is an
+   * entry of `left_` removed in the transaction.
+   */
+  void find_next_entry();
+
+private:
+  unique_ptr<ObLsmIterator> left_;
+  unique_ptr<ObLsmIterator> right_;
+  ObLsmIterator            *current_ = nullptr;
+  ObDefaultComparator       comparator_;
+};
 }  // namespace oceanbase
\ No newline at end of file
@@ -10,6 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/ob_lsm_impl.h"
 
+#include "common/lang/limits.h"
 #include "common/log/log.h"
 #include "common/sys/rc.h"
 #include "oblsm/include/ob_lsm.h"
@@ -78,6 +79,11 @@ RC ObLsmImpl::recover()
 
   // Recover memtable from WAL file.
   wal_ = std::make_unique<WAL>();
+  rc   = wal_->open(get_wal_path(memtable_id_.load()));
+  if (rc != RC::SUCCESS) {
+    LOG_ERROR("Failed to open wal file, rc=%s", strrc(rc));
+    return rc;
+  }
 
   // After recover from the old manifest file, write the snapshot into a new manifest file.
   if (!compaction_records.empty()) {
@@ -110,7 +116,7 @@ RC ObLsmImpl::put(const string_view &key, const string_view &value)
   // and the skiplist concurently write is not thread safe, so we use mutex here,
   // if the skiplist support `insert_concurrently()` interface, can we remove the mutex?
   unique_lock<mutex> lock(mu_);
-  uint64_t           seq = seq_.fetch_add(1);
+  uint64_t           seq = seq_.load() + 1;
   // Write WAL
   rc = wal_->put(seq, key, value);
   if (rc != RC::SUCCESS) {
@@ -126,6 +132,80 @@ RC ObLsmImpl::put(const string_view &key, const string_view &value)
   }
   // write memtable
   mem_table_->put(seq, key, value);
+  // readers only see entries whose seq is not greater than `seq_`, so publish it after the memtable is written.
+  seq_.store(seq);
+  return make_room_for_write(lock, seq);
+}
+
+RC ObLsmImpl::batch_put(const vector<pair<string, string>> &kvs) { return write_batch(kvs, nullptr); }
+
+RC ObLsmImpl::batch_put_if_unchanged(const vector<pair<string, string>> &kvs, uint64_t snapshot_seq)
+{
+  return write_batch(kvs, &snapshot_seq);
+}
+
+RC ObLsmImpl::write_batch(const vector<pair<string, string>> &kvs, const uint64_t *snapshot_seq)
+{
+  if (kvs.empty()) {
+    return RC::SUCCESS;
+  }
+
+  RC                 rc = RC::SUCCESS;
+  unique_lock<mutex> lock(mu_);
+  // All writers hold `mu_`, so no key can be written between the validation and the write below.
+  if (snapshot_seq != nullptr) {
+    for (const auto &kv : kvs) {
+      const uint64_t latest_seq = latest_seq_of(kv.first);
+      if (latest_seq > *snapshot_seq) {
+        LOG_TRACE("write conflict. key has been written after snapshot. latest seq=%lu, snapshot seq=%lu",
+                  latest_seq, *snapshot_seq);
+        return RC::LOCKED_CONCURRENCY_CONFLICT;
+      }
+    }
+  }
+
+  const uint64_t first_seq = seq_.load() + 1;
+  rc                       = wal_->put_batch(first_seq, kvs);
+  if (rc != RC::SUCCESS) {
+    return rc;
+  }
+
+  if (options_.force_sync_new_log) {
+    rc = wal_->sync();
+    if (rc != RC::SUCCESS) {
+      LOG_ERROR("Failed to sync wal logs, rc=%s", strrc(rc));
+      return rc;
+    }
+  }
+
+  uint64_t seq = first_seq;
+  for (const auto &kv : kvs) {
+    mem_table_->put(seq++, kv.first, kv.second);
+  }
+  // publish the whole batch at once, readers never see part of it.
+  seq_.store(seq - 1);
+  return make_room_for_write(lock, seq - 1);
+}
+
+uint64_t ObLsmImpl::latest_seq_of(const string_view &key)
+{
+  string lookup_key;
+  put_numeric<uint64_t>(&lookup_key, key.size() + SEQ_SIZE);
+  lookup_key.append(key.data(), key.size());
+  // internal keys of the same user key are sorted by seq in descending order
+  put_numeric<uint64_t>(&lookup_key, numeric_limits<uint64_t>::max());
+
+  unique_ptr<ObLsmIterator> iter(new_internal_iterator());
+  iter->seek(lookup_key);
+  if (iter->valid() && extract_user_key(iter->key()) == key) {
+    return extract_sequence(iter->key());
+  }
+  return 0;
+}
+
+RC ObLsmImpl::make_room_for_write(unique_lock<mutex> &lock, uint64_t seq)
+{
+  RC     rc       = RC::SUCCESS;
   size_t mem_size = mem_table_->appro_memory_usage();
   if (mem_size > options_.memtable_size) {
     // Thinking point: here vector is used to store imems,
@@ -148,9 +228,8 @@ RC ObLsmImpl::put(const string_view &key, const string_view &value)
   return rc;
 }
 
-RC ObLsmImpl::batch_put(const vector<pair<string, string>> &kvs) { return RC::UNIMPLEMENTED; }
-
-RC ObLsmImpl::remove(const string_view &key) { return RC::UNIMPLEMENTED; }
+// an entry with an empty value is a tombstone, see `ObUserIterator`.
+RC ObLsmImpl::remove(const string_view &key) { return put(key, string_view()); }
 
 RC ObLsmImpl::try_freeze_memtable()
 {
@@ -314,9 +393,8 @@ string ObLsmImpl::get_wal_path(uint64_t memtable_id)
 
 RC ObLsmImpl::get(const string_view &key, string *value)
 {
-  RC                 rc = RC::SUCCESS;
-  unique_lock<mutex> lock(mu_);
-  auto               iter = unique_ptr<ObLsmIterator>(new_iterator(ObLsmReadOptions{}));
+  RC   rc   = RC::SUCCESS;
+  auto iter = unique_ptr<ObLsmIterator>(new_iterator(ObLsmReadOptions{}));
   iter->seek(key);
   if (iter->valid() && iter->key() == key) {
     if (iter->value().empty()) {
@@ -332,7 +410,17 @@ RC ObLsmImpl::get(const string_view &key, string *value)
 
 ObLsmIterator *ObLsmImpl::new_iterator(ObLsmReadOptions options)
 {
-  unique_lock<mutex>     lock(mu_);
+  unique_lock<mutex> lock(mu_);
+  // `seq_` is published after the entries are written, read it before getting the tables
+  // so that all entries visible to the iterator are in these tables.
+  const uint64_t     seq  = options.seq == -1 ? seq_.load() : options.seq;
+  ObLsmIterator     *iter = new_internal_iterator();
+  lock.unlock();
+  return new_user_iterator(iter, seq);
+}
+
+ObLsmIterator *ObLsmImpl::new_internal_iterator()
+{
   shared_ptr<ObMemTable> mem = mem_table_;
 
   shared_ptr<ObMemTable> imm = nullptr;
@@ -343,7 +431,6 @@ ObLsmIterator *ObLsmImpl::new_iterator(ObLsmReadOptions options)
   for (auto &level : *sstables_) {
     sstables.insert(sstables.end(), level.begin(), level.end());
   }
-  lock.unlock();
   vector<unique_ptr<ObLsmIterator>> iters;
   iters.emplace_back(mem->new_iterator());
   if (imm != nullptr) {
@@ -353,8 +440,7 @@ ObLsmIterator *ObLsmImpl::new_iterator(ObLsmReadOptions options)
     iters.emplace_back(sst->new_iterator());
   }
 
-  return new_user_iterator(
-      new_merging_iterator(&internal_key_comparator_, std::move(iters)), options.seq == -1 ? seq_.load() : options.seq);
+  return new_merging_iterator(&internal_key_comparator_, std::move(iters));
 }
 
 ObLsmTransaction *ObLsmImpl::begin_transaction() { return new ObLsmTransaction(this, seq_.load()); }
@@ -62,6 +62,7 @@ public:
 
   RC recover();
   RC batch_put(const std::vector<pair<string, string>> &kvs) override;
+  RC batch_put_if_unchanged(const vector<pair<string, string>> &kvs, uint64_t snapshot_seq) override;
 
   // used for debug
   void dump_sstables() override;
@@ -74,6 +75,39 @@ private:
   RC write_manifest_snapshot();
 
 private:
+  /**
+   * @brief Writes a batch of entries with consecutive sequence numbers.
+   *
+   * The entries are written to the WAL with a single append, then to the memtable, and become
+   * visible to readers at the same time.
+   *
+   * @param kvs The entries to write.
+   * @param snapshot_seq If not null, fails with `RC::LOCKED_CONCURRENCY_CONFLICT` when any key has
+   *                     a version newer than `*snapshot_seq`.
+   */
+  RC write_batch(const vector<pair<string, string>> &kvs, const uint64_t *snapshot_seq);
+
+  /**
+   * @brief Returns the sequence number of the latest version of `key`, or 0 if it has never been written.
+   * @note The caller must hold `mu_`.
+   */
+  uint64_t latest_seq_of(const string_view &key);
+
+  /**
+   * @brief Creates an iterator over the internal keys of all memtables and SSTables.
+   * @note The caller must hold `mu_`.
+   */
+  ObLsmIterator *new_internal_iterator();
+
+  /**
+   * @brief Freezes the active memtable if it is full after a write.
+   *
+   * @param lock The lock of `mu_` held by the writer, may be released while waiting for the
+   *             previous frozen memtable to be flushed.
+   * @param seq The sequence number of the last written entry.
+   */
+  RC make_room_for_write(unique_lock<mutex> &lock, uint64_t seq);
+
   /**
    * @brief Attempts to freeze the current active MemTable.
    *
@@ -168,7 +202,7 @@ private:
   SSTablesPtr                       sstables_;
   common::ThreadPoolExecutor        executor_;
   ObManifest                        manifest_;
-  atomic<uint64_t>                  seq_{0};
+  atomic<uint64_t>                  seq_{0};  // sequence number of the last visible entry
   atomic<uint64_t>                  sstable_id_{0};
   atomic<uint64_t>                  memtable_id_{0};
   condition_variable                cv_;
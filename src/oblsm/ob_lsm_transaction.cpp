@@ -10,52 +10,144 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/include/ob_lsm_transaction.h"
 #include "oblsm/util/ob_comparator.h"
+#include "common/lang/iterator.h"
 #include "common/lang/memory.h"
+#include "common/lang/vector.h"
 
 namespace oceanbase {
 
-/**
- * @brief merge TrxInnerMapIterator and ObUserIterator
- * @details Merges two iterators of different types into one.
- * If the two iterators have the same key, only
- * produce the key once and prefer the entry from left.
- */
-class TrxIterator : public ObLsmIterator
+void TrxIterator::seek_to_first()
 {
-public:
-  TrxIterator(ObLsmIterator *left, ObLsmIterator *right) : left_(left), right_(right) {}
-  ~TrxIterator() override = default;
+  left_->seek_to_first();
+  right_->seek_to_first();
+  find_next_entry();
+}
 
-  bool valid() const override { return false; }
-  void seek_to_first() override {}
-  void seek_to_last() override {}
-  void seek(const string_view &key) override {}
-  void next() override {}
+void TrxIterator::seek_to_last()
+{
+  // `ObUserIterator` can neither seek to last nor move backward, and the last key of
+  // `right_` may be removed in the transaction, so find the last key by a forward scan.
+  seek_to_first();
+  if (!valid()) {
+    return;
+  }
 
-  string_view key() const override { return ""; }
-  string_view value() const override { return ""; }
+  string last_key;
+  while (valid()) {
+    last_key.assign(key().data(), key().size());
+    next();
+  }
+  seek(last_key);
+}
 
-private:
-  unique_ptr<ObLsmIterator> left_;
-  unique_ptr<ObLsmIterator> right_;
-};
+void TrxIterator::seek(const string_view &key)
+{
+  left_->seek(key);
+  right_->seek(key);
+  find_next_entry();
+}
 
-ObLsmTransaction::ObLsmTransaction(ObLsm *db, uint64_t ts) : db_(db), ts_(ts)
+void TrxIterator::next()
 {
-  (void)db_;
-  (void)ts_;
+  current_->next();
+  find_next_entry();
 }
 
-RC ObLsmTransaction::get(const string_view &key, string *value) { return RC::UNIMPLEMENTED; }
+void TrxIterator::find_next_entry()
+{
+  while (true) {
+    const bool left_valid  = left_->valid();
+    const bool right_valid = right_->valid();
+    if (!left_valid && !right_valid) {
+      current_ = nullptr;
+      return;
+    }
+
+    if (!left_valid) {
+      current_ = right_.get();
+      return;
+    }
 
-RC ObLsmTransaction::put(const string_view &key, const string_view &value) { return RC::UNIMPLEMENTED; }
+    const int cmp = right_valid ? comparator_.compare(left_->key(), right_->key()) : -1;
+    if (cmp > 0) {
+      current_ = right_.get();
+      return;
+    }
 
-RC ObLsmTransaction::remove(const string_view &key) { return RC::UNIMPLEMENTED; }
+    if (cmp == 0) {
+      right_->next();
+    }
+    if (!left_->value().empty()) {
+      current_ = left_.get();
+      return;
+    }
+    left_->next();
+  }
+}
+
+void TrxInnerMapIterator::seek_to_last() { iter_ = store_.empty() ? store_.end() : std::prev(store_.end()); }
 
-ObLsmIterator *ObLsmTransaction::new_iterator(ObLsmReadOptions options) { return nullptr; }
+ObLsmTransaction::ObLsmTransaction(ObLsm *db, uint64_t ts) : db_(db), ts_(ts) {}
 
-RC ObLsmTransaction::commit() { return RC::UNIMPLEMENTED; }
+RC ObLsmTransaction::get(const string_view &key, string *value)
+{
+  auto store_iter = inner_store_.find(string(key));
+  if (store_iter != inner_store_.end()) {
+    if (store_iter->second.empty()) {
+      return RC::NOT_EXIST;
+    }
+    value->assign(store_iter->second);
+    return RC::SUCCESS;
+  }
 
-RC ObLsmTransaction::rollback() { return RC::UNIMPLEMENTED; }
+  ObLsmReadOptions options;
+  options.seq = static_cast<int64_t>(ts_);
+  unique_ptr<ObLsmIterator> iter(db_->new_iterator(options));
+  iter->seek(key);
+  if (!iter->valid() || iter->key() != key || iter->value().empty()) {
+    return RC::NOT_EXIST;
+  }
+  value->assign(iter->value());
+  return RC::SUCCESS;
+}
+
+RC ObLsmTransaction::put(const string_view &key, const string_view &value)
+{
+  inner_store_[string(key)].assign(value.data(), value.size());
+  return RC::SUCCESS;
+}
+
+RC ObLsmTransaction::remove(const string_view &key)
+{
+  inner_store_[string(key)].clear();
+  return RC::SUCCESS;
+}
+
+ObLsmIterator *ObLsmTransaction::new_iterator(ObLsmReadOptions options)
+{
+  options.seq = static_cast<int64_t>(ts_);
+  return new TrxIterator(new TrxInnerMapIterator(inner_store_), db_->new_iterator(options));
+}
+
+RC ObLsmTransaction::commit()
+{
+  if (inner_store_.empty()) {
+    return RC::SUCCESS;
+  }
+
+  vector<pair<string, string>> kvs;
+  kvs.reserve(inner_store_.size());
+  for (auto &[key, value] : inner_store_) {
+    kvs.emplace_back(key, std::move(value));
+  }
+  inner_store_.clear();
+  return db_->batch_put_if_unchanged(kvs, ts_);
+}
+
+RC ObLsmTransaction::rollback()
+{
+  inner_store_.clear();
+  return RC::SUCCESS;
+}
 
 }  // namespace oceanbase
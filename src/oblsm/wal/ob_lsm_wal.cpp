@@ -10,10 +10,63 @@
 
 #include "oblsm/wal/ob_lsm_wal.h"
 #include "common/log/log.h"
+#include "oblsm/util/ob_coding.h"
 #include "oblsm/util/ob_file_reader.h"
 
 namespace oceanbase {
 RC WAL::recover(const std::string &wal_file, std::vector<WalRecord> &wal_records) { return RC::UNIMPLEMENTED; }
 
-RC WAL::put(uint64_t seq, string_view key, string_view val) { return RC::UNIMPLEMENTED; }
+RC WAL::open(const std::string &filename)
+{
+  filename_ = filename;
+  writer_   = ObFileWriter::create_file_writer(filename, true /*append*/);
+  if (writer_ == nullptr) {
+    LOG_WARN("failed to open wal file. filename=%s", filename.c_str());
+    return RC::IOERR_OPEN;
+  }
+  return RC::SUCCESS;
+}
+
+void WAL::encode_record(string &buf, uint64_t seq, string_view key, string_view val)
+{
+  put_numeric<uint64_t>(&buf, seq);
+  put_numeric<size_t>(&buf, key.size());
+  buf.append(key.data(), key.size());
+  put_numeric<size_t>(&buf, val.size());
+  buf.append(val.data(), val.size());
+}
+
+RC WAL::put(uint64_t seq, string_view key, string_view val)
+{
+  if (writer_ == nullptr) {
+    return RC::FILE_NOT_OPENED;
+  }
+
+  string buf;
+  put_numeric<uint32_t>(&buf, 1);
+  encode_record(buf, seq, key, val);
+  return writer_->write(buf);
+}
+
+RC WAL::put_batch(uint64_t seq, const vector<pair<string, string>> &kvs)
+{
+  if (writer_ == nullptr) {
+    return RC::FILE_NOT_OPENED;
+  }
+
+  string buf;
+  put_numeric<uint32_t>(&buf, static_cast<uint32_t>(kvs.size()));
+  for (const auto &[key, val] : kvs) {
+    encode_record(buf, seq++, key, val);
+  }
+  return writer_->write(buf);
+}
+
+RC WAL::sync()
+{
+  if (writer_ == nullptr) {
+    return RC::FILE_NOT_OPENED;
+  }
+  return writer_->flush();
+}
 }  // namespace oceanbase
\ No newline at end of file
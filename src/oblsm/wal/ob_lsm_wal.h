@@ -13,7 +13,10 @@
 //
 #pragma once
 
+#include "common/lang/memory.h"
 #include "common/lang/mutex.h"
+#include "common/lang/utility.h"
+#include "common/lang/vector.h"
 #include "common/sys/rc.h"
 #include "oblsm/util/ob_file_writer.h"
 
@@ -62,6 +65,11 @@ struct WalRecord
  *
  * The data is written to the file in the order: key length, key, value length, value.
  * After writing the data, the system performs a `flush()` operation to ensure the data is persisted.
+ *
+ * Entries are appended in groups. Each group starts with a **Record Count (uint32_t)** followed by that
+ * many entries, and is written with a single append. `put` writes a group of one entry, `put_batch` writes
+ * all entries of a transaction as one group. A crash can only cut off the last group, and recovery must
+ * drop an incomplete group as a whole, so a transaction is either fully recovered or not at all.
  */
 class WAL
 {
@@ -85,7 +93,7 @@ public:
    * @param filename The name of the WAL file to write logs.
    * @return `RC::SUCCESS` if the file was successfully opened, or an error code if it failed.
    */
-  RC open(const std::string &filename) { return RC::UNIMPLEMENTED; }
+  RC open(const std::string &filename);
 
   /**
    * @brief Recovers data from a specified WAL file.
@@ -111,17 +119,36 @@ public:
    */
   RC put(uint64_t seq, std::string_view key, std::string_view val);
 
+  /**
+   * @brief Writes a batch of key-value pairs to the WAL as one group.
+   *
+   * The entries get consecutive sequence numbers starting from `seq`, in the order of `kvs`.
+   * All entries are serialized into one buffer and appended with a single write.
+   *
+   * @param seq The sequence number of the first record.
+   * @param kvs The key-value pairs to write.
+   * @return `RC::SUCCESS` if the write operation is successful, or an error code if it fails.
+   */
+  RC put_batch(uint64_t seq, const vector<pair<string, string>> &kvs);
+
   /**
    * @brief Synchronizes the WAL to disk.
    * Forces any buffered data in the WAL to be written to the underlying storage.
    *
    * @return `RC::SUCCESS` if the sync operation is successful, or an error code if it fails.
    */
-  RC sync() { return RC::UNIMPLEMENTED; }
+  RC sync();
 
   const string &filename() const { return filename_; }
 
 private:
-  string filename_;
+  /**
+   * @brief Appends one entry to `buf` in the serialization format.
+   */
+  static void encode_record(string &buf, uint64_t seq, std::string_view key, std::string_view val);
+
+private:
+  string                   filename_;
+  unique_ptr<ObFileWriter> writer_;
 };
 }  // namespace oceanbase
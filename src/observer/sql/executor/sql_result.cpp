@@ -47,7 +47,7 @@ RC SqlResult::close()
 
   if (session_ && !session_->is_trx_multi_operation_mode()) {
     if (rc == RC::SUCCESS) {
-      rc = session_->current_trx()->commit();
+      rc = session_->current_trx()->autocommit();
     } else {
       RC rc2 = session_->current_trx()->rollback();
       if (rc2 != RC::SUCCESS) {
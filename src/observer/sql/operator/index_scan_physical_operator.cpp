@@ -17,16 +17,15 @@ See the Mulan PSL v2 for more details. */
 #include "storage/trx/trx.h"
 
 IndexScanPhysicalOperator::IndexScanPhysicalOperator(Table *table, Index *index, ReadWriteMode mode,
-    const Value *left_value, bool left_inclusive, const Value *right_value, bool right_inclusive)
-    : table_(table), index_(index), mode_(mode), left_inclusive_(left_inclusive), right_inclusive_(right_inclusive)
-{
-  if (left_value) {
-    left_value_ = *left_value;
-  }
-  if (right_value) {
-    right_value_ = *right_value;
-  }
-}
+    vector<Value> left_values, bool left_inclusive, vector<Value> right_values, bool right_inclusive)
+    : table_(table),
+      index_(index),
+      mode_(mode),
+      left_values_(std::move(left_values)),
+      right_values_(std::move(right_values)),
+      left_inclusive_(left_inclusive),
+      right_inclusive_(right_inclusive)
+{}
 
 RC IndexScanPhysicalOperator::open(Trx *trx)
 {
@@ -34,19 +33,53 @@ RC IndexScanPhysicalOperator::open(Trx *trx)
     return RC::INTERNAL;
   }
 
-  IndexScanner *index_scanner = index_->create_scanner(left_value_.data(),
-      left_value_.length(),
-      left_inclusive_,
-      right_value_.data(),
-      right_value_.length(),
-      right_inclusive_);
-  if (nullptr == index_scanner) {
-    LOG_WARN("failed to create index scanner");
-    return RC::INTERNAL;
+  vector<char> left_buffer;
+  vector<char> right_buffer;
+  int          left_len  = 0;
+  int          right_len = 0;
+  const char  *left_key  = make_key(left_values_, left_buffer, left_len);
+  const char  *right_key = make_key(right_values_, right_buffer, right_len);
+
+  RC rc = RC::SUCCESS;
+  if (point_get_) {
+    point_rids_.clear();
+    point_index_ = 0;
+    // 比字段还长的字符串不可能与字段相等
+    if (left_len <= index_->key_length()) {
+      rc = index_->get_entries(left_key, left_len, point_rids_);
+      if (OB_FAIL(rc)) {
+        LOG_WARN("failed to get entries from index. index=%s, rc=%s", index_->index_meta().name(), strrc(rc));
+        return rc;
+      }
+    }
+  } else {
+    IndexScanner *index_scanner =
+        index_->create_scanner(left_key, left_len, left_inclusive_, right_key, right_len, right_inclusive_);
+    if (nullptr == index_scanner) {
+      LOG_WARN("failed to create index scanner");
+      return RC::INTERNAL;
+    }
+    index_scanner_ = index_scanner;
   }
-  index_scanner_ = index_scanner;
 
   tuple_.set_schema(table_, table_->table_meta().field_metas());
+  tuple_record_ = &current_record_;
+
+  if (index_only_) {
+    const int record_size = table_->table_meta().record_size();
+    key_buffer_.resize(index_->key_length());
+    rc = index_record_.new_record(record_size);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    memset(index_record_.data(), 0, record_size);
+
+    // 点查到的记录键值都相同，就是查找用的键值
+    if (point_get_ && left_len <= index_->key_length()) {
+      memset(key_buffer_.data(), 0, key_buffer_.size());
+      memcpy(key_buffer_.data(), left_key, left_len);
+    }
+  }
 
   trx_ = trx;
   return RC::SUCCESS;
@@ -54,12 +87,16 @@ RC IndexScanPhysicalOperator::open(Trx *trx)
 
 RC IndexScanPhysicalOperator::next()
 {
+  if (index_only_) {
+    return next_index_only();
+  }
+
   // TODO: 需要适配 lsm-tree 引擎
   RID rid;
   RC  rc = RC::SUCCESS;
 
   bool filter_result = false;
-  while (RC::SUCCESS == (rc = index_scanner_->next_entry(&rid))) {
+  while (RC::SUCCESS == (rc = next_entry(rid, nullptr))) {
     rc = table_->get_record(rid, current_record_);
     if (OB_FAIL(rc)) {
       LOG_TRACE("failed to get record. rid=%s, rc=%s", rid.to_string().c_str(), strrc(rc));
@@ -92,16 +129,81 @@ RC IndexScanPhysicalOperator::next()
   return rc;
 }
 
+RC IndexScanPhysicalOperator::next_index_only()
+{
+  RID rid;
+  RC  rc = RC::SUCCESS;
+
+  bool filter_result = false;
+  while (RC::SUCCESS == (rc = next_entry(rid, key_buffer_.data()))) {
+    const bool need_record = !trx_->is_visible_without_record(table_, rid, mode_);
+    if (need_record) {
+      rc = table_->get_record(rid, current_record_);
+      if (OB_FAIL(rc)) {
+        LOG_TRACE("failed to get record. rid=%s, rc=%s", rid.to_string().c_str(), strrc(rc));
+        return rc;
+      }
+      tuple_record_ = &current_record_;
+    } else {
+      // 键值中各个字段按照索引字段的顺序紧挨着存放
+      const char *key = key_buffer_.data();
+      for (const FieldMeta &field_meta : index_->field_metas()) {
+        memcpy(index_record_.data() + field_meta.offset(), key, field_meta.len());
+        key += field_meta.len();
+      }
+      index_record_.set_rid(rid);
+      tuple_record_ = &index_record_;
+    }
+
+    tuple_.set_record(tuple_record_);
+    rc = filter(tuple_, filter_result);
+    if (OB_FAIL(rc)) {
+      LOG_TRACE("failed to filter record. rc=%s", strrc(rc));
+      return rc;
+    }
+
+    if (!filter_result) {
+      continue;
+    }
+
+    if (!need_record) {
+      return RC::SUCCESS;
+    }
+
+    rc = trx_->visit_record(table_, current_record_, mode_);
+    if (rc != RC::RECORD_INVISIBLE) {
+      return rc;
+    }
+  }
+
+  return rc;
+}
+
+RC IndexScanPhysicalOperator::next_entry(RID &rid, char *key)
+{
+  if (point_get_) {
+    if (point_index_ >= point_rids_.size()) {
+      return RC::RECORD_EOF;
+    }
+    rid = point_rids_[point_index_++];
+    return RC::SUCCESS;
+  }
+
+  return key == nullptr ? index_scanner_->next_entry(&rid) : index_scanner_->next_entry(&rid, key);
+}
+
 RC IndexScanPhysicalOperator::close()
 {
-  index_scanner_->destroy();
-  index_scanner_ = nullptr;
+  if (index_scanner_ != nullptr) {
+    index_scanner_->destroy();
+    index_scanner_ = nullptr;
+  }
   return RC::SUCCESS;
 }
 
 Tuple *IndexScanPhysicalOperator::current_tuple()
 {
-  tuple_.set_record(&current_record_);
+  tuple_.set_record(tuple_record_);
   return &tuple_;
 }
 
@@ -110,6 +212,29 @@ void IndexScanPhysicalOperator::set_predicates(vector<unique_ptr<Expression>> &&
   predicates_ = std::move(exprs);
 }
 
+const char *IndexScanPhysicalOperator::make_key(const vector<Value> &values, vector<char> &buffer, int &length) const
+{
+  length = 0;
+  if (values.empty()) {
+    return nullptr;
+  }
+
+  const vector<FieldMeta> &field_metas = index_->field_metas();
+  if (field_metas.size() == 1) {
+    length = values[0].length();
+    return values[0].data();
+  }
+
+  buffer.clear();
+  for (size_t i = 0; i < values.size() && i < field_metas.size(); i++) {
+    const int offset = static_cast<int>(buffer.size());
+    buffer.resize(offset + field_metas[i].len(), 0);
+    memcpy(buffer.data() + offset, values[i].data(), min(values[i].length(), field_metas[i].len()));
+  }
+  length = static_cast<int>(buffer.size());
+  return buffer.data();
+}
+
 RC IndexScanPhysicalOperator::filter(RowTuple &tuple, bool &result)
 {
   RC    rc = RC::SUCCESS;
@@ -133,5 +258,6 @@ RC IndexScanPhysicalOperator::filter(RowTuple &tuple, bool &result)
 
 string IndexScanPhysicalOperator::param() const
 {
-  return string(index_->index_meta().name()) + " ON " + table_->name();
+  return string(index_->index_meta().name()) + " ON " + table_->name() + (point_get_ ? " POINT GET" : "") +
+         (index_only_ ? " INDEX ONLY" : "");
 }
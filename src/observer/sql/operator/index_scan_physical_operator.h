@@ -21,12 +21,14 @@ See the Mulan PSL v2 for more details. */
 /**
  * @brief 索引扫描物理算子
  * @ingroup PhysicalOperator
+ * @details 扫描范围的左右边界按照索引字段的顺序给出每个字段的值，可以只给出前面几个字段。
+ * 边界为空表示没有限制。
  */
 class IndexScanPhysicalOperator : public PhysicalOperator
 {
 public:
-  IndexScanPhysicalOperator(Table *table, Index *index, ReadWriteMode mode, const Value *left_value,
-      bool left_inclusive, const Value *right_value, bool right_inclusive);
+  IndexScanPhysicalOperator(Table *table, Index *index, ReadWriteMode mode, vector<Value> left_values,
+      bool left_inclusive, vector<Value> right_values, bool right_inclusive);
 
   virtual ~IndexScanPhysicalOperator() = default;
 
@@ -42,10 +44,45 @@ public:
 
   void set_predicates(vector<unique_ptr<Expression>> &&exprs);
 
+  /**
+   * @brief 只扫描索引，不回表
+   * @details 查询用到的字段都在索引中时使用。事务能确定记录可见时，直接用键值中的字段拼出一行数据，
+   * 其它字段都是0；不能确定时仍然回表读取记录检查可见性
+   */
+  void set_index_only(bool index_only) { index_only_ = index_only; }
+
+  /**
+   * @brief 唯一索引上所有字段都是等值条件时，直接查找键值，不创建扫描器
+   * @details 唯一索引中相同键值的有效记录最多只有一条，但还没有清理的旧版本仍然在索引中，
+   * 所以查找的结果还是一组记录，需要逐个检查可见性
+   */
+  void set_point_get(bool point_get) { point_get_ = point_get; }
+
 private:
   // 与TableScanPhysicalOperator代码相同，可以优化
   RC filter(RowTuple &tuple, bool &result);
 
+  /**
+   * @brief 只扫描索引时，取下一条可见的记录
+   */
+  RC next_index_only();
+
+  /**
+   * @brief 取下一个索引项
+   * @param key 不为空时同时返回键值
+   */
+  RC next_entry(RID &rid, char *key);
+
+  /**
+   * @brief 把边界中各个字段的值拼接成索引的键值
+   * @details 单个字段时直接使用值本身，由索引处理变长字段。
+   * 多个字段时每个字段都按照字段的长度存放
+   * @param buffer 多个字段时存放拼接好的键值
+   * @param[out] length 键值的长度
+   * @return 没有边界时返回 nullptr
+   */
+  const char *make_key(const vector<Value> &values, vector<char> &buffer, int &length) const;
+
 private:
   Trx          *trx_           = nullptr;
   Table        *table_         = nullptr;
@@ -56,10 +93,19 @@ private:
   Record   current_record_;
   RowTuple tuple_;
 
-  Value left_value_;
-  Value right_value_;
-  bool  left_inclusive_  = false;
-  bool  right_inclusive_ = false;
+  bool         index_only_ = false;
+  vector<char> key_buffer_;              ///< 只扫描索引时存放当前的键值
+  Record       index_record_;            ///< 只扫描索引时用键值拼出来的记录
+  Record      *tuple_record_ = nullptr;  ///< 当前这一行数据来自哪个记录
+
+  bool        point_get_ = false;
+  vector<RID> point_rids_;       ///< 点查的结果，重复打开时复用
+  size_t      point_index_ = 0;  ///< 下一个要返回的点查结果
+
+  vector<Value> left_values_;
+  vector<Value> right_values_;
+  bool          left_inclusive_  = false;
+  bool          right_inclusive_ = false;
 
   vector<unique_ptr<Expression>> predicates_;
 };
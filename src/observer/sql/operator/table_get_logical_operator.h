@@ -57,6 +57,14 @@ public:
   void set_predicates(vector<unique_ptr<Expression>> &&exprs);
   auto predicates() -> vector<unique_ptr<Expression>> & { return predicates_; }
 
+  /**
+   * @brief 设置整个查询中用到的这张表的字段
+   * @details 生成物理计划时据此判断索引是否覆盖了查询需要的所有字段。没有设置过时认为用到了所有字段
+   */
+  void set_referenced_fields(vector<const FieldMeta *> &&fields);
+  bool referenced_fields_known() const { return referenced_fields_known_; }
+  auto referenced_fields() const -> const vector<const FieldMeta *> & { return referenced_fields_; }
+
 private:
   Table        *table_ = nullptr;
   ReadWriteMode mode_  = ReadWriteMode::READ_WRITE;
@@ -66,4 +74,7 @@ private:
   // 不包含复杂的表达式运算，比如加减乘除、或者conjunction expression
   // 如果有多个表达式，他们的关系都是 AND
   vector<unique_ptr<Expression>> predicates_;
+
+  bool                      referenced_fields_known_ = false;
+  vector<const FieldMeta *> referenced_fields_;  ///< 查询中用到的这张表的字段
 };
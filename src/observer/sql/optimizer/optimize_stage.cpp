@@ -18,12 +18,18 @@ See the Mulan PSL v2 for more details. */
 
 #include "common/conf/ini.h"
 #include "common/io/io.h"
+#include "common/lang/algorithm.h"
 #include "common/lang/string.h"
 #include "common/log/log.h"
 #include "event/session_event.h"
 #include "event/sql_event.h"
 #include "sql/operator/logical_operator.h"
 #include "sql/stmt/stmt.h"
+#include "sql/expr/expression_iterator.h"
+#include "sql/operator/group_by_logical_operator.h"
+#include "sql/operator/join_logical_operator.h"
+#include "sql/operator/order_by_logical_operator.h"
+#include "sql/operator/table_get_logical_operator.h"
 #include "sql/optimizer/cascade/optimizer.h"
 #include "sql/optimizer/optimizer_utils.h"
 
@@ -51,6 +57,12 @@ RC OptimizeStage::handle_request(SQLStageEvent *sql_event)
     return rc;
   }
 
+  rc = optimize(logical_operator);
+  if (rc != RC::SUCCESS) {
+    LOG_WARN("failed to optimize plan. rc=%s", strrc(rc));
+    return rc;
+  }
+
   // TODO: better way
   logical_operator->generate_general_child();
   Optimizer optimizer;
@@ -79,10 +91,104 @@ RC OptimizeStage::handle_request(SQLStageEvent *sql_event)
   return rc;
 }
 
+static RC collect_expression_fields(Expression &expr, vector<const Field *> &fields)
+{
+  if (expr.type() == ExprType::FIELD) {
+    fields.push_back(&static_cast<FieldExpr &>(expr).field());
+    return RC::SUCCESS;
+  }
+
+  return ExpressionIterator::iterate_child_expr(
+      expr, [&fields](unique_ptr<Expression> &child) { return collect_expression_fields(*child, fields); });
+}
+
+/**
+ * @brief 收集整个逻辑计划中所有表达式引用的字段
+ */
+static RC collect_plan_fields(LogicalOperator &oper, vector<const Field *> &fields)
+{
+  RC rc = RC::SUCCESS;
+
+  vector<Expression *> exprs;
+  for (unique_ptr<Expression> &expr : oper.expressions()) {
+    exprs.push_back(expr.get());
+  }
+
+  switch (oper.type()) {
+    case LogicalOperatorType::TABLE_GET: {
+      for (unique_ptr<Expression> &expr : static_cast<TableGetLogicalOperator &>(oper).predicates()) {
+        exprs.push_back(expr.get());
+      }
+    } break;
+    case LogicalOperatorType::JOIN: {
+      for (unique_ptr<Expression> &expr : static_cast<JoinLogicalOperator &>(oper).get_join_predicates()) {
+        exprs.push_back(expr.get());
+      }
+    } break;
+    case LogicalOperatorType::GROUP_BY: {
+      auto &group_by_oper = static_cast<GroupByLogicalOperator &>(oper);
+      for (unique_ptr<Expression> &expr : group_by_oper.group_by_expressions()) {
+        exprs.push_back(expr.get());
+      }
+      vector<Expression *> &aggregate_exprs = group_by_oper.aggregate_expressions();
+      exprs.insert(exprs.end(), aggregate_exprs.begin(), aggregate_exprs.end());
+    } break;
+    case LogicalOperatorType::ORDER_BY: {
+      for (OrderByNode &node : static_cast<OrderByLogicalOperator &>(oper).order_by_expressions()) {
+        exprs.push_back(node.expr.get());
+      }
+    } break;
+    default: break;
+  }
+
+  for (Expression *expr : exprs) {
+    rc = collect_expression_fields(*expr, fields);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+
+  for (unique_ptr<LogicalOperator> &child : oper.children()) {
+    rc = collect_plan_fields(*child, fields);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+  return rc;
+}
+
+static void set_referenced_fields(LogicalOperator &oper, const vector<const Field *> &fields)
+{
+  if (oper.type() == LogicalOperatorType::TABLE_GET) {
+    auto &table_get_oper = static_cast<TableGetLogicalOperator &>(oper);
+
+    vector<const FieldMeta *> table_fields;
+    for (const Field *field : fields) {
+      if (field->table() == table_get_oper.table() &&
+          find(table_fields.begin(), table_fields.end(), field->meta()) == table_fields.end()) {
+        table_fields.push_back(field->meta());
+      }
+    }
+    table_get_oper.set_referenced_fields(std::move(table_fields));
+  }
+
+  for (unique_ptr<LogicalOperator> &child : oper.children()) {
+    set_referenced_fields(*child, fields);
+  }
+}
+
 RC OptimizeStage::optimize(unique_ptr<LogicalOperator> &oper)
 {
-  // do nothing
-  return RC::SUCCESS;
+  // 记下每张表在查询中用到了哪些字段，生成物理计划时用来判断能否只扫描索引
+  vector<const Field *> fields;
+  RC                    rc = collect_plan_fields(*oper, fields);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to collect referenced fields. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  set_referenced_fields(*oper, fields);
+  return rc;
 }
 
 RC OptimizeStage::generate_physical_plan(
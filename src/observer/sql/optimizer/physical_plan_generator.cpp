@@ -12,6 +12,7 @@ See the Mulan PSL v2 for more details. */
 // Created by Wangyunlai on 2022/12/14.
 //
 
+#include "common/lang/algorithm.h"
 #include "common/log/log.h"
 #include "sql/expr/expression.h"
 #include "session/session.h"
@@ -49,6 +50,7 @@ See the Mulan PSL v2 for more details. */
 #include "sql/operator/limit_physical_operator.h"
 #include "sql/operator/limit_vec_physical_operator.h"
 #include "sql/optimizer/physical_plan_generator.h"
+#include "storage/index/index.h"
 
 using namespace std;
 
@@ -187,68 +189,238 @@ RC PhysicalPlanGenerator::create_vec(
   return rc;
 }
 
-RC PhysicalPlanGenerator::create_plan(
-    TableGetLogicalOperator &table_get_oper, unique_ptr<PhysicalOperator> &oper, Session *session)
+/**
+ * @brief 字段与常量比较的简单条件，字段总是在左边
+ */
+struct FieldValueCondition
 {
-  vector<unique_ptr<Expression>> &predicates = table_get_oper.predicates();
-  // 看看是否有可以用于索引查找的表达式
-  Table *table = table_get_oper.table();
+  const FieldMeta *field = nullptr;
+  CompOp           comp  = NO_OP;
+  Value            value;  ///< 已经转换成字段的类型
+};
+
+/**
+ * @brief 可以用于索引扫描的范围
+ * @details 索引前面的 equal_num 个字段是等值条件，紧接着的字段可以有范围条件。
+ * 边界中的值按照索引字段的顺序排列，可以只包含前面几个字段。
+ */
+struct IndexScanRange
+{
+  Index        *index           = nullptr;
+  int           equal_num       = 0;
+  bool          has_range       = false;
+  vector<Value> left_values;
+  bool          left_inclusive  = true;
+  vector<Value> right_values;
+  bool          right_inclusive = true;
+
+  /// 等值的字段越多越好，其次是有范围条件的
+  int score() const { return equal_num * 2 + (has_range ? 1 : 0); }
+
+  /// 唯一索引的所有字段都是等值条件，最多只有一条有效的记录，可以直接查找
+  bool point_get() const
+  {
+    return index->index_meta().unique() && equal_num == static_cast<int>(index->field_metas().size());
+  }
+};
 
-  Index     *index      = nullptr;
-  ValueExpr *value_expr = nullptr;
+/**
+ * @brief 从过滤条件中找出字段与常量比较的条件
+ */
+static void collect_field_value_conditions(
+    vector<unique_ptr<Expression>> &predicates, vector<FieldValueCondition> &conditions)
+{
   for (auto &expr : predicates) {
-    if (expr->type() == ExprType::COMPARISON) {
-      auto comparison_expr = static_cast<ComparisonExpr *>(expr.get());
-      // 简单处理，就找等值查询
-      if (comparison_expr->comp() != EQUAL_TO && comparison_expr->comp() != NOT_EQUAL) {
+    if (expr->type() != ExprType::COMPARISON) {
+      continue;
+    }
+
+    auto comparison_expr = static_cast<ComparisonExpr *>(expr.get());
+    CompOp comp          = comparison_expr->comp();
+    if (comp == NOT_EQUAL || comp == NO_OP) {
+      continue;
+    }
+
+    unique_ptr<Expression> &left_expr  = comparison_expr->left();
+    unique_ptr<Expression> &right_expr = comparison_expr->right();
+
+    FieldExpr *field_expr = nullptr;
+    ValueExpr *value_expr = nullptr;
+    if (left_expr->type() == ExprType::FIELD && right_expr->type() == ExprType::VALUE) {
+      field_expr = static_cast<FieldExpr *>(left_expr.get());
+      value_expr = static_cast<ValueExpr *>(right_expr.get());
+    } else if (right_expr->type() == ExprType::FIELD && left_expr->type() == ExprType::VALUE) {
+      field_expr = static_cast<FieldExpr *>(right_expr.get());
+      value_expr = static_cast<ValueExpr *>(left_expr.get());
+      // 把字段换到左边
+      switch (comp) {
+        case LESS_EQUAL: comp = GREAT_EQUAL; break;
+        case LESS_THAN: comp = GREAT_THAN; break;
+        case GREAT_EQUAL: comp = LESS_EQUAL; break;
+        case GREAT_THAN: comp = LESS_THAN; break;
+        default: break;
+      }
+    } else {
+      continue;
+    }
+
+    FieldValueCondition condition;
+    condition.field = field_expr->field().meta();
+    condition.comp  = comp;
+
+    // 索引中存放的是字段类型的数据，值的类型不同时需要转换。
+    // 转换有损失时(比如浮点数转换成整数)，扫描的范围可能不对，就不使用这个条件
+    const Value &value = value_expr->get_value();
+    if (value.attr_type() == condition.field->type()) {
+      condition.value = value;
+    } else {
+      Value restored_value;
+      if (OB_FAIL(Value::cast_to(value, condition.field->type(), condition.value)) ||
+          OB_FAIL(Value::cast_to(condition.value, value.attr_type(), restored_value)) ||
+          restored_value.compare(value) != 0) {
         continue;
       }
+    }
+    conditions.push_back(std::move(condition));
+  }
+}
 
-      unique_ptr<Expression> &left_expr  = comparison_expr->left();
-      unique_ptr<Expression> &right_expr = comparison_expr->right();
-      // 左右比较的一边最少是一个值
-      if (left_expr->type() != ExprType::VALUE && right_expr->type() != ExprType::VALUE) {
+/**
+ * @brief 计算某个索引可以扫描的范围
+ * @return 索引不能使用时返回false
+ */
+static bool make_index_scan_range(Index *index, const vector<FieldValueCondition> &conditions, IndexScanRange &range)
+{
+  range       = IndexScanRange();
+  range.index = index;
+
+  const vector<FieldMeta> &index_fields = index->field_metas();
+
+  // 多字段的索引要求每个字段的值都按照字段的长度存放，超长的字符串无法放到键值中
+  auto fits_in_key = [&index_fields](const FieldMeta &field, const Value &value) {
+    return index_fields.size() == 1 || field.type() != AttrType::CHARS || value.length() <= field.len();
+  };
+
+  for (const FieldMeta &field : index_fields) {
+    const FieldValueCondition *equal_condition = nullptr;
+    const FieldValueCondition *lower_condition = nullptr;
+    const FieldValueCondition *upper_condition = nullptr;
+    for (const FieldValueCondition &condition : conditions) {
+      if (0 != strcmp(condition.field->name(), field.name()) || !fits_in_key(field, condition.value)) {
         continue;
       }
 
-      FieldExpr *field_expr = nullptr;
-      if (left_expr->type() == ExprType::FIELD) {
-        ASSERT(right_expr->type() == ExprType::VALUE, "right expr should be a value expr while left is field expr");
-        field_expr = static_cast<FieldExpr *>(left_expr.get());
-        value_expr = static_cast<ValueExpr *>(right_expr.get());
-      } else if (right_expr->type() == ExprType::FIELD) {
-        ASSERT(left_expr->type() == ExprType::VALUE, "left expr should be a value expr while right is a field expr");
-        field_expr = static_cast<FieldExpr *>(right_expr.get());
-        value_expr = static_cast<ValueExpr *>(left_expr.get());
+      if (condition.comp == EQUAL_TO && equal_condition == nullptr) {
+        equal_condition = &condition;
+      } else if ((condition.comp == GREAT_EQUAL || condition.comp == GREAT_THAN) && lower_condition == nullptr) {
+        lower_condition = &condition;
+      } else if ((condition.comp == LESS_EQUAL || condition.comp == LESS_THAN) && upper_condition == nullptr) {
+        upper_condition = &condition;
+      }
+    }
+
+    if (equal_condition != nullptr) {
+      range.left_values.push_back(equal_condition->value);
+      range.right_values.push_back(equal_condition->value);
+      range.equal_num++;
+      continue;
+    }
+
+    // 范围条件之后的字段就不能再用来确定扫描范围了
+    if (lower_condition != nullptr) {
+      range.left_values.push_back(lower_condition->value);
+      range.left_inclusive = (lower_condition->comp == GREAT_EQUAL);
+      range.has_range      = true;
+    }
+    if (upper_condition != nullptr) {
+      range.right_values.push_back(upper_condition->value);
+      range.right_inclusive = (upper_condition->comp == LESS_EQUAL);
+      range.has_range       = true;
+    }
+    break;
+  }
+
+  return range.score() > 0;
+}
+
+/**
+ * @brief 查询用到的这张表的字段是否都在索引中
+ * @details 只有这种情况下才可以只扫描索引，不回表
+ */
+static bool index_covers_fields(Index *index, TableGetLogicalOperator &table_get_oper)
+{
+  if (!table_get_oper.referenced_fields_known()) {
+    return false;
+  }
+
+  const vector<FieldMeta> &index_fields = index->field_metas();
+  for (const FieldMeta *field : table_get_oper.referenced_fields()) {
+    auto iter = find_if(index_fields.begin(), index_fields.end(), [field](const FieldMeta &index_field) {
+      return 0 == strcmp(index_field.name(), field->name());
+    });
+    if (iter == index_fields.end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+RC PhysicalPlanGenerator::create_plan(
+    TableGetLogicalOperator &table_get_oper, unique_ptr<PhysicalOperator> &oper, Session *session)
+{
+  vector<unique_ptr<Expression>> &predicates = table_get_oper.predicates();
+  // 看看是否有可以用于索引查找的表达式
+  Table *table = table_get_oper.table();
+
+  vector<FieldValueCondition> conditions;
+  collect_field_value_conditions(predicates, conditions);
+
+  // 在所有的索引中，找一个等值条件覆盖的字段最多的。一样多时优先选择能覆盖查询的索引，可以不回表，
+  // 其次选择可以点查的唯一索引
+  IndexScanRange best_range;
+  bool           best_covering = false;
+  if (!conditions.empty()) {
+    const TableMeta &table_meta = table->table_meta();
+    for (int i = 0; i < table_meta.index_num(); i++) {
+      Index *index = table->find_index(table_meta.index(i)->name());
+      if (nullptr == index) {
+        continue;
       }
 
-      if (field_expr == nullptr) {
+      IndexScanRange range;
+      if (!make_index_scan_range(index, conditions, range)) {
         continue;
       }
 
-      const Field &field = field_expr->field();
-      index              = table->find_index_by_field(field.field_name());
-      if (nullptr != index) {
-        break;
+      const bool covering = index_covers_fields(index, table_get_oper);
+      const bool better   = range.score() > best_range.score() ||
+                          (range.score() == best_range.score() &&
+                              (covering != best_covering ? covering : range.point_get() && !best_range.point_get()));
+      if (better) {
+        best_range    = std::move(range);
+        best_covering = covering;
       }
     }
   }
 
-  if (index != nullptr) {
-    ASSERT(value_expr != nullptr, "got an index but value expr is null ?");
-
-    const Value               &value           = value_expr->get_value();
+  if (best_range.index != nullptr) {
     IndexScanPhysicalOperator *index_scan_oper = new IndexScanPhysicalOperator(table,
-        index,
+        best_range.index,
         table_get_oper.read_write_mode(),
-        &value,
-        true /*left_inclusive*/,
-        &value,
-        true /*right_inclusive*/);
+        std::move(best_range.left_values),
+        best_range.left_inclusive,
+        std::move(best_range.right_values),
+        best_range.right_inclusive);
 
+    // 扫描的范围可能比条件大，所有的条件还要再过滤一遍
     index_scan_oper->set_predicates(std::move(predicates));
+    // 修改数据时需要读取记录本身，只有只读的查询可以不回表
+    const bool index_only = best_covering && table_get_oper.read_write_mode() == ReadWriteMode::READ_ONLY;
+    index_scan_oper->set_index_only(index_only);
+    index_scan_oper->set_point_get(best_range.point_get());
+    LOG_TRACE("use index scan. index=%s, index only=%d, point get=%d",
+        best_range.index->index_meta().name(), index_only, best_range.point_get());
     oper = unique_ptr<PhysicalOperator>(index_scan_oper);
-    LOG_TRACE("use index scan");
   } else {
     auto table_scan_oper = new TableScanPhysicalOperator(table, table_get_oper.read_write_mode());
     table_scan_oper->set_predicates(std::move(predicates));
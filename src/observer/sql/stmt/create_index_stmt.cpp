@@ -13,6 +13,7 @@ See the Mulan PSL v2 for more details. */
 //
 
 #include "sql/stmt/create_index_stmt.h"
+#include "common/lang/algorithm.h"
 #include "common/lang/string.h"
 #include "common/log/log.h"
 #include "storage/db/db.h"
@@ -26,10 +27,9 @@ RC CreateIndexStmt::create(Db *db, const CreateIndexSqlNode &create_index, Stmt
   stmt = nullptr;
 
   const char *table_name = create_index.relation_name.c_str();
-  if (is_blank(table_name) || is_blank(create_index.index_name.c_str()) ||
-      is_blank(create_index.attribute_name.c_str())) {
-    LOG_WARN("invalid argument. db=%p, table_name=%p, index name=%s, attribute name=%s",
-        db, table_name, create_index.index_name.c_str(), create_index.attribute_name.c_str());
+  if (is_blank(table_name) || is_blank(create_index.index_name.c_str()) || create_index.attribute_names.empty()) {
+    LOG_WARN("invalid argument. db=%p, table_name=%p, index name=%s, attribute num=%d",
+        db, table_name, create_index.index_name.c_str(), static_cast<int>(create_index.attribute_names.size()));
     return RC::INVALID_ARGUMENT;
   }
 
@@ -40,11 +40,20 @@ RC CreateIndexStmt::create(Db *db, const CreateIndexSqlNode &create_index, Stmt
     return RC::SCHEMA_TABLE_NOT_EXIST;
   }
 
-  const FieldMeta *field_meta = table->table_meta().field(create_index.attribute_name.c_str());
-  if (nullptr == field_meta) {
-    LOG_WARN("no such field in table. db=%s, table=%s, field name=%s", 
-             db->name(), table_name, create_index.attribute_name.c_str());
-    return RC::SCHEMA_FIELD_NOT_EXIST;
+  vector<const FieldMeta *> field_metas;
+  for (const string &attribute_name : create_index.attribute_names) {
+    const FieldMeta *field_meta = table->table_meta().field(attribute_name.c_str());
+    if (nullptr == field_meta) {
+      LOG_WARN("no such field in table. db=%s, table=%s, field name=%s", 
+               db->name(), table_name, attribute_name.c_str());
+      return RC::SCHEMA_FIELD_NOT_EXIST;
+    }
+
+    if (find(field_metas.begin(), field_metas.end(), field_meta) != field_metas.end()) {
+      LOG_WARN("duplicate field in index. db=%s, table=%s, field name=%s", db->name(), table_name, attribute_name.c_str());
+      return RC::INVALID_ARGUMENT;
+    }
+    field_metas.push_back(field_meta);
   }
 
   Index *index = table->find_index(create_index.index_name.c_str());
@@ -53,6 +62,6 @@ RC CreateIndexStmt::create(Db *db, const CreateIndexSqlNode &create_index, Stmt
     return RC::SCHEMA_INDEX_NAME_REPEAT;
   }
 
-  stmt = new CreateIndexStmt(table, field_meta, create_index.index_name);
+  stmt = new CreateIndexStmt(table, field_metas, create_index.index_name, create_index.unique);
   return RC::SUCCESS;
 }
@@ -0,0 +1,323 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "storage/buffer/async_io.h"
+#include "common/io/io.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/deque.h"
+#include "common/lang/string.h"
+#include "common/lang/vector.h"
+#include "common/log/log.h"
+
+using namespace common;
+
+RC AsyncIo::create(const char *name, int queue_depth, unique_ptr<AsyncIo> &async_io)
+{
+  if (name == nullptr || common::is_blank(name)) {
+    name = "posix";
+  }
+
+  if (queue_depth <= 0) {
+    queue_depth = DEFAULT_QUEUE_DEPTH;
+  }
+
+  if (strcasecmp(name, "posix") == 0) {
+    async_io = make_unique<PosixAsyncIo>();
+  } else if (strcasecmp(name, "io_uring") == 0) {
+#ifdef __linux__
+    async_io = make_unique<IoUringAsyncIo>();
+#else
+    LOG_WARN("io_uring is not supported on current platform, use posix instead");
+    async_io = make_unique<PosixAsyncIo>();
+#endif
+  } else {
+    LOG_WARN("unknown io engine: %s", name);
+    return RC::INVALID_ARGUMENT;
+  }
+
+  RC rc = async_io->init(queue_depth);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to init io engine %s, use posix instead. rc=%s", name, strrc(rc));
+    async_io = make_unique<PosixAsyncIo>();
+    rc       = async_io->init(queue_depth);
+  }
+
+  LOG_INFO("use io engine %s, queue depth %d", async_io->name(), queue_depth);
+  return rc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+RC PosixAsyncIo::execute(span<IoRequest> requests)
+{
+  for (IoRequest &request : requests) {
+    int ret = 0;
+    if (request.type == IoRequest::Type::READ) {
+      ret        = preadn(request.fd, request.buf, request.size, request.offset);
+      request.rc = (ret == 0) ? RC::SUCCESS : RC::IOERR_READ;
+    } else {
+      ret        = pwriten(request.fd, request.buf, request.size, request.offset);
+      request.rc = (ret == 0) ? RC::SUCCESS : RC::IOERR_WRITE;
+    }
+
+    if (ret != 0) {
+      LOG_WARN("failed to execute io request. fd=%d, offset=%ld, size=%d, ret=%d, error=%s",
+               request.fd, request.offset, request.size, ret, ret > 0 ? strerror(ret) : "eof");
+    }
+  }
+  return RC::SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+#ifdef __linux__
+
+static int io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+static inline unsigned load_acquire(const unsigned *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static inline void     store_release(unsigned *p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+IoUringAsyncIo::~IoUringAsyncIo() { destroy(); }
+
+RC IoUringAsyncIo::init(int queue_depth)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int fd = io_uring_setup(static_cast<unsigned>(queue_depth), &params);
+  if (fd < 0) {
+    LOG_WARN("failed to setup io_uring. queue depth=%d, error=%s", queue_depth, strerror(errno));
+    return RC::IOERR_OPEN;
+  }
+  ring_fd_ = fd;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = max(sq_ring_size_, cq_ring_size_);
+    cq_ring_size_ = sq_ring_size_;
+  }
+
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    sq_ring_ = nullptr;
+    LOG_WARN("failed to mmap io_uring sq ring. error=%s", strerror(errno));
+    destroy();
+    return RC::NOMEM;
+  }
+
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+  } else {
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      cq_ring_ = nullptr;
+      LOG_WARN("failed to mmap io_uring cq ring. error=%s", strerror(errno));
+      destroy();
+      return RC::NOMEM;
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqes_      = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes_ == MAP_FAILED) {
+    sqes_ = nullptr;
+    LOG_WARN("failed to mmap io_uring sqes. error=%s", strerror(errno));
+    destroy();
+    return RC::NOMEM;
+  }
+
+  char *sq    = static_cast<char *>(sq_ring_);
+  sq_head_    = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail_    = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_    = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_entries_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+  sq_array_   = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+  char *cq = static_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_    = cq + params.cq_off.cqes;
+
+  queue_depth_ = params.sq_entries;
+  LOG_INFO("io_uring setup done. fd=%d, sq entries=%u, cq entries=%u", fd, params.sq_entries, params.cq_entries);
+  return RC::SUCCESS;
+}
+
+void IoUringAsyncIo::destroy()
+{
+  if (sqes_ != nullptr) {
+    munmap(sqes_, sqes_size_);
+    sqes_ = nullptr;
+  }
+  if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  cq_ring_ = nullptr;
+  if (sq_ring_ != nullptr) {
+    munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = nullptr;
+  }
+  if (ring_fd_ >= 0) {
+    close(ring_fd_);
+    ring_fd_ = -1;
+  }
+}
+
+/// 请求没有完成时的错误码
+static RC io_error_rc(const IoRequest &request)
+{
+  return (request.type == IoRequest::Type::READ) ? RC::IOERR_READ : RC::IOERR_WRITE;
+}
+
+RC IoUringAsyncIo::execute(span<IoRequest> requests)
+{
+  if (requests.empty()) {
+    return RC::SUCCESS;
+  }
+
+  lock_guard<mutex> guard(lock_);
+
+  // 先把所有请求标记为失败，完成时再改成成功。中途出错返回时，没有完成的请求都带着各自的错误码
+  RC batch_rc = RC::IOERR_READ;
+  for (IoRequest &request : requests) {
+    request.rc = io_error_rc(request);
+    if (request.type == IoRequest::Type::WRITE) {
+      batch_rc = RC::IOERR_WRITE;
+    }
+  }
+
+  if (ring_fd_ < 0) {
+    LOG_WARN("io_uring is not available");
+    return batch_rc;
+  }
+
+  auto *sqes = static_cast<struct io_uring_sqe *>(sqes_);
+  auto *cqes = static_cast<struct io_uring_cqe *>(cqes_);
+
+  // 读写的字节数可能比请求的少，这时需要把剩余的部分重新提交
+  vector<int>   done_bytes(requests.size(), 0);
+  deque<size_t> pending;
+  for (size_t i = 0; i < requests.size(); i++) {
+    pending.push_back(i);
+  }
+
+  size_t   finished  = 0;
+  unsigned in_flight = 0;
+
+  auto reap_completions = [&]() {
+    unsigned head = *cq_head_;
+    while (head != load_acquire(cq_tail_)) {
+      const struct io_uring_cqe &cqe     = cqes[head & *cq_mask_];
+      const size_t               index   = static_cast<size_t>(cqe.user_data);
+      IoRequest                 &request = requests[index];
+      head++;
+      in_flight--;
+
+      if (cqe.res < 0) {
+        if (-cqe.res == EAGAIN || -cqe.res == EINTR) {
+          pending.push_back(index);
+          continue;
+        }
+        LOG_WARN("failed to execute io request. fd=%d, offset=%ld, size=%d, error=%s",
+                 request.fd, request.offset, request.size, strerror(-cqe.res));
+        finished++;
+      } else if (cqe.res == 0 && request.type == IoRequest::Type::READ) {
+        LOG_WARN("failed to execute io request, got end of file. fd=%d, offset=%ld, size=%d",
+                 request.fd, request.offset, request.size);
+        finished++;
+      } else {
+        done_bytes[index] += cqe.res;
+        if (done_bytes[index] < request.size) {
+          pending.push_back(index);
+        } else {
+          request.rc = RC::SUCCESS;
+          finished++;
+        }
+      }
+    }
+    store_release(cq_head_, head);
+  };
+
+  while (finished < requests.size()) {
+    unsigned tail = *sq_tail_;
+    while (!pending.empty() && in_flight < queue_depth_ && tail - load_acquire(sq_head_) < *sq_entries_) {
+      const size_t index   = pending.front();
+      IoRequest   &request = requests[index];
+      pending.pop_front();
+
+      const unsigned       sq_index = tail & *sq_mask_;
+      struct io_uring_sqe *sqe      = &sqes[sq_index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode    = (request.type == IoRequest::Type::READ) ? IORING_OP_READ : IORING_OP_WRITE;
+      sqe->fd        = request.fd;
+      sqe->addr      = reinterpret_cast<uint64_t>(static_cast<char *>(request.buf) + done_bytes[index]);
+      sqe->len       = static_cast<uint32_t>(request.size - done_bytes[index]);
+      sqe->off       = static_cast<uint64_t>(request.offset + done_bytes[index]);
+      sqe->user_data = index;
+
+      sq_array_[sq_index] = sq_index;
+      tail++;
+      in_flight++;
+    }
+    store_release(sq_tail_, tail);
+
+    // 上一轮没有被内核取走的请求也要算在里面
+    const unsigned to_submit = tail - load_acquire(sq_head_);
+    int ret = io_uring_enter(ring_fd_, to_submit, 1 /*min_complete*/, IORING_ENTER_GETEVENTS);
+    if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      LOG_ERROR("failed to enter io_uring. error=%s", strerror(errno));
+
+      // 还没有被内核取走的请求直接撤回，不能留给下一批
+      const unsigned sq_head = load_acquire(sq_head_);
+      in_flight -= tail - sq_head;
+      store_release(sq_tail_, sq_head);
+
+      // 已经提交的请求还在使用调用者的内存，必须等它们完成。否则它们的完成事件会留在队列中，
+      // 被下一批请求当成自己的
+      reap_completions();
+      while (in_flight > 0) {
+        ret = io_uring_enter(ring_fd_, 0 /*to_submit*/, 1 /*min_complete*/, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+          LOG_ERROR("failed to wait for in-flight io_uring requests, close the ring. in flight=%u, error=%s",
+                    in_flight, strerror(errno));
+          destroy();
+          break;
+        }
+        reap_completions();
+      }
+      return batch_rc;
+    }
+
+    reap_completions();
+  }
+  return RC::SUCCESS;
+}
+
+#endif  // __linux__
@@ -0,0 +1,134 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/sys/rc.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
+#include "common/lang/span.h"
+
+/**
+ * @brief 一次文件读写请求
+ * @ingroup BufferPool
+ */
+struct IoRequest
+{
+  enum class Type
+  {
+    READ,
+    WRITE,
+  };
+
+  Type    type   = Type::READ;
+  int     fd     = -1;
+  void   *buf    = nullptr;
+  int     size   = 0;
+  int64_t offset = 0;
+
+  /// 请求的结果。SUCCESS 表示读写了完整的size字节，读到文件尾时是 IOERR_READ
+  RC rc = RC::SUCCESS;
+};
+
+/**
+ * @brief 批量页面IO的执行器
+ * @ingroup BufferPool
+ * @details 一次提交一批读写请求，等待它们全部完成。不同的实现决定了同时有多少个请求在设备上执行：
+ * posix 实现逐个调用 pread/pwrite；io_uring 实现最多同时保持 queue_depth 个请求在内核中执行，
+ * 对于随机读写来说可以充分利用设备的并发能力。
+ * 可以通过配置文件中 [STORAGE] 的 IO_ENGINE 来选择使用哪种实现。
+ */
+class AsyncIo
+{
+public:
+  AsyncIo()          = default;
+  virtual ~AsyncIo() = default;
+
+  /**
+   * @brief 初始化
+   * @param queue_depth 最多同时执行多少个请求
+   */
+  virtual RC init(int queue_depth) = 0;
+
+  /**
+   * @brief 执行一批请求，等待全部完成后返回
+   * @details 每个请求的结果记录在它自己的rc中。如果返回值不是SUCCESS，说明执行器本身出了问题。
+   * 这时没有完成的请求的rc是对应读写类型的错误码，返回值在批次中有写请求时是 IOERR_WRITE，否则是 IOERR_READ。
+   * 可以多线程调用。
+   */
+  virtual RC execute(span<IoRequest> requests) = 0;
+
+  virtual const char *name() const = 0;
+
+  /**
+   * @brief 根据名字创建执行器
+   * @details 当前支持 posix(默认) 和 io_uring。如果当前系统不支持 io_uring，会退化成 posix
+   */
+  static RC create(const char *name, int queue_depth, unique_ptr<AsyncIo> &async_io);
+
+  static constexpr int DEFAULT_QUEUE_DEPTH = 32;
+};
+
+/**
+ * @brief 使用 pread/pwrite 同步地逐个执行请求
+ * @ingroup BufferPool
+ */
+class PosixAsyncIo final : public AsyncIo
+{
+public:
+  RC          init(int /*queue_depth*/) override { return RC::SUCCESS; }
+  RC          execute(span<IoRequest> requests) override;
+  const char *name() const override { return "posix"; }
+};
+
+#ifdef __linux__
+/**
+ * @brief 使用 io_uring 执行请求
+ * @ingroup BufferPool
+ * @details 直接使用系统调用，不依赖liburing。一个io_uring实例同时只服务一个批次，
+ * 多个线程同时提交时会排队。
+ */
+class IoUringAsyncIo final : public AsyncIo
+{
+public:
+  IoUringAsyncIo() = default;
+  ~IoUringAsyncIo() override;
+
+  RC          init(int queue_depth) override;
+  RC          execute(span<IoRequest> requests) override;
+  const char *name() const override { return "io_uring"; }
+
+private:
+  void destroy();
+
+private:
+  int      ring_fd_     = -1;
+  unsigned queue_depth_ = 0;
+
+  void  *sq_ring_      = nullptr;
+  size_t sq_ring_size_ = 0;
+  void  *cq_ring_      = nullptr;
+  size_t cq_ring_size_ = 0;
+  void  *sqes_         = nullptr;
+  size_t sqes_size_    = 0;
+
+  unsigned *sq_head_    = nullptr;
+  unsigned *sq_tail_    = nullptr;
+  unsigned *sq_mask_    = nullptr;
+  unsigned *sq_entries_ = nullptr;
+  unsigned *sq_array_   = nullptr;
+  unsigned *cq_head_    = nullptr;
+  unsigned *cq_tail_    = nullptr;
+  unsigned *cq_mask_    = nullptr;
+  void     *cqes_       = nullptr;
+
+  mutex lock_;
+};
+#endif  // __linux__
@@ -12,6 +12,8 @@ See the Mulan PSL v2 for more details. */
 // Created by Meiyi & Longda on 2021/4/13.
 //
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <string.h>
 
 #include "common/io/io.h"
@@ -38,11 +40,58 @@ string BPFileHeader::to_string() const
 
 ////////////////////////////////////////////////////////////////////////////////
 
-BPFrameManager::BPFrameManager(const char *name) : allocator_(name) {}
+BPFrameManager::BPFrameManager(const char *name) : tag_(name) {}
 
-RC BPFrameManager::init(int pool_num)
+RC BPFrameManager::create_allocator(const char *allocator)
 {
-  int ret = allocator_.init(false, pool_num);
+  if (allocator == nullptr || allocator[0] == '\0' || 0 == strcasecmp(allocator, "simple")) {
+    allocator_      = make_unique<FrameAllocator>(tag_.c_str());
+    allocator_name_ = "simple";
+  } else if (0 == strcasecmp(allocator, "mmap")) {
+    allocator_      = make_unique<common::MemPoolMapped<Frame>>(tag_.c_str(), false /*numa_interleave*/);
+    allocator_name_ = "mmap";
+  } else if (0 == strcasecmp(allocator, "mmap_interleave")) {
+    allocator_      = make_unique<common::MemPoolMapped<Frame>>(tag_.c_str(), true /*numa_interleave*/);
+    allocator_name_ = "mmap_interleave";
+  } else {
+    LOG_WARN("unknown frame allocator: %s", allocator);
+    return RC::INVALID_ARGUMENT;
+  }
+  return RC::SUCCESS;
+}
+
+RC BPFrameManager::init(int pool_num, int partition_num /* = DEFAULT_PARTITION_NUM */,
+    const char *replacer /* = nullptr */, const char *allocator /* = nullptr */)
+{
+  if (partition_num <= 0) {
+    partition_num = 1;
+  }
+
+  // 淘汰策略看到的是一个分区内的页帧，容量也按照分区来计算
+  const size_t capacity = max<size_t>(static_cast<size_t>(pool_num) * DEFAULT_ITEM_NUM_PER_POOL / partition_num, 1);
+
+  partitions_.clear();
+  partitions_.reserve(partition_num);
+  for (int i = 0; i < partition_num; i++) {
+    auto partition = make_unique<Partition>();
+    RC   rc        = FrameReplacer::create(replacer, capacity, partition->replacer);
+    if (OB_FAIL(rc)) {
+      partitions_.clear();
+      return rc;
+    }
+    partitions_.emplace_back(std::move(partition));
+  }
+  replacer_name_ = partitions_.front()->replacer->name();
+
+  if (!allocator_) {
+    RC rc = create_allocator(allocator);
+    if (OB_FAIL(rc)) {
+      partitions_.clear();
+      return rc;
+    }
+  }
+
+  int ret = allocator_->init(false, pool_num);
   if (ret == 0) {
     return RC::SUCCESS;
   }
@@ -51,50 +100,82 @@ RC BPFrameManager::init(int pool_num)
 
 RC BPFrameManager::cleanup()
 {
-  if (frames_.count() > 0) {
+  if (frame_count_.load() > 0) {
     return RC::INTERNAL;
   }
 
-  frames_.destroy();
+  for (unique_ptr<Partition> &partition : partitions_) {
+    partition->frames.clear();
+    partition->replacer->clear();
+  }
   return RC::SUCCESS;
 }
 
-int BPFrameManager::purge_frames(int count, function<RC(Frame *frame)> purger)
+BPFrameManager::Partition &BPFrameManager::partition_of(const FrameId &frame_id)
 {
-  lock_guard<mutex> lock_guard(lock_);
+  // 同一个文件的连续页面在hash值上也是连续的，这里打散一下，防止都落在相邻的几个分区上
+  uint64_t hash = static_cast<uint64_t>(frame_id.hash()) * 0x9E3779B97F4A7C15ULL;
+  return *partitions_[(hash >> 32) % partitions_.size()];
+}
 
-  vector<Frame *> frames_can_purge;
+int BPFrameManager::purge_frames(int count, function<RC(Frame *frame)> purger)
+{
   if (count <= 0) {
     count = 1;
   }
-  frames_can_purge.reserve(count);
 
-  auto purge_finder = [&frames_can_purge, count](const FrameId &frame_id, Frame *const frame) {
-    if (frame->can_purge()) {
-      frame->pin();
-      frames_can_purge.push_back(frame);
-      if (frames_can_purge.size() >= static_cast<size_t>(count)) {
-        return false;  // false to break the progress
+  /// 从一个轮转的分区开始查找可以淘汰的页帧，这样各个分区被淘汰的机会比较平均。
+  /// purger 是一个非常耗时的操作，它需要把脏页数据刷新到磁盘上去。这里只会锁住当前
+  /// 正在处理的一个分区，其它分区上的访问不受影响。
+  const size_t partition_num = partitions_.size();
+  const size_t start         = purge_cursor_.fetch_add(1) % partition_num;
+
+  int freed_count = 0;
+  for (size_t i = 0; i < partition_num && freed_count < count; i++) {
+    Partition &partition = *partitions_[(start + i) % partition_num];
+
+    lock_guard<mutex> lock_guard(partition.lock);
+
+    vector<Frame *> frames_can_purge;
+
+    // 干净的页面不需要等待写盘，先在最应该淘汰的一部分页帧中找干净的页面
+    int  visited_count = 0;
+    auto clean_finder  = [&frames_can_purge, &visited_count, count, freed_count](Frame *frame) {
+      if (frame->can_purge() && !frame->dirty()) {
+        frame->pin();
+        frames_can_purge.push_back(frame);
+        if (frames_can_purge.size() + freed_count >= static_cast<size_t>(count)) {
+          return false;
+        }
       }
-    }
-    return true;  // true continue to look up
-  };
+      return ++visited_count < CLEAN_VICTIM_SEARCH_DEPTH;
+    };
+    auto purge_finder = [&frames_can_purge, count, freed_count](Frame *frame) {
+      if (frame->can_purge()) {
+        frame->pin();
+        frames_can_purge.push_back(frame);
+        if (frames_can_purge.size() + freed_count >= static_cast<size_t>(count)) {
+          return false;  // false to break the progress
+        }
+      }
+      return true;  // true continue to look up
+    };
 
-  frames_.foreach_reverse(purge_finder);
-  LOG_INFO("purge frames find %ld pages total", frames_can_purge.size());
+    partition.replacer->foreach_victim(clean_finder);
+    if (frames_can_purge.size() + freed_count < static_cast<size_t>(count)) {
+      partition.replacer->foreach_victim(purge_finder);
+    }
 
-  /// 当前还在frameManager的锁内，而 purger 是一个非常耗时的操作
-  /// 他需要把脏页数据刷新到磁盘上去，所以这里会极大地降低并发度
-  int freed_count = 0;
-  for (Frame *frame : frames_can_purge) {
-    RC rc = purger(frame);
-    if (RC::SUCCESS == rc) {
-      free_internal(frame->frame_id(), frame);
-      freed_count++;
-    } else {
-      frame->unpin();
-      LOG_WARN("failed to purge frame. frame_id=%s, rc=%s", 
-               frame->frame_id().to_string().c_str(), strrc(rc));
+    for (Frame *frame : frames_can_purge) {
+      RC rc = purger(frame);
+      if (RC::SUCCESS == rc) {
+        free_internal(partition, frame->frame_id(), frame);
+        freed_count++;
+      } else {
+        frame->unpin();
+        LOG_WARN("failed to purge frame. frame_id=%s, rc=%s", 
+                 frame->frame_id().to_string().c_str(), strrc(rc));
+      }
     }
   }
   LOG_INFO("purge frame done. number=%d", freed_count);
@@ -103,42 +184,75 @@ int BPFrameManager::purge_frames(int count, function<RC(Frame *frame)> purger)
 
 Frame *BPFrameManager::get(int buffer_pool_id, PageNum page_num)
 {
-  FrameId frame_id(buffer_pool_id, page_num);
+  FrameId    frame_id(buffer_pool_id, page_num);
+  Partition &partition = partition_of(frame_id);
+
+  lock_guard<mutex> lock_guard(partition.lock);
 
-  lock_guard<mutex> lock_guard(lock_);
-  return get_internal(frame_id);
+  bool   prefetch_hit = false;
+  Frame *frame        = get_internal(partition, frame_id, prefetch_hit);
+  if (frame == nullptr) {
+    partition.miss_count++;
+  } else if (prefetch_hit) {
+    partition.prefetch_hit_count++;
+  } else {
+    partition.hit_count++;
+  }
+  return frame;
 }
 
-Frame *BPFrameManager::get_internal(const FrameId &frame_id)
+Frame *BPFrameManager::get_internal(Partition &partition, const FrameId &frame_id, bool &prefetch_hit)
 {
-  Frame *frame = nullptr;
-  (void)frames_.get(frame_id, frame);
-  if (frame != nullptr) {
-    frame->pin();
-    LOG_DEBUG("got a frame. frame=%s", frame->to_string().c_str());
+  auto iter = partition.frames.find(frame_id);
+  if (iter == partition.frames.end()) {
+    return nullptr;
+  }
+
+  Frame *frame = iter->second;
+  frame->pin();
+  prefetch_hit = frame->prefetched();
+  if (prefetch_hit) {
+    frame->set_prefetched(false);
+  } else {
+    partition.replacer->on_access(frame);
   }
+  LOG_DEBUG("got a frame. frame=%s", frame->to_string().c_str());
   return frame;
 }
 
-Frame *BPFrameManager::alloc(int buffer_pool_id, PageNum page_num)
+Frame *BPFrameManager::alloc(int buffer_pool_id, PageNum page_num, bool prefetch /*= false*/)
 {
-  FrameId frame_id(buffer_pool_id, page_num);
+  FrameId    frame_id(buffer_pool_id, page_num);
+  Partition &partition = partition_of(frame_id);
 
-  lock_guard<mutex> lock_guard(lock_);
+  lock_guard<mutex> lock_guard(partition.lock);
 
-  Frame *frame = get_internal(frame_id);
+  Frame *frame = nullptr;
+  if (prefetch) {
+    auto iter = partition.frames.find(frame_id);
+    if (iter != partition.frames.end()) {
+      frame = iter->second;
+      frame->pin();
+    }
+  } else {
+    bool prefetch_hit = false;
+    frame             = get_internal(partition, frame_id, prefetch_hit);
+  }
   if (frame != nullptr) {
     return frame;
   }
 
-  frame = allocator_.alloc();
+  frame = allocator_->alloc();
   if (frame != nullptr) {
     ASSERT(frame->pin_count() == 0, "got an invalid frame that pin count is not 0. frame=%s", 
            frame->to_string().c_str());
     frame->set_buffer_pool_id(buffer_pool_id);
     frame->set_page_num(page_num);
+    frame->set_prefetched(prefetch);
     frame->pin();
-    frames_.put(frame_id, frame);
+    partition.frames.emplace(frame_id, frame);
+    partition.replacer->on_insert(frame);
+    frame_count_.fetch_add(1);
     LOG_DEBUG("allocate a new frame. frame=%s", frame->to_string().c_str());
   }
   return frame;
@@ -146,64 +260,179 @@ Frame *BPFrameManager::alloc(int buffer_pool_id, PageNum page_num)
 
 RC BPFrameManager::free(int buffer_pool_id, PageNum page_num, Frame *frame)
 {
-  FrameId frame_id(buffer_pool_id, page_num);
+  FrameId    frame_id(buffer_pool_id, page_num);
+  Partition &partition = partition_of(frame_id);
+
+  lock_guard<mutex> lock_guard(partition.lock);
+  return free_internal(partition, frame_id, frame);
+}
+
+RC BPFrameManager::try_free(int buffer_pool_id, PageNum page_num, Frame *frame)
+{
+  FrameId    frame_id(buffer_pool_id, page_num);
+  Partition &partition = partition_of(frame_id);
 
-  lock_guard<mutex> lock_guard(lock_);
-  return free_internal(frame_id, frame);
+  lock_guard<mutex> lock_guard(partition.lock);
+  if (frame->pin_count() != 1) {
+    return RC::LOCKED_UNLOCK;
+  }
+  return free_internal(partition, frame_id, frame);
 }
 
-RC BPFrameManager::free_internal(const FrameId &frame_id, Frame *frame)
+RC BPFrameManager::free_internal(Partition &partition, const FrameId &frame_id, Frame *frame)
 {
-  Frame                *frame_source = nullptr;
-  [[maybe_unused]] bool found        = frames_.get(frame_id, frame_source);
+  auto                  iter         = partition.frames.find(frame_id);
+  [[maybe_unused]] bool found        = iter != partition.frames.end();
+  [[maybe_unused]] Frame *frame_source = found ? iter->second : nullptr;
   ASSERT(found && frame == frame_source && frame->pin_count() == 1,
       "failed to free frame. found=%d, frameId=%s, frame_source=%p, frame=%p, pinCount=%d, lbt=%s",
       found, frame_id.to_string().c_str(), frame_source, frame, frame->pin_count(), lbt());
 
+  partition.replacer->on_remove(frame_id, frame);
+  partition.frames.erase(iter);
   frame->set_page_num(-1);
   frame->unpin();
-  frames_.remove(frame_id);
-  allocator_.free(frame);
+  frame_count_.fetch_sub(1);
+  allocator_->free(frame);
   return RC::SUCCESS;
 }
 
 list<Frame *> BPFrameManager::find_list(int buffer_pool_id)
 {
-  lock_guard<mutex> lock_guard(lock_);
-
   list<Frame *> frames;
-  auto          fetcher = [&frames, buffer_pool_id](const FrameId &frame_id, Frame *const frame) -> bool {
-    if (buffer_pool_id == frame_id.buffer_pool_id()) {
-      frame->pin();
-      frames.push_back(frame);
+  for (unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    for (auto &[frame_id, frame] : partition->frames) {
+      if (buffer_pool_id == frame_id.buffer_pool_id()) {
+        frame->pin();
+        frames.push_back(frame);
+      }
     }
-    return true;
-  };
-  frames_.foreach (fetcher);
+  }
   return frames;
 }
 
+size_t BPFrameManager::find_dirty_frames(vector<Frame *> &frames)
+{
+  size_t dirty_count = 0;
+  for (unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    for (auto &[frame_id, frame] : partition->frames) {
+      if (!frame->dirty()) {
+        continue;
+      }
+
+      dirty_count++;
+      if (frame->can_purge()) {
+        frame->pin();
+        frames.push_back(frame);
+      }
+    }
+  }
+  return dirty_count;
+}
+
+LSN BPFrameManager::min_rec_lsn()
+{
+  LSN min_lsn = 0;
+  for (unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    for (auto &[frame_id, frame] : partition->frames) {
+      const LSN rec_lsn = frame->rec_lsn();
+      if (rec_lsn != 0 && (min_lsn == 0 || rec_lsn < min_lsn)) {
+        min_lsn = rec_lsn;
+      }
+    }
+  }
+  return min_lsn;
+}
+
+uint64_t BPFrameManager::hit_count() const
+{
+  uint64_t count = 0;
+  for (const unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    count += partition->hit_count;
+  }
+  return count;
+}
+
+uint64_t BPFrameManager::miss_count() const
+{
+  uint64_t count = 0;
+  for (const unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    count += partition->miss_count;
+  }
+  return count;
+}
+
+uint64_t BPFrameManager::prefetch_hit_count() const
+{
+  uint64_t count = 0;
+  for (const unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    count += partition->prefetch_hit_count;
+  }
+  return count;
+}
+
+double BPFrameManager::hit_ratio() const
+{
+  uint64_t hits  = 0;
+  uint64_t total = 0;
+  for (const unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    hits += partition->hit_count;
+    total += partition->hit_count + partition->miss_count + partition->prefetch_hit_count;
+  }
+  return (total == 0) ? 0.0 : static_cast<double>(hits) / total;
+}
+
+void BPFrameManager::reset_stat()
+{
+  for (unique_ptr<Partition> &partition : partitions_) {
+    lock_guard<mutex> lock_guard(partition->lock);
+    partition->hit_count          = 0;
+    partition->miss_count         = 0;
+    partition->prefetch_hit_count = 0;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 BufferPoolIterator::BufferPoolIterator() {}
 BufferPoolIterator::~BufferPoolIterator() {}
-RC BufferPoolIterator::init(DiskBufferPool &bp, PageNum start_page /* = 0 */)
+RC BufferPoolIterator::init(DiskBufferPool &bp, PageNum start_page /* = 0 */, bool read_ahead /* = false */)
 {
-  bitmap_.init(bp.file_header_->bitmap, bp.file_header_->page_count);
+  buffer_pool_ = &bp;
+  end_page_    = bp.file_header_->page_count;
   if (start_page <= 0) {
     current_page_num_ = -1;
   } else {
     current_page_num_ = start_page - 1;
   }
+
+  read_ahead_     = read_ahead && bp.read_ahead_pages() > 0;
+  read_ahead_end_ = 0;
   return RC::SUCCESS;
 }
 
-bool BufferPoolIterator::has_next() { return bitmap_.next_setted_bit(current_page_num_ + 1) != -1; }
+bool BufferPoolIterator::has_next()
+{
+  return buffer_pool_->next_allocated_page(current_page_num_ + 1, end_page_) != BP_INVALID_PAGE_NUM;
+}
 
 PageNum BufferPoolIterator::next()
 {
-  PageNum next_page = bitmap_.next_setted_bit(current_page_num_ + 1);
-  if (next_page != -1) {
+  PageNum next_page = buffer_pool_->next_allocated_page(current_page_num_ + 1, end_page_);
+  if (next_page != BP_INVALID_PAGE_NUM) {
     current_page_num_ = next_page;
+
+    if (read_ahead_ && next_page >= read_ahead_end_) {
+      const int read_ahead_pages = buffer_pool_->read_ahead_pages();
+      (void)buffer_pool_->read_ahead(next_page, read_ahead_pages);
+      read_ahead_end_ = next_page + read_ahead_pages;
+    }
   }
   return next_page;
 }
@@ -266,13 +495,31 @@ RC DiskBufferPool::open_file(const char *file_name)
 
   if ((rc = load_page(BP_HEADER_PAGE, hdr_frame_)) != RC::SUCCESS) {
     LOG_ERROR("Failed to load first page of %s, due to %s.", file_name, strerror(errno));
+    hdr_frame_->finish_load(false);
     purge_frame(BP_HEADER_PAGE, hdr_frame_);
     close(fd);
     file_desc_ = -1;
     return rc;
   }
+  hdr_frame_->mark_loaded();
 
   file_header_ = (BPFileHeader *)hdr_frame_->data();
+  if (OB_FAIL(rc = load_space_maps())) {
+    LOG_ERROR("Failed to load space map pages of %s. rc=%s", file_name, strrc(rc));
+    for (Frame *frame : space_map_frames_) {
+      frame->unpin();
+    }
+    space_map_frames_.clear();
+    hdr_frame_->unpin();
+    purge_all_pages();
+    close(fd);
+    file_desc_ = -1;
+    return rc;
+  }
+  init_free_pages();
+
+  struct stat file_stat;
+  preallocated_pages_ = fstat(file_desc_, &file_stat) == 0 ? static_cast<PageNum>(file_stat.st_size / BP_PAGE_SIZE) : 0;
 
   LOG_INFO("Successfully open %s. file_desc=%d, hdr_frame=%p, file header=%s",
            file_name, file_desc_, hdr_frame_, file_header_->to_string().c_str());
@@ -287,6 +534,13 @@ RC DiskBufferPool::close_file()
   }
 
   hdr_frame_->unpin();
+  for (Frame *frame : space_map_frames_) {
+    frame->unpin();
+  }
+  space_map_frames_.clear();
+
+  // 后台刷脏页时会 pin 住一些页帧，等它这一轮结束，否则这些页帧不能被清理掉
+  auto cleaner_guard = bp_manager_.page_cleaner().hold();
 
   // TODO: 理论上是在回放时回滚未提交事务，但目前没有undo log，因此不下刷数据page，只通过redo log回放
   rc = purge_all_pages();
@@ -320,34 +574,39 @@ RC DiskBufferPool::get_this_page(PageNum page_num, Frame **frame)
   *frame = nullptr;
 
   Frame *used_match_frame = frame_manager_.get(id(), page_num);
-  if (used_match_frame != nullptr) {
-    used_match_frame->access();
-    *frame = used_match_frame;
-    return RC::SUCCESS;
-  }
+  if (used_match_frame == nullptr) {
+    // Allocate one page and load the data into this page
+    // 如果有其它线程同时在加载这个页面，拿到的就是它分配的页帧，在下面等待加载完成即可
+    rc = allocate_frame(page_num, &used_match_frame);
+    if (rc != RC::SUCCESS) {
+      LOG_ERROR("Failed to alloc frame %s:%d, due to failed to alloc page.", file_name_.c_str(), page_num);
+      return rc;
+    }
 
-  scoped_lock lock_guard(lock_);  // 直接加了一把大锁，其实可以根据访问的页面来细化提高并行度
+    if (used_match_frame->try_begin_load()) {
+      used_match_frame->set_buffer_pool_id(id());
+      // used_match_frame->pin(); // pined in manager::get
 
-  // Allocate one page and load the data into this page
-  Frame *allocated_frame = nullptr;
+      if ((rc = load_page(page_num, used_match_frame)) != RC::SUCCESS) {
+        LOG_ERROR("Failed to load page %s:%d", file_name_.c_str(), page_num);
+        used_match_frame->finish_load(false);
+        discard_frame(page_num, used_match_frame);
+        return rc;
+      }
+      used_match_frame->finish_load(true);
 
-  rc = allocate_frame(page_num, &allocated_frame);
-  if (rc != RC::SUCCESS) {
-    LOG_ERROR("Failed to alloc frame %s:%d, due to failed to alloc page.", file_name_.c_str(), page_num);
-    return rc;
+      detect_sequential_read(page_num);
+    }
   }
 
-  allocated_frame->set_buffer_pool_id(id());
-  // allocated_frame->pin(); // pined in manager::get
-  allocated_frame->access();
-
-  if ((rc = load_page(page_num, allocated_frame)) != RC::SUCCESS) {
-    LOG_ERROR("Failed to load page %s:%d", file_name_.c_str(), page_num);
-    purge_frame(page_num, allocated_frame);
-    return rc;
+  if (!used_match_frame->wait_loaded()) {
+    LOG_WARN("Failed to get page %s:%d, due to another thread failed to load it", file_name_.c_str(), page_num);
+    used_match_frame->unpin();
+    return RC::IOERR_READ;
   }
 
-  *frame = allocated_frame;
+  used_match_frame->access();
+  *frame = used_match_frame;
   return RC::SUCCESS;
 }
 
@@ -357,41 +616,50 @@ RC DiskBufferPool::allocate_page(Frame **frame)
 
   lock_.lock();
 
-  int byte = 0, bit = 0;
   if ((file_header_->allocated_pages) < (file_header_->page_count)) {
     // There is one free page
-    for (int i = 0; i < file_header_->page_count; i++) {
-      byte = i / 8;
-      bit  = i % 8;
-      if (((file_header_->bitmap[byte]) & (1 << bit)) == 0) {
-        (file_header_->allocated_pages)++;
-        file_header_->bitmap[byte] |= (1 << bit);
-        // TODO,  do we need clean the loaded page's data?
-        hdr_frame_->mark_dirty();
-        LSN lsn = 0;
-        rc      = log_handler_.allocate_page(i, lsn);
-        if (OB_FAIL(rc)) {
-          LOG_ERROR("Failed to log allocate page %d, rc=%s", i, strrc(rc));
-          // 忽略了错误
-        }
+    const PageNum i = free_pages_.find_free();
+    if (i != BP_INVALID_PAGE_NUM) {
+      (file_header_->allocated_pages)++;
+      free_pages_.set_allocated(i);
+      // TODO,  do we need clean the loaded page's data?
+      hdr_frame_->mark_dirty();
+      LSN lsn = 0;
+      rc      = log_handler_.allocate_page(i, lsn);
+      if (OB_FAIL(rc)) {
+        LOG_ERROR("Failed to log allocate page %d, rc=%s", i, strrc(rc));
+        // 忽略了错误
+      }
 
-        hdr_frame_->set_lsn(lsn);
+      hdr_frame_->set_lsn(lsn);
+      set_page_allocated(i, true, lsn);
 
-        LOG_DEBUG("allocate a new page without extend buffer pool. page num=%d, buffer pool=%d", i, id());
+      LOG_DEBUG("allocate a new page without extend buffer pool. page num=%d, buffer pool=%d", i, id());
 
-        lock_.unlock();
-        return get_this_page(i, frame);
-      }
+      lock_.unlock();
+      return get_this_page(i, frame);
     }
+
+    LOG_WARN("free page index is inconsistent with file header. file=%s, header=%s, free pages=%d",
+             file_name_.c_str(), file_header_->to_string().c_str(), free_pages_.free_count());
   }
 
-  if (file_header_->page_count >= BPFileHeader::MAX_PAGE_NUM) {
+  // 新的页面可能还需要一个空间位图页
+  if (file_header_->page_count >= BPFileHeader::MAX_PAGE_NUM - 1) {
     LOG_WARN("file buffer pool is full. page count %d, max page count %d",
         file_header_->page_count, BPFileHeader::MAX_PAGE_NUM);
     lock_.unlock();
     return RC::BUFFERPOOL_NOBUF;
   }
 
+  if (is_space_map_page(file_header_->page_count)) {
+    if (OB_FAIL(rc = add_space_map_page())) {
+      LOG_WARN("failed to add space map page. file=%s, rc=%s", file_name_.c_str(), strrc(rc));
+      lock_.unlock();
+      return rc;
+    }
+  }
+
   LSN lsn = 0;
   rc      = log_handler_.allocate_page(file_header_->page_count, lsn);
   if (OB_FAIL(rc)) {
@@ -413,16 +681,17 @@ RC DiskBufferPool::allocate_page(Frame **frame)
 
   file_header_->allocated_pages++;
   file_header_->page_count++;
+  free_pages_.resize(file_header_->page_count);
+  preallocate_extent(page_num);
 
-  byte = page_num / 8;
-  bit  = page_num % 8;
-  file_header_->bitmap[byte] |= (1 << bit);
+  set_page_allocated(page_num, true, lsn);
   hdr_frame_->mark_dirty();
 
   allocated_frame->set_buffer_pool_id(id());
   allocated_frame->access();
   allocated_frame->clear_page();
-  allocated_frame->set_page_num(file_header_->page_count - 1);
+  allocated_frame->set_page_num(page_num);
+  allocated_frame->mark_loaded();
 
   // Use flush operation to extension file
   if ((rc = flush_page_internal(*allocated_frame)) != RC::SUCCESS) {
@@ -444,11 +713,20 @@ RC DiskBufferPool::dispose_page(PageNum page_num)
     return RC::INTERNAL;
   }
 
+  if (is_space_map_page(page_num)) {
+    LOG_ERROR("Failed to dispose page %d, because it is a space map page. filename=%s", page_num, file_name_.c_str());
+    return RC::INTERNAL;
+  }
+
   scoped_lock lock_guard(lock_);
   Frame      *used_frame = frame_manager_.get(id(), page_num);
   if (used_frame != nullptr) {
-    ASSERT("the page try to dispose is in use. frame:%s", used_frame->to_string().c_str());
-    frame_manager_.free(id(), page_num, used_frame);
+    // B+树的乐观读不加锁，可能还 pin 着这个页面，它们校验版本号时会发现页面已经被修改了。
+    // 这时不能释放页帧，留在内存中等它被淘汰，或者等这个页面被重新分配出去
+    if (OB_FAIL(frame_manager_.try_free(id(), page_num, used_frame))) {
+      LOG_DEBUG("page is still pinned while disposing it. frame=%s", used_frame->to_string().c_str());
+      used_frame->unpin();
+    }
   } else {
     LOG_DEBUG("page not found in memory while disposing it. pageNum=%d", page_num);
   }
@@ -463,8 +741,8 @@ RC DiskBufferPool::dispose_page(PageNum page_num)
   hdr_frame_->set_lsn(lsn);
   hdr_frame_->mark_dirty();
   file_header_->allocated_pages--;
-  char tmp = 1 << (page_num % 8);
-  file_header_->bitmap[page_num / 8] &= ~tmp;
+  set_page_allocated(page_num, false, lsn);
+  free_pages_.set_free(page_num);
   return RC::SUCCESS;
 }
 
@@ -495,6 +773,132 @@ RC DiskBufferPool::purge_frame(PageNum page_num, Frame *buf)
   return RC::SUCCESS;
 }
 
+void DiskBufferPool::discard_frame(PageNum page_num, Frame *frame)
+{
+  // 等待的线程被唤醒后会看到加载失败，然后放弃这个页帧
+  while (frame_manager_.try_free(id(), page_num, frame) == RC::LOCKED_UNLOCK) {
+    this_thread::yield();
+  }
+}
+
+void DiskBufferPool::detect_sequential_read(PageNum page_num)
+{
+  const int read_ahead_pages = bp_manager_.read_ahead_pages();
+  if (read_ahead_pages <= 0) {
+    return;
+  }
+
+  if (page_num != next_sequential_page_.load(std::memory_order_relaxed)) {
+    sequential_miss_count_.store(1, std::memory_order_relaxed);
+    next_sequential_page_.store(page_num + 1, std::memory_order_relaxed);
+    return;
+  }
+
+  if (sequential_miss_count_.fetch_add(1, std::memory_order_relaxed) + 1 < SEQUENTIAL_MISS_THRESHOLD) {
+    next_sequential_page_.store(page_num + 1, std::memory_order_relaxed);
+    return;
+  }
+
+  next_sequential_page_.store(page_num + 1 + read_ahead_pages, std::memory_order_relaxed);
+  LOG_DEBUG("sequential read detected, read ahead. file=%s, start page=%d, page count=%d",
+            file_name_.c_str(), page_num + 1, read_ahead_pages);
+  (void)read_ahead(page_num + 1, read_ahead_pages);
+}
+
+int DiskBufferPool::read_ahead_pages() const { return bp_manager_.read_ahead_pages(); }
+
+RC DiskBufferPool::read_ahead(PageNum start_page, int page_count)
+{
+  const int max_page_count = static_cast<int>(frame_manager_.total_frame_num() / 4);
+  page_count               = min(page_count, max_page_count);
+
+  const PageNum end_page = min(start_page + page_count, file_header_->page_count);
+
+  vector<PageNum> page_nums;
+  for (PageNum page_num = next_allocated_page(max(start_page, 1), end_page); page_num != BP_INVALID_PAGE_NUM;
+       page_num         = next_allocated_page(page_num + 1, end_page)) {
+    page_nums.push_back(page_num);
+  }
+
+  RC rc = prefetch_pages(page_nums);
+  LOG_DEBUG("read ahead done. file=%s, start page=%d, page count=%d, pages=%d",
+            file_name_.c_str(), start_page, page_count, static_cast<int>(page_nums.size()));
+  return rc;
+}
+
+RC DiskBufferPool::prefetch_pages(span<const PageNum> page_nums)
+{
+  const size_t max_page_count = frame_manager_.total_frame_num() / 4;
+  if (page_nums.size() > max_page_count) {
+    page_nums = page_nums.first(max_page_count);
+  }
+
+  vector<Frame *>   frames;
+  vector<IoRequest> requests;
+  for (PageNum page_num : page_nums) {
+    if (page_num <= 0 || next_allocated_page(page_num, page_num + 1) != page_num) {
+      continue;
+    }
+
+    // 页面已经在内存中时，拿到的就是已有的页帧。这里不使用 frame_manager_.get，免得预读影响命中率的统计，
+    // 也不调整已有页面在淘汰策略中的位置
+    Frame *frame = nullptr;
+    RC     rc    = allocate_frame(page_num, &frame, true /*prefetch*/);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to allocate frame for prefetch. file=%s, page num=%d, rc=%s",
+               file_name_.c_str(), page_num, strrc(rc));
+      break;
+    }
+
+    // 页面已经在内存中，或者其它线程已经在加载这个页面了
+    if (!frame->try_begin_load()) {
+      frame->unpin();
+      continue;
+    }
+
+    frame->set_buffer_pool_id(id());
+
+    // double write buffer 中的页面可能比数据文件中的更新
+    if (OB_SUCC(dblwr_manager_.read_page(this, page_num, frame->page()))) {
+      frame->finish_load(true);
+      frame->unpin();
+      continue;
+    }
+
+    IoRequest request;
+    request.type   = IoRequest::Type::READ;
+    request.fd     = file_desc_;
+    request.buf    = &frame->page();
+    request.size   = BP_PAGE_SIZE;
+    request.offset = static_cast<int64_t>(page_num) * BP_PAGE_SIZE;
+    requests.push_back(request);
+    frames.push_back(frame);
+  }
+
+  if (requests.empty()) {
+    return RC::SUCCESS;
+  }
+
+  RC rc = bp_manager_.async_io().execute(requests);
+  for (size_t i = 0; i < frames.size(); i++) {
+    Frame        *frame    = frames[i];
+    const PageNum page_num = frame->page_num();
+    if (OB_SUCC(rc) && OB_SUCC(requests[i].rc)) {
+      frame->finish_load(true);
+      frame->unpin();
+    } else {
+      LOG_WARN("failed to prefetch page. file=%s, page num=%d, rc=%s",
+               file_name_.c_str(), page_num, strrc(OB_FAIL(rc) ? rc : requests[i].rc));
+      frame->finish_load(false);
+      discard_frame(page_num, frame);
+    }
+  }
+
+  LOG_DEBUG("prefetch pages done. file=%s, page count=%d, read=%d",
+            file_name_.c_str(), static_cast<int>(page_nums.size()), static_cast<int>(frames.size()));
+  return rc;
+}
+
 RC DiskBufferPool::purge_page(PageNum page_num)
 {
   scoped_lock lock_guard(lock_);
@@ -527,10 +931,12 @@ RC DiskBufferPool::check_all_pages_unpinned()
   scoped_lock lock_guard(lock_);
   for (Frame *frame : frames) {
     frame->unpin();
-    if (frame->page_num() == BP_HEADER_PAGE && frame->pin_count() > 1) {
+    // 文件头和空间位图页一直是pin住的
+    const bool resident = frame->page_num() == BP_HEADER_PAGE || is_space_map_page(frame->page_num());
+    if (resident && frame->pin_count() > 1) {
       LOG_WARN("This page has been pinned. id=%d, pageNum:%d, pin count=%d",
           id(), frame->page_num(), frame->pin_count());
-    } else if (frame->page_num() != BP_HEADER_PAGE && frame->pin_count() > 0) {
+    } else if (!resident && frame->pin_count() > 0) {
       LOG_WARN("This page has been pinned. id=%d, pageNum:%d, pin count=%d",
           id(), frame->page_num(), frame->pin_count());
     }
@@ -585,30 +991,34 @@ RC DiskBufferPool::flush_all_pages()
 
 RC DiskBufferPool::recover_page(PageNum page_num)
 {
-  int byte = 0, bit = 0;
-  byte = page_num / 8;
-  bit  = page_num % 8;
-
   scoped_lock lock_guard(lock_);
-  if (!(file_header_->bitmap[byte] & (1 << bit))) {
-    file_header_->bitmap[byte] |= (1 << bit);
+  if (page_num >= file_header_->page_count || !is_page_allocated(page_num)) {
+    if (page_num >= file_header_->page_count && is_space_map_page(file_header_->page_count)) {
+      RC rc = add_space_map_page();
+      if (OB_FAIL(rc)) {
+        LOG_WARN("failed to add space map page. file=%s, rc=%s", file_name_.c_str(), strrc(rc));
+        return rc;
+      }
+    }
+
     file_header_->allocated_pages++;
     file_header_->page_count++;
     hdr_frame_->mark_dirty();
+
+    free_pages_.resize(max(file_header_->page_count, page_num + 1));
+    free_pages_.set_allocated(page_num);
+    if (page_num < file_header_->page_count) {
+      set_page_allocated(page_num, true, hdr_frame_->lsn());
+    }
   }
   return RC::SUCCESS;
 }
 
 RC DiskBufferPool::write_page(PageNum page_num, Page &page)
 {
-  scoped_lock lock_guard(wr_lock_);
-  int64_t     offset = ((int64_t)page_num) * sizeof(Page);
-  if (lseek(file_desc_, offset, SEEK_SET) == -1) {
-    LOG_ERROR("Failed to write page %lld of %d due to failed to seek %s.", offset, file_desc_, strerror(errno));
-    return RC::IOERR_SEEK;
-  }
-
-  if (writen(file_desc_, &page, sizeof(Page)) != 0) {
+  // 使用pwrite指定偏移量写入，不会修改文件的读写位置，所以不需要加锁
+  int64_t offset = ((int64_t)page_num) * sizeof(Page);
+  if (pwriten(file_desc_, &page, sizeof(Page), offset) != 0) {
     LOG_ERROR("Failed to write page %lld of %d due to %s.", offset, file_desc_, strerror(errno));
     return RC::IOERR_WRITE;
   }
@@ -619,82 +1029,103 @@ RC DiskBufferPool::write_page(PageNum page_num, Page &page)
 
 RC DiskBufferPool::redo_allocate_page(LSN lsn, PageNum page_num)
 {
-  if (hdr_frame_->lsn() >= lsn) {
-    return RC::SUCCESS;
-  }
-
+  // 文件头和空间位图页是分别写回磁盘的，需要根据各自的LSN判断是否已经包含了这次修改
   // scoped_lock lock_guard(lock_); // redo 过程中可以不加锁
-  if (page_num < file_header_->page_count) {
-    Bitmap bitmap(file_header_->bitmap, file_header_->page_count);
-    if (bitmap.get_bit(page_num)) {
-      LOG_WARN("page %d has been allocated. file=%s", page_num, file_name_.c_str());
-      return RC::SUCCESS;
+  const bool redo_header = hdr_frame_->lsn() < lsn;
+  if (redo_header) {
+    if (page_num >= file_header_->page_count) {
+      // 扩展文件。新页面是一个组的第一个数据页时，需要先创建这个组的空间位图页
+      const bool new_group = page_num == file_header_->page_count + 1 && is_space_map_page(file_header_->page_count);
+      if (page_num != file_header_->page_count && !new_group) {
+        LOG_WARN("page %d is not continuous. file=%s, page_count=%d",
+                 page_num, file_name_.c_str(), file_header_->page_count);
+        return RC::INTERNAL;
+      }
+
+      if (file_header_->page_count >= BPFileHeader::MAX_PAGE_NUM - 1) {
+        LOG_WARN("file buffer pool is full. page count %d, max page count %d",
+            file_header_->page_count, BPFileHeader::MAX_PAGE_NUM);
+        return RC::INTERNAL;
+      }
+
+      if (new_group) {
+        RC rc = add_space_map_page();
+        if (OB_FAIL(rc)) {
+          LOG_WARN("failed to add space map page. file=%s, rc=%s", file_name_.c_str(), strrc(rc));
+          return rc;
+        }
+      }
+
+      // 文件可能还没有包含这个页面，比如分配以后还没有刷盘就重启了，后面回放这个页面的日志时需要读取它
+      preallocate_extent(page_num);
+      file_header_->page_count++;
+      free_pages_.resize(file_header_->page_count);
+      LOG_TRACE("[redo] allocate new page. file=%s, pageNum=%d", file_name_.c_str(), page_num);
     }
 
-    bitmap.set_bit(page_num);
     file_header_->allocated_pages++;
+    hdr_frame_->set_lsn(lsn);
     hdr_frame_->mark_dirty();
-    return RC::SUCCESS;
-  }
-
-  if (page_num > file_header_->page_count) {
-    LOG_WARN("page %d is not continuous. file=%s, page_count=%d",
-             page_num, file_name_.c_str(), file_header_->page_count);
+  } else if (page_num >= file_header_->page_count) {
+    LOG_WARN("page %d is not exist. file=%s, page_count=%d", page_num, file_name_.c_str(), file_header_->page_count);
     return RC::INTERNAL;
   }
 
-  // page_num == file_header_->page_count
-  if (file_header_->page_count >= BPFileHeader::MAX_PAGE_NUM) {
-    LOG_WARN("file buffer pool is full. page count %d, max page count %d",
-        file_header_->page_count, BPFileHeader::MAX_PAGE_NUM);
-    return RC::INTERNAL;
+  Frame     *map_frame = space_map_frame(page_num);
+  const bool redo_map  = (map_frame == hdr_frame_) ? redo_header : map_frame->lsn() < lsn;
+  if (redo_map) {
+    if (is_page_allocated(page_num)) {
+      LOG_WARN("page %d has been allocated. file=%s", page_num, file_name_.c_str());
+    }
+    set_page_allocated(page_num, true, lsn);
   }
 
-  file_header_->allocated_pages++;
-  file_header_->page_count++;
-  hdr_frame_->set_lsn(lsn);
-  hdr_frame_->mark_dirty();
-
-  // TODO 应该检查文件是否足够大，包含了当前新分配的页面
-
-  Bitmap bitmap(file_header_->bitmap, file_header_->page_count);
-  bitmap.set_bit(page_num);
-  LOG_TRACE("[redo] allocate new page. file=%s, pageNum=%d", file_name_.c_str(), page_num);
+  free_pages_.set_allocated(page_num);
   return RC::SUCCESS;
 }
 
 RC DiskBufferPool::redo_deallocate_page(LSN lsn, PageNum page_num)
 {
-  if (hdr_frame_->lsn() >= lsn) {
-    return RC::SUCCESS;
-  }
-
   if (page_num >= file_header_->page_count) {
     LOG_WARN("page %d is not exist. file=%s", page_num, file_name_.c_str());
-    return RC::INTERNAL;
+    return hdr_frame_->lsn() >= lsn ? RC::SUCCESS : RC::INTERNAL;
   }
 
-  Bitmap bitmap(file_header_->bitmap, file_header_->page_count);
-  if (!bitmap.get_bit(page_num)) {
-    LOG_WARN("page %d has been deallocated. file=%s", page_num, file_name_.c_str());
-    return RC::INTERNAL;
+  const bool redo_header = hdr_frame_->lsn() < lsn;
+  Frame     *map_frame   = space_map_frame(page_num);
+  const bool redo_map    = (map_frame == hdr_frame_) ? redo_header : map_frame->lsn() < lsn;
+  if (!redo_header && !redo_map) {
+    return RC::SUCCESS;
   }
 
-  bitmap.clear_bit(page_num);
-  file_header_->allocated_pages--;
-  hdr_frame_->set_lsn(lsn);
-  hdr_frame_->mark_dirty();
+  if (redo_map) {
+    if (!is_page_allocated(page_num)) {
+      LOG_WARN("page %d has been deallocated. file=%s", page_num, file_name_.c_str());
+      return RC::INTERNAL;
+    }
+    set_page_allocated(page_num, false, lsn);
+  }
+
+  if (redo_header) {
+    file_header_->allocated_pages--;
+    hdr_frame_->set_lsn(lsn);
+    hdr_frame_->mark_dirty();
+  }
+  free_pages_.set_free(page_num);
   LOG_TRACE("[redo] deallocate page. file=%s, pageNum=%d", file_name_.c_str(), page_num);
   return RC::SUCCESS;
 }
 
-RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer)
+RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer, bool prefetch /*= false*/)
 {
-  auto purger = [this](Frame *frame) {
+  bool flushed_dirty_frame = false;
+  auto purger              = [this, &flushed_dirty_frame](Frame *frame) {
     if (!frame->dirty()) {
       return RC::SUCCESS;
     }
 
+    flushed_dirty_frame = true;
+
     RC rc = RC::SUCCESS;
     if (frame->buffer_pool_id() == id()) {
       rc = this->flush_page_internal(*frame);
@@ -709,7 +1140,7 @@ RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer)
   };
 
   while (true) {
-    Frame *frame = frame_manager_.alloc(id(), page_num);
+    Frame *frame = frame_manager_.alloc(id(), page_num, prefetch);
     if (frame != nullptr) {
       *buffer = frame;
       LOG_DEBUG("allocate frame %p, page num %d, frame=%s", frame, page_num, frame->to_string().c_str());
@@ -718,6 +1149,13 @@ RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer)
 
     LOG_TRACE("frames are all allocated, so we should purge some frames to get one free frame");
     (void)frame_manager_.purge_frames(1 /*count*/, purger);
+
+    // 前台线程不得不等待刷脏页，说明后台刷得不够快
+    // purger 是在页帧表分区的锁内执行的，不能在里面调用
+    if (flushed_dirty_frame) {
+      flushed_dirty_frame = false;
+      bp_manager_.page_cleaner().notify();
+    }
   }
   return RC::BUFFERPOOL_NOBUF;
 }
@@ -728,7 +1166,7 @@ RC DiskBufferPool::check_page_num(PageNum page_num)
     LOG_ERROR("Invalid pageNum:%d, file's name:%s", page_num, file_name_.c_str());
     return RC::BUFFERPOOL_INVALID_PAGE_NUM;
   }
-  if ((file_header_->bitmap[page_num / 8] & (1 << (page_num % 8))) == 0) {
+  if (!is_page_allocated(page_num)) {
     LOG_ERROR("Invalid pageNum:%d, file's name:%s", page_num, file_name_.c_str());
     return RC::BUFFERPOOL_INVALID_PAGE_NUM;
   }
@@ -743,15 +1181,8 @@ RC DiskBufferPool::load_page(PageNum page_num, Frame *frame)
     return rc;
   }
 
-  scoped_lock lock_guard(wr_lock_);
-  int64_t     offset = ((int64_t)page_num) * BP_PAGE_SIZE;
-  if (lseek(file_desc_, offset, SEEK_SET) == -1) {
-    LOG_ERROR("Failed to load page %s:%d, due to failed to lseek:%s.", file_name_.c_str(), page_num, strerror(errno));
-
-    return RC::IOERR_SEEK;
-  }
-
-  int ret = readn(file_desc_, &page, BP_PAGE_SIZE);
+  int64_t offset = ((int64_t)page_num) * BP_PAGE_SIZE;
+  int     ret    = preadn(file_desc_, &page, BP_PAGE_SIZE, offset);
   if (ret != 0) {
     LOG_ERROR("Failed to load page %s, file_desc:%d, page num:%d, due to failed to read data:%s, ret=%d, page count=%d",
               file_name_.c_str(), file_desc_, page_num, strerror(errno), ret, file_header_->allocated_pages);
@@ -765,22 +1196,182 @@ RC DiskBufferPool::load_page(PageNum page_num, Frame *frame)
   return RC::SUCCESS;
 }
 
+RC DiskBufferPool::load_space_maps()
+{
+  for (PageNum page_num = BPFileHeader::PAGES_PER_GROUP; page_num < file_header_->page_count;
+       page_num += BPFileHeader::PAGES_PER_GROUP) {
+    Frame *frame = nullptr;
+    RC     rc    = get_this_page(page_num, &frame);
+    if (OB_FAIL(rc)) {
+      LOG_ERROR("failed to load space map page. file=%s, page num=%d, rc=%s", file_name_.c_str(), page_num, strrc(rc));
+      return rc;
+    }
+    space_map_frames_.push_back(frame);
+  }
+  return RC::SUCCESS;
+}
+
+RC DiskBufferPool::add_space_map_page()
+{
+  const PageNum page_num = file_header_->page_count;
+  ASSERT(is_space_map_page(page_num), "page %d is not a space map page", page_num);
+
+  Frame *frame = nullptr;
+  RC     rc    = allocate_frame(page_num, &frame);
+  if (OB_FAIL(rc)) {
+    LOG_ERROR("Failed to allocate frame for space map page. file=%s, page num=%d", file_name_.c_str(), page_num);
+    return rc;
+  }
+
+  frame->set_buffer_pool_id(id());
+  frame->access();
+  frame->clear_page();
+  frame->set_page_num(page_num);
+  frame->mark_loaded();
+  space_map_frames_.push_back(frame);
+
+  // 空间位图页自己总是已经分配的
+  file_header_->allocated_pages++;
+  file_header_->page_count++;
+  free_pages_.resize(file_header_->page_count);
+  preallocate_extent(page_num);
+  set_page_allocated(page_num, true, 0);
+  hdr_frame_->mark_dirty();
+
+  if (OB_FAIL(rc = flush_page_internal(*frame))) {
+    LOG_WARN("failed to flush space map page. file=%s, page num=%d, rc=%s", file_name_.c_str(), page_num, strrc(rc));
+  }
+
+  LOG_INFO("add space map page. file=%s, page num=%d", file_name_.c_str(), page_num);
+  return RC::SUCCESS;
+}
+
+Frame *DiskBufferPool::space_map_frame(PageNum page_num)
+{
+  const int group = page_num / BPFileHeader::PAGES_PER_GROUP;
+  return group == 0 ? hdr_frame_ : space_map_frames_[group - 1];
+}
+
+Bitmap DiskBufferPool::space_map_of(PageNum page_num, int bit_count /* = BPFileHeader::PAGES_PER_GROUP */)
+{
+  Frame *frame = space_map_frame(page_num);
+  return Bitmap(frame == hdr_frame_ ? file_header_->bitmap : frame->data(), bit_count);
+}
+
+bool DiskBufferPool::is_page_allocated(PageNum page_num)
+{
+  return page_num < file_header_->page_count && space_map_of(page_num).get_bit(page_num % BPFileHeader::PAGES_PER_GROUP);
+}
+
+void DiskBufferPool::set_page_allocated(PageNum page_num, bool allocated, LSN lsn)
+{
+  Frame *frame  = space_map_frame(page_num);
+  Bitmap bitmap = space_map_of(page_num);
+  if (allocated) {
+    bitmap.set_bit(page_num % BPFileHeader::PAGES_PER_GROUP);
+  } else {
+    bitmap.clear_bit(page_num % BPFileHeader::PAGES_PER_GROUP);
+  }
+
+  if (lsn > frame->lsn()) {
+    frame->set_lsn(lsn);
+  }
+  frame->mark_dirty();
+}
+
+PageNum DiskBufferPool::next_allocated_page(PageNum start_page, PageNum end_page)
+{
+  scoped_lock lock_guard(lock_);
+
+  end_page = min(end_page, file_header_->page_count);
+  for (PageNum page_num = max(start_page, 0); page_num < end_page;) {
+    const PageNum group_start = page_num / BPFileHeader::PAGES_PER_GROUP * BPFileHeader::PAGES_PER_GROUP;
+    const int     group_pages = min(end_page - group_start, BPFileHeader::PAGES_PER_GROUP);
+
+    Bitmap bitmap = space_map_of(page_num, group_pages);
+
+    // 跳过空间位图页自己
+    const int start_bit = max(page_num - group_start, group_start == 0 ? 0 : 1);
+    const int bit       = bitmap.next_setted_bit(start_bit);
+    if (bit != -1) {
+      return group_start + bit;
+    }
+    page_num = group_start + BPFileHeader::PAGES_PER_GROUP;
+  }
+  return BP_INVALID_PAGE_NUM;
+}
+
+void DiskBufferPool::init_free_pages()
+{
+  free_pages_.reset(file_header_->page_count);
+
+  for (PageNum group_start = 0; group_start < file_header_->page_count;
+       group_start += BPFileHeader::PAGES_PER_GROUP) {
+    const int group_pages = min(file_header_->page_count - group_start, BPFileHeader::PAGES_PER_GROUP);
+    Bitmap    bitmap      = space_map_of(group_start, group_pages);
+    for (int bit = bitmap.next_unsetted_bit(0); bit != -1; bit = bitmap.next_unsetted_bit(bit + 1)) {
+      free_pages_.set_free(group_start + bit);
+    }
+  }
+}
+
+void DiskBufferPool::preallocate_extent(PageNum page_num)
+{
+  if (page_num < preallocated_pages_) {
+    return;
+  }
+
+  const int     extent_pages = clamp(file_header_->page_count, MIN_EXTENT_PAGES, MAX_EXTENT_PAGES);
+  // 跳过的页面已经写过了，不需要再预留
+  const PageNum start_page   = max(preallocated_pages_, page_num);
+  const PageNum end_page     = page_num + extent_pages;
+  const int64_t offset       = static_cast<int64_t>(start_page) * BP_PAGE_SIZE;
+  const int64_t length       = static_cast<int64_t>(end_page - start_page) * BP_PAGE_SIZE;
+
+  // 失败时也不再重试这一段，避免文件系统不支持时每个页面都调用一次
+  const int ret       = posix_fallocate(file_desc_, offset, length);
+  preallocated_pages_ = end_page;
+  if (ret != 0) {
+    LOG_WARN("failed to preallocate extent. file=%s, offset=%ld, length=%ld, error=%s",
+             file_name_.c_str(), offset, length, strerror(ret));
+    return;
+  }
+
+  LOG_DEBUG("preallocate extent. file=%s, pages=[%d, %d)", file_name_.c_str(), start_page, end_page);
+}
+
 int DiskBufferPool::file_desc() const { return file_desc_; }
 
 ////////////////////////////////////////////////////////////////////////////////
-BufferPoolManager::BufferPoolManager(int memory_size /* = 0 */)
+BufferPoolManager::BufferPoolManager(
+    int memory_size /* = 0 */, const char *replacer /* = nullptr */, const char *allocator /* = nullptr */)
 {
   if (memory_size <= 0) {
     memory_size = MEM_POOL_ITEM_NUM * DEFAULT_ITEM_NUM_PER_POOL * BP_PAGE_SIZE;
   }
   const int pool_num = max(memory_size / BP_PAGE_SIZE / DEFAULT_ITEM_NUM_PER_POOL, 1);
-  frame_manager_.init(pool_num);
-  LOG_INFO("buffer pool manager init with memory size %d, page num: %d, pool num: %d",
-           memory_size, pool_num * DEFAULT_ITEM_NUM_PER_POOL, pool_num);
+  RC        rc       = frame_manager_.init(pool_num, BPFrameManager::DEFAULT_PARTITION_NUM, replacer, allocator);
+  if (rc == RC::INVALID_ARGUMENT) {
+    LOG_WARN("invalid frame replacer %s or frame allocator %s, use lru and simple instead",
+             replacer == nullptr ? "" : replacer, allocator == nullptr ? "" : allocator);
+    frame_manager_.init(pool_num, BPFrameManager::DEFAULT_PARTITION_NUM, "lru", "simple");
+  }
+  LOG_INFO("buffer pool manager init with memory size %d, page num: %d, pool num: %d, replacer: %s, allocator: %s",
+           memory_size, pool_num * DEFAULT_ITEM_NUM_PER_POOL, pool_num,
+           frame_manager_.replacer_name(), frame_manager_.allocator_name());
 }
 
 BufferPoolManager::~BufferPoolManager()
 {
+  page_cleaner_.stop();
+
+  LOG_INFO("buffer pool statistics. replacer=%s, hit=%llu, miss=%llu, prefetch hit=%llu, hit ratio=%.4f",
+           frame_manager_.replacer_name(),
+           static_cast<unsigned long long>(frame_manager_.hit_count()),
+           static_cast<unsigned long long>(frame_manager_.miss_count()),
+           static_cast<unsigned long long>(frame_manager_.prefetch_hit_count()),
+           frame_manager_.hit_ratio());
+
   unordered_map<string, DiskBufferPool *> tmp_bps;
   tmp_bps.swap(buffer_pools_);
 
@@ -789,10 +1380,15 @@ BufferPoolManager::~BufferPoolManager()
   }
 }
 
-RC BufferPoolManager::init(unique_ptr<DoubleWriteBuffer> dblwr_buffer)
+RC BufferPoolManager::init(unique_ptr<DoubleWriteBuffer> dblwr_buffer, unique_ptr<AsyncIo> async_io /* = nullptr */)
 {
   dblwr_buffer_ = std::move(dblwr_buffer);
-  return RC::SUCCESS;
+
+  if (async_io) {
+    async_io_ = std::move(async_io);
+    return RC::SUCCESS;
+  }
+  return AsyncIo::create("posix", AsyncIo::DEFAULT_QUEUE_DEPTH, async_io_);
 }
 
 RC BufferPoolManager::create_file(const char *file_name)
@@ -895,16 +1491,13 @@ RC BufferPoolManager::close_file(const char *_file_name)
 
 RC BufferPoolManager::flush_page(Frame &frame)
 {
-  int buffer_pool_id = frame.buffer_pool_id();
-
-  scoped_lock lock_guard(lock_);
-  auto        iter = id_to_buffer_pools_.find(buffer_pool_id);
-  if (iter == id_to_buffer_pools_.end()) {
-    LOG_WARN("unknown buffer pool of id %d", buffer_pool_id);
-    return RC::INTERNAL;
+  // 刷页面时可能会写满 double write buffer，写回批次时要再次查找 buffer pool，所以这里不能一直拿着锁
+  DiskBufferPool *bp = nullptr;
+  RC              rc = get_buffer_pool(frame.buffer_pool_id(), bp);
+  if (OB_FAIL(rc)) {
+    return rc;
   }
 
-  DiskBufferPool *bp = iter->second;
   return bp->flush_page(frame);
 }
 
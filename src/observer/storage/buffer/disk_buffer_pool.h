@@ -25,15 +25,21 @@ See the Mulan PSL v2 for more details. */
 #include <time.h>
 #include <optional>
 
+#include "common/lang/algorithm.h"
 #include "common/lang/bitmap.h"
-#include "common/lang/lru_cache.h"
+#include "common/lang/limits.h"
 #include "common/lang/mutex.h"
 #include "common/lang/memory.h"
+#include "common/lang/span.h"
 #include "common/lang/unordered_map.h"
 #include "common/mm/mem_pool.h"
 #include "common/sys/rc.h"
 #include "common/types.h"
+#include "storage/buffer/async_io.h"
 #include "storage/buffer/frame.h"
+#include "storage/buffer/frame_replacer.h"
+#include "storage/buffer/free_page_index.h"
+#include "storage/buffer/page_cleaner.h"
 #include "storage/buffer/page.h"
 #include "storage/buffer/buffer_pool_log.h"
 
@@ -53,27 +59,34 @@ class BufferPoolLogHandler;
 /**
  * @brief BufferPool的文件第一个页面，存放一些元数据信息，包括了后面每页的分配信息。
  * @ingroup BufferPool
- * @details
+ * @details 文件按照每 PAGES_PER_GROUP 个页面划分成一个组(group)，每个组的页面分配情况使用一个位图记录。
+ * 第0个组的位图就存放在文件头中；其它组的第一个页面是这个组的空间位图页(space map page)，只存放这个组的位图。
+ * 空间位图页的位置是固定的，根据页面编号就能算出它属于哪个组、位图在哪个页面，文件增长时也不需要移动已有的数据。
+ * 这样一个文件最多可以有 MAX_PAGE_NUM 个页面，而不再受文件头中位图大小的限制。
  * @code
- * TODO 1. 当前的做法，只能分配比较少的页面，你可以扩展一下，支持更多的页面或无限多的页面吗？
- *         可以参考Linux ext(n)和Windows NTFS等文件系统
- *      2. 当前使用bitmap存放页面分配情况，但是这种方法在页面非常多的时候，查找空闲页面的
- *         效率非常低，你有办法优化吗？
+ * | page 0      | page 1 ... | page G      | page G+1 ... | page 2G     | ...
+ * | 文件头+位图0 | 组0的页面   | 组1的位图页   | 组1的页面     | 组2的位图页  | ...
  * @endcode
+ * 位图只用来持久化页面的分配情况，查找空闲页面使用内存中的 FreePageIndex。
  */
 struct BPFileHeader
 {
   int32_t buffer_pool_id;   //! buffer pool id
-  int32_t page_count;       //! 当前文件一共有多少个页面
-  int32_t allocated_pages;  //! 已经分配了多少个页面
-  char    bitmap[0];        //! 页面分配位图, 第0个页面(就是当前页面)，总是1
+  int32_t page_count;       //! 当前文件一共有多少个页面，包括空间位图页
+  int32_t allocated_pages;  //! 已经分配了多少个页面，包括空间位图页
+  char    bitmap[0];        //! 第0个组的页面分配位图, 第0个页面(就是当前页面)，总是1
 
   /**
-   * 能够分配的最大的页面个数，即bitmap的字节数 乘以8
+   * 一个组的页面个数，即文件头中bitmap的字节数 乘以8。空间位图页中的位图也是这么大
    */
-  static const int MAX_PAGE_NUM =
+  static constexpr int PAGES_PER_GROUP =
       (BP_PAGE_DATA_SIZE - sizeof(buffer_pool_id) - sizeof(page_count) - sizeof(allocated_pages)) * 8;
 
+  /**
+   * 能够分配的最大的页面个数，受页面编号类型的限制
+   */
+  static constexpr int MAX_PAGE_NUM = numeric_limits<PageNum>::max();
+
   string to_string() const;
 };
 
@@ -84,13 +97,33 @@ struct BPFileHeader
  * 当内存中的页帧不够用时，需要从内存中淘汰一些页帧，以便为新的页帧腾出空间。
  * 这个管理器负责为所有的BufferPool提供页帧管理服务，也就是所有的BufferPool磁盘文件
  * 在访问时都使用这个管理器映射到内存。
+ *
+ * 页帧表按照 FrameId 的哈希值被切分成多个分区，每个分区有自己的锁和淘汰策略(FrameReplacer)。
+ * 不同页面的访问通常落在不同的分区上，这样多个线程查找页面时就不会都竞争同一把锁。
+ * 淘汰时从一个轮转的分区开始查找，每次只锁住正在查找的那一个分区。
+ * 每个分区还会统计页面查找的命中次数，用来比较不同淘汰策略的效果。
  */
 class BPFrameManager
 {
+public:
+  static constexpr int DEFAULT_PARTITION_NUM     = 16;
+  static constexpr int CLEAN_VICTIM_SEARCH_DEPTH = 64;
+
 public:
   BPFrameManager(const char *tag);
 
-  RC init(int pool_num);
+  /**
+   * @brief 初始化
+   * @param pool_num 内存池的个数，每个内存池包含 DEFAULT_ITEM_NUM_PER_POOL 个页帧
+   * @param partition_num 页帧表的分区个数
+   * @param replacer 淘汰策略的名字，参考 FrameReplacer::create
+   * @param allocator 页帧内存的分配方式
+   * - simple(默认): 使用 MemPoolSimple，每个内存池单独 new 出来
+   * - mmap: 使用 MemPoolMapped，启动时一次性映射所有页帧的内存，有大页时使用大页
+   * - mmap_interleave: 与 mmap 相同，并且让内存在所有NUMA节点之间交错分配
+   */
+  RC init(int pool_num, int partition_num = DEFAULT_PARTITION_NUM, const char *replacer = nullptr,
+      const char *allocator = nullptr);
   RC cleanup();
 
   /**
@@ -115,9 +148,11 @@ public:
    *
    * @param buffer_pool_id buffer Pool标识
    * @param page_num 页面编号
+   * @param prefetch 是否为预读分配。预读不算对页面的访问，已经在内存中的页面不调整它在淘汰策略中的位置；
+   * 新分配的页帧标记为预读的页帧，第一次真正访问时才算作加入淘汰策略以后的那次访问
    * @return Frame* 页帧指针
    */
-  Frame *alloc(int buffer_pool_id, PageNum page_num);
+  Frame *alloc(int buffer_pool_id, PageNum page_num, bool prefetch = false);
 
   /**
    * 尽管frame中已经包含了buffer_pool_id和page_num，但是依然要求
@@ -125,25 +160,56 @@ public:
    */
   RC free(int buffer_pool_id, PageNum page_num, Frame *frame);
 
+  /**
+   * @brief 与free类似，但是当页帧还被其他人引用时(pin count > 1)不会释放，而是返回 RC::LOCKED_UNLOCK
+   * @details 页面加载失败时，可能还有其它线程在等待这个页帧，需要等它们都放弃以后才能释放
+   */
+  RC try_free(int buffer_pool_id, PageNum page_num, Frame *frame);
+
   /**
    * 如果不能从空闲链表中分配新的页面，就使用这个接口，
-   * 尝试从pin count=0的页面中淘汰一些
+   * 尝试从pin count=0的页面中淘汰一些。
+   * 会先在最应该被淘汰的 CLEAN_VICTIM_SEARCH_DEPTH 个页帧中查找干净的页面，找不到时才淘汰脏页
    * @param count 想要purge多少个页面
    * @param purger 需要在释放frame之前，对页面做些什么操作。当前是刷新脏数据到磁盘
    * @return 返回本次清理了多少个页面
    */
   int purge_frames(int count, function<RC(Frame *frame)> purger);
 
-  size_t frame_num() const { return frames_.count(); }
+  /**
+   * @brief 找出没有被使用的脏页并 pin 住，调用者需要负责 unpin
+   * @return 所有脏页的个数，包括正在被使用的
+   */
+  size_t find_dirty_frames(vector<Frame *> &frames);
+
+  /**
+   * @brief 所有脏页中最小的recLSN，做检查点时使用
+   * @return 没有脏页或者脏页还没有记录日志时返回0
+   */
+  LSN min_rec_lsn();
+
+  size_t frame_num() const { return frame_count_.load(); }
 
   /**
    * 测试使用。返回已经从内存申请的个数
    */
-  size_t total_frame_num() const { return allocator_.get_size(); }
+  size_t total_frame_num() const { return allocator_ ? allocator_->get_size() : 0; }
 
-private:
-  Frame *get_internal(const FrameId &frame_id);
-  RC     free_internal(const FrameId &frame_id, Frame *frame);
+  int partition_num() const { return static_cast<int>(partitions_.size()); }
+
+  const char *replacer_name() const { return replacer_name_.c_str(); }
+  const char *allocator_name() const { return allocator_name_.c_str(); }
+
+  /**
+   * @brief 调用 get 查找页面时，在内存中找到的次数和没有找到的次数
+   * @details 第一次访问预读加载的页面时不算命中，单独统计在 prefetch_hit_count 中。
+   * 命中率是命中次数占所有查找次数的比例
+   */
+  uint64_t hit_count() const;
+  uint64_t miss_count() const;
+  uint64_t prefetch_hit_count() const;
+  double   hit_ratio() const;
+  void     reset_stat();
 
 private:
   class BPFrameIdHasher
@@ -152,17 +218,50 @@ private:
     size_t operator()(const FrameId &frame_id) const { return frame_id.hash(); }
   };
 
-  using FrameLruCache  = common::LruCache<FrameId, Frame *, BPFrameIdHasher>;
   using FrameAllocator = common::MemPoolSimple<Frame>;
 
-  mutex          lock_;
-  FrameLruCache  frames_;
-  FrameAllocator allocator_;
+  /**
+   * @brief 页帧表的一个分区
+   * @details 每个分区管理一部分页帧，使用自己的锁保护页帧表和淘汰策略。
+   * 命中统计也放在分区中，由分区锁保护，避免所有线程更新同一个计数器
+   */
+  struct Partition
+  {
+    mutex                                            lock;
+    unordered_map<FrameId, Frame *, BPFrameIdHasher> frames;
+    unique_ptr<FrameReplacer>                        replacer;
+    uint64_t                                         hit_count          = 0;
+    uint64_t                                         miss_count         = 0;
+    uint64_t                                         prefetch_hit_count = 0;
+  };
+
+  Partition &partition_of(const FrameId &frame_id);
+
+  RC create_allocator(const char *allocator);
+
+  /**
+   * @brief 查找并pin住页帧
+   * @details 预读加载的页帧第一次被访问时，相当于刚刚加入淘汰策略，不调用 on_access，
+   * 否则一次扫描就会把预读的页面都当作热点页面
+   * @param[out] prefetch_hit 是否是第一次访问预读加载的页帧
+   */
+  Frame *get_internal(Partition &partition, const FrameId &frame_id, bool &prefetch_hit);
+  RC     free_internal(Partition &partition, const FrameId &frame_id, Frame *frame);
+
+private:
+  vector<unique_ptr<Partition>> partitions_;
+  atomic<size_t>                frame_count_{0};     ///< 所有分区中页帧的总数
+  atomic<uint32_t>              purge_cursor_{0};    ///< 下一次淘汰从哪个分区开始查找
+  string                        tag_;
+  unique_ptr<FrameAllocator>    allocator_;
+  string                        allocator_name_;
+  string                        replacer_name_;
 };
 
 /**
  * @brief 用于遍历BufferPool中的所有页面
  * @ingroup BufferPool
+ * @details 只遍历初始化时已经存在的页面，会跳过空间位图页
  */
 class BufferPoolIterator
 {
@@ -170,14 +269,21 @@ public:
   BufferPoolIterator();
   ~BufferPoolIterator();
 
-  RC      init(DiskBufferPool &bp, PageNum start_page = 0);
+  /**
+   * @param read_ahead 是否预读。遍历整个文件的扫描可以打开，每次走到预读窗口的末尾时，
+   * 会把接下来一个窗口内的页面一次批量读到内存中，参考 DiskBufferPool::read_ahead
+   */
+  RC      init(DiskBufferPool &bp, PageNum start_page = 0, bool read_ahead = false);
   bool    has_next();
   PageNum next();
   RC      reset();
 
 private:
-  common::Bitmap bitmap_;
-  PageNum        current_page_num_ = -1;
+  DiskBufferPool *buffer_pool_      = nullptr;
+  PageNum         current_page_num_ = -1;
+  PageNum         end_page_         = 0;      ///< 初始化时文件中的页面个数
+  bool            read_ahead_       = false;  ///< 是否需要预读
+  PageNum         read_ahead_end_   = 0;      ///< 已经预读到哪个页面(不包含)
 };
 
 /**
@@ -188,6 +294,11 @@ private:
  */
 class DiskBufferPool final
 {
+public:
+  /// 文件空间不够时，一次预留的页面个数的范围，参考 preallocate_extent
+  static constexpr int MIN_EXTENT_PAGES = 8;
+  static constexpr int MAX_EXTENT_PAGES = 1024;
+
 public:
   DiskBufferPool(BufferPoolManager &bp_manager, BPFrameManager &frame_manager, DoubleWriteBuffer &dblwr_manager,
       LogHandler &log_handler);
@@ -205,6 +316,8 @@ public:
 
   /**
    * 根据文件ID和页号获取指定页面到缓冲区，返回页面句柄指针。
+   * @details 页面不在内存中时，由第一个访问的线程负责从磁盘加载，同时访问这个页面的其它线程在页帧上
+   * 等待加载完成。这个过程不会加整个buffer pool的锁，所以访问不同页面的线程可以同时做IO。
    */
   RC get_this_page(PageNum page_num, Frame **frame);
 
@@ -269,13 +382,49 @@ public:
   RC redo_allocate_page(LSN lsn, PageNum page_num);
   RC redo_deallocate_page(LSN lsn, PageNum page_num);
 
+  /**
+   * @brief 预读从 start_page 开始的 page_count 个页面
+   * @details 跳过没有分配的和已经在内存中的页面，剩下的页面通过 BufferPoolManager 的 AsyncIo 一次批量读取，
+   * 这样扫描时就不需要每个页面都等待一次磁盘IO。预读的页面不会被 pin 住。
+   * 预读只是一个提示，某个页面读取失败时，只是放弃这个页面，后面访问时会重新读取。
+   * @param page_count 预读的页面个数，最多预读页帧总数的 1/4，防止把其它页面都淘汰出去
+   */
+  RC read_ahead(PageNum start_page, int page_count);
+
+  /**
+   * @brief 预读指定的一组页面
+   * @details 和 read_ahead 一样，跳过没有分配的和已经在内存中的页面，剩下的页面一次批量读取，不会被 pin 住。
+   * 日志回放时用它提前读取日志涉及的页面
+   * @param page_nums 要预读的页面，最多预读页帧总数的 1/4
+   */
+  RC prefetch_pages(span<const PageNum> page_nums);
+
+  /**
+   * @brief 预读窗口的大小，为0表示不预读
+   */
+  int read_ahead_pages() const;
+
+  /**
+   * @brief 查找 [start_page, end_page) 中第一个已经分配的页面，会跳过空间位图页
+   * @return 没有找到时返回 BP_INVALID_PAGE_NUM
+   */
+  PageNum next_allocated_page(PageNum start_page, PageNum end_page);
+
+  /**
+   * @brief 是否为空间位图页，即每个组的第一个页面(文件头除外)。参考 BPFileHeader
+   */
+  static bool is_space_map_page(PageNum page_num)
+  {
+    return page_num > BP_HEADER_PAGE && page_num % BPFileHeader::PAGES_PER_GROUP == 0;
+  }
+
 public:
   int32_t id() const { return buffer_pool_id_; }
 
   const char *filename() const { return file_name_.c_str(); }
 
 protected:
-  RC allocate_frame(PageNum page_num, Frame **buf);
+  RC allocate_frame(PageNum page_num, Frame **buf, bool prefetch = false);
 
   /**
    * 刷新指定页面到磁盘(flush)，并且释放关联的Frame
@@ -283,11 +432,69 @@ protected:
   RC purge_frame(PageNum page_num, Frame *used_frame);
   RC check_page_num(PageNum page_num);
 
+  /**
+   * 页面加载失败时，释放对应的页帧。会等待其它引用这个页帧的线程都放弃以后再释放
+   */
+  void discard_frame(PageNum page_num, Frame *frame);
+
+  /**
+   * @brief 检测是否在按照页面编号顺序缺页，连续缺页 SEQUENTIAL_MISS_THRESHOLD 次以后开始预读
+   * @details 预读一个窗口以后，下一次缺页就是窗口之后的那个页面，所以记录的是下一个"顺序"缺页的页面编号
+   */
+  void detect_sequential_read(PageNum page_num);
+
   /**
    * 加载指定页面的数据到内存中
    */
   RC load_page(PageNum page_num, Frame *frame);
 
+  /**
+   * @brief 加载所有的空间位图页，与文件头一样一直 pin 在内存中
+   */
+  RC load_space_maps();
+
+  /**
+   * @brief 文件增长到一个新的组时，在组的第一个页面创建空间位图页
+   * @details 新的空间位图页会计入文件头中的页面个数，并且马上写入磁盘
+   */
+  RC add_space_map_page();
+
+  /**
+   * @brief 页面所在组的位图所在的页帧。第0个组的位图在文件头中，返回文件头的页帧
+   * @details 调用者需要保证页面所在的组已经存在，并且持有 lock_ 或者在重做日志
+   */
+  Frame *space_map_frame(PageNum page_num);
+
+  /**
+   * @brief 页面所在组的位图，位图中的下标是页面在组中的偏移
+   * @param bit_count 位图的大小，查找时可以用来排除不存在的页面
+   */
+  common::Bitmap space_map_of(PageNum page_num, int bit_count = BPFileHeader::PAGES_PER_GROUP);
+
+  /**
+   * @brief 页面是否已经分配。调用者需要持有 lock_ 或者在重做日志
+   */
+  bool is_page_allocated(PageNum page_num);
+
+  /**
+   * @brief 修改页面在空间位图中的状态，并把位图所在的页面标记为脏页
+   * @details 不会修改文件头中的页面计数，也不会修改空闲页面索引
+   */
+  void set_page_allocated(PageNum page_num, bool allocated, LSN lsn);
+
+  /**
+   * @brief 根据所有的空间位图重建空闲页面索引
+   */
+  void init_free_pages();
+
+  /**
+   * @brief 新页面超出了文件已经预留的空间时，一次预留一段连续的空间(extent)
+   * @details 批量导入数据时页面是一个一个分配的，如果文件每次只增长一个页面，文件系统很难分配出连续的空间，
+   * 每次写入也都要更新文件的元数据。每次预留的页面数与当前的页面数相同，在 MIN_EXTENT_PAGES 和
+   * MAX_EXTENT_PAGES 之间，也就是文件较小时成倍增长。预留失败不影响页面分配，写入时文件会自然增长。
+   */
+  void preallocate_extent(PageNum page_num);
+
   /**
    * 如果页面是脏的，就将数据刷新到磁盘
    */
@@ -301,15 +508,23 @@ private:
 
   int file_desc_ = -1;  /// 文件描述符
   /// 由于在最开始打开文件时，没有正确的buffer pool id不能加载header frame，所以单独从文件中读取此标识
-  int32_t       buffer_pool_id_ = -1;
-  Frame        *hdr_frame_      = nullptr;  /// 文件头页面
-  BPFileHeader *file_header_    = nullptr;  /// 文件头
-  set<PageNum>  disposed_pages_;            /// 已经释放的页面
+  int32_t         buffer_pool_id_     = -1;
+  Frame          *hdr_frame_          = nullptr;  /// 文件头页面
+  BPFileHeader   *file_header_        = nullptr;  /// 文件头
+  set<PageNum>    disposed_pages_;                /// 已经释放的页面
+  vector<Frame *> space_map_frames_;              /// 空间位图页，第i个元素属于第i+1个组，由lock_保护
+  FreePageIndex   free_pages_;                    /// 空闲页面索引，由lock_保护
+  PageNum         preallocated_pages_ = 0;        /// 文件中已经预留了空间的页面个数
 
   string file_name_;  /// 文件名
 
   common::Mutex lock_;
-  common::Mutex wr_lock_;
+
+  static constexpr int SEQUENTIAL_MISS_THRESHOLD = 4;
+
+  /// 顺序读检测。多个线程同时访问时检测结果可能不准确，只会影响是否预读，所以不需要加锁
+  atomic<PageNum> next_sequential_page_{-1};
+  atomic<int>     sequential_miss_count_{0};
 
 private:
   friend class BufferPoolIterator;
@@ -322,10 +537,23 @@ private:
 class BufferPoolManager final
 {
 public:
-  BufferPoolManager(int memory_size = 0);
+  static constexpr int DEFAULT_READ_AHEAD_PAGES = 32;
+
+public:
+  /**
+   * @param memory_size 页帧使用的内存大小，不大于0时使用默认值
+   * @param replacer 页帧淘汰策略的名字，参考 FrameReplacer::create
+   * @param allocator 页帧内存的分配方式，参考 BPFrameManager::init
+   */
+  BufferPoolManager(int memory_size = 0, const char *replacer = nullptr, const char *allocator = nullptr);
   ~BufferPoolManager();
 
-  RC init(unique_ptr<DoubleWriteBuffer> dblwr_buffer);
+  /**
+   * @brief 初始化
+   * @param dblwr_buffer double write buffer
+   * @param async_io 批量读写页面使用的IO执行器，为空时使用 posix 实现
+   */
+  RC init(unique_ptr<DoubleWriteBuffer> dblwr_buffer, unique_ptr<AsyncIo> async_io = nullptr);
 
   RC create_file(const char *file_name);
   RC open_file(LogHandler &log_handler, const char *file_name, DiskBufferPool *&bp);
@@ -333,8 +561,16 @@ public:
 
   RC flush_page(Frame &frame);
 
+  /**
+   * @brief 设置预读窗口的大小，为0时不预读
+   */
+  void set_read_ahead_pages(int read_ahead_pages) { read_ahead_pages_ = max(read_ahead_pages, 0); }
+  int  read_ahead_pages() const { return read_ahead_pages_; }
+
   BPFrameManager    &get_frame_manager() { return frame_manager_; }
+  PageCleaner       &page_cleaner() { return page_cleaner_; }
   DoubleWriteBuffer *get_dblwr_buffer() { return dblwr_buffer_.get(); }
+  AsyncIo           &async_io() { return *async_io_; }
 
   /**
    * @brief 根据ID获取对应的BufferPool对象
@@ -348,6 +584,9 @@ private:
   BPFrameManager frame_manager_{"BufPool"};
 
   unique_ptr<DoubleWriteBuffer> dblwr_buffer_;
+  unique_ptr<AsyncIo>           async_io_;
+  int                           read_ahead_pages_ = DEFAULT_READ_AHEAD_PAGES;
+  PageCleaner                   page_cleaner_{*this};
 
   common::Mutex                            lock_;
   unordered_map<string, DiskBufferPool *>  buffer_pools_;
@@ -17,8 +17,9 @@ See the Mulan PSL v2 for more details. */
 #include "storage/buffer/disk_buffer_pool.h"
 #include "common/io/io.h"
 #include "common/log/log.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/vector.h"
 #include "common/math/crc.h"
-#include <algorithm>
 
 using namespace common;
 
@@ -31,7 +32,7 @@ public:
 public:
   DoubleWritePageKey key;
   int32_t            page_index = -1;  /// 页面在double write buffer文件中的页索引
-  bool valid = true;  /// 表示页面是否有效，在页面被删除时，需要同时标记磁盘上的值。
+  bool valid = true;  /// 表示页面是否有效。旧版本在页面写回原位置后会把磁盘上的值标记为无效
   Page page;
 
   static const int32_t SIZE;
@@ -45,8 +46,8 @@ const int32_t DoubleWritePage::SIZE = sizeof(DoubleWritePage);
 
 const int32_t DoubleWriteBufferHeader::SIZE = sizeof(DoubleWriteBufferHeader);
 
-DiskDoubleWriteBuffer::DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages /*=16*/)
-    : max_pages_(max_pages), bp_manager_(bp_manager)
+DiskDoubleWriteBuffer::DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages /*=DEFAULT_BATCH_PAGES*/)
+    : max_pages_(max(max_pages, 1)), bp_manager_(bp_manager)
 {}
 
 DiskDoubleWriteBuffer::~DiskDoubleWriteBuffer()
@@ -72,108 +73,182 @@ RC DiskDoubleWriteBuffer::open_file(const char *filename)
   return load_pages();
 }
 
-RC DiskDoubleWriteBuffer::flush_page()
+RC DiskDoubleWriteBuffer::flush_page() { return flush_pages(nullptr); }
+
+RC DiskDoubleWriteBuffer::add_page(DiskBufferPool *bp, PageNum page_num, Page &page)
 {
-  sync();
+  DoubleWritePageKey key{bp->id(), page_num};
+  bool               full = false;
+  {
+    scoped_lock lock_guard(lock_);
+    auto        iter = dblwr_pages_.find(key);
+    if (iter != dblwr_pages_.end()) {
+      iter->second->page = page;
+      LOG_TRACE("[cache hit]add page into double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d, dwb size=%d",
+                bp->id(), page_num, page.lsn, static_cast<int>(dblwr_pages_.size()));
+      return RC::SUCCESS;
+    }
+
+    DoubleWritePage *dblwr_page = new DoubleWritePage(bp->id(), page_num, -1 /*page_index*/, page);
+    dblwr_pages_.emplace(key, dblwr_page);
+    LOG_TRACE("insert page into double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d, dwb size:%d",
+              bp->id(), page_num, page.lsn, static_cast<int>(dblwr_pages_.size()));
+
+    full = static_cast<int>(dblwr_pages_.size()) >= max_pages_;
+  }
 
-  for (const auto &pair : dblwr_pages_) {
-    RC rc = write_page(pair.second);
-    if (rc != RC::SUCCESS) {
+  if (full) {
+    RC rc = flush_page();
+    if (OB_FAIL(rc)) {
+      LOG_ERROR("Failed to flush pages in double write buffer. rc=%s", strrc(rc));
       return rc;
     }
-    pair.second->valid = false;
-    write_page_internal(pair.second);
-    delete pair.second;
   }
 
-  dblwr_pages_.clear();
-  header_.page_cnt = 0;
-
   return RC::SUCCESS;
 }
 
-RC DiskDoubleWriteBuffer::add_page(DiskBufferPool *bp, PageNum page_num, Page &page)
+RC DiskDoubleWriteBuffer::flush_pages(DiskBufferPool *bp)
 {
-  scoped_lock        lock_guard(lock_);
-  DoubleWritePageKey key{bp->id(), page_num};
-  auto               iter = dblwr_pages_.find(key);
-  if (iter != dblwr_pages_.end()) {
-    iter->second->page = page;
-    LOG_TRACE("[cache hit]add page into double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d, dwb size=%d",
-              bp->id(), page_num, page.lsn, static_cast<int>(dblwr_pages_.size()));
-    return write_page_internal(iter->second);
+  scoped_lock flush_guard(flush_lock_);
+
+  vector<DoubleWritePage *> pages;
+  {
+    scoped_lock lock_guard(lock_);
+    for (auto iter = dblwr_pages_.begin(); iter != dblwr_pages_.end();) {
+      if (bp != nullptr && iter->first.buffer_pool_id != bp->id()) {
+        ++iter;
+        continue;
+      }
+      pages.push_back(iter->second);
+      flushing_pages_.insert(*iter);
+      iter = dblwr_pages_.erase(iter);
+    }
   }
 
-  int64_t          page_cnt   = dblwr_pages_.size();
-  DoubleWritePage *dblwr_page = new DoubleWritePage(bp->id(), page_num, page_cnt, page);
-  dblwr_pages_.insert(pair<DoubleWritePageKey, DoubleWritePage *>(key, dblwr_page));
-  LOG_TRACE("insert page into double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d, dwb size:%d",
-            bp->id(), page_num, page.lsn, static_cast<int>(dblwr_pages_.size()));
-
-  RC rc = write_page_internal(dblwr_page);
-  if (OB_FAIL(rc)) {
-    LOG_WARN("failed to write page into double write buffer. rc=%s buffer_pool_id:%d,page_num:%d,lsn=%d.",
-        strrc(rc), bp->id(), page_num, page.lsn);
-    return rc;
+  if (pages.empty()) {
+    return RC::SUCCESS;
   }
 
-  if (page_cnt + 1 > header_.page_cnt) {
-    header_.page_cnt = page_cnt + 1;
-    if (lseek(file_desc_, 0, SEEK_SET) == -1) {
-      LOG_ERROR("Failed to add page header due to failed to seek %s.", strerror(errno));
-      return RC::IOERR_SEEK;
+  // 按照文件和偏移量排序，每一批的数据文件写入都尽量是顺序的
+  sort(pages.begin(), pages.end(), [](const DoubleWritePage *a, const DoubleWritePage *b) {
+    if (a->key.buffer_pool_id != b->key.buffer_pool_id) {
+      return a->key.buffer_pool_id < b->key.buffer_pool_id;
     }
+    return a->key.page_num < b->key.page_num;
+  });
 
-    if (writen(file_desc_, &header_, sizeof(header_)) != 0) {
-      LOG_ERROR("Failed to add page header due to %s.", strerror(errno));
-      return RC::IOERR_WRITE;
+  RC     rc            = RC::SUCCESS;
+  size_t written_count = 0;
+  while (written_count < pages.size()) {
+    const size_t batch_size = min(pages.size() - written_count, static_cast<size_t>(max_pages_));
+    rc = write_batch(span<DoubleWritePage *>(pages.data() + written_count, batch_size));
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to write pages in double write buffer. rc=%s", strrc(rc));
+      break;
     }
+    written_count += batch_size;
   }
 
-  if (static_cast<int>(dblwr_pages_.size()) >= max_pages_) {
-    RC rc = flush_page();
-    if (rc != RC::SUCCESS) {
-      LOG_ERROR("Failed to flush pages in double write buffer");
-      return rc;
+  // 没有写成功的页面放回去，等待下次刷盘，除非这期间已经有了更新的版本
+  scoped_lock lock_guard(lock_);
+  for (size_t i = 0; i < pages.size(); i++) {
+    DoubleWritePage *dblwr_page = pages[i];
+    flushing_pages_.erase(dblwr_page->key);
+    if (i >= written_count && dblwr_pages_.count(dblwr_page->key) == 0) {
+      dblwr_pages_.emplace(dblwr_page->key, dblwr_page);
+    } else {
+      delete dblwr_page;
     }
   }
-
-  return RC::SUCCESS;
+  return rc;
 }
 
-RC DiskDoubleWriteBuffer::write_page_internal(DoubleWritePage *page)
+RC DiskDoubleWriteBuffer::write_batch(span<DoubleWritePage *> pages)
 {
-  int32_t page_index = page->page_index;
-  int64_t offset     = page_index * DoubleWritePage::SIZE + DoubleWriteBufferHeader::SIZE;
-  if (lseek(file_desc_, offset, SEEK_SET) == -1) {
-    LOG_ERROR("Failed to add page %lld of %d due to failed to seek %s.", offset, file_desc_, strerror(errno));
-    return RC::IOERR_SEEK;
+  // 文件头和所有页面是连续存放的，一次写入，一次fsync
+  header_.page_cnt = static_cast<int32_t>(pages.size());
+
+  vector<struct iovec> iovs;
+  iovs.reserve(pages.size() + 1);
+  iovs.push_back({&header_, sizeof(header_)});
+  for (size_t i = 0; i < pages.size(); i++) {
+    pages[i]->page_index = static_cast<int32_t>(i);
+    pages[i]->valid      = true;
+    iovs.push_back({pages[i], static_cast<size_t>(DoubleWritePage::SIZE)});
   }
 
-  if (writen(file_desc_, page, DoubleWritePage::SIZE) != 0) {
-    LOG_ERROR("Failed to add page %lld of %d due to %s.", offset, file_desc_, strerror(errno));
+  int ret = pwritevn(file_desc_, iovs.data(), static_cast<int>(iovs.size()), 0);
+  if (ret != 0) {
+    LOG_ERROR("Failed to write pages into double write buffer file. page count=%d, error=%s",
+              header_.page_cnt, strerror(ret));
     return RC::IOERR_WRITE;
   }
 
-  return RC::SUCCESS;
-}
+  if (fdatasync(file_desc_) != 0) {
+    LOG_ERROR("Failed to sync double write buffer file. error=%s", strerror(errno));
+    return RC::IOERR_SYNC;
+  }
 
-RC DiskDoubleWriteBuffer::write_page(DoubleWritePage *dblwr_page)
-{
-  DiskBufferPool *disk_buffer = nullptr;
-  // skip invalid page
-  if (!dblwr_page->valid) {
-    LOG_TRACE("double write buffer write page invalid. buffer_pool_id:%d,page_num:%d,lsn=%d",
+  // 页面已经有了完整的副本，现在可以放心地并发写回原位置
+  vector<IoRequest> requests(pages.size());
+  vector<int>       file_descs;
+  for (size_t i = 0; i < pages.size(); i++) {
+    DoubleWritePage *dblwr_page  = pages[i];
+    DiskBufferPool  *disk_buffer = nullptr;
+    RC               rc          = bp_manager_.get_buffer_pool(dblwr_page->key.buffer_pool_id, disk_buffer);
+    if (OB_FAIL(rc) || disk_buffer == nullptr) {
+      LOG_ERROR("failed to get disk buffer pool of %d. rc=%s", dblwr_page->key.buffer_pool_id, strrc(rc));
+      return RC::INTERNAL;
+    }
+
+    LOG_TRACE("double write buffer write page. buffer_pool_id:%d,page_num:%d,lsn=%d",
               dblwr_page->key.buffer_pool_id, dblwr_page->key.page_num, dblwr_page->page.lsn);
-    return RC::SUCCESS;
+
+    IoRequest &request = requests[i];
+    request.type       = IoRequest::Type::WRITE;
+    request.fd         = disk_buffer->file_desc();
+    request.buf        = &dblwr_page->page;
+    request.size       = sizeof(Page);
+    request.offset     = static_cast<int64_t>(dblwr_page->key.page_num) * sizeof(Page);
+
+    // 页面是按照buffer pool排过序的，相同的文件是相邻的
+    if (file_descs.empty() || file_descs.back() != request.fd) {
+      file_descs.push_back(request.fd);
+    }
   }
-  RC rc = bp_manager_.get_buffer_pool(dblwr_page->key.buffer_pool_id, disk_buffer);
-  ASSERT(OB_SUCC(rc) && disk_buffer != nullptr, "failed to get disk buffer pool of %d", dblwr_page->key.buffer_pool_id);
 
-  LOG_TRACE("double write buffer write page. buffer_pool_id:%d,page_num:%d,lsn=%d",
-            dblwr_page->key.buffer_pool_id, dblwr_page->key.page_num, dblwr_page->page.lsn);
+  RC rc = bp_manager_.async_io().execute(requests);
+  if (OB_FAIL(rc)) {
+    LOG_ERROR("Failed to write pages back to data files. rc=%s", strrc(rc));
+    return rc;
+  }
 
-  return disk_buffer->write_page(dblwr_page->key.page_num, dblwr_page->page);
+  for (const IoRequest &request : requests) {
+    if (OB_FAIL(request.rc)) {
+      LOG_ERROR("Failed to write page back to data file. fd=%d, offset=%ld, rc=%s",
+                request.fd, request.offset, strrc(request.rc));
+      return request.rc;
+    }
+  }
+
+  for (int fd : file_descs) {
+    if (fdatasync(fd) != 0) {
+      LOG_ERROR("Failed to sync data file. fd=%d, error=%s", fd, strerror(errno));
+      return RC::IOERR_SYNC;
+    }
+  }
+
+  // 这一批页面已经安全地写回原位置了。文件头不需要sync，就算恢复时重新写一遍这些页面，内容也是一样的
+  header_.page_cnt = 0;
+  ret              = pwriten(file_desc_, &header_, sizeof(header_), 0);
+  if (ret != 0) {
+    LOG_WARN("Failed to reset double write buffer header. error=%s", strerror(ret));
+  }
+
+  LOG_DEBUG("double write buffer wrote a batch. page count=%d, file count=%d",
+            static_cast<int>(pages.size()), static_cast<int>(file_descs.size()));
+  return RC::SUCCESS;
 }
 
 RC DiskDoubleWriteBuffer::read_page(DiskBufferPool *bp, PageNum page_num, Page &page)
@@ -181,55 +256,23 @@ RC DiskDoubleWriteBuffer::read_page(DiskBufferPool *bp, PageNum page_num, Page &
   scoped_lock        lock_guard(lock_);
   DoubleWritePageKey key{bp->id(), page_num};
   auto               iter = dblwr_pages_.find(key);
-  if (iter != dblwr_pages_.end()) {
-    page = iter->second->page;
-    LOG_TRACE("double write buffer read page success. bp id=%d, page_num:%d, lsn:%d", bp->id(), page_num, page.lsn);
-    return RC::SUCCESS;
+  if (iter == dblwr_pages_.end()) {
+    iter = flushing_pages_.find(key);
+    if (iter == flushing_pages_.end()) {
+      return RC::BUFFERPOOL_INVALID_PAGE_NUM;
+    }
   }
 
-  return RC::BUFFERPOOL_INVALID_PAGE_NUM;
+  page = iter->second->page;
+  LOG_TRACE("double write buffer read page success. bp id=%d, page_num:%d, lsn:%d", bp->id(), page_num, page.lsn);
+  return RC::SUCCESS;
 }
 
 RC DiskDoubleWriteBuffer::clear_pages(DiskBufferPool *buffer_pool)
 {
-  vector<DoubleWritePage *> spec_pages;
-
-  auto remove_pred = [&spec_pages, buffer_pool](const pair<DoubleWritePageKey, DoubleWritePage *> &pair) {
-    DoubleWritePage *dbl_page = pair.second;
-    if (buffer_pool->id() == dbl_page->key.buffer_pool_id) {
-      spec_pages.push_back(dbl_page);
-      return true;
-    }
-    return false;
-  };
-
-  lock_.lock();
-  erase_if(dblwr_pages_, remove_pred);
-  lock_.unlock();
-
-  LOG_INFO("clear pages in double write buffer. file name=%s, page count=%d",
-           buffer_pool->filename(), spec_pages.size());
-
-  // 页面从小到大排序，防止出现小页面还没有写入，而页面编号更大的seek失败的情况
-  sort(spec_pages.begin(), spec_pages.end(), [](DoubleWritePage *a, DoubleWritePage *b) {
-    return a->key.page_num < b->key.page_num;
-  });
-
-  RC rc = RC::SUCCESS;
-  for (DoubleWritePage *dbl_page : spec_pages) {
-    rc = buffer_pool->write_page(dbl_page->key.page_num, dbl_page->page);
-    if (OB_FAIL(rc)) {
-      LOG_WARN("Failed to write page %s:%d to disk buffer pool. rc=%s",
-               buffer_pool->filename(), dbl_page->key.page_num, strrc(rc));
-      break;
-    }
-    dbl_page->valid = false;
-    write_page_internal(dbl_page);
-  }
-
-  for_each(spec_pages.begin(), spec_pages.end(), [](DoubleWritePage *dbl_page) { delete dbl_page; });
-
-  return RC::SUCCESS;
+  RC rc = flush_pages(buffer_pool);
+  LOG_INFO("clear pages in double write buffer. file name=%s, rc=%s", buffer_pool->filename(), strrc(rc));
+  return rc;
 }
 
 RC DiskDoubleWriteBuffer::load_pages()
@@ -276,7 +319,10 @@ RC DiskDoubleWriteBuffer::load_pages()
     }
 
     const CheckSum check_sum = crc32(page.data, BP_PAGE_DATA_SIZE);
-    if (check_sum == page.check_sum) {
+    if (!dblwr_page->valid) {
+      LOG_TRACE("skip an invalid page. buffer_pool_id:%d, page_num:%d",
+                dblwr_page->key.buffer_pool_id, dblwr_page->key.page_num);
+    } else if (check_sum == page.check_sum) {
       DoubleWritePageKey key = dblwr_page->key;
       dblwr_pages_.insert(pair<DoubleWritePageKey, DoubleWritePage *>(key, dblwr_page.release()));
     } else {
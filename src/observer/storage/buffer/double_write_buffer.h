@@ -15,6 +15,7 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include "common/lang/mutex.h"
+#include "common/lang/span.h"
 #include "common/lang/unordered_map.h"
 #include "common/types.h"
 #include "common/sys/rc.h"
@@ -80,18 +81,28 @@ struct DoubleWritePageKeyHash
  * 当我们从磁盘中读取页面时，会校验页面的checksum，如果校验失败，则说明页面写入不完整，这时候可以从
  * DoubleWriteBuffer中读取数据。
  *
- * @note 每次都要保证，不管在内存中还是在文件中，这里的数据都是最新的，都比Buffer pool中的数据要新
+ * 页面先在内存中攒成一批，每一批的写盘过程是：
+ * 1. 把文件头和这一批页面用一次 pwritev 写入共享文件，然后只做一次 fdatasync；
+ * 2. 按照(文件, 偏移量)排序后，通过 BufferPoolManager 的 AsyncIo 一次提交所有页面的原位置写，
+ *    使用 io_uring 时这些写请求会并发执行；
+ * 3. 每个涉及到的数据文件 fdatasync 一次，之后共享文件中的这一批页面才可以被下一批覆盖。
+ * 这样每一批页面只需要 1 + 文件个数 次 fsync，而不是每个页面单独写入、单独等待。
+ *
+ * @note 每次都要保证，在页面写回原位置之前，这里的数据都是最新的，都比Buffer pool文件中的数据要新
  */
 class DiskDoubleWriteBuffer : public DoubleWriteBuffer
 {
+public:
+  static constexpr int DEFAULT_BATCH_PAGES = 64;
+
 public:
   /**
    * @brief 构造函数
    *
    * @param bp_manager 关联的buffer pool manager
-   * @param max_pages  内存中保存的最大页面数
+   * @param max_pages  一批最多包含多少个页面，内存中攒够这么多页面后就会刷盘
    */
-  DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages = 16);
+  DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages = DEFAULT_BATCH_PAGES);
   virtual ~DiskDoubleWriteBuffer();
 
   /**
@@ -101,19 +112,18 @@ public:
 
   /**
    * 将buffer中的页全部写入磁盘，并且清空buffer
-   * TODO 目前的解决方案是等buffer装满后再刷盘，可能会导致程序卡住一段时间
    */
   RC flush_page();
 
   /**
-   * 将页面加入buffer，并且写入磁盘中的共享表空间
+   * 将页面加入buffer，buffer满了之后整批写入磁盘
    */
   RC add_page(DiskBufferPool *bp, PageNum page_num, Page &page) override;
 
   RC read_page(DiskBufferPool *bp, PageNum page_num, Page &page) override;
 
   /**
-   * @brief 清空所有与指定buffer pool关联的页面
+   * @brief 将所有与指定buffer pool关联的页面写入磁盘，并从buffer中清除
    */
   RC clear_pages(DiskBufferPool *bp) override;
 
@@ -124,16 +134,15 @@ public:
 
 private:
   /**
-   * 将buffer中的页面写入对应的磁盘
+   * @brief 将buffer中的页面按批写入磁盘
+   * @param bp 只写入这个buffer pool的页面。为空时写入所有页面
    */
-  RC write_page(DoubleWritePage *page);
+  RC flush_pages(DiskBufferPool *bp);
 
   /**
-   * 将页面写到当前double write buffer文件中
-   * @details 每次页面更新都应该写入到磁盘中。保证double write buffer
-   * 内存和文件中的数据都是最新的。
+   * @brief 写入一批页面，先写入double write buffer文件，再写入页面对应的数据文件
    */
-  RC write_page_internal(DoubleWritePage *page);
+  RC write_batch(span<DoubleWritePage *> pages);
 
   /**
    * @brief 将磁盘文件中的内容加载到内存中。在启动时调用
@@ -141,13 +150,17 @@ private:
   RC load_pages();
 
 private:
+  using DoubleWritePageMap = unordered_map<DoubleWritePageKey, DoubleWritePage *, DoubleWritePageKeyHash>;
+
   int                     file_desc_ = -1;
   int                     max_pages_ = 0;
-  common::Mutex           lock_;
+  common::Mutex           lock_;        ///< 保护 dblwr_pages_ 和 flushing_pages_
+  common::Mutex           flush_lock_;  ///< 同一时间只能有一批页面在写盘，它们共用文件中的位置
   BufferPoolManager      &bp_manager_;
   DoubleWriteBufferHeader header_;
 
-  unordered_map<DoubleWritePageKey, DoubleWritePage *, DoubleWritePageKeyHash> dblwr_pages_;
+  DoubleWritePageMap dblwr_pages_;     ///< 还没有开始写盘的页面
+  DoubleWritePageMap flushing_pages_;  ///< 正在写盘的页面，写回原位置之前读页面时还需要从这里读
 };
 
 class VacuousDoubleWriteBuffer : public DoubleWriteBuffer
@@ -76,9 +76,14 @@ void Frame::write_latch(intptr_t xid)
 
   lock_.lock();
 
-#ifdef DEBUG
   write_locker_ = xid;
-  ++write_recursive_count_;
+  if (++write_recursive_count_ == 1) {
+    // 后面对页面的修改不能早于版本号的变化
+    latch_version_.store(latch_version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+#ifdef DEBUG
   TRACE("frame write lock success."
         "this=%p, pin=%d, frameId=%s, write locker=%lx(recursive=%d), xid=%lx, lbt=%s",
       this,
@@ -117,6 +122,7 @@ void Frame::write_unlatch(intptr_t xid)
 
   if (--write_recursive_count_ == 0) {
     write_locker_ = 0;
+    latch_version_.store(latch_version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
   }
   debug_lock_.unlock();
 
@@ -283,6 +289,28 @@ int Frame::unpin()
   return pin_count;
 }
 
+bool Frame::try_begin_load()
+{
+  LoadState expected = LoadState::NEW;
+  return load_state_.compare_exchange_strong(expected, LoadState::LOADING);
+}
+
+void Frame::finish_load(bool success)
+{
+  load_state_.store(success ? LoadState::LOADED : LoadState::FAILED);
+  load_state_.notify_all();
+}
+
+bool Frame::wait_loaded()
+{
+  LoadState state = load_state_.load();
+  while (state == LoadState::NEW || state == LoadState::LOADING) {
+    load_state_.wait(state);
+    state = load_state_.load();
+  }
+  return state == LoadState::LOADED;
+}
+
 unsigned long current_time()
 {
   struct timespec tp;
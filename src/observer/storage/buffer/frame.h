@@ -75,7 +75,12 @@ public:
    * @details 在 MemPoolSimple 分配和释放一个Frame对象时，不会调用构造函数和析构函数，
    * 而是调用reinit和reset。
    */
-  void reinit() {}
+  void reinit()
+  {
+    load_state_.store(LoadState::NEW);
+    rec_lsn_.store(0, std::memory_order_relaxed);
+    prefetched_ = false;
+  }
   void reset() {}
 
   void clear_page() { memset(&page_, 0, sizeof(page_)); }
@@ -104,7 +109,19 @@ public:
    * 序列号要小，那就可以从日志中读取这些更大序列号的日志，做重做操作，将页面恢复到最新状态，也就是redo。
    */
   LSN  lsn() const { return page_.lsn; }
-  void set_lsn(LSN lsn) { page_.lsn = lsn; }
+  void set_lsn(LSN lsn)
+  {
+    page_.lsn    = lsn;
+    LSN expected = 0;
+    rec_lsn_.compare_exchange_strong(expected, lsn, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief 页面变脏以后第一次修改对应的日志序列号(recovery LSN)
+   * @details 比这个LSN小的日志，对当前页面来说都已经落盘了，恢复时不需要再重做。
+   * 检查点取所有脏页中最小的recLSN，用来确定恢复时从哪里开始回放日志。页面刷盘后重置为0。
+   */
+  LSN rec_lsn() const { return rec_lsn_.load(std::memory_order_acquire); }
 
   /**
    * @brief 页面校验和
@@ -132,13 +149,49 @@ public:
    * @brief 重置“脏”标记
    * @details 如果页面已经被写入磁盘文件，则应调用此函数。
    */
-  void clear_dirty() { dirty_ = false; }
+  void clear_dirty()
+  {
+    dirty_ = false;
+    rec_lsn_.store(0, std::memory_order_release);
+  }
   bool dirty() const { return dirty_; }
 
   char *data() { return page_.data; }
 
+  /**
+   * @brief 页帧中的数据是否已经从磁盘加载完成
+   * @details 一个新分配的页帧处于NEW状态，此时页面中的数据是无效的。第一个拿到页帧的线程负责
+   * 从磁盘加载数据(try_begin_load)，其它同时访问这个页面的线程，需要等待加载完成(wait_loaded)。
+   * 这样多个线程读取不同的页面时可以并发地进行IO，而读取同一个页面的线程只在这个页帧上等待。
+   */
+  bool try_begin_load();
+
+  /**
+   * @brief 结束加载，唤醒所有等待这个页帧的线程
+   * @param success 是否加载成功。加载失败时，等待者会拿到失败的结果
+   */
+  void finish_load(bool success);
+
+  /**
+   * @brief 标记页帧的数据已经是有效的，比如新分配的页面，不需要从磁盘加载
+   */
+  void mark_loaded() { finish_load(true); }
+
+  /**
+   * @brief 等待页帧加载完成
+   * @return 页面数据是否有效
+   */
+  bool wait_loaded();
+
   bool can_purge() { return pin_count_.load() == 0; }
 
+  /**
+   * @brief 页帧是否由预读加载，并且还没有被真正访问过
+   * @details 由 BPFrameManager 在分区锁内读写
+   */
+  bool prefetched() const { return prefetched_; }
+  void set_prefetched(bool prefetched) { prefetched_ = prefetched; }
+
   /**
    * @brief 给当前页帧增加引用计数
    * pin通常都会加着frame manager锁来访问。
@@ -166,13 +219,38 @@ public:
   void read_unlatch();
   void read_unlatch(intptr_t xid);
 
+  /**
+   * @brief 页面内容的版本号，用来做不加锁的乐观读
+   * @details 加写锁和释放写锁(最外层的)时各加1，所以持有写锁期间是奇数。
+   * 乐观读不加锁，读之前取一次版本号，读完以后用 check_latch_version 校验，
+   * 版本号是偶数并且没有变化，就说明读到的内容是一致的。
+   * 读到的内容在校验之前可能是不一致的，不能用它访问其它内存。读的时候需要 pin 住页帧。
+   */
+  uint64_t latch_version() const { return latch_version_.load(std::memory_order_acquire); }
+  bool     check_latch_version(uint64_t version) const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return latch_version_.load(std::memory_order_relaxed) == version;
+  }
+
   string to_string() const;
 
 private:
   friend class BufferPool;
 
-  bool          dirty_ = false;
+  enum class LoadState
+  {
+    NEW,      ///< 刚分配出来，数据无效
+    LOADING,  ///< 正在从磁盘加载数据
+    LOADED,   ///< 数据有效
+    FAILED,   ///< 加载失败
+  };
+
+  atomic<bool>      dirty_{false};  /// 后台的 PageCleaner 也会读写这个标识
+  atomic<LoadState> load_state_{LoadState::NEW};
+  atomic<LSN>       rec_lsn_{0};  /// 检查点线程会读取这个值
   atomic<int>   pin_count_{0};
+  bool          prefetched_ = false;
   unsigned long acc_time_ = 0;
   FrameId       frame_id_;
   Page          page_;
@@ -180,6 +258,9 @@ private:
   /// 在非并发编译时，加锁解锁动作将什么都不做
   common::RecursiveSharedMutex lock_;
 
+  /// 页帧回收再使用时也不重置，乐观读拿着旧的版本号校验时一定会失败
+  atomic<uint64_t> latch_version_{0};
+
   /// 使用一些手段来做测试，提前检测出头疼的死锁问题
   /// 如果编译时没有增加调试选项，这些代码什么都不做
   common::DebugMutex           debug_lock_;
@@ -0,0 +1,176 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/buffer/frame_replacer.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/string.h"
+#include "common/log/log.h"
+
+RC FrameReplacer::create(const char *name, size_t capacity, unique_ptr<FrameReplacer> &replacer)
+{
+  if (name == nullptr || common::is_blank(name)) {
+    name = "lru";
+  }
+
+  if (strcasecmp(name, "lru") == 0) {
+    replacer = make_unique<LruFrameReplacer>();
+  } else if (strcasecmp(name, "2q") == 0) {
+    replacer = make_unique<TwoQueueFrameReplacer>(capacity);
+  } else {
+    LOG_WARN("unknown frame replacer: %s", name);
+    return RC::INVALID_ARGUMENT;
+  }
+  return RC::SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+void LruFrameReplacer::on_insert(Frame *frame)
+{
+  lru_list_.push_front(frame);
+  positions_[frame] = lru_list_.begin();
+}
+
+void LruFrameReplacer::on_access(Frame *frame)
+{
+  auto iter = positions_.find(frame);
+  if (iter != positions_.end()) {
+    lru_list_.splice(lru_list_.begin(), lru_list_, iter->second);
+  }
+}
+
+void LruFrameReplacer::on_remove(const FrameId &frame_id, Frame *frame)
+{
+  auto iter = positions_.find(frame);
+  if (iter != positions_.end()) {
+    lru_list_.erase(iter->second);
+    positions_.erase(iter);
+  }
+}
+
+void LruFrameReplacer::foreach_victim(function<bool(Frame *)> func)
+{
+  for (auto iter = lru_list_.rbegin(); iter != lru_list_.rend(); ++iter) {
+    if (!func(*iter)) {
+      break;
+    }
+  }
+}
+
+void LruFrameReplacer::clear()
+{
+  lru_list_.clear();
+  positions_.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+TwoQueueFrameReplacer::TwoQueueFrameReplacer(size_t capacity)
+{
+  // 论文中建议 A1in 占 1/4，A1out 记录 1/2 容量的页面
+  kin_  = max<size_t>(capacity / 4, 1);
+  kout_ = max<size_t>(capacity / 2, 1);
+}
+
+void TwoQueueFrameReplacer::on_insert(Frame *frame)
+{
+  Position position;
+
+  auto ghost_iter = a1out_index_.find(frame->frame_id());
+  if (ghost_iter != a1out_index_.end()) {
+    a1out_.erase(ghost_iter->second);
+    a1out_index_.erase(ghost_iter);
+
+    am_.push_front(frame);
+    position.hot  = true;
+    position.iter = am_.begin();
+  } else {
+    a1in_.push_front(frame);
+    position.hot  = false;
+    position.iter = a1in_.begin();
+  }
+  positions_[frame] = position;
+}
+
+void TwoQueueFrameReplacer::on_access(Frame *frame)
+{
+  auto iter = positions_.find(frame);
+  if (iter == positions_.end()) {
+    return;
+  }
+
+  Position &position = iter->second;
+  if (position.hot) {
+    am_.splice(am_.begin(), am_, position.iter);
+  } else {
+    // 扫描只会在页面加载时访问一次，能在 A1in 中再次命中的页面就认为是热点页面
+    am_.splice(am_.begin(), a1in_, position.iter);
+    position.hot = true;
+  }
+}
+
+void TwoQueueFrameReplacer::on_remove(const FrameId &frame_id, Frame *frame)
+{
+  auto iter = positions_.find(frame);
+  if (iter == positions_.end()) {
+    return;
+  }
+
+  if (iter->second.hot) {
+    am_.erase(iter->second.iter);
+  } else {
+    a1in_.erase(iter->second.iter);
+    remember(frame_id);
+  }
+  positions_.erase(iter);
+}
+
+void TwoQueueFrameReplacer::remember(const FrameId &frame_id)
+{
+  if (a1out_index_.find(frame_id) != a1out_index_.end()) {
+    return;
+  }
+
+  a1out_.push_front(frame_id);
+  a1out_index_[frame_id] = a1out_.begin();
+  while (a1out_.size() > kout_) {
+    a1out_index_.erase(a1out_.back());
+    a1out_.pop_back();
+  }
+}
+
+void TwoQueueFrameReplacer::foreach_victim(function<bool(Frame *)> func)
+{
+  auto visit = [&func](list<Frame *> &frames) {
+    for (auto iter = frames.rbegin(); iter != frames.rend(); ++iter) {
+      if (!func(*iter)) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  if (a1in_.size() > kin_) {
+    if (visit(a1in_)) {
+      visit(am_);
+    }
+  } else {
+    if (visit(am_)) {
+      visit(a1in_);
+    }
+  }
+}
+
+void TwoQueueFrameReplacer::clear()
+{
+  a1in_.clear();
+  am_.clear();
+  positions_.clear();
+  a1out_.clear();
+  a1out_index_.clear();
+}
@@ -0,0 +1,135 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/sys/rc.h"
+#include "common/lang/functional.h"
+#include "common/lang/list.h"
+#include "common/lang/memory.h"
+#include "common/lang/unordered_map.h"
+#include "storage/buffer/frame.h"
+
+/**
+ * @brief 页帧淘汰策略
+ * @ingroup BufferPool
+ * @details 决定内存不够时先淘汰哪些页帧。BPFrameManager 的每个分区都有一个自己的淘汰策略对象，
+ * 所有的接口都在分区锁的保护下调用，实现中不需要再加锁。
+ * 可以通过配置文件中 [STORAGE] 的 BUFFER_POOL_REPLACER 来选择。
+ */
+class FrameReplacer
+{
+public:
+  FrameReplacer()          = default;
+  virtual ~FrameReplacer() = default;
+
+  /**
+   * @brief 一个新的页帧加入管理
+   */
+  virtual void on_insert(Frame *frame) = 0;
+
+  /**
+   * @brief 页帧被访问(命中)
+   */
+  virtual void on_access(Frame *frame) = 0;
+
+  /**
+   * @brief 页帧不再被管理，比如被淘汰或者页面被释放
+   */
+  virtual void on_remove(const FrameId &frame_id, Frame *frame) = 0;
+
+  /**
+   * @brief 按照淘汰的优先顺序遍历页帧
+   * @param func 返回false时停止遍历。遍历过程中不能修改当前对象
+   */
+  virtual void foreach_victim(function<bool(Frame *)> func) = 0;
+
+  virtual void clear() = 0;
+
+  virtual const char *name() const = 0;
+
+  /**
+   * @brief 根据名字创建淘汰策略
+   * @details 当前支持 lru(默认) 和 2q
+   * @param name 策略名称
+   * @param capacity 期望管理的页帧个数，有些策略会根据这个值来划分内部各个队列的大小
+   */
+  static RC create(const char *name, size_t capacity, unique_ptr<FrameReplacer> &replacer);
+};
+
+/**
+ * @brief 最近最少使用淘汰策略
+ * @ingroup BufferPool
+ * @details 一次大表的全表扫描会把所有的热点页面都淘汰出去
+ */
+class LruFrameReplacer final : public FrameReplacer
+{
+public:
+  void on_insert(Frame *frame) override;
+  void on_access(Frame *frame) override;
+  void on_remove(const FrameId &frame_id, Frame *frame) override;
+  void foreach_victim(function<bool(Frame *)> func) override;
+  void clear() override;
+
+  const char *name() const override { return "lru"; }
+
+private:
+  list<Frame *>                                  lru_list_;  ///< 头部是最近访问的
+  unordered_map<Frame *, list<Frame *>::iterator> positions_;
+};
+
+/**
+ * @brief 2Q 淘汰策略，可以抵抗大范围扫描对热点页面的冲击
+ * @ingroup BufferPool
+ * @details 参考 Johnson & Shasha, 2Q: A Low Overhead High Performance Buffer Management Replacement Algorithm.
+ * 第一次访问的页面进入 A1in 这个FIFO队列，A1in 中的页面被淘汰后，只在 A1out 中记录它的标识。
+ * 页面在 A1in 中再次命中，或者在 A1out 中还能找到时又被访问了，说明它确实是热点页面，就放入 Am 这个LRU队列中。
+ * 扫描时每个页面只在加载时访问一次，这些页面都停留在 A1in 中，并且会被优先淘汰。
+ * 与论文中的完整版本不同，这里没有忽略 A1in 中的再次访问，因为 get_this_page 不会对同一个页面做连续的重复访问，
+ * 并且在内存足够时 A1in 中的页面可能一直不会被淘汰，热点页面就没有机会进入 Am。
+ */
+class TwoQueueFrameReplacer final : public FrameReplacer
+{
+public:
+  explicit TwoQueueFrameReplacer(size_t capacity);
+
+  void on_insert(Frame *frame) override;
+  void on_access(Frame *frame) override;
+  void on_remove(const FrameId &frame_id, Frame *frame) override;
+  void foreach_victim(function<bool(Frame *)> func) override;
+  void clear() override;
+
+  const char *name() const override { return "2q"; }
+
+private:
+  struct FrameIdHasher
+  {
+    size_t operator()(const FrameId &frame_id) const { return frame_id.hash(); }
+  };
+
+  struct Position
+  {
+    bool                     hot = false;  ///< 是否在 Am 中
+    list<Frame *>::iterator iter;
+  };
+
+  void remember(const FrameId &frame_id);
+
+private:
+  size_t kin_  = 0;  ///< A1in 的最大长度，超过时优先从 A1in 中淘汰
+  size_t kout_ = 0;  ///< A1out 最多记录多少个页面
+
+  list<Frame *>                     a1in_;  ///< 头部是最新进入的
+  list<Frame *>                     am_;    ///< 头部是最近访问的
+  unordered_map<Frame *, Position> positions_;
+
+  list<FrameId>                                                         a1out_;  ///< 头部是最新淘汰的
+  unordered_map<FrameId, list<FrameId>::iterator, FrameIdHasher> a1out_index_;
+};
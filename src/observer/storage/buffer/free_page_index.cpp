@@ -0,0 +1,89 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <bit>
+
+#include "storage/buffer/free_page_index.h"
+#include "common/log/log.h"
+
+void FreePageIndex::reset(int page_count)
+{
+  free_bits_.clear();
+  summary_.clear();
+  page_count_ = 0;
+  free_count_ = 0;
+  resize(page_count);
+}
+
+void FreePageIndex::resize(int page_count)
+{
+  ASSERT(page_count >= page_count_, "free page index can not shrink. page count=%d, new page count=%d",
+         page_count_, page_count);
+
+  const size_t word_num = (page_count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+  free_bits_.resize(word_num, 0);
+  summary_.resize((word_num + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+  page_count_ = page_count;
+}
+
+void FreePageIndex::set_free(PageNum page_num)
+{
+  ASSERT(page_num >= 0 && page_num < page_count_, "invalid page num %d, page count=%d", page_num, page_count_);
+
+  const int      word_index = page_num / BITS_PER_WORD;
+  uint64_t      &word       = free_bits_[word_index];
+  const uint64_t mask       = 1ULL << (page_num % BITS_PER_WORD);
+  if ((word & mask) == 0) {
+    word |= mask;
+    summary_[word_index / BITS_PER_WORD] |= 1ULL << (word_index % BITS_PER_WORD);
+    free_count_++;
+  }
+}
+
+void FreePageIndex::set_allocated(PageNum page_num)
+{
+  ASSERT(page_num >= 0 && page_num < page_count_, "invalid page num %d, page count=%d", page_num, page_count_);
+
+  const int      word_index = page_num / BITS_PER_WORD;
+  uint64_t      &word       = free_bits_[word_index];
+  const uint64_t mask       = 1ULL << (page_num % BITS_PER_WORD);
+  if ((word & mask) != 0) {
+    word &= ~mask;
+    if (word == 0) {
+      summary_[word_index / BITS_PER_WORD] &= ~(1ULL << (word_index % BITS_PER_WORD));
+    }
+    free_count_--;
+  }
+}
+
+bool FreePageIndex::is_free(PageNum page_num) const
+{
+  if (page_num < 0 || page_num >= page_count_) {
+    return false;
+  }
+  return (free_bits_[page_num / BITS_PER_WORD] & (1ULL << (page_num % BITS_PER_WORD))) != 0;
+}
+
+PageNum FreePageIndex::find_free() const
+{
+  if (free_count_ == 0) {
+    return BP_INVALID_PAGE_NUM;
+  }
+
+  for (size_t i = 0; i < summary_.size(); i++) {
+    if (summary_[i] == 0) {
+      continue;
+    }
+
+    const size_t word_index = i * BITS_PER_WORD + std::countr_zero(summary_[i]);
+    return static_cast<PageNum>(word_index * BITS_PER_WORD + std::countr_zero(free_bits_[word_index]));
+  }
+  return BP_INVALID_PAGE_NUM;
+}
@@ -0,0 +1,64 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/vector.h"
+#include "storage/buffer/page.h"
+
+/**
+ * @brief 空闲页面索引
+ * @ingroup BufferPool
+ * @details 文件头中的位图记录了每个页面是否已经分配，但是从头开始逐位查找空闲页面，在页面很多时非常慢。
+ * 这里在内存中维护一个两层的位图：
+ * - 第一层每一位对应一个页面，1 表示页面是空闲的；
+ * - 第二层每一位对应第一层的一个64位的字，1 表示这个字中至少有一个空闲页面。
+ * 查找时先在第二层中找到第一个不为0的字，再用 countr_zero 依次定位到第一层的字和其中的页面。
+ * 第二层的每个字覆盖 4096 个页面，即使是上百万个页面的文件，也只需要检查几百个字。
+ * 索引只在内存中，打开文件时根据文件头中的位图重建，不改变文件格式。
+ */
+class FreePageIndex
+{
+public:
+  FreePageIndex()  = default;
+  ~FreePageIndex() = default;
+
+  /**
+   * @brief 清空索引，并调整可以记录的页面个数
+   * @details 所有页面都认为是已经分配的
+   */
+  void reset(int page_count);
+
+  /**
+   * @brief 调整可以记录的页面个数。新增加的页面认为是已经分配的
+   */
+  void resize(int page_count);
+
+  void set_free(PageNum page_num);
+  void set_allocated(PageNum page_num);
+  bool is_free(PageNum page_num) const;
+
+  /**
+   * @brief 找到编号最小的空闲页面
+   * @return 没有空闲页面时返回 BP_INVALID_PAGE_NUM
+   */
+  PageNum find_free() const;
+
+  int free_count() const { return free_count_; }
+  int page_count() const { return page_count_; }
+
+private:
+  static constexpr int BITS_PER_WORD = 64;
+
+  vector<uint64_t> free_bits_;  ///< 第一层，每一位对应一个页面
+  vector<uint64_t> summary_;    ///< 第二层，每一位对应第一层的一个字
+  int              page_count_ = 0;
+  int              free_count_ = 0;
+};
@@ -0,0 +1,204 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/buffer/page_cleaner.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
+#include "common/lang/utility.h"
+#include "common/lang/vector.h"
+#include "common/log/log.h"
+#include "storage/buffer/disk_buffer_pool.h"
+
+using namespace common;
+
+static int64_t now_us()
+{
+  return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PageCleaner::PageCleaner(BufferPoolManager &bp_manager) : bp_manager_(bp_manager) {}
+
+PageCleaner::~PageCleaner() { stop(); }
+
+RC PageCleaner::init(int interval_ms, int low_watermark, int high_watermark, int batch_size)
+{
+  if (low_watermark < 0 || high_watermark > 100 || low_watermark > high_watermark || batch_size <= 0) {
+    LOG_WARN("invalid page cleaner options. low watermark=%d, high watermark=%d, batch size=%d",
+             low_watermark, high_watermark, batch_size);
+    return RC::INVALID_ARGUMENT;
+  }
+
+  interval_ms_    = interval_ms;
+  low_watermark_  = low_watermark;
+  high_watermark_ = high_watermark;
+  batch_size_     = batch_size;
+  return RC::SUCCESS;
+}
+
+RC PageCleaner::start()
+{
+  if (running_.load()) {
+    LOG_WARN("page cleaner has been started");
+    return RC::INTERNAL;
+  }
+
+  if (interval_ms_ <= 0) {
+    LOG_INFO("page cleaner is disabled");
+    return RC::SUCCESS;
+  }
+
+  last_round_time_us_ = now_us();
+  running_.store(true);
+#ifdef CONCURRENCY
+  thread_ = make_unique<thread>(&PageCleaner::thread_func, this);
+  LOG_INFO("page cleaner started. interval=%dms, low watermark=%d%%, high watermark=%d%%, batch size=%d",
+           interval_ms_, low_watermark_, high_watermark_, batch_size_);
+#else
+  LOG_INFO("page cleaner runs in foreground threads as CONCURRENCY is off");
+#endif
+  return RC::SUCCESS;
+}
+
+void PageCleaner::stop()
+{
+  if (!running_.exchange(false)) {
+    return;
+  }
+
+  if (thread_) {
+    {
+      lock_guard<mutex> guard(notify_lock_);
+      notified_ = true;
+    }
+    notify_cv_.notify_one();
+    thread_->join();
+    thread_.reset();
+  }
+
+  LOG_INFO("page cleaner stopped. rounds=%llu, flushed pages=%llu",
+           static_cast<unsigned long long>(round_count()), static_cast<unsigned long long>(flushed_page_count()));
+}
+
+void PageCleaner::notify()
+{
+  if (!running_.load()) {
+    return;
+  }
+
+  if (!thread_) {
+    (void)run_once();
+    return;
+  }
+
+  {
+    lock_guard<mutex> guard(notify_lock_);
+    notified_ = true;
+  }
+  notify_cv_.notify_one();
+}
+
+void PageCleaner::thread_func()
+{
+  LOG_INFO("page cleaner thread started");
+  while (running_.load()) {
+    {
+      unique_lock<mutex> guard(notify_lock_);
+      notify_cv_.wait_for(guard, chrono::milliseconds(interval_ms_), [this]() { return notified_; });
+      notified_ = false;
+    }
+
+    if (!running_.load()) {
+      break;
+    }
+
+    (void)run_once();
+  }
+  LOG_INFO("page cleaner thread stopped");
+}
+
+size_t PageCleaner::flush_target(size_t dirty_count, size_t total_count) const
+{
+  const size_t low_count  = total_count * low_watermark_ / 100;
+  const size_t high_count = total_count * high_watermark_ / 100;
+  if (dirty_count <= low_count) {
+    return 0;
+  }
+
+  if (dirty_count > high_count) {
+    return dirty_count - low_count;
+  }
+  return min(static_cast<size_t>(batch_size_), dirty_count - low_count);
+}
+
+int PageCleaner::run_once()
+{
+  // 前台线程和后台线程可能同时触发，只要有一个在执行就可以了
+  unique_lock<mutex> round_guard(round_lock_, std::try_to_lock);
+  if (!round_guard.owns_lock()) {
+    return 0;
+  }
+
+  BPFrameManager &frame_manager = bp_manager_.get_frame_manager();
+
+  vector<Frame *> frames;
+  const size_t    dirty_count = frame_manager.find_dirty_frames(frames);
+  const size_t    total_count = frame_manager.total_frame_num();
+  dirty_page_count_.store(dirty_count, std::memory_order_relaxed);
+  total_page_count_.store(total_count, std::memory_order_relaxed);
+
+  const size_t target = min(flush_target(dirty_count, total_count), frames.size());
+
+  // 先记下LSN再排序，页面的LSN可能在排序过程中被修改
+  vector<pair<LSN, Frame *>> candidates;
+  candidates.reserve(frames.size());
+  for (Frame *frame : frames) {
+    candidates.emplace_back(frame->lsn(), frame);
+  }
+  partial_sort(candidates.begin(), candidates.begin() + target, candidates.end(),
+      [](const pair<LSN, Frame *> &a, const pair<LSN, Frame *> &b) { return a.first < b.first; });
+
+  int flushed_count = 0;
+  for (size_t i = 0; i < candidates.size(); i++) {
+    Frame *frame = candidates[i].second;
+
+    // 拿不到读锁说明有人正在修改这个页面，下一轮再刷
+    if (i < target && frame->try_read_latch()) {
+      if (frame->dirty()) {
+        RC rc = bp_manager_.flush_page(*frame);
+        if (OB_SUCC(rc)) {
+          flushed_count++;
+        } else {
+          LOG_WARN("page cleaner failed to flush page. frame=%s, rc=%s", frame->to_string().c_str(), strrc(rc));
+        }
+      }
+      frame->read_unlatch();
+    }
+    frame->unpin();
+  }
+
+  const int64_t now        = now_us();
+  const int64_t elapsed_us = max<int64_t>(now - last_round_time_us_, 1);
+  last_round_time_us_      = now;
+  flush_rate_.store(static_cast<double>(flushed_count) * 1000000 / elapsed_us, std::memory_order_relaxed);
+  flushed_page_count_.fetch_add(flushed_count, std::memory_order_relaxed);
+  round_count_.fetch_add(1, std::memory_order_relaxed);
+
+  if (flushed_count > 0) {
+    LOG_DEBUG("page cleaner flushed %d pages. dirty pages=%d, total pages=%d",
+              flushed_count, static_cast<int>(dirty_count), static_cast<int>(total_count));
+  }
+  return flushed_count;
+}
+
+double PageCleaner::dirty_ratio() const
+{
+  const size_t total_count = total_page_count_.load(std::memory_order_relaxed);
+  return total_count == 0 ? 0.0 : static_cast<double>(dirty_page_count()) / total_count;
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/sys/rc.h"
+#include "common/lang/atomic.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
+#include "common/lang/thread.h"
+
+class BufferPoolManager;
+
+/**
+ * @brief 后台刷脏页
+ * @ingroup BufferPool
+ * @details 没有后台刷脏页时，只有在淘汰页帧时才会把脏页写出去，查询也可能因为要等待写盘而变慢。
+ * PageCleaner 定期检查脏页在所有页帧中的比例：
+ * - 超过低水位时，每一轮刷一批脏页；
+ * - 超过高水位时，一直刷到低水位以下。
+ * 每一轮按照页面LSN从小到大的顺序挑选没有被使用的脏页，这样最早修改的页面先落盘。
+ * 前台淘汰页帧时会优先选择干净的页面(参考 BPFrameManager::purge_frames)，
+ * 如果不得不刷脏页，就调用 notify 唤醒后台线程尽快开始下一轮。
+ *
+ * 没有打开 CONCURRENCY 编译选项时，页帧的读写锁不起作用，后台线程无法与前台线程安全地访问同一个页面。
+ * 这时不会启动线程，notify 会在调用者的线程中直接执行一轮刷盘。
+ */
+class PageCleaner
+{
+public:
+  static constexpr int DEFAULT_INTERVAL_MS    = 100;
+  static constexpr int DEFAULT_LOW_WATERMARK  = 10;  ///< 百分比
+  static constexpr int DEFAULT_HIGH_WATERMARK = 50;  ///< 百分比
+  static constexpr int DEFAULT_BATCH_SIZE     = 64;
+
+public:
+  explicit PageCleaner(BufferPoolManager &bp_manager);
+  ~PageCleaner();
+
+  /**
+   * @brief 设置参数。需要在 start 之前调用
+   * @param interval_ms 两轮之间最长的间隔时间
+   * @param low_watermark 脏页比例的低水位，百分比
+   * @param high_watermark 脏页比例的高水位，百分比
+   * @param batch_size 每一批最多刷多少个页面
+   */
+  RC init(int interval_ms, int low_watermark, int high_watermark, int batch_size);
+
+  RC   start();
+  void stop();
+
+  /**
+   * @brief 前台线程不得不刷脏页时调用，让刷脏页的工作尽快开始
+   */
+  void notify();
+
+  /**
+   * @brief 执行一轮刷盘
+   * @return 本轮刷了多少个页面
+   */
+  int run_once();
+
+  /**
+   * @brief 阻止新的一轮刷盘开始，并等待正在进行的一轮结束
+   * @details 关闭文件时使用。刷盘时会 pin 住一些页帧，关闭文件时这些页帧不能被清理掉
+   */
+  unique_lock<mutex> hold() { return unique_lock<mutex>(round_lock_); }
+
+  /// 最近一轮看到的脏页个数
+  size_t   dirty_page_count() const { return dirty_page_count_.load(std::memory_order_relaxed); }
+  double   dirty_ratio() const;
+  uint64_t flushed_page_count() const { return flushed_page_count_.load(std::memory_order_relaxed); }
+  uint64_t round_count() const { return round_count_.load(std::memory_order_relaxed); }
+  /// 最近一段时间每秒刷盘的页面数
+  double flush_rate() const { return flush_rate_.load(std::memory_order_relaxed); }
+
+private:
+  void thread_func();
+
+  /**
+   * @brief 计算本轮要刷多少个页面
+   */
+  size_t flush_target(size_t dirty_count, size_t total_count) const;
+
+private:
+  BufferPoolManager &bp_manager_;
+
+  int interval_ms_    = DEFAULT_INTERVAL_MS;
+  int low_watermark_  = DEFAULT_LOW_WATERMARK;
+  int high_watermark_ = DEFAULT_HIGH_WATERMARK;
+  int batch_size_     = DEFAULT_BATCH_SIZE;
+
+  unique_ptr<thread> thread_;
+  atomic_bool        running_{false};
+  mutex              notify_lock_;
+  condition_variable notify_cv_;
+  bool               notified_ = false;
+
+  mutex round_lock_;  ///< 同一时间只能有一轮在执行
+
+  atomic<size_t>   dirty_page_count_{0};
+  atomic<size_t>   total_page_count_{0};
+  atomic<uint64_t> flushed_page_count_{0};
+  atomic<uint64_t> round_count_{0};
+  atomic<double>   flush_rate_{0.0};
+  int64_t          last_round_time_us_ = 0;
+};
@@ -26,7 +26,13 @@ using namespace common;
 RC DiskLogHandler::init(const char *path)
 {
   const int max_entry_number_per_file = 1000;
-  return file_manager_.init(path, max_entry_number_per_file);
+  RC        rc                        = file_manager_.init(path, max_entry_number_per_file);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  // 重放日志以后还会从最大的LSN重新初始化一次
+  return entry_buffer_.init(0);
 }
 
 RC DiskLogHandler::start()
@@ -50,6 +56,11 @@ RC DiskLogHandler::stop()
   }
 
   running_.store(false);
+  {
+    lock_guard guard(mutex_);
+  }
+  flush_cond_.notify_all();
+  flushed_cond_.notify_all();
 
   LOG_INFO("log handler stopped");
   return RC::SUCCESS;
@@ -89,6 +100,11 @@ RC DiskLogHandler::replay(LogReplayer &replayer, LSN start_lsn)
     return rc;
   }
 
+  // 检查点之后可能没有任何日志，此时不能让LSN从头开始
+  if (start_lsn > 0 && max_lsn < start_lsn - 1) {
+    max_lsn = start_lsn - 1;
+  }
+
   rc = entry_buffer_.init(max_lsn);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to init log entry buffer. rc=%s", strrc(rc));
@@ -133,6 +149,19 @@ RC DiskLogHandler::iterate(function<RC(LogEntry &)> consumer, LSN start_lsn)
   return RC::SUCCESS;
 }
 
+RC DiskLogHandler::recycle(LSN lsn)
+{
+  int removed_count = 0;
+  RC  rc            = file_manager_.recycle(lsn, removed_count);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to recycle clog files. lsn=%ld, rc=%s", lsn, strrc(rc));
+  }
+  if (removed_count > 0) {
+    LOG_INFO("recycle clog files done. lsn=%ld, removed files=%d", lsn, removed_count);
+  }
+  return rc;
+}
+
 RC DiskLogHandler::_append(LSN &lsn, LogModule module, vector<char> &&data)
 {
   ASSERT(running_.load(), "log handler is not running. lsn=%ld, module=%s, size=%d", 
@@ -144,14 +173,19 @@ RC DiskLogHandler::_append(LSN &lsn, LogModule module, vector<char> &&data)
     return rc;
   }
 
+  // 先加锁再通知，刷新日志的线程检查缓冲区和开始等待之间不会漏掉这次通知
+  {
+    lock_guard guard(mutex_);
+  }
+  flush_cond_.notify_one();
   return RC::SUCCESS;
 }
 
 RC DiskLogHandler::wait_lsn(LSN lsn)
 {
-  // 直接强制等待。在生产系统中，我们可能会使用条件变量来等待。
-  while (running_.load() && current_flushed_lsn() < lsn) {
-    this_thread::sleep_for(chrono::milliseconds(100));
+  if (current_flushed_lsn() < lsn) {
+    unique_lock lock(mutex_);
+    flushed_cond_.wait(lock, [this, lsn]() { return !running_.load() || current_flushed_lsn() >= lsn; });
   }
 
   if (current_flushed_lsn() >= lsn) {
@@ -164,9 +198,10 @@ RC DiskLogHandler::wait_lsn(LSN lsn)
 void DiskLogHandler::thread_func()
 {
   /*
-  这个线程一直不停的循环，检查日志缓冲区中是否有日志在内存中，如果在内存中就刷新到磁盘。
-  这种做法很粗暴简单，与生产数据库的做法不同。生产数据库通常会在内存达到一定量，或者一定时间
-  之后，会刷新一下磁盘。这样做的好处是减少磁盘的IO次数，提高性能。
+  这个线程在缓冲区中有日志时，把所有的日志作为一批刷新到磁盘，每一批只做一次fsync。
+  刷盘的时候，其它线程还可以继续往缓冲区中追加日志，它们会在下一批中一起刷盘。
+  所以提交的事务越多，每一批的日志就越多，平摊到每个事务上的fsync就越少。
+  没有日志时，在条件变量上等待，而不是定时检查。
   */
   thread_set_name("LogHandler");
   LOG_INFO("log handler thread started");
@@ -198,11 +233,23 @@ void DiskLogHandler::thread_func()
       LOG_WARN("failed to flush log entry buffer. rc=%s", strrc(rc));
     }
 
+    if (flush_count > 0) {
+      {
+        lock_guard guard(mutex_);
+      }
+      flushed_cond_.notify_all();
+    }
+
     if (flush_count == 0 && rc == RC::SUCCESS) {
-      this_thread::sleep_for(chrono::milliseconds(100));
-      continue;
+      unique_lock lock(mutex_);
+      flush_cond_.wait(lock, [this]() { return !running_.load() || entry_buffer_.ready_to_flush(); });
     }
   }
 
+  // 停止以后等待的线程就不会再等到日志刷盘了
+  {
+    lock_guard guard(mutex_);
+  }
+  flushed_cond_.notify_all();
   LOG_INFO("log handler thread stopped");
 }
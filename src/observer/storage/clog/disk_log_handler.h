@@ -20,6 +20,8 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/deque.h"
 #include "common/lang/memory.h"
 #include "common/lang/thread.h"
+#include "common/lang/mutex.h"
+#include "common/lang/condition_variable.h"
 #include "storage/clog/log_module.h"
 #include "storage/clog/log_file.h"
 #include "storage/clog/log_buffer.h"
@@ -31,7 +33,9 @@ class LogReplayer;
  * @brief 对外提供服务的CLog模块
  * @ingroup CLog
  * @details 该模块负责日志的写入、读取、回放等功能。
- * 会在后台开启一个线程，一直尝试刷新内存中的日志到磁盘。
+ * 会在后台开启一个线程刷新内存中的日志到磁盘。这个线程在没有日志时等待在条件变量上，有新的日志时被唤醒，
+ * 每次把缓冲区中所有的日志作为一批写入文件并只做一次fsync，然后唤醒所有等待日志刷盘的线程(wait_lsn)。
+ * 在刷盘的过程中提交的事务，它们的日志会在下一批一起刷盘，这就是组提交(group commit)。
  * 所有的CLog日志文件都存放在指定的目录下，每个日志文件按照日志条数来划分。
  * 调用的顺序应该是：
  * @code {.cpp}
@@ -92,11 +96,17 @@ public:
 
   /**
    * @brief 等待指定的日志刷盘
-   *
+   * @details 在条件变量上等待，刷日志的线程每刷完一批日志就会唤醒所有等待的线程
    * @param lsn 想要等待的日志
    */
   RC wait_lsn(LSN lsn) override;
 
+  /**
+   * @brief 删除所有日志都小于lsn的日志文件
+   * @details 正在写入的最后一个文件不会被删除
+   */
+  RC recycle(LSN lsn) override;
+
   /// @brief 当前的LSN
   LSN current_lsn() const override { return entry_buffer_.current_lsn(); }
   /// @brief 当前刷新到哪个日志
@@ -122,6 +132,10 @@ private:
   unique_ptr<thread> thread_;          /// 刷新日志的线程
   atomic_bool        running_{false};  /// 是否还要继续运行
 
+  mutex              mutex_;          /// 配合下面的条件变量使用
+  condition_variable flush_cond_;     /// 有新的日志或者需要停止时，唤醒刷新日志的线程
+  condition_variable flushed_cond_;   /// 一批日志刷盘以后，唤醒等待日志刷盘的线程
+
   LogFileManager file_manager_;  /// 管理所有的日志文件
   LogEntryBuffer entry_buffer_;  /// 缓存日志
 
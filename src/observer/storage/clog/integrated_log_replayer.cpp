@@ -12,24 +12,68 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai on 2024/02/04
 //
 
+#include <string.h>
+
 #include "storage/clog/integrated_log_replayer.h"
 #include "storage/clog/log_entry.h"
+#include "storage/buffer/disk_buffer_pool.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
+#include "common/lang/map.h"
+#include "common/lang/thread.h"
+#include "common/thread/thread_util.h"
+
+static int64_t now_us()
+{
+  return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 IntegratedLogReplayer::IntegratedLogReplayer(BufferPoolManager &bpm)
-    : buffer_pool_log_replayer_(bpm),
+    : bpm_(bpm),
+      buffer_pool_log_replayer_(bpm),
       record_log_replayer_(bpm),
       bplus_tree_log_replayer_(bpm),
       trx_log_replayer_(nullptr)
 {}
 
-IntegratedLogReplayer::IntegratedLogReplayer(BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer)
-    : buffer_pool_log_replayer_(bpm),
+IntegratedLogReplayer::IntegratedLogReplayer(
+    BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer, int redo_thread_num /*= 1*/)
+    : bpm_(bpm),
+      buffer_pool_log_replayer_(bpm),
       record_log_replayer_(bpm),
       bplus_tree_log_replayer_(bpm),
       trx_log_replayer_(std::move(trx_log_replayer))
-{}
+{
+  redo_thread_num_ = max(redo_thread_num, 1);
+#ifndef CONCURRENCY
+  if (redo_thread_num_ > 1) {
+    LOG_INFO("replay log partitions one by one as CONCURRENCY is off. redo thread num=%d", redo_thread_num_);
+  }
+#endif
+  if (redo_thread_num_ > 1) {
+    partitions_.resize(redo_thread_num_);
+  }
+}
 
 RC IntegratedLogReplayer::replay(const LogEntry &entry)
+{
+  entry_count_++;
+  if (redo_thread_num_ <= 1) {
+    return replay_entry(entry);
+  }
+
+  RC rc = dispatch(entry);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  if (batch_bytes_ >= MAX_BATCH_BYTES) {
+    rc = replay_batch();
+  }
+  return rc;
+}
+
+RC IntegratedLogReplayer::replay_entry(const LogEntry &entry)
 {
   switch (entry.module().id()) {
     case LogModule::Id::BUFFER_POOL: return buffer_pool_log_replayer_.replay(entry);
@@ -40,9 +84,186 @@ RC IntegratedLogReplayer::replay(const LogEntry &entry)
   }
 }
 
+RC IntegratedLogReplayer::dispatch(const LogEntry &entry)
+{
+  const int64_t begin_us = now_us();
+
+  int32_t buffer_pool_id = -1;
+  PageNum page_num       = BP_INVALID_PAGE_NUM;
+  switch (entry.module().id()) {
+    case LogModule::Id::TRANSACTION: {
+      // 事务日志只会记录在内存中，不访问页面
+      RC rc = trx_log_replayer_->replay(entry);
+      trx_redo_us_ += now_us() - begin_us;
+      return rc;
+    }
+    case LogModule::Id::BUFFER_POOL: break;
+    case LogModule::Id::RECORD_MANAGER: {
+      if (entry.payload_size() < RecordLogHeader::SIZE) {
+        LOG_WARN("invalid record log entry. entry=%s", entry.to_string().c_str());
+        return RC::LOG_ENTRY_INVALID;
+      }
+      auto header    = reinterpret_cast<const RecordLogHeader *>(entry.data());
+      buffer_pool_id = header->buffer_pool_id;
+      page_num       = header->page_num;
+    } break;
+    case LogModule::Id::BPLUS_TREE: {
+      // B+树日志的开头是 buffer pool id
+      if (entry.payload_size() < static_cast<int32_t>(sizeof(int32_t))) {
+        LOG_WARN("invalid bplus tree log entry. entry=%s", entry.to_string().c_str());
+        return RC::LOG_ENTRY_INVALID;
+      }
+      memcpy(&buffer_pool_id, entry.data(), sizeof(buffer_pool_id));
+    } break;
+    default: {
+      LOG_WARN("unknown log module. entry=%s", entry.to_string().c_str());
+      return RC::INVALID_ARGUMENT;
+    }
+  }
+
+  LogEntry copy;
+  RC       rc = copy.init(entry.lsn(), entry.module(), vector<char>(entry.data(), entry.data() + entry.payload_size()));
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  batch_bytes_ += copy.total_size();
+  if (entry.module().id() == LogModule::Id::BUFFER_POOL) {
+    buffer_pool_entries_.push_back(std::move(copy));
+  } else {
+    const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(buffer_pool_id)) << 32) |
+                         static_cast<uint32_t>(page_num);
+    partitions_[hash<uint64_t>()(key) % partitions_.size()].push_back(std::move(copy));
+  }
+
+  dispatch_us_ += now_us() - begin_us;
+  return RC::SUCCESS;
+}
+
+RC IntegratedLogReplayer::replay_batch()
+{
+  if (batch_bytes_ == 0) {
+    return RC::SUCCESS;
+  }
+
+  batch_count_++;
+
+  // 页面分配好以后才能回放这些页面上的日志，所以先回放 buffer pool 的日志
+  int64_t begin_us = now_us();
+  for (const LogEntry &entry : buffer_pool_entries_) {
+    RC rc = buffer_pool_log_replayer_.replay(entry);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to replay buffer pool log. entry=%s, rc=%s", entry.to_string().c_str(), strrc(rc));
+      return rc;
+    }
+  }
+  buffer_pool_entries_.clear();
+  buffer_pool_us_ += now_us() - begin_us;
+
+  begin_us = now_us();
+  (void)run_partitions([this](vector<LogEntry> &partition) {
+    prefetch_partition(partition);
+    return RC::SUCCESS;
+  });
+  prefetch_us_ += now_us() - begin_us;
+
+  begin_us = now_us();
+  RC rc    = run_partitions([this](vector<LogEntry> &partition) {
+    for (const LogEntry &entry : partition) {
+      RC rc = replay_entry(entry);
+      if (OB_FAIL(rc)) {
+        LOG_WARN("failed to replay log. entry=%s, rc=%s", entry.to_string().c_str(), strrc(rc));
+        return rc;
+      }
+    }
+    return RC::SUCCESS;
+  });
+  page_redo_us_ += now_us() - begin_us;
+
+  for (vector<LogEntry> &partition : partitions_) {
+    partition.clear();
+  }
+  batch_bytes_ = 0;
+  return rc;
+}
+
+void IntegratedLogReplayer::prefetch_partition(const vector<LogEntry> &partition)
+{
+  map<int32_t, vector<PageNum>> pages;
+  for (const LogEntry &entry : partition) {
+    if (entry.module().id() == LogModule::Id::RECORD_MANAGER) {
+      auto header = reinterpret_cast<const RecordLogHeader *>(entry.data());
+      pages[header->buffer_pool_id].push_back(header->page_num);
+    }
+  }
+
+  for (auto &[buffer_pool_id, page_nums] : pages) {
+    DiskBufferPool *buffer_pool = nullptr;
+    if (OB_FAIL(bpm_.get_buffer_pool(buffer_pool_id, buffer_pool))) {
+      continue;
+    }
+
+    // 按照页面编号排序，尽量顺序读
+    sort(page_nums.begin(), page_nums.end());
+    page_nums.erase(unique(page_nums.begin(), page_nums.end()), page_nums.end());
+    (void)buffer_pool->prefetch_pages(page_nums);
+  }
+}
+
+RC IntegratedLogReplayer::run_partitions(function<RC(vector<LogEntry> &)> func)
+{
+#ifndef CONCURRENCY
+  // 没有多线程支持时，按顺序处理每个分区。分区之间没有依赖，结果和并行处理一样
+  for (vector<LogEntry> &partition : partitions_) {
+    RC rc = func(partition);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+  return RC::SUCCESS;
+#else
+  vector<RC>     results(partitions_.size(), RC::SUCCESS);
+  vector<thread> threads;
+  for (size_t i = 0; i < partitions_.size(); i++) {
+    if (partitions_[i].empty()) {
+      continue;
+    }
+
+    threads.emplace_back([this, &func, &results, i]() {
+      common::thread_set_name("LogRedo");
+      results[i] = func(partitions_[i]);
+    });
+  }
+
+  for (thread &thread : threads) {
+    thread.join();
+  }
+
+  for (RC rc : results) {
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+  return RC::SUCCESS;
+#endif
+}
+
 RC IntegratedLogReplayer::on_done()
 {
-  RC rc = buffer_pool_log_replayer_.on_done();
+  RC rc = replay_batch();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to replay the last batch of logs. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  if (redo_thread_num_ > 1) {
+    LOG_INFO("parallel redo done. threads=%d, entries=%ld, batches=%ld, dispatch=%ldms, buffer pool redo=%ldms, "
+             "prefetch=%ldms, page redo=%ldms, trx redo=%ldms",
+             redo_thread_num_, entry_count_, batch_count_, dispatch_us_ / 1000, buffer_pool_us_ / 1000,
+             prefetch_us_ / 1000, page_redo_us_ / 1000, trx_redo_us_ / 1000);
+  }
+
+  rc = buffer_pool_log_replayer_.on_done();
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to do buffer pool log replay. rc=%s", strrc(rc));
     return rc;
@@ -59,11 +280,13 @@ RC IntegratedLogReplayer::on_done()
     return rc;
   }
 
-  rc = trx_log_replayer_->on_done();
-  if (OB_FAIL(rc)) {
-    LOG_WARN("failed to do mvcc trx log replay. rc=%s", strrc(rc));
-    return rc;
+  if (trx_log_replayer_) {
+    rc = trx_log_replayer_->on_done();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to do mvcc trx log replay. rc=%s", strrc(rc));
+      return rc;
+    }
   }
 
   return RC::SUCCESS;
-}
\ No newline at end of file
+}
@@ -14,6 +14,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/lang/functional.h"
+#include "common/lang/vector.h"
+#include "storage/clog/log_entry.h"
 #include "storage/clog/log_replayer.h"
 #include "storage/buffer/buffer_pool_log.h"
 #include "storage/record/record_log.h"
@@ -25,11 +28,29 @@ class BufferPoolManager;
 /**
  * @brief 整体日志回放类
  * @ingroup Clog
- * @details 负责回放所有日志，是其它各模块日志回放的分发器
+ * @details 负责回放所有日志，是其它各模块日志回放的分发器。
+ *
+ * 回放线程数大于1时，使用并行回放：日志先按批缓存起来，每一批：
+ * 1. 先按照LSN顺序回放 buffer pool 的日志。这些日志修改的是文件头和空间位图页，回放很快，
+ *    并且页面分配好以后，后面的页面日志才能读取这些页面；
+ * 2. record 日志按照 (buffer_pool_id, page_num) 分区，B+树日志按照 buffer_pool_id 分区，
+ *    因为一条B+树日志是一个mini transaction，会修改同一个文件的多个页面。
+ *    每个工作线程先批量预读自己分区中 record 日志涉及的页面，然后按照LSN顺序回放自己的分区，
+ *    这样每个页面上的日志仍然是按照LSN顺序回放的；
+ * 3. 事务日志只是在内存中记录事务的操作，读到时直接在当前线程回放，on_done 时再回滚未提交的事务。
+ *
+ * 最后一批日志在 on_done 中回放，各个阶段的耗时也在这时打印出来。
+ * 只有打开 CONCURRENCY 编译选项时，页面的锁才会生效，否则总是使用单线程回放。
  */
 class IntegratedLogReplayer : public LogReplayer
 {
 public:
+  /// 默认的回放线程数
+  static constexpr int DEFAULT_REDO_THREAD_NUM = 4;
+
+  /// 并行回放时，每一批最多缓存多少字节的日志
+  static constexpr int64_t MAX_BATCH_BYTES = 64 * 1024 * 1024;
+
   /**
    * @brief 构造函数
    * @details 在做恢复时，我们通常需要一个 BufferPoolManager 对象，因为恢复过程中需要读取磁盘页。
@@ -42,8 +63,9 @@ public:
    * @brief 构造函数
    * @details
    * 区别于另一个构造函数，这个构造函数可以指定不同的事务日志回放器。比如进程启动时可以指定选择使用VacuousTrx还是MvccTrx。
+   * @param redo_thread_num 回放页面日志的线程数，为1时逐条回放
    */
-  IntegratedLogReplayer(BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer);
+  IntegratedLogReplayer(BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer, int redo_thread_num = 1);
   virtual ~IntegratedLogReplayer() = default;
 
   //! @copydoc LogReplayer::replay
@@ -53,8 +75,43 @@ public:
   RC on_done() override;
 
 private:
+  /// @brief 交给对应模块的回放器回放一条日志
+  RC replay_entry(const LogEntry &entry);
+
+  /// @brief 并行回放时，把日志放到当前批次的对应分区中
+  RC dispatch(const LogEntry &entry);
+
+  /// @brief 回放当前批次中缓存的所有日志
+  RC replay_batch();
+
+  /// @brief 预读一个分区中 record 日志涉及的页面
+  void prefetch_partition(const vector<LogEntry> &partition);
+
+  /**
+   * @brief 使用 redo_thread_num_ 个线程，每个线程处理一个分区
+   * @details 没有开启 CONCURRENCY 时在当前线程中依次处理各个分区
+   * @return 第一个失败的返回值
+   */
+  RC run_partitions(function<RC(vector<LogEntry> &)> func);
+
+private:
+  BufferPoolManager      &bpm_;
   BufferPoolLogReplayer   buffer_pool_log_replayer_;  ///< 缓冲池日志回放器
   RecordLogReplayer       record_log_replayer_;       ///< record manager 日志回放器
   BplusTreeLogReplayer    bplus_tree_log_replayer_;   ///< bplus tree 日志回放器
   unique_ptr<LogReplayer> trx_log_replayer_;          ///< trx 日志回放器
+
+  int                      redo_thread_num_ = 1;  ///< 回放页面日志的线程数
+  vector<LogEntry>         buffer_pool_entries_;  ///< 当前批次中 buffer pool 的日志
+  vector<vector<LogEntry>> partitions_;           ///< 当前批次中按照页面分区的日志
+  int64_t                  batch_bytes_ = 0;      ///< 当前批次缓存的日志大小
+
+  /// 各个阶段的耗时统计，单位微秒
+  int64_t entry_count_       = 0;
+  int64_t batch_count_       = 0;
+  int64_t dispatch_us_       = 0;
+  int64_t buffer_pool_us_    = 0;
+  int64_t prefetch_us_       = 0;
+  int64_t page_redo_us_      = 0;
+  int64_t trx_redo_us_       = 0;
 };
\ No newline at end of file
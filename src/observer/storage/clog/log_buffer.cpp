@@ -12,20 +12,44 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai on 2024/01/31
 //
 
+#include <bit>
+#include <string.h>
+
 #include "storage/clog/log_buffer.h"
 #include "storage/clog/log_file.h"
-#include "common/lang/chrono.h"
+#include "common/lang/algorithm.h"
+#include "common/log/log.h"
 
 using namespace common;
 
 RC LogEntryBuffer::init(LSN lsn, int32_t max_bytes /*= 0*/)
 {
-  current_lsn_.store(lsn);
-  flushed_lsn_.store(lsn);
+  if (lsn < 0) {
+    LOG_ERROR("invalid lsn. lsn=%ld", lsn);
+    return RC::INVALID_ARGUMENT;
+  }
 
   if (max_bytes > 0) {
     max_bytes_ = max_bytes;
   }
+
+  // 至少能放下一条最大的日志，否则这条日志永远也等不到足够的空间
+  const uint32_t capacity = std::bit_ceil(static_cast<uint32_t>(max(max_bytes_, LogEntry::max_size())));
+  if (capacity != capacity_) {
+    capacity_   = capacity;
+    buffer_     = make_unique<char[]>(capacity_);
+    // 每条日志至少占用一个日志头的空间，所以缓冲区中的日志条数不会超过 slot_count_
+    slot_count_ = capacity_ / LogHeader::SIZE;
+    slots_      = make_unique<atomic<LSN>[]>(slot_count_);
+  }
+
+  for (uint32_t i = 0; i < slot_count_; i++) {
+    slots_[i].store(0, std::memory_order_relaxed);
+  }
+
+  flushed_lsn_.store(lsn);
+  reserved_.store(static_cast<uint64_t>(static_cast<uint32_t>(lsn)) << 32);
+  flushed_offset_.store(0);
   return RC::SUCCESS;
 }
 
@@ -36,65 +60,163 @@ RC LogEntryBuffer::append(LSN &lsn, LogModule::Id module_id, vector<char> &&data
 
 RC LogEntryBuffer::append(LSN &lsn, LogModule module, vector<char> &&data)
 {
-  /// 控制当前buffer使用的内存
-  /// 简单粗暴，强制原地等待
-  /// 但是如果当前想要新插入的日志比较大，不会做控制。所以理论上容纳的最大buffer内存是2*max_bytes_
-  while (bytes_.load() >= max_bytes_) {
-    this_thread::sleep_for(chrono::milliseconds(10));
+  if (static_cast<int32_t>(data.size()) > LogEntry::max_payload_size()) {
+    LOG_DEBUG("log entry size is too large. size=%zu, max_payload_size=%d", data.size(), LogEntry::max_payload_size());
+    return RC::INVALID_ARGUMENT;
   }
 
-  LogEntry entry;
-  RC       rc = entry.init(lsn, module, std::move(data));
-  if (OB_FAIL(rc)) {
-    LOG_WARN("failed to init log entry. rc=%s", strrc(rc));
-    return rc;
+  ASSERT(buffer_, "log entry buffer is not initialized");
+
+  const int32_t  payload_size = static_cast<int32_t>(data.size());
+  const uint32_t total_size   = static_cast<uint32_t>(LogHeader::SIZE + payload_size);
+
+  // 同时分配LSN和空间。空间不够时等待刷盘线程腾出空间
+  uint64_t reserved = reserved_.load(std::memory_order_relaxed);
+  while (true) {
+    const uint32_t offset = offset_of(reserved);
+    if (!has_space(offset, total_size)) {
+      unique_lock lock(mutex_);
+      space_cond_.wait(lock, [this, total_size]() { return has_space(offset_of(reserved_.load()), total_size); });
+      reserved = reserved_.load(std::memory_order_relaxed);
+      continue;
+    }
+
+    const uint64_t next =
+        (static_cast<uint64_t>(lsn_low_of(reserved) + 1) << 32) | static_cast<uint32_t>(offset + total_size);
+    if (reserved_.compare_exchange_weak(reserved, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      break;
+    }
   }
 
-  lock_guard guard(mutex_);
-  lsn = ++current_lsn_;
-  entry.set_lsn(lsn);
+  // 这条日志还没有标记为写好，刷盘不会越过它，所以 flushed_lsn_ 不会超过它的LSN
+  lsn                    = lsn_of(flushed_lsn_.load(), lsn_low_of(reserved) + 1);
+  const uint32_t offset  = offset_of(reserved);
+
+  LogHeader header;
+  header.lsn       = lsn;
+  header.size      = payload_size;
+  header.module_id = module.index();
+  copy_in(offset, reinterpret_cast<const char *>(&header), LogHeader::SIZE);
+  copy_in(offset + LogHeader::SIZE, data.data(), payload_size);
 
-  entries_.push_back(std::move(entry));
-  bytes_ += entry.total_size();
+  // 日志已经完整地写入缓冲区，刷盘线程可以看到它了
+  slots_[lsn % slot_count_].store(lsn, std::memory_order_release);
   return RC::SUCCESS;
 }
 
 RC LogEntryBuffer::flush(LogFileWriter &writer, int &count)
 {
   count = 0;
+  if (!buffer_) {
+    return RC::SUCCESS;
+  }
 
-  while (entry_number() > 0) {
-    LogEntry entry;
-    {
-      lock_guard guard(mutex_);
-      if (entries_.empty()) {
-        break;
-      }
-
-      LogEntry &front_entry = entries_.front();
-      ASSERT(front_entry.lsn() > 0 && front_entry.payload_size() > 0, "invalid log entry");
-      entry = std::move(entries_.front());
-      ASSERT(entry.payload_size() > 0 && entry.lsn() > 0, "invalid log entry");
-      entries_.pop_front();
-      bytes_ -= entry.total_size();
+  // 从上次刷盘的位置开始，找到所有连续的已经写好的日志，整批写入文件，只需要一次fsync。
+  // 这样同时提交的多个事务只需要等待一次刷盘，也就是组提交(group commit)
+  const LSN      first_lsn    = flushed_lsn_.load() + 1;
+  const uint32_t start_offset = flushed_offset_.load();
+  const LSN      end_lsn      = min(current_lsn(), writer.end_lsn());
+
+  LSN      lsn    = first_lsn;
+  uint32_t offset = start_offset;
+  for (; lsn <= end_lsn; lsn++) {
+    if (slots_[lsn % slot_count_].load(std::memory_order_acquire) != lsn) {
+      break;
     }
 
-    RC rc = writer.write(entry);
-    if (OB_FAIL(rc)) {
-      lock_guard guard(mutex_);
-      entries_.emplace_front(std::move(entry));
-      LogEntry &front_entry = entries_.front();
-      ASSERT(front_entry.lsn() > 0 && front_entry.payload_size() > 0, "invalid log entry");
-      return rc;
-    } else {
-      ++count;
-      flushed_lsn_ = entry.lsn();
+    LogHeader header;
+    copy_out(offset, reinterpret_cast<char *>(&header), LogHeader::SIZE);
+    ASSERT(header.lsn == lsn && header.size >= 0, "invalid log entry. expect lsn=%ld, header=%s", 
+           lsn, header.to_string().c_str());
+    offset += LogHeader::SIZE + header.size;
+  }
+
+  const LSN last_lsn = lsn - 1;
+  if (last_lsn < first_lsn) {
+    // 下一条日志已经写好了，但是当前文件放不下了
+    if (first_lsn > writer.end_lsn() && first_lsn <= current_lsn()) {
+      return RC::LOG_FILE_FULL;
     }
+    return RC::SUCCESS;
   }
 
-  return RC::SUCCESS;
+  // 这段日志在缓冲区中可能会回绕到开头，最多分成两段
+  const uint32_t bytes = offset - start_offset;
+  const uint32_t pos   = start_offset & (capacity_ - 1);
+  const uint32_t first = min(bytes, capacity_ - pos);
+
+  struct iovec iov[2];
+  int          iovcnt = 0;
+  iov[iovcnt++]       = {buffer_.get() + pos, first};
+  if (first < bytes) {
+    iov[iovcnt++] = {buffer_.get(), bytes - first};
+  }
+
+  RC rc = writer.write(first_lsn, last_lsn, span<struct iovec>(iov, iovcnt));
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to write log entries. first lsn=%ld, last lsn=%ld, rc=%s", first_lsn, last_lsn, strrc(rc));
+    return rc;
+  }
+
+  count = static_cast<int>(last_lsn - first_lsn + 1);
+  flushed_lsn_.store(last_lsn);
+  flushed_offset_.store(offset);
+
+  // 先加锁再通知，等待空间的线程检查空间和开始等待之间不会漏掉这次通知
+  {
+    lock_guard guard(mutex_);
+  }
+  space_cond_.notify_all();
+
+  return last_lsn < current_lsn() && last_lsn >= writer.end_lsn() ? RC::LOG_FILE_FULL : RC::SUCCESS;
 }
 
-int64_t LogEntryBuffer::bytes() const { return bytes_.load(); }
+LSN LogEntryBuffer::current_lsn() const
+{
+  // 先读取已经刷盘的LSN，它一定不会超过后面读到的已经分配的LSN
+  const LSN flushed_lsn = flushed_lsn_.load();
+  return lsn_of(flushed_lsn, lsn_low_of(reserved_.load()));
+}
 
-int32_t LogEntryBuffer::entry_number() const { return entries_.size(); }
+int64_t LogEntryBuffer::bytes() const
+{
+  return static_cast<uint32_t>(offset_of(reserved_.load()) - flushed_offset_.load());
+}
+
+int32_t LogEntryBuffer::entry_number() const { return static_cast<int32_t>(current_lsn() - flushed_lsn()); }
+
+bool LogEntryBuffer::ready_to_flush() const
+{
+  if (!buffer_) {
+    return false;
+  }
+  const LSN lsn = flushed_lsn_.load() + 1;
+  return slots_[lsn % slot_count_].load(std::memory_order_acquire) == lsn;
+}
+
+bool LogEntryBuffer::has_space(uint32_t offset, uint32_t size) const
+{
+  // 偏移量都是在2^32上回绕的，差值就是已经使用的空间
+  const uint32_t used = offset - flushed_offset_.load();
+  return static_cast<uint64_t>(used) + size <= capacity_;
+}
+
+void LogEntryBuffer::copy_in(uint32_t offset, const char *data, int32_t size)
+{
+  const uint32_t pos   = offset & (capacity_ - 1);
+  const uint32_t first = min(static_cast<uint32_t>(size), capacity_ - pos);
+  memcpy(buffer_.get() + pos, data, first);
+  if (first < static_cast<uint32_t>(size)) {
+    memcpy(buffer_.get(), data + first, size - first);
+  }
+}
+
+void LogEntryBuffer::copy_out(uint32_t offset, char *data, int32_t size) const
+{
+  const uint32_t pos   = offset & (capacity_ - 1);
+  const uint32_t first = min(static_cast<uint32_t>(size), capacity_ - pos);
+  memcpy(data, buffer_.get() + pos, first);
+  if (first < static_cast<uint32_t>(size)) {
+    memcpy(data + first, buffer_.get(), size - first);
+  }
+}
@@ -17,9 +17,10 @@ See the Mulan PSL v2 for more details. */
 #include "common/sys/rc.h"
 #include "common/types.h"
 #include "common/lang/mutex.h"
+#include "common/lang/memory.h"
 #include "common/lang/vector.h"
-#include "common/lang/deque.h"
 #include "common/lang/atomic.h"
+#include "common/lang/condition_variable.h"
 #include "storage/clog/log_module.h"
 #include "storage/clog/log_entry.h"
 
@@ -29,8 +30,18 @@ class LogFileWriter;
  * @brief 日志数据缓冲区
  * @ingroup CLog
  * @details 缓存一部分日志在内存中而不是直接写入磁盘。
- * 这里的缓存没有考虑高性能操作，比如使用预分配内存、环形缓冲池等。
- * 在生产数据库中，通常会使用预分配内存形式的缓存来提高性能，并且可以减少内存碎片。
+ * 缓冲区是一块预先分配好的环形内存，日志按照 LogHeader + 日志数据 的格式连续存放，和日志文件中的格式一样，
+ * 刷盘时直接把一段连续的内存写入文件，不需要为每条日志单独分配内存。
+ *
+ * 追加日志时不加锁：LSN的低32位和日志在环形缓冲区中的偏移量放在一个64位的原子变量中，
+ * 通过一次CAS同时分配LSN和空间，所以LSN的顺序和日志在缓冲区中的顺序是一致的。缓冲区中没有刷盘的日志
+ * 不会超过 slot_count_ 条，所以完整的LSN可以根据已经刷盘的LSN还原出来，不会在2^32条日志以后回绕。分配好空间以后，各个线程
+ * 并行地把日志拷贝进去，然后在 slots_ 中标记这条日志已经写好。刷盘线程从上次刷盘的位置开始，找到一段连续的
+ * 已经写好的日志，一起写入文件。
+ *
+ * 缓冲区满的时候，追加日志的线程在条件变量上等待，刷盘以后被唤醒，而不是睡眠一段时间再检查。
+ *
+ * 只能有一个线程调用 flush。
  */
 class LogEntryBuffer
 {
@@ -38,44 +49,87 @@ public:
   LogEntryBuffer()  = default;
   ~LogEntryBuffer() = default;
 
+  /**
+   * @brief 初始化
+   * @details 可以多次调用，比如重放日志以后，从最大的LSN开始。调用时缓冲区中不能有没有刷盘的日志
+   * @param lsn 当前最大的LSN，下一条日志从 lsn + 1 开始
+   * @param max_bytes 缓冲区大小，会向上取整到2的幂，并且至少能放下一条最大的日志
+   */
   RC init(LSN lsn, int32_t max_bytes = 0);
 
   /**
    * @brief 在缓冲区中追加一条日志
+   * @details 缓冲区满时会等待，直到刷盘线程腾出空间
    */
   RC append(LSN &lsn, LogModule::Id module_id, vector<char> &&data);
   RC append(LSN &lsn, LogModule module, vector<char> &&data);
 
   /**
    * @brief 刷新缓冲区中的日志到磁盘
-   *
+   * @details 从上次刷盘的位置开始，所有连续的已经写好的日志作为一批写入文件，只做一次fsync。
+   * 当前文件写满时返回 RC::LOG_FILE_FULL，没有写入的日志会留在缓冲区中
    * @param file_handle 使用它来写文件
    * @param count 刷了多少条日志
    */
   RC flush(LogFileWriter &file_writer, int &count);
 
   /**
-   * @brief 当前缓冲区中有多少字节的日志
+   * @brief 当前缓冲区中有多少字节的日志，包括正在写入的日志
    */
   int64_t bytes() const;
 
   /**
-   * @brief 当前缓冲区中有多少条日志
+   * @brief 当前缓冲区中有多少条日志，包括正在写入的日志
    */
   int32_t entry_number() const;
 
-  LSN current_lsn() const { return current_lsn_.load(); }
+  /**
+   * @brief 下一条要刷盘的日志是否已经写好了
+   */
+  bool ready_to_flush() const;
+
+  LSN current_lsn() const;
   LSN flushed_lsn() const { return flushed_lsn_.load(); }
 
 private:
-  /// 当前数据结构一定会在多线程中访问，所以强制使用有效的锁，
-  /// 而不是有条件生效的common::Mutex
-  mutex           mutex_;
-  deque<LogEntry> entries_;  /// 日志缓冲区
-  atomic<int64_t> bytes_;    /// 当前缓冲区中的日志数据大小
+  static uint32_t lsn_low_of(uint64_t reserved) { return static_cast<uint32_t>(reserved >> 32); }
+  static uint32_t offset_of(uint64_t reserved) { return static_cast<uint32_t>(reserved); }
+
+  /**
+   * @brief 根据LSN的低32位还原出完整的LSN
+   * @details 还原出来的是不小于 base 的LSN中，第一个低32位等于 lsn_low 的
+   * @param base 不大于要还原的LSN，并且差值小于2^32。没有刷盘的日志不超过 slot_count_ 条，
+   * 所以在分配LSN之后读取的 flushed_lsn_ 可以作为 base
+   */
+  static LSN lsn_of(LSN base, uint32_t lsn_low)
+  {
+    return base + static_cast<uint32_t>(lsn_low - static_cast<uint32_t>(base));
+  }
+
+  /// @brief 缓冲区中从 offset 开始，是否还能放下 size 字节
+  bool has_space(uint32_t offset, uint32_t size) const;
+
+  /// @brief 在环形缓冲区中拷贝数据，处理回绕的情况
+  void copy_in(uint32_t offset, const char *data, int32_t size);
+  void copy_out(uint32_t offset, char *data, int32_t size) const;
+
+private:
+  unique_ptr<char[]>        buffer_;        /// 环形缓冲区
+  uint32_t                  capacity_ = 0;  /// 缓冲区大小，是2的幂
+  unique_ptr<atomic<LSN>[]> slots_;         /// 日志写好以后，把LSN记录在 slots_[lsn % slot_count_] 中
+  uint32_t                  slot_count_ = 0;
+
+  /// 高32位是已经分配的最大LSN的低32位，低32位是已经分配的空间的结束位置。
+  /// 偏移量在2^32上回绕，而缓冲区大小是2的幂，所以取模以后就是在缓冲区中的位置
+  atomic<uint64_t> reserved_{0};
 
-  atomic<LSN> current_lsn_{0};
-  atomic<LSN> flushed_lsn_{0};
+  atomic<LSN>      flushed_lsn_{0};
+  atomic<uint32_t> flushed_offset_{0};  /// 已经刷盘的日志的结束位置，之前的空间可以重用
+
+  /// 当前数据结构一定会在多线程中访问，所以强制使用有效的锁，
+  /// 而不是有条件生效的common::Mutex。只在缓冲区满的时候使用
+  mutex              mutex_;
+  condition_variable space_cond_;  /// 刷盘以后唤醒等待空间的线程
 
   int32_t max_bytes_ = 4 * 1024 * 1024;  /// 缓冲区最大字节数
 };
@@ -13,9 +13,13 @@ See the Mulan PSL v2 for more details. */
 //
 
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #include "common/lang/string_view.h"
 #include "common/lang/charconv.h"
+#include "common/lang/vector.h"
 #include "common/log/log.h"
 #include "storage/clog/log_file.h"
 #include "storage/clog/log_entry.h"
@@ -23,6 +27,45 @@ See the Mulan PSL v2 for more details. */
 
 using namespace common;
 
+const int32_t LogFileHeader::MAGIC   = 0x474f4c43;  // "CLOG"
+const int32_t LogFileHeader::VERSION = 1;
+const int32_t LogFileHeader::SIZE    = sizeof(LogFileHeader);
+
+RC LogFileHeader::check(int fd, const char *filename, bool &empty)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    LOG_WARN("stat file failed. filename=%s, error=%s", filename, strerror(errno));
+    return RC::IOERR_ACCESS;
+  }
+
+  empty = st.st_size < SIZE;
+  if (empty) {
+    return RC::SUCCESS;
+  }
+
+  LogFileHeader header;
+  int           ret = preadn(fd, &header, SIZE, 0);
+  if (0 != ret) {
+    LOG_WARN("read file header failed. filename=%s, ret=%d, error=%s", filename, ret, strerror(errno));
+    return RC::IOERR_READ;
+  }
+
+  if (header.magic != MAGIC) {
+    LOG_ERROR("log file has no valid header, it may be written by an old version that is not supported. "
+              "filename=%s, magic=%x",
+              filename, header.magic);
+    return RC::LOG_FILE_VERSION_MISMATCH;
+  }
+  if (header.version != VERSION) {
+    LOG_ERROR("unsupported log file version. filename=%s, version=%d, expected=%d", filename, header.version, VERSION);
+    return RC::LOG_FILE_VERSION_MISMATCH;
+  }
+  return RC::SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LogFileReader
 RC LogFileReader::open(const char *filename)
 {
   filename_ = filename;
@@ -33,6 +76,15 @@ RC LogFileReader::open(const char *filename)
     return RC::FILE_OPEN;
   }
 
+  bool empty = false;
+  RC   rc    = LogFileHeader::check(fd_, filename, empty);
+  if (OB_FAIL(rc)) {
+    (void)close();
+    return rc;
+  }
+  // 没有完整文件头的文件中也不会有日志，直接从文件末尾开始读
+  data_offset_ = empty ? lseek(fd_, 0, SEEK_END) : LogFileHeader::SIZE;
+
   LOG_INFO("open file success. filename=%s, fd=%d", filename, fd_);
   return RC::SUCCESS;
 }
@@ -98,9 +150,9 @@ RC LogFileReader::skip_to(LSN start_lsn)
     return RC::FILE_NOT_OPENED;
   }
 
-  off_t pos = lseek(fd_, 0, SEEK_SET);
+  off_t pos = lseek(fd_, data_offset_, SEEK_SET);
   if (off_t(-1) == pos) {
-    LOG_WARN("seek file failed. seek to the beginning. filename=%s, error=%s", filename_.c_str(), strerror(errno));
+    LOG_WARN("seek file failed. seek to the first entry. filename=%s, error=%s", filename_.c_str(), strerror(errno));
     return RC::IOERR_SEEK;
   }
 
@@ -143,7 +195,7 @@ RC LogFileReader::skip_to(LSN start_lsn)
 // LogFileWriter
 LogFileWriter::~LogFileWriter() { (void)this->close(); }
 
-RC LogFileWriter::open(const char *filename, int end_lsn)
+RC LogFileWriter::open(const char *filename, LSN end_lsn)
 {
   if (fd_ >= 0) {
     return RC::FILE_OPEN;
@@ -152,16 +204,51 @@ RC LogFileWriter::open(const char *filename, int end_lsn)
   filename_ = filename;
   end_lsn_  = end_lsn;
 
-  fd_ = ::open(filename, O_WRONLY | O_APPEND | O_CREAT | O_SYNC, 0644);
+  // 不使用 O_SYNC，每批日志写完以后统一做一次 fdatasync
+  fd_ = ::open(filename, O_RDWR | O_APPEND | O_CREAT, 0644);
   if (fd_ < 0) {
     LOG_WARN("open file failed. filename=%s, error=%s", filename, strerror(errno));
     return RC::FILE_OPEN;
   }
 
+  bool empty = false;
+  RC   rc    = LogFileHeader::check(fd_, filename, empty);
+  if (OB_SUCC(rc) && empty) {
+    rc = write_header();
+  }
+  if (OB_FAIL(rc)) {
+    (void)close();
+    return rc;
+  }
+
   LOG_INFO("open file success. filename=%s, fd=%d", filename, fd_);
   return RC::SUCCESS;
 }
 
+RC LogFileWriter::write_header()
+{
+  // 上次可能只写了一部分文件头
+  if (ftruncate(fd_, 0) != 0) {
+    LOG_WARN("truncate file failed. filename=%s, error=%s", filename_.c_str(), strerror(errno));
+    return RC::IOERR_WRITE;
+  }
+
+  LogFileHeader header;
+  header.magic   = LogFileHeader::MAGIC;
+  header.version = LogFileHeader::VERSION;
+  int ret        = writen(fd_, &header, LogFileHeader::SIZE);
+  if (0 != ret) {
+    LOG_WARN("write file header failed. filename=%s, ret=%d, error=%s", filename_.c_str(), ret, strerror(errno));
+    return RC::IOERR_WRITE;
+  }
+
+  if (fdatasync(fd_) != 0) {
+    LOG_WARN("sync log file failed. filename=%s, error=%s", filename_.c_str(), strerror(errno));
+    return RC::IOERR_SYNC;
+  }
+  return RC::SUCCESS;
+}
+
 RC LogFileWriter::close()
 {
   if (fd_ < 0) {
@@ -175,39 +262,79 @@ RC LogFileWriter::close()
 
 RC LogFileWriter::write(LogEntry &entry)
 {
+  int count = 0;
+  return write(span<LogEntry>(&entry, 1), count);
+}
+
+RC LogFileWriter::write(span<LogEntry> entries, int &count)
+{
+  count = 0;
+  if (fd_ < 0) {
+    return RC::FILE_NOT_OPENED;
+  }
+
   // 一个日志文件写的日志条数是有限制的
-  if (entry.lsn() > end_lsn_) {
-    return RC::LOG_FILE_FULL;
+  vector<struct iovec> iov;
+  iov.reserve(entries.size() * 2);
+  LSN last_lsn = last_lsn_;
+  for (LogEntry &entry : entries) {
+    if (entry.lsn() > end_lsn_) {
+      break;
+    }
+
+    if (entry.lsn() <= last_lsn) {
+      LOG_WARN("write log entry failed. lsn is too small. filename=%s, last_lsn=%ld, entry=%s", 
+               filename_.c_str(), last_lsn, entry.to_string().c_str());
+      return RC::INVALID_ARGUMENT;
+    }
+
+    iov.push_back({const_cast<LogHeader *>(&entry.header()), static_cast<size_t>(LogHeader::SIZE)});
+    iov.push_back({const_cast<char *>(entry.data()), static_cast<size_t>(entry.payload_size())});
+    last_lsn = entry.lsn();
+  }
+
+  const int entry_count = static_cast<int>(iov.size() / 2);
+  if (entry_count == 0) {
+    return entries.empty() ? RC::SUCCESS : RC::LOG_FILE_FULL;
   }
 
+  RC rc = write(entries[0].lsn(), last_lsn, iov);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  count = entry_count;
+  return entry_count < static_cast<int>(entries.size()) ? RC::LOG_FILE_FULL : RC::SUCCESS;
+}
+
+RC LogFileWriter::write(LSN first_lsn, LSN last_lsn, span<struct iovec> buffers)
+{
   if (fd_ < 0) {
     return RC::FILE_NOT_OPENED;
   }
 
-  if (entry.lsn() <= last_lsn_) {
-    LOG_WARN("write log entry failed. lsn is too small. filename=%s, last_lsn=%ld, entry=%s", 
-             filename_.c_str(), last_lsn_, entry.to_string().c_str());
+  if (first_lsn <= last_lsn_ || last_lsn < first_lsn || last_lsn > end_lsn_) {
+    LOG_WARN("write log entries failed. invalid lsn. filename=%s, last_lsn=%ld, end_lsn=%ld, first=%ld, last=%ld", 
+             filename_.c_str(), last_lsn_, end_lsn_, first_lsn, last_lsn);
     return RC::INVALID_ARGUMENT;
   }
 
   /// WARNING 这里需要处理日志写一半的情况
   /// 日志只写成功一部分到文件中非常难处理
-  int ret = writen(fd_, reinterpret_cast<const char *>(&entry.header()), LogHeader::SIZE);
+  int ret = writevn(fd_, buffers.data(), static_cast<int>(buffers.size()));
   if (0 != ret) {
-    LOG_WARN("write log entry header failed. filename=%s, ret = %d, error=%s, entry=%s", 
-             filename_.c_str(), ret, strerror(errno), entry.to_string().c_str());
+    LOG_WARN("write log entries failed. filename=%s, ret = %d, error=%s, first lsn=%ld, last lsn=%ld", 
+             filename_.c_str(), ret, strerror(ret), first_lsn, last_lsn);
     return RC::IOERR_WRITE;
   }
 
-  ret = writen(fd_, entry.data(), entry.payload_size());
-  if (0 != ret) {
-    LOG_WARN("write log entry payload failed. filename=%s, ret = %d, error=%s, entry=%s", 
-             filename_.c_str(), ret, strerror(errno), entry.to_string().c_str());
-    return RC::IOERR_WRITE;
+  if (fdatasync(fd_) != 0) {
+    LOG_WARN("sync log file failed. filename=%s, error=%s", filename_.c_str(), strerror(errno));
+    return RC::IOERR_SYNC;
   }
 
-  last_lsn_ = entry.lsn();
-  LOG_TRACE("write log entry success. filename=%s, entry=%s", filename_.c_str(), entry.to_string().c_str());
+  last_lsn_ = last_lsn;
+  LOG_TRACE("write log entries success. filename=%s, first lsn=%ld, last lsn=%ld", filename_.c_str(), first_lsn, last_lsn);
   return RC::SUCCESS;
 }
 
@@ -287,6 +414,7 @@ RC LogFileManager::list_files(vector<string> &files, LSN start_lsn)
 {
   files.clear();
 
+  lock_guard<mutex> guard(lock_);
   // 这里的代码是AI自动生成的
   // 其实写的不好，我们只需要找到比start_lsn相等或者小的第一个日志文件就可以了
   for (auto &file : log_files_) {
@@ -300,28 +428,74 @@ RC LogFileManager::list_files(vector<string> &files, LSN start_lsn)
 
 RC LogFileManager::last_file(LogFileWriter &file_writer)
 {
-  if (log_files_.empty()) {
+  filesystem::path file_path;
+  LSN              end_lsn = 0;
+  {
+    lock_guard<mutex> guard(lock_);
+    if (!log_files_.empty()) {
+      auto last_file_item = log_files_.rbegin();
+      file_path           = last_file_item->second;
+      end_lsn             = last_file_item->first + max_entry_number_per_file_ - 1;
+    }
+  }
+
+  if (file_path.empty()) {
     return next_file(file_writer);
   }
 
   file_writer.close();
-
-  auto last_file_item = log_files_.rbegin();
-  return file_writer.open(last_file_item->second.c_str(), last_file_item->first + max_entry_number_per_file_ - 1);
+  return file_writer.open(file_path.c_str(), end_lsn);
 }
 
 RC LogFileManager::next_file(LogFileWriter &file_writer)
 {
   file_writer.close();
 
-  LSN lsn = 0;
-  if (!log_files_.empty()) {
-    lsn = log_files_.rbegin()->first + max_entry_number_per_file_;
-  }
+  LSN              lsn = 0;
+  filesystem::path file_path;
+  {
+    lock_guard<mutex> guard(lock_);
+    if (!log_files_.empty()) {
+      lsn = log_files_.rbegin()->first + max_entry_number_per_file_;
+    }
 
-  string           filename  = file_prefix_ + to_string(lsn) + file_suffix_;
-  filesystem::path file_path = directory_ / filename;
-  log_files_.emplace(lsn, file_path);
+    string filename = file_prefix_ + to_string(lsn) + file_suffix_;
+    file_path       = directory_ / filename;
+    log_files_.emplace(lsn, file_path);
+  }
 
   return file_writer.open(file_path.c_str(), lsn + max_entry_number_per_file_ - 1);
 }
+
+RC LogFileManager::recycle(LSN lsn, int &removed_count)
+{
+  removed_count = 0;
+
+  vector<filesystem::path> files;
+  {
+    lock_guard<mutex> guard(lock_);
+    while (log_files_.size() > 1) {
+      auto first_file_item = log_files_.begin();
+      if (first_file_item->first + max_entry_number_per_file_ - 1 >= lsn) {
+        break;
+      }
+
+      files.push_back(first_file_item->second);
+      log_files_.erase(first_file_item);
+    }
+  }
+
+  // 文件已经从列表中摘除了，不会再有人访问，删除文件时不需要持有锁
+  RC rc = RC::SUCCESS;
+  for (const filesystem::path &file : files) {
+    error_code ec;
+    if (!filesystem::remove(file, ec) && ec) {
+      LOG_WARN("failed to remove log file. file=%s, error=%s", file.c_str(), ec.message().c_str());
+      rc = RC::FILE_REMOVE;
+      continue;
+    }
+    removed_count++;
+    LOG_INFO("log file recycled. file=%s", file.c_str());
+  }
+  return rc;
+}
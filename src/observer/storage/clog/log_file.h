@@ -14,9 +14,13 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <sys/uio.h>
+
 #include "common/sys/rc.h"
 #include "common/types.h"
 #include "common/lang/map.h"
+#include "common/lang/mutex.h"
+#include "common/lang/span.h"
 #include "common/lang/functional.h"
 #include "common/lang/filesystem.h"
 #include "common/lang/fstream.h"
@@ -24,6 +28,34 @@ See the Mulan PSL v2 for more details. */
 
 class LogEntry;
 
+/**
+ * @brief 日志文件头
+ * @ingroup CLog
+ * @details 每个日志文件的开头都是文件头，后面才是一条条日志。日志的编码方式有变化时要增加版本号，
+ * 版本号不同的日志文件会拒绝打开，不会按照当前的格式去解析。
+ * 版本历史：
+ * - 没有文件头：最早的格式，不再支持
+ * - 1: record 模块的更新日志只记录变化的部分，B+树日志使用变长整数编码
+ */
+struct LogFileHeader final
+{
+  int32_t magic;    /// 日志文件的魔数
+  int32_t version;  /// 日志格式的版本号
+
+  static const int32_t MAGIC;    /// 当前使用的魔数
+  static const int32_t VERSION;  /// 当前的日志格式版本号
+  static const int32_t SIZE;     /// 文件头大小
+
+  /**
+   * @brief 检查一个已经存在的日志文件的文件头
+   * @details 文件的长度不足一个文件头时，说明创建文件后还没有写完文件头，可以当作空文件
+   * @param fd 日志文件描述符
+   * @param filename 日志文件名，用于打印日志
+   * @param[out] empty 文件中是否还没有完整的文件头
+   */
+  static RC check(int fd, const char *filename, bool &empty);
+};
+
 /**
  * @brief 负责处理一个日志文件，包括读取和写入
  * @ingroup CLog
@@ -51,6 +83,7 @@ private:
 private:
   int    fd_ = -1;
   string filename_;
+  off_t  data_offset_ = 0;  /// 第一条日志在文件中的位置
 };
 
 /**
@@ -68,14 +101,32 @@ public:
    * @param filename 日志文件名
    * @param end_lsn 当前日志文件允许的最大LSN（包含）
    */
-  RC open(const char *filename, int end_lsn);
+  RC open(const char *filename, LSN end_lsn);
 
   /// @brief 关闭当前文件
   RC close();
 
-  /// @brief 写入一条日志
+  /// @brief 写入一条日志，并且等待日志刷到磁盘
   RC write(LogEntry &entry);
 
+  /**
+   * @brief 写入一批日志
+   * @details 所有日志使用一次 writev 写入文件，然后只做一次 fdatasync，返回成功时这批日志都已经持久化了。
+   * 当前文件中放不下的日志不会写入，这时返回 RC::LOG_FILE_FULL，调用者需要换一个文件继续写剩下的日志
+   * @param entries 按照LSN从小到大排列的日志
+   * @param[out] count 写入了多少条日志
+   */
+  RC write(span<LogEntry> entries, int &count);
+
+  /**
+   * @brief 写入一段已经按照文件格式排列好的日志
+   * @details 和写入一批日志一样，只做一次 fdatasync。调用者需要保证这些日志的LSN是连续的，并且都能写入当前文件
+   * @param first_lsn 第一条日志的LSN
+   * @param last_lsn 最后一条日志的LSN
+   * @param buffers 日志数据，可能分成几段。写入时会修改这些 iovec
+   */
+  RC write(LSN first_lsn, LSN last_lsn, span<struct iovec> buffers);
+
   /**
    * @brief 当前文件是否已经打开
    */
@@ -90,11 +141,18 @@ public:
 
   const char *filename() const { return filename_.c_str(); }
 
+  /// @brief 当前文件允许写入的最大的LSN
+  LSN end_lsn() const { return end_lsn_; }
+
+private:
+  /// @brief 给新的日志文件写入文件头
+  RC write_header();
+
 private:
   string filename_;       /// 日志文件名
   int    fd_       = -1;  /// 日志文件描述符
-  int    last_lsn_ = 0;   /// 写入的最后一条日志LSN
-  int    end_lsn_  = 0;   /// 当前日志文件中允许写入的最大的LSN，包括这条日志
+  LSN    last_lsn_ = 0;   /// 写入的最后一条日志LSN
+  LSN    end_lsn_  = 0;   /// 当前日志文件中允许写入的最大的LSN，包括这条日志
 };
 
 /**
@@ -137,6 +195,15 @@ public:
    */
   RC next_file(LogFileWriter &file_writer);
 
+  /**
+   * @brief 回收日志文件
+   * @details 删除所有日志都小于lsn的日志文件。最后一个日志文件可能正在写入，永远不会被删除。
+   * 检查点完成后调用，lsn就是检查点的LSN，恢复时不会再读取这些日志。
+   * @param lsn 小于这个LSN的日志都不再需要
+   * @param removed_count 删除的文件个数
+   */
+  RC recycle(LSN lsn, int &removed_count);
+
 private:
   /**
    * @brief 从文件名称中获取LSN
@@ -151,5 +218,7 @@ private:
   filesystem::path directory_;                  /// 日志文件存放的目录
   int              max_entry_number_per_file_;  /// 一个文件最大允许存放多少条日志
 
+  /// 刷日志线程会创建新文件，检查点线程会删除旧文件
+  mutex                      lock_;
   map<LSN, filesystem::path> log_files_;  /// 日志文件名和第一个LSN的映射
 };
@@ -96,6 +96,14 @@ public:
 
   virtual LSN current_lsn() const = 0;
 
+  /**
+   * @brief 回收不再需要的日志
+   * @details 做完检查点以后调用，恢复时只会从检查点开始读取日志，比检查点LSN小的日志就可以删除了。
+   * 默认什么都不做。
+   * @param lsn 检查点的LSN
+   */
+  virtual RC recycle(LSN lsn) { return RC::SUCCESS; }
+
   static RC create(const char *name, LogHandler *&handler);
 
 private:
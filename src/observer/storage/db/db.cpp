@@ -17,21 +17,37 @@ See the Mulan PSL v2 for more details. */
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include "common/conf/ini.h"
+#include "common/lang/chrono.h"
 #include "common/lang/string.h"
 #include "common/log/log.h"
 #include "common/os/path.h"
+#include "common/thread/thread_util.h"
 #include "common/global_context.h"
 #include "storage/common/meta_util.h"
 #include "storage/table/table.h"
 #include "storage/table/table_meta.h"
+#include "storage/trx/mvcc_trx.h"
 #include "storage/trx/trx.h"
 #include "storage/clog/disk_log_handler.h"
 #include "storage/clog/integrated_log_replayer.h"
 
 using namespace common;
 
+/// 配置文件中存储相关配置项所在的section
+static const char *STORAGE_SECTION = "STORAGE";
+
 Db::~Db()
 {
+  // 检查点和清理旧版本会访问buffer pool、表、事务和日志，最先停止
+  stop_vacuum_thread();
+  stop_checkpoint_thread();
+
+  // 刷脏页需要写日志，也会用到表的文件，所以要最先停止
+  if (buffer_pool_manager_) {
+    buffer_pool_manager_->page_cleaner().stop();
+  }
+
   for (auto &iter : opened_tables_) {
     delete iter.second;
   }
@@ -82,10 +98,27 @@ RC Db::init(const char *name, const char *dbpath, const char *trx_kit_name, cons
 
   trx_kit_.reset(trx_kit);
 
+  const string lock_wait_timeout = get_properties()->get(
+      "LOCK_WAIT_TIMEOUT_MS", std::to_string(MvccTrxKit::DEFAULT_LOCK_WAIT_TIMEOUT_MS), STORAGE_SECTION);
+  trx_kit_->set_lock_wait_timeout(atoi(lock_wait_timeout.c_str()));
+
+  const string group_commit_delay = get_properties()->get("GROUP_COMMIT_DELAY_US", "0", STORAGE_SECTION);
+  trx_kit_->set_group_commit_delay(atoi(group_commit_delay.c_str()));
+
   storage_engine_ = storage_engine;
 
-  buffer_pool_manager_ = make_unique<BufferPoolManager>();
-  auto dblwr_buffer    = make_unique<DiskDoubleWriteBuffer>(*buffer_pool_manager_);
+  const string frame_replacer  = get_properties()->get("BUFFER_POOL_REPLACER", "lru", STORAGE_SECTION);
+  const string frame_allocator = get_properties()->get("BUFFER_POOL_ALLOCATOR", "simple", STORAGE_SECTION);
+  buffer_pool_manager_ =
+      make_unique<BufferPoolManager>(0 /*memory_size*/, frame_replacer.c_str(), frame_allocator.c_str());
+
+  const string read_ahead_pages = get_properties()->get(
+      "READ_AHEAD_PAGES", std::to_string(BufferPoolManager::DEFAULT_READ_AHEAD_PAGES), STORAGE_SECTION);
+  buffer_pool_manager_->set_read_ahead_pages(atoi(read_ahead_pages.c_str()));
+
+  const string dblwr_batch_pages = get_properties()->get(
+      "DOUBLE_WRITE_BATCH_PAGES", std::to_string(DiskDoubleWriteBuffer::DEFAULT_BATCH_PAGES), STORAGE_SECTION);
+  auto dblwr_buffer = make_unique<DiskDoubleWriteBuffer>(*buffer_pool_manager_, atoi(dblwr_batch_pages.c_str()));
 
   const char      *double_write_buffer_filename  = "dblwr.db";
   filesystem::path double_write_buffer_file_path = filesystem::path(dbpath) / double_write_buffer_filename;
@@ -96,12 +129,48 @@ RC Db::init(const char *name, const char *dbpath, const char *trx_kit_name, cons
     return rc;
   }
 
-  rc = buffer_pool_manager_->init(std::move(dblwr_buffer));
+  unique_ptr<AsyncIo> async_io;
+  const string        io_engine      = get_properties()->get("IO_ENGINE", "posix", STORAGE_SECTION);
+  const int           io_queue_depth = atoi(get_properties()->get("IO_QUEUE_DEPTH", "0", STORAGE_SECTION).c_str());
+  rc                                 = AsyncIo::create(io_engine.c_str(), io_queue_depth, async_io);
+  if (OB_FAIL(rc)) {
+    LOG_ERROR("Failed to create io engine. name=%s, rc=%s", io_engine.c_str(), strrc(rc));
+    return rc;
+  }
+
+  rc = buffer_pool_manager_->init(std::move(dblwr_buffer), std::move(async_io));
   if (OB_FAIL(rc)) {
     LOG_ERROR("Failed to init buffer pool manager. dbpath=%s, rc=%s", dbpath, strrc(rc));
     return rc;
   }
 
+  auto get_int_property = [](const char *key, int default_value) {
+    return atoi(get_properties()->get(key, std::to_string(default_value), STORAGE_SECTION).c_str());
+  };
+  rc = buffer_pool_manager_->page_cleaner().init(
+      get_int_property("PAGE_CLEANER_INTERVAL_MS", PageCleaner::DEFAULT_INTERVAL_MS),
+      get_int_property("DIRTY_PAGE_LOW_WATERMARK", PageCleaner::DEFAULT_LOW_WATERMARK),
+      get_int_property("DIRTY_PAGE_HIGH_WATERMARK", PageCleaner::DEFAULT_HIGH_WATERMARK),
+      get_int_property("PAGE_CLEANER_BATCH_SIZE", PageCleaner::DEFAULT_BATCH_SIZE));
+  if (OB_FAIL(rc)) {
+    LOG_ERROR("Failed to init page cleaner. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  index_build_options_.fill_factor =
+      get_int_property("INDEX_FILL_FACTOR", BplusTreeBulkLoadOptions::DEFAULT_FILL_FACTOR);
+  index_build_options_.thread_num =
+      get_int_property("INDEX_BUILD_THREADS", BplusTreeBulkLoadOptions::DEFAULT_THREAD_NUM);
+  // 按MB配置，换算成字节时使用64位整数，避免溢出
+  const int     default_sort_buffer_mb = BplusTreeBulkLoadOptions::DEFAULT_SORT_BUFFER_SIZE / (1024 * 1024);
+  const int64_t min_sort_buffer_mb     = BplusTreeBulkLoadOptions::MIN_SORT_BUFFER_SIZE / (1024 * 1024);
+  int64_t       sort_buffer_mb         = get_int_property("INDEX_BUILD_SORT_BUFFER_MB", default_sort_buffer_mb);
+  if (sort_buffer_mb < min_sort_buffer_mb) {
+    LOG_WARN("INDEX_BUILD_SORT_BUFFER_MB is too small. value=%ld, use %ld instead", sort_buffer_mb, min_sort_buffer_mb);
+    sort_buffer_mb = min_sort_buffer_mb;
+  }
+  index_build_options_.sort_buffer_size = sort_buffer_mb * 1024 * 1024;
+
   filesystem::path clog_path       = filesystem::path(dbpath) / "clog";
   LogHandler      *tmp_log_handler = nullptr;
   rc                               = LogHandler::create(log_handler_name, tmp_log_handler);
@@ -148,6 +217,25 @@ RC Db::init(const char *name, const char *dbpath, const char *trx_kit_name, cons
     return rc;
   }
 
+  // 刷脏页时需要日志模块已经启动，所以在恢复之后再启动
+  rc = buffer_pool_manager_->page_cleaner().start();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to start page cleaner. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  rc = start_checkpoint_thread(get_int_property("CHECKPOINT_INTERVAL_MS", DEFAULT_CHECKPOINT_INTERVAL_MS));
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to start checkpoint thread. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  rc = start_vacuum_thread(get_int_property("VACUUM_INTERVAL_MS", DEFAULT_VACUUM_INTERVAL_MS));
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to start vacuum thread. rc=%s", strrc(rc));
+    return rc;
+  }
+
   return rc;
 }
 
@@ -180,7 +268,10 @@ RC Db::create_table(const char *table_name, span<const AttrInfoSqlNode> attribut
     return rc;
   }
 
-  opened_tables_[table_name] = table;
+  {
+    lock_guard guard(tables_lock_);
+    opened_tables_[table_name] = table;
+  }
   LOG_INFO("Create table success. table name=%s, table_id:%d", table_name, table_id);
   return RC::SUCCESS;
 }
@@ -254,6 +345,8 @@ void Db::all_tables(vector<string> &table_names) const
 
 RC Db::sync()
 {
+  lock_guard<mutex> guard(checkpoint_lock_);
+
   RC rc = RC::SUCCESS;
   // 调用所有表的sync函数刷新数据到磁盘
   for (const auto &table_pair : opened_tables_) {
@@ -281,28 +374,232 @@ RC Db::sync()
     return rc;
   }
 
-  check_point_lsn_ = current_lsn;
-  rc               = flush_meta();
+  rc = write_checkpoint(current_lsn);
   if (OB_FAIL(rc)) {
-    LOG_ERROR("Failed to flush meta. db=%s, rc=%d:%s", name_.c_str(), rc, strrc(rc));
     return rc;
   }
   LOG_INFO("Successfully sync db. db=%s", name_.c_str());
   return rc;
 }
 
+RC Db::checkpoint()
+{
+  lock_guard<mutex> guard(checkpoint_lock_);
+
+  // 先记下当前的LSN，下一轮检查点不会超过它
+  const LSN round_lsn = log_handler_->current_lsn();
+
+  LSN  checkpoint_lsn = last_round_lsn_ + 1;
+  auto bound_by       = [&checkpoint_lsn](LSN lsn) {
+    if (lsn != 0 && lsn < checkpoint_lsn) {
+      checkpoint_lsn = lsn;
+    }
+  };
+  bound_by(buffer_pool_manager_->get_frame_manager().min_rec_lsn());
+  bound_by(trx_kit_->min_active_lsn());
+  last_round_lsn_ = round_lsn;
+
+  if (checkpoint_lsn <= check_point_lsn_) {
+    LOG_TRACE("checkpoint lsn does not advance. db=%s, checkpoint lsn=%ld", name_.c_str(), check_point_lsn_);
+    return RC::SUCCESS;
+  }
+
+  // 刷脏页时页面先放到 double write buffer 的内存中就被标记为干净的了，要让它们落盘后才能推进检查点
+  auto dblwr_buffer = static_cast<DiskDoubleWriteBuffer *>(buffer_pool_manager_->get_dblwr_buffer());
+  RC   rc           = dblwr_buffer->flush_page();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to flush double write buffer. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  // 检查点之前的日志要落盘，重启后LSN才能从检查点之后接着分配
+  rc = log_handler_->wait_lsn(checkpoint_lsn - 1);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to wait lsn. lsn=%ld, rc=%s", checkpoint_lsn - 1, strrc(rc));
+    return rc;
+  }
+
+  return write_checkpoint(checkpoint_lsn);
+}
+
+RC Db::write_checkpoint(LSN checkpoint_lsn)
+{
+  check_point_lsn_    = checkpoint_lsn;
+  check_point_trx_id_ = trx_kit_->current_trx_id();
+  RC rc               = flush_meta();
+  if (OB_FAIL(rc)) {
+    LOG_ERROR("Failed to flush meta. db=%s, rc=%d:%s", name_.c_str(), rc, strrc(rc));
+    return rc;
+  }
+
+  // 回收失败不影响检查点，下一次检查点会再次尝试
+  (void)log_handler_->recycle(checkpoint_lsn);
+  LOG_DEBUG("checkpoint done. db=%s, checkpoint lsn=%ld", name_.c_str(), checkpoint_lsn);
+  return RC::SUCCESS;
+}
+
+RC Db::start_checkpoint_thread(int interval_ms)
+{
+  last_round_lsn_ = log_handler_->current_lsn();
+  if (interval_ms <= 0) {
+    LOG_INFO("checkpoint thread is disabled");
+    return RC::SUCCESS;
+  }
+
+#ifdef CONCURRENCY
+  checkpoint_running_ = true;
+  checkpoint_thread_  = make_unique<thread>(&Db::checkpoint_thread_func, this, interval_ms);
+  LOG_INFO("checkpoint thread started. interval=%dms", interval_ms);
+#else
+  // 非并发编译时事务和double write buffer都没有加锁，只在sync时做检查点
+  LOG_INFO("checkpoint thread is disabled as CONCURRENCY is off");
+#endif
+  return RC::SUCCESS;
+}
+
+void Db::stop_checkpoint_thread()
+{
+  if (!checkpoint_thread_) {
+    return;
+  }
+
+  {
+    lock_guard<mutex> guard(checkpoint_thread_lock_);
+    checkpoint_running_ = false;
+  }
+  checkpoint_cv_.notify_one();
+  checkpoint_thread_->join();
+  checkpoint_thread_.reset();
+  LOG_INFO("checkpoint thread stopped");
+}
+
+void Db::checkpoint_thread_func(int interval_ms)
+{
+  thread_set_name("Checkpoint");
+  while (true) {
+    {
+      unique_lock<mutex> guard(checkpoint_thread_lock_);
+      checkpoint_cv_.wait_for(guard, chrono::milliseconds(interval_ms), [this]() { return !checkpoint_running_; });
+      if (!checkpoint_running_) {
+        break;
+      }
+    }
+
+    RC rc = checkpoint();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to do checkpoint. db=%s, rc=%s", name_.c_str(), strrc(rc));
+    }
+  }
+}
+
+RC Db::vacuum(int &purged_count)
+{
+  lock_guard vacuum_guard(vacuum_lock_);
+
+  vector<Table *> tables;
+  {
+    lock_guard guard(tables_lock_);
+    for (const auto &iter : opened_tables_) {
+      tables.push_back(iter.second);
+    }
+  }
+
+  purged_count = 0;
+  for (Table *table : tables) {
+    int table_purged_count = 0;
+    RC  rc                 = trx_kit_->vacuum(table, table_purged_count);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to vacuum table. db=%s, table=%s, rc=%s", name_.c_str(), table->name(), strrc(rc));
+      return rc;
+    }
+    purged_count += table_purged_count;
+  }
+
+  if (purged_count > 0) {
+    LOG_INFO("vacuum done. db=%s, purged records=%d", name_.c_str(), purged_count);
+  }
+  return RC::SUCCESS;
+}
+
+RC Db::start_vacuum_thread(int interval_ms)
+{
+  if (interval_ms <= 0) {
+    LOG_INFO("vacuum thread is disabled");
+    return RC::SUCCESS;
+  }
+
+#ifdef CONCURRENCY
+  vacuum_running_ = true;
+  vacuum_thread_  = make_unique<thread>(&Db::vacuum_thread_func, this, interval_ms);
+  LOG_INFO("vacuum thread started. interval=%dms", interval_ms);
+#else
+  // 非并发编译时页面锁不起作用，后台线程不能和前台同时访问表
+  LOG_INFO("vacuum thread is disabled as CONCURRENCY is off");
+#endif
+  return RC::SUCCESS;
+}
+
+void Db::stop_vacuum_thread()
+{
+  if (!vacuum_thread_) {
+    return;
+  }
+
+  {
+    lock_guard<mutex> guard(vacuum_thread_lock_);
+    vacuum_running_ = false;
+  }
+  vacuum_cv_.notify_one();
+  vacuum_thread_->join();
+  vacuum_thread_.reset();
+  LOG_INFO("vacuum thread stopped");
+}
+
+void Db::vacuum_thread_func(int interval_ms)
+{
+  thread_set_name("Vacuum");
+  while (true) {
+    {
+      unique_lock<mutex> guard(vacuum_thread_lock_);
+      vacuum_cv_.wait_for(guard, chrono::milliseconds(interval_ms), [this]() { return !vacuum_running_; });
+      if (!vacuum_running_) {
+        break;
+      }
+    }
+
+    int purged_count = 0;
+    RC  rc           = vacuum(purged_count);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to vacuum. db=%s, rc=%s", name_.c_str(), strrc(rc));
+    }
+  }
+}
+
 RC Db::recover()
 {
   LOG_TRACE("db recover begin. check_point_lsn=%d", check_point_lsn_);
 
+  // 检查点之前的日志可能已经回收了，它们的事务号只能从元数据中恢复
+  trx_kit_->advance_trx_id(check_point_trx_id_);
+
   LogReplayer *trx_log_replayer = trx_kit_->create_log_replayer(*this, *log_handler_);
   if (trx_log_replayer == nullptr) {
     LOG_ERROR("Failed to create trx log replayer.");
     return RC::INTERNAL;
   }
 
-  IntegratedLogReplayer log_replayer(*buffer_pool_manager_, unique_ptr<LogReplayer>(trx_log_replayer));
-  RC                    rc = log_handler_->replay(log_replayer, check_point_lsn_ /*start_lsn*/);
+  const int redo_thread_num = atoi(get_properties()->get("REDO_THREAD_NUM",
+      std::to_string(IntegratedLogReplayer::DEFAULT_REDO_THREAD_NUM), STORAGE_SECTION).c_str());
+  IntegratedLogReplayer log_replayer(
+      *buffer_pool_manager_, unique_ptr<LogReplayer>(trx_log_replayer), redo_thread_num);
+
+  auto now_ms = []() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+  };
+
+  int64_t begin_ms  = now_ms();
+  RC      rc        = log_handler_->replay(log_replayer, check_point_lsn_ /*start_lsn*/);
+  int64_t replay_ms = now_ms() - begin_ms;
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to replay log. rc=%s", strrc(rc));
     return rc;
@@ -314,13 +611,17 @@ RC Db::recover()
     return rc;
   }
 
-  rc = log_replayer.on_done();
+  begin_ms        = now_ms();
+  rc              = log_replayer.on_done();
+  int64_t done_ms = now_ms() - begin_ms;
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to on_done. rc=%s", strrc(rc));
     return rc;
   }
 
-  LOG_INFO("Successfully recover db. db=%s checkpoint_lsn=%d", name_.c_str(), check_point_lsn_);
+  // 并行回放时，最后一批日志在 on_done 中回放，各个阶段的耗时由 IntegratedLogReplayer 打印
+  LOG_INFO("Successfully recover db. db=%s checkpoint_lsn=%d, read and replay logs=%ldms, finish replay=%ldms",
+           name_.c_str(), check_point_lsn_, replay_ms, done_ms);
   return rc;
 }
 
@@ -328,7 +629,8 @@ RC Db::init_meta()
 {
   filesystem::path db_meta_file_path = db_meta_file(path_.c_str(), name_.c_str());
   if (!filesystem::exists(db_meta_file_path)) {
-    check_point_lsn_ = 0;
+    check_point_lsn_    = 0;
+    check_point_trx_id_ = 0;
     LOG_INFO("Db meta file not exist. db=%s, file=%s", name_.c_str(), db_meta_file_path.c_str());
     return RC::SUCCESS;
   }
@@ -354,10 +656,13 @@ RC Db::init_meta()
       return RC::IOERR_TOO_LONG;
     }
 
-    buffer[n]        = '\0';
-    check_point_lsn_ = atoll(buffer);  // 当前元数据就这一个数字
-    LOG_INFO("Successfully read db meta file. db=%s, file=%s, check_point_lsn=%ld", 
-             name_.c_str(), db_meta_file_path.c_str(), check_point_lsn_);
+    // 元数据是检查点LSN和当时的最大事务号，旧的元数据中只有检查点LSN
+    buffer[n]           = '\0';
+    char *end           = nullptr;
+    check_point_lsn_    = strtoll(buffer, &end, 10);
+    check_point_trx_id_ = static_cast<int32_t>(strtol(end, nullptr, 10));
+    LOG_INFO("Successfully read db meta file. db=%s, file=%s, check_point_lsn=%ld, check_point_trx_id=%d", 
+             name_.c_str(), db_meta_file_path.c_str(), check_point_lsn_, check_point_trx_id_);
   }
   close(fd);
 
@@ -382,8 +687,11 @@ RC Db::flush_meta()
     return RC::IOERR_WRITE;
   }
 
-  string buffer = to_string(check_point_lsn_);
+  string buffer = to_string(check_point_lsn_) + " " + to_string(check_point_trx_id_);
   int    n      = write(fd, buffer.c_str(), buffer.size());
+  // 检查点之前的日志文件会被删除，元数据必须先落盘
+  const int sync_ret = (n < 0) ? 0 : fsync(fd);
+  close(fd);
   if (n < 0) {
     LOG_ERROR("Failed to write db meta file. db=%s, file=%s, errno=%s", 
               name_.c_str(), temp_meta_file_path.c_str(), strerror(errno));
@@ -392,6 +700,10 @@ RC Db::flush_meta()
     LOG_ERROR("Failed to write db meta file. db=%s, file=%s, buffer size=%ld, write size=%d", 
               name_.c_str(), temp_meta_file_path.c_str(), buffer.size(), n);
     rc = RC::IOERR_WRITE;
+  } else if (sync_ret != 0) {
+    LOG_ERROR("Failed to sync db meta file. db=%s, file=%s, errno=%s",
+              name_.c_str(), temp_meta_file_path.c_str(), strerror(errno));
+    rc = RC::IOERR_SYNC;
   } else {
     error_code ec;
     filesystem::rename(temp_meta_file_path, meta_file_path, ec);
@@ -401,8 +713,8 @@ RC Db::flush_meta()
       rc = RC::IOERR_WRITE;
     } else {
 
-      LOG_INFO("Successfully write db meta file. db=%s, file=%s, check_point_lsn=%ld", 
-               name_.c_str(), temp_meta_file_path.c_str(), check_point_lsn_);
+      LOG_INFO("Successfully write db meta file. db=%s, file=%s, check_point_lsn=%ld, check_point_trx_id=%d", 
+               name_.c_str(), temp_meta_file_path.c_str(), check_point_lsn_, check_point_trx_id_);
     }
   }
 
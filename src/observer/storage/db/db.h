@@ -20,10 +20,14 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/unordered_map.h"
 #include "common/lang/memory.h"
 #include "common/lang/span.h"
+#include "common/lang/mutex.h"
+#include "common/lang/thread.h"
+#include "common/lang/condition_variable.h"
 #include "sql/parser/parse_defs.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/clog/disk_log_handler.h"
 #include "storage/buffer/double_write_buffer.h"
+#include "storage/index/bplus_tree_bulk_loader.h"
 #include "oblsm/include/ob_lsm.h"
 
 class Table;
@@ -44,6 +48,10 @@ class TrxKit;
  */
 class Db
 {
+public:
+  static constexpr int DEFAULT_CHECKPOINT_INTERVAL_MS = 10000;
+  static constexpr int DEFAULT_VACUUM_INTERVAL_MS     = 5000;
+
 public:
   Db() = default;
   ~Db();
@@ -91,6 +99,25 @@ public:
    */
   RC sync();
 
+  /**
+   * @brief 做一次模糊检查点(fuzzy checkpoint)
+   * @details 不需要停止事务，也不需要刷新所有脏页。检查点的LSN取下面几个值中最小的一个：
+   * 所有脏页的recLSN、所有活跃事务的第一条日志、上一轮检查点开始时的LSN加1。
+   * 恢复时从检查点LSN开始回放，比它小的日志文件会被回收。
+   * 后台线程会周期性地调用这个函数。
+   */
+  RC checkpoint();
+
+  /// @brief 最近一次检查点的LSN，恢复时从这里开始回放日志
+  LSN check_point_lsn() const { return check_point_lsn_; }
+
+  /**
+   * @brief 清理所有表中已经没有事务能看到的旧版本记录
+   * @details 由事务管理器判断哪些版本可以清理。后台线程会周期性地调用这个函数
+   * @param purged_count 返回清理掉的记录数
+   */
+  RC vacuum(int &purged_count);
+
   /// @brief 获取当前数据库的日志处理器
   LogHandler &log_handler();
 
@@ -100,6 +127,9 @@ public:
   /// @brief 获取当前数据库的事务管理器
   TrxKit &trx_kit();
 
+  /// @brief 在已有数据的表上创建索引时使用的参数
+  const BplusTreeBulkLoadOptions &index_build_options() const { return index_build_options_; }
+
   string path() const { return path_; }
 
   oceanbase::ObLsm *lsm() { return lsm_; }
@@ -118,6 +148,19 @@ private:
   /// @brief 初始化数据库的double buffer pool
   RC init_dblwr_buffer();
 
+  /// @brief 记录新的检查点LSN并回收之前的日志文件。调用者需要持有checkpoint_lock_
+  RC write_checkpoint(LSN checkpoint_lsn);
+
+  /// @brief 启动和停止周期性做检查点的后台线程
+  RC   start_checkpoint_thread(int interval_ms);
+  void stop_checkpoint_thread();
+  void checkpoint_thread_func(int interval_ms);
+
+  /// @brief 启动和停止周期性清理旧版本的后台线程
+  RC   start_vacuum_thread(int interval_ms);
+  void stop_vacuum_thread();
+  void vacuum_thread_func(int interval_ms);
+
   StorageEngine get_storage_engine()
   {
     StorageEngine engine = StorageEngine::UNKNOWN_ENGINE;
@@ -137,6 +180,7 @@ private:
   string                         name_;                 ///< 数据库名称
   string                         path_;                 ///< 数据库文件存放的目录
   unordered_map<string, Table *> opened_tables_;        ///< 当前所有打开的表
+  mutex                          tables_lock_;          ///< 后台线程遍历表时，保护 opened_tables_
   unique_ptr<BufferPoolManager>  buffer_pool_manager_;  ///< 当前数据库的buffer pool管理器
   unique_ptr<LogHandler>         log_handler_;          ///< 当前数据库的日志处理器
   unique_ptr<TrxKit>             trx_kit_;              ///< 当前数据库的事务管理器
@@ -145,6 +189,25 @@ private:
   /// 给每个table都分配一个ID，用来记录日志。这里假设所有的DDL都不会并发操作，所以相关的数据都不上锁
   int32_t next_table_id_ = 0;
 
-  LSN    check_point_lsn_ = 0;  ///< 当前数据库的检查点LSN。会记录到磁盘中。
-  string storage_engine_;
+  LSN     check_point_lsn_    = 0;  ///< 当前数据库的检查点LSN。会记录到磁盘中。
+  int32_t check_point_trx_id_ = 0;  ///< 检查点时已经分配的最大事务号，和检查点LSN一起记录到磁盘中
+  string  storage_engine_;
+
+  BplusTreeBulkLoadOptions index_build_options_;  ///< 创建索引时批量构建B+树的参数
+
+  /// 上一轮检查点开始时的LSN。日志写入和设置页面LSN不是原子的，刚写完日志的页面可能还没有记录
+  /// recLSN，所以检查点不能超过上一轮开始时的LSN，这中间隔了一个周期，这些页面一定已经记录好了
+  LSN last_round_lsn_ = 0;
+
+  mutex              checkpoint_lock_;  ///< 检查点和sync不能同时执行
+  unique_ptr<thread> checkpoint_thread_;
+  mutex              checkpoint_thread_lock_;
+  condition_variable checkpoint_cv_;
+  bool               checkpoint_running_ = false;
+
+  mutex              vacuum_lock_;  ///< 同一时间只做一次清理
+  unique_ptr<thread> vacuum_thread_;
+  mutex              vacuum_thread_lock_;
+  condition_variable vacuum_cv_;
+  bool               vacuum_running_ = false;
 };
@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 //
 
 #include "storage/index/bplus_tree.h"
+#include "common/lang/atomic.h"
 #include "common/lang/lower_bound.h"
 #include "common/log/log.h"
 #include "common/global_context.h"
@@ -150,6 +151,9 @@ bool IndexNodeHandler::validate() const
       LOG_WARN("root page internal node has less than 2 child. size=%d", size());
       return false;
     }
+  } else if (size() < min_size()) {
+    LOG_WARN("page has less than min size items. page num=%d, size=%d, min size=%d", page_num(), size(), min_size());
+    return false;
   }
   return true;
 }
@@ -791,6 +795,30 @@ RC BplusTreeHandler::sync()
 
 RC BplusTreeHandler::create(LogHandler &log_handler, BufferPoolManager &bpm, const char *file_name, AttrType attr_type,
     int attr_length, int internal_max_size /* = -1*/, int leaf_max_size /* = -1 */)
+{
+  return this->create(log_handler,
+      bpm,
+      file_name,
+      span<const AttrType>(&attr_type, 1),
+      span<const int32_t>(&attr_length, 1),
+      internal_max_size,
+      leaf_max_size);
+}
+
+RC BplusTreeHandler::create(LogHandler &log_handler, DiskBufferPool &buffer_pool, AttrType attr_type, int attr_length,
+    int internal_max_size /* = -1 */, int leaf_max_size /* = -1 */)
+{
+  return this->create(log_handler,
+      buffer_pool,
+      span<const AttrType>(&attr_type, 1),
+      span<const int32_t>(&attr_length, 1),
+      internal_max_size,
+      leaf_max_size);
+}
+
+RC BplusTreeHandler::create(LogHandler &log_handler, BufferPoolManager &bpm, const char *file_name,
+    span<const AttrType> attr_types, span<const int32_t> attr_lengths, int internal_max_size /* = -1*/,
+    int leaf_max_size /* = -1 */)
 {
   RC rc = bpm.create_file(file_name);
   if (OB_FAIL(rc)) {
@@ -808,7 +836,7 @@ RC BplusTreeHandler::create(LogHandler &log_handler, BufferPoolManager &bpm, con
   }
   LOG_INFO("Successfully open index file %s.", file_name);
 
-  rc = this->create(log_handler, *bp, attr_type, attr_length, internal_max_size, leaf_max_size);
+  rc = this->create(log_handler, *bp, attr_types, attr_lengths, internal_max_size, leaf_max_size);
   if (OB_FAIL(rc)) {
     bpm.close_file(file_name);
     return rc;
@@ -818,9 +846,21 @@ RC BplusTreeHandler::create(LogHandler &log_handler, BufferPoolManager &bpm, con
   return rc;
 }
 
-RC BplusTreeHandler::create(LogHandler &log_handler, DiskBufferPool &buffer_pool, AttrType attr_type, int attr_length,
-    int internal_max_size /* = -1 */, int leaf_max_size /* = -1 */)
+RC BplusTreeHandler::create(LogHandler &log_handler, DiskBufferPool &buffer_pool, span<const AttrType> attr_types,
+    span<const int32_t> attr_lengths, int internal_max_size /* = -1 */, int leaf_max_size /* = -1 */)
 {
+  if (attr_types.empty() || attr_types.size() != attr_lengths.size() ||
+      attr_types.size() > static_cast<size_t>(IndexFileHeader::MAX_ATTR_NUM)) {
+    LOG_WARN("invalid attributes of b+tree key. attr num=%d, max attr num=%d",
+             static_cast<int>(attr_types.size()), IndexFileHeader::MAX_ATTR_NUM);
+    return RC::INVALID_ARGUMENT;
+  }
+
+  int attr_length = 0;
+  for (int32_t length : attr_lengths) {
+    attr_length += length;
+  }
+
   if (internal_max_size < 0) {
     internal_max_size = calc_internal_page_capacity(attr_length);
   }
@@ -853,7 +893,12 @@ RC BplusTreeHandler::create(LogHandler &log_handler, DiskBufferPool &buffer_pool
   IndexFileHeader *file_header   = (IndexFileHeader *)pdata;
   file_header->attr_length       = attr_length;
   file_header->key_length        = attr_length + sizeof(RID);
-  file_header->attr_type         = attr_type;
+  file_header->attr_type         = attr_types[0];
+  file_header->attr_num          = static_cast<int32_t>(attr_types.size());
+  for (int i = 0; i < file_header->attr_num; i++) {
+    file_header->attr_types[i]   = attr_types[i];
+    file_header->attr_lengths[i] = attr_lengths[i];
+  }
   file_header->internal_max_size = internal_max_size;
   file_header->leaf_max_size     = leaf_max_size;
   file_header->root_page         = BP_INVALID_PAGE_NUM;
@@ -873,8 +918,8 @@ RC BplusTreeHandler::create(LogHandler &log_handler, DiskBufferPool &buffer_pool
     return RC::NOMEM;
   }
 
-  key_comparator_.init(file_header->attr_type, file_header->attr_length);
-  key_printer_.init(file_header->attr_type, file_header->attr_length);
+  key_comparator_.init(file_header->attr_type_list(), file_header->attr_length_list());
+  key_printer_.init(file_header->attr_type_list(), file_header->attr_length_list());
 
   /*
   虽然我们针对B+树记录了WAL，但是我们记录的都是逻辑日志，并没有记录某个页面如何修改的物理日志。
@@ -931,6 +976,7 @@ RC BplusTreeHandler::open(LogHandler &log_handler, DiskBufferPool &buffer_pool)
 
   char *pdata = frame->data();
   memcpy(&file_header_, pdata, sizeof(IndexFileHeader));
+  file_header_.fix_attr_list();
   header_dirty_     = false;
   disk_buffer_pool_ = &buffer_pool;
   log_handler_      = &log_handler;
@@ -945,8 +991,8 @@ RC BplusTreeHandler::open(LogHandler &log_handler, DiskBufferPool &buffer_pool)
   // close old page_handle
   buffer_pool.unpin_page(frame);
 
-  key_comparator_.init(file_header_.attr_type, file_header_.attr_length);
-  key_printer_.init(file_header_.attr_type, file_header_.attr_length);
+  key_comparator_.init(file_header_.attr_type_list(), file_header_.attr_length_list());
+  key_printer_.init(file_header_.attr_type_list(), file_header_.attr_length_list());
   LOG_INFO("Successfully open index");
   return RC::SUCCESS;
 }
@@ -1174,8 +1220,14 @@ bool BplusTreeHandler::is_empty() const { return file_header_.root_page == BP_IN
 
 RC BplusTreeHandler::find_leaf(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op, const char *key, Frame *&frame)
 {
-  auto child_page_getter = [this, key](InternalIndexNodeHandler &internal_node) {
-    return internal_node.value_at(internal_node.lookup(key_comparator_, key));
+  return find_leaf(mtr, op, key_comparator_, key, frame);
+}
+
+RC BplusTreeHandler::find_leaf(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op,
+    const KeyComparator &comparator, const char *key, Frame *&frame)
+{
+  auto child_page_getter = [&comparator, key](InternalIndexNodeHandler &internal_node) {
+    return internal_node.value_at(internal_node.lookup(comparator, key));
   };
   return find_leaf_internal(mtr, op, child_page_getter, frame);
 }
@@ -1189,6 +1241,18 @@ RC BplusTreeHandler::left_most_page(BplusTreeMiniTransaction &mtr, Frame *&frame
 RC BplusTreeHandler::find_leaf_internal(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op,
     const function<PageNum(InternalIndexNodeHandler &)> &child_page_getter, Frame *&frame)
 {
+  if (optimistic_latch_) {
+    for (int i = 0; i < OPTIMISTIC_RETRY_TIMES; i++) {
+      RC rc = optimistic_find_leaf(mtr, op, child_page_getter, frame);
+      if (rc == RC::LOCKED_NEED_WAIT) {
+        break;
+      }
+      if (rc != RC::LOCKED_CONCURRENCY_CONFLICT) {
+        return rc;
+      }
+    }
+  }
+
   LatchMemo &latch_memo = mtr.latch_memo();
 
   // root locked
@@ -1224,6 +1288,93 @@ RC BplusTreeHandler::find_leaf_internal(BplusTreeMiniTransaction &mtr, BplusTree
   return RC::SUCCESS;
 }
 
+PageNum BplusTreeHandler::root_page_num() const
+{
+  // 修改根节点时加着 root_lock_，这里不加锁读取，所以使用原子操作
+  return std::atomic_ref<PageNum>(const_cast<PageNum &>(file_header_.root_page)).load(std::memory_order_acquire);
+}
+
+RC BplusTreeHandler::optimistic_find_leaf(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op,
+    const function<PageNum(InternalIndexNodeHandler &)> &child_page_getter, Frame *&frame)
+{
+  LatchMemo &latch_memo = mtr.latch_memo();
+
+  // 放弃这次查找，释放所有的页面。查找叶子节点时 mtr 中还没有其它页面
+  auto give_up = [&latch_memo](RC rc) {
+    latch_memo.release_to(latch_memo.memo_point());
+    return rc;
+  };
+
+  const PageNum root_page = root_page_num();
+  if (root_page == BP_INVALID_PAGE_NUM) {
+    return RC::EMPTY;
+  }
+
+  // 页面号可能已经过期，页面已经被释放了，这时候获取页面失败也只是重试
+  RC rc = latch_memo.get_page(root_page, frame);
+  if (OB_FAIL(rc)) {
+    return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+  }
+
+  // 根节点分裂或者被替换时都加着写锁，所以先取版本号，再确认它还是根节点
+  uint64_t version = frame->latch_version();
+  if ((version & 1) != 0 || root_page_num() != root_page) {
+    return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+  }
+
+  while (!reinterpret_cast<const IndexNode *>(frame->data())->is_leaf) {
+    InternalIndexNodeHandler internal_node(mtr, file_header_, frame);
+
+    // 没有校验过的内容可能是不一致的，不能让查找越过页面的边界
+    const int size = internal_node.size();
+    if (size <= 0 || size > internal_node.max_size()) {
+      return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+    }
+
+    const PageNum child_page = child_page_getter(internal_node);
+    if (!frame->check_latch_version(version)) {
+      return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+    }
+
+    const int memo_point  = latch_memo.memo_point();
+    Frame    *child_frame = nullptr;
+    rc                    = latch_memo.get_page(child_page, child_frame);
+    if (OB_FAIL(rc)) {
+      return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+    }
+
+    // 孩子节点分裂或合并时，一定也加着父节点的写锁，所以取到孩子的版本号以后父节点还没有变化，
+    // 这个版本的孩子节点就是正确的
+    const uint64_t child_version = child_frame->latch_version();
+    if ((child_version & 1) != 0 || !frame->check_latch_version(version)) {
+      return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+    }
+
+    latch_memo.release_to(memo_point);
+    frame   = child_frame;
+    version = child_version;
+  }
+
+  const bool readonly = (op == BplusTreeOperationType::READ);
+  latch_memo.latch(frame, readonly ? LatchMemoType::SHARED : LatchMemoType::EXCLUSIVE);
+
+  // 加写锁时版本号会加1
+  if (frame->latch_version() != (readonly ? version : version + 1)) {
+    return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+  }
+
+  IndexNodeHandler leaf_node(mtr, file_header_, frame);
+  if (!leaf_node.is_leaf()) {
+    return give_up(RC::LOCKED_CONCURRENCY_CONFLICT);
+  }
+
+  // 上面的节点都没有加锁，叶子节点不能分裂也不能合并
+  if (!leaf_node.is_safe(op, frame->page_num() == root_page)) {
+    return give_up(RC::LOCKED_NEED_WAIT);
+  }
+  return RC::SUCCESS;
+}
+
 RC BplusTreeHandler::crabing_protocal_fetch_page(
     BplusTreeMiniTransaction &mtr, BplusTreeOperationType op, PageNum page_num, bool is_root_node, Frame *&frame)
 {
@@ -1423,12 +1574,13 @@ RC BplusTreeHandler::recover_init_header_page(
 {
   IndexFileHeader *file_header = reinterpret_cast<IndexFileHeader *>(frame->data());
   memcpy(file_header, &header, sizeof(IndexFileHeader));
-  file_header_  = header;
+  file_header_ = header;
+  file_header_.fix_attr_list();
   header_dirty_ = false;
   frame->mark_dirty();
 
-  key_comparator_.init(file_header_.attr_type, file_header_.attr_length);
-  key_printer_.init(file_header_.attr_type, file_header_.attr_length);
+  key_comparator_.init(file_header_.attr_type_list(), file_header_.attr_length_list());
+  key_printer_.init(file_header_.attr_type_list(), file_header_.attr_length_list());
 
   return RC::SUCCESS;
 }
@@ -1441,7 +1593,7 @@ void BplusTreeHandler::update_root_page_num_locked(BplusTreeMiniTransaction &mtr
   IndexFileHeader *file_header = reinterpret_cast<IndexFileHeader *>(frame->data());
   mtr.logger().update_root_page(frame, root_page_num, file_header->root_page);
   file_header->root_page = root_page_num;
-  file_header_.root_page = root_page_num;
+  std::atomic_ref<PageNum>(file_header_.root_page).store(root_page_num, std::memory_order_release);
   header_dirty_          = true;
   frame->mark_dirty();
   LOG_DEBUG("set root page to %d", root_page_num);
@@ -1486,6 +1638,19 @@ MemPoolItem::item_unique_ptr BplusTreeHandler::make_key(const char *user_key, co
   return key;
 }
 
+MemPoolItem::item_unique_ptr BplusTreeHandler::make_key(const char *user_key, int user_key_len, const RID &rid)
+{
+  MemPoolItem::item_unique_ptr key = mem_pool_item_->alloc_unique_ptr();
+  if (key == nullptr) {
+    LOG_WARN("Failed to alloc memory for key.");
+    return nullptr;
+  }
+  memcpy(static_cast<char *>(key.get()), user_key, user_key_len);
+  memset(static_cast<char *>(key.get()) + user_key_len, 0, file_header_.attr_length - user_key_len);
+  memcpy(static_cast<char *>(key.get()) + file_header_.attr_length, &rid, sizeof(rid));
+  return key;
+}
+
 RC BplusTreeHandler::insert_entry(const char *user_key, const RID *rid)
 {
   if (user_key == nullptr || rid == nullptr) {
@@ -1556,6 +1721,234 @@ RC BplusTreeHandler::get_entry(const char *user_key, int key_len, list<RID> &rid
   return rc;
 }
 
+RC BplusTreeHandler::get_entries(const char *user_key, int key_len, vector<RID> &rids)
+{
+  if (user_key == nullptr || key_len <= 0 || key_len > file_header_.attr_length) {
+    LOG_WARN("invalid key. key len=%d, attr length=%d", key_len, file_header_.attr_length);
+    return RC::INVALID_ARGUMENT;
+  }
+
+  // 相同的键值按照RID排序，用最小的RID就能定位到第一个相同的键值
+  MemPoolItem::item_unique_ptr pkey = make_key(user_key, key_len, *RID::min());
+  if (pkey == nullptr) {
+    return RC::NOMEM;
+  }
+  const char           *key             = static_cast<const char *>(pkey.get());
+  const AttrComparator &attr_comparator = key_comparator_.attr_comparator();
+
+  RC rc = RC::SUCCESS;
+  while (true) {
+    rids.clear();
+
+    BplusTreeMiniTransaction mtr(*this);
+    LatchMemo               &latch_memo = mtr.latch_memo();
+
+    Frame *frame = nullptr;
+    rc           = find_leaf(mtr, BplusTreeOperationType::READ, key, frame);
+    if (rc == RC::EMPTY) {
+      return RC::SUCCESS;
+    }
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to find leaf page. rc=%s", strrc(rc));
+      return rc;
+    }
+
+    int index = LeafIndexNodeHandler(mtr, file_header_, frame).lookup(key_comparator_, key);
+    while (true) {
+      LeafIndexNodeHandler node(mtr, file_header_, frame);
+      for (; index < node.size(); index++) {
+        if (attr_comparator(node.key_at(index), key) != 0) {
+          return RC::SUCCESS;
+        }
+        rids.push_back(*reinterpret_cast<const RID *>(node.value_at(index)));
+      }
+
+      const PageNum next_page_num = node.next_page();
+      if (next_page_num == BP_INVALID_PAGE_NUM) {
+        return RC::SUCCESS;
+      }
+
+      const int memo_point = latch_memo.memo_point();
+      rc                   = latch_memo.get_page(next_page_num, frame);
+      if (OB_FAIL(rc)) {
+        LOG_WARN("failed to get next page. page num=%d, rc=%s", next_page_num, strrc(rc));
+        return rc;
+      }
+
+      // 与扫描器一样，向右加锁的顺序与修改时不同，不能等待，失败了就从头再找一遍
+      if (!latch_memo.try_slatch(frame)) {
+        break;
+      }
+      latch_memo.release_to(memo_point);
+      index = 0;
+    }
+  }
+  return rc;
+}
+
+RC BplusTreeHandler::bulk_load(const function<RC(const char *&key)> &next, int64_t entry_num, int fill_factor)
+{
+  if (!is_empty()) {
+    LOG_WARN("cannot bulk load into a non-empty tree. root page=%d", file_header_.root_page);
+    return RC::INTERNAL;
+  }
+  if (entry_num <= 0) {
+    return RC::SUCCESS;
+  }
+
+  fill_factor = max(50, min(100, fill_factor));
+
+  /// 每一层正在填充的节点。第0层是叶子节点
+  struct Level
+  {
+    int64_t item_num   = 0;   ///< 这一层所有节点的元素个数之和，也就是下一层的节点个数
+    int64_t node_num   = 0;
+    int64_t node_index = -1;  ///< 正在填充的是这一层的第几个节点
+    int     node_size  = 0;   ///< 正在填充的节点要放多少个元素
+    Frame  *frame      = nullptr;
+  };
+
+  // 先算出每一层的节点个数，元素平均分配到各个节点中，避免最后一个节点太空。
+  // 节点个数不超过 item_num / min_size，这样除了根节点，每个节点都不少于 min_size 个元素，
+  // 此时节点可能会超过 fill_factor，但不会超过 max_size
+  vector<Level> levels;
+  for (int64_t item_num = entry_num; levels.empty() || levels.back().node_num > 1; item_num = levels.back().node_num) {
+    const bool leaf     = levels.empty();
+    const int  max_size = leaf ? file_header_.leaf_max_size : file_header_.internal_max_size;
+    const int  min_size = max(leaf ? 1 : 2, max_size - max_size / 2);
+    const int  capacity = max(min_size, max_size * fill_factor / 100);
+
+    Level level;
+    level.item_num = item_num;
+    level.node_num = max<int64_t>(1, min<int64_t>((item_num + capacity - 1) / capacity, item_num / min_size));
+    levels.push_back(level);
+  }
+
+  const int leaf_item_size     = file_header_.key_length + sizeof(RID);
+  const int internal_item_size = file_header_.key_length + sizeof(PageNum);
+
+  auto close_node = [this](Level &level) {
+    level.frame->mark_dirty();
+    level.frame->write_unlatch();
+    disk_buffer_pool_->unpin_page(level.frame);
+    level.frame = nullptr;
+  };
+
+  // 打开某一层的下一个节点，key 是这个节点的第一个键值。父节点满了的话先打开新的父节点
+  function<RC(int, const char *)> open_node = [&](int height, const char *key) -> RC {
+    PageNum parent_page_num = BP_INVALID_PAGE_NUM;
+    if (height + 1 < static_cast<int>(levels.size())) {
+      Level &parent = levels[height + 1];
+      if (parent.frame == nullptr || reinterpret_cast<IndexNode *>(parent.frame->data())->key_num == parent.node_size) {
+        RC rc = open_node(height + 1, key);
+        if (OB_FAIL(rc)) {
+          return rc;
+        }
+      }
+      parent_page_num = parent.frame->page_num();
+    }
+
+    Frame *frame = nullptr;
+    RC     rc    = disk_buffer_pool_->allocate_page(&frame);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to allocate page while bulk loading. rc=%s", strrc(rc));
+      return rc;
+    }
+    frame->write_latch();
+
+    IndexNode *node = reinterpret_cast<IndexNode *>(frame->data());
+    node->is_leaf   = (height == 0);
+    node->key_num   = 0;
+    node->parent    = parent_page_num;
+    if (node->is_leaf) {
+      reinterpret_cast<LeafIndexNode *>(node)->next_brother = BP_INVALID_PAGE_NUM;
+    }
+
+    Level &level = levels[height];
+    if (level.frame != nullptr) {
+      if (node->is_leaf) {
+        reinterpret_cast<LeafIndexNode *>(level.frame->data())->next_brother = frame->page_num();
+      }
+      close_node(level);
+    }
+    level.frame = frame;
+    level.node_index++;
+    level.node_size = static_cast<int>(
+        level.item_num / level.node_num + (level.node_index < level.item_num % level.node_num ? 1 : 0));
+
+    // 内部节点的第一个键值不使用
+    if (parent_page_num != BP_INVALID_PAGE_NUM) {
+      InternalIndexNode *parent_node = reinterpret_cast<InternalIndexNode *>(levels[height + 1].frame->data());
+      char              *item        = parent_node->array + parent_node->key_num * internal_item_size;
+      if (parent_node->key_num == 0) {
+        memset(item, 0, file_header_.key_length);
+      } else {
+        memcpy(item, key, file_header_.key_length);
+      }
+      const PageNum page_num = frame->page_num();
+      memcpy(item + file_header_.key_length, &page_num, sizeof(page_num));
+      parent_node->key_num++;
+    }
+    return RC::SUCCESS;
+  };
+
+  RC          rc         = RC::SUCCESS;
+  int64_t     loaded_num = 0;
+  Level      &leaf_level = levels[0];
+  const char *key        = nullptr;
+  while (OB_SUCC(rc = next(key))) {
+    if (leaf_level.frame == nullptr || reinterpret_cast<IndexNode *>(leaf_level.frame->data())->key_num == leaf_level.node_size) {
+      rc = open_node(0, key);
+      if (OB_FAIL(rc)) {
+        break;
+      }
+    }
+
+    // 叶子节点中的值就是RID，紧跟在键值后面
+    LeafIndexNode *leaf_node = reinterpret_cast<LeafIndexNode *>(leaf_level.frame->data());
+    char          *item      = leaf_node->array + leaf_node->key_num * leaf_item_size;
+    memcpy(item, key, file_header_.key_length);
+    memcpy(item + file_header_.key_length, key + file_header_.attr_length, sizeof(RID));
+    leaf_node->key_num++;
+    loaded_num++;
+  }
+
+  if (rc == RC::RECORD_EOF) {
+    rc = RC::SUCCESS;
+    if (loaded_num != entry_num) {
+      LOG_WARN("entry number mismatch while bulk loading. expected=%ld, loaded=%ld", entry_num, loaded_num);
+      rc = RC::INTERNAL;
+    }
+  }
+
+  const PageNum root_page_num = levels.back().frame != nullptr ? levels.back().frame->page_num() : BP_INVALID_PAGE_NUM;
+  for (Level &level : levels) {
+    if (level.frame != nullptr) {
+      close_node(level);
+    }
+  }
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to bulk load bplus tree. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  {
+    BplusTreeMiniTransaction mtr(*this);
+    update_root_page_num_locked(mtr, root_page_num);
+  }
+
+  // 这些页面都没有记录日志，需要在索引可以使用之前写到磁盘上
+  rc = sync();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to sync bplus tree after bulk loading. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  LOG_INFO("bulk loaded bplus tree. entry num=%ld, height=%d, root page=%d",
+           entry_num, static_cast<int>(levels.size()), root_page_num);
+  return rc;
+}
+
 RC BplusTreeHandler::adjust_root(BplusTreeMiniTransaction &mtr, Frame *root_frame)
 {
   LatchMemo &latch_memo = mtr.latch_memo();
@@ -1829,14 +2222,30 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
 
   LatchMemo &latch_memo = mtr_.latch_memo();
 
-  // 校验输入的键值是否是合法范围
+  // 多字段的键值，根据边界的长度判断给出了前面几个字段
+  const auto &attr_comparator = tree_handler_.key_comparator_.attr_comparator();
+  const bool  multi_attr      = attr_comparator.attr_num() > 1;
+  int         left_attr_num   = attr_comparator.attr_num();
+  right_attr_num_             = attr_comparator.attr_num();
+  if (multi_attr && left_user_key) {
+    left_attr_num = attr_comparator.attr_num_of_length(left_len);
+  }
+  if (multi_attr && right_user_key) {
+    right_attr_num_ = attr_comparator.attr_num_of_length(right_len);
+  }
+  if (left_attr_num <= 0 || right_attr_num_ <= 0) {
+    LOG_WARN("invalid key length of multi-field key. left len=%d, right len=%d", left_len, right_len);
+    return RC::INVALID_ARGUMENT;
+  }
+
+  // 左边界大于右边界，或者相等但不包含边界时，范围是空的，比如 k > 10 and k < 5，直接扫描结束
   if (left_user_key && right_user_key) {
-    const auto &attr_comparator = tree_handler_.key_comparator_.attr_comparator();
-    const int   result          = attr_comparator(left_user_key, right_user_key);
-    if (result > 0 ||  // left < right
+    const int result = attr_comparator.compare(left_user_key, right_user_key, min(left_attr_num, right_attr_num_));
+    if (result > 0 ||  // left > right
                        // left == right but is (left,right)/[left,right) or (left,right]
-        (result == 0 && (left_inclusive == false || right_inclusive == false))) {
-      return RC::INVALID_ARGUMENT;
+        (result == 0 && left_attr_num == right_attr_num_ && (left_inclusive == false || right_inclusive == false))) {
+      current_frame_ = nullptr;
+      return RC::SUCCESS;
     }
   }
 
@@ -1856,7 +2265,7 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
   } else {
 
     char *fixed_left_key = const_cast<char *>(left_user_key);
-    if (tree_handler_.file_header_.attr_type == AttrType::CHARS) {
+    if (!multi_attr && tree_handler_.file_header_.attr_type == AttrType::CHARS) {
       bool should_inclusive_after_fix = false;
       rc = fix_user_key(left_user_key, left_len, true /*greater*/, &fixed_left_key, &should_inclusive_after_fix);
       if (OB_FAIL(rc)) {
@@ -1870,10 +2279,11 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
     }
 
     MemPoolItem::item_unique_ptr left_pkey;
-    if (left_inclusive) {
-      left_pkey = tree_handler_.make_key(fixed_left_key, *RID::min());
+    const RID                   &left_rid = left_inclusive ? *RID::min() : *RID::max();
+    if (multi_attr) {
+      left_pkey = tree_handler_.make_key(fixed_left_key, left_len, left_rid);
     } else {
-      left_pkey = tree_handler_.make_key(fixed_left_key, *RID::max());
+      left_pkey = tree_handler_.make_key(fixed_left_key, left_rid);
     }
 
     const char *left_key = (const char *)left_pkey.get();
@@ -1883,7 +2293,16 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
       fixed_left_key = nullptr;
     }
 
-    rc = tree_handler_.find_leaf(mtr_, BplusTreeOperationType::READ, left_key, current_frame_);
+    // 只给出了部分字段时，只比较这几个字段
+    const KeyComparator *left_comparator = &tree_handler_.key_comparator_;
+    KeyComparator        prefix_comparator;
+    if (left_attr_num < attr_comparator.attr_num()) {
+      prefix_comparator = tree_handler_.key_comparator_;
+      prefix_comparator.set_prefix_attr_num(left_attr_num);
+      left_comparator = &prefix_comparator;
+    }
+
+    rc = tree_handler_.find_leaf(mtr_, BplusTreeOperationType::READ, *left_comparator, left_key, current_frame_);
     if (rc == RC::EMPTY) {
       rc             = RC::SUCCESS;
       current_frame_ = nullptr;
@@ -1894,7 +2313,7 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
     }
 
     LeafIndexNodeHandler left_node(mtr_, tree_handler_.file_header_, current_frame_);
-    int                  left_index = left_node.lookup(tree_handler_.key_comparator_, left_key);
+    int                  left_index = left_node.lookup(*left_comparator, left_key);
     // lookup 返回的是适合插入的位置，还需要判断一下是否在合适的边界范围内
     if (left_index >= left_node.size()) {  // 超出了当前页，就需要向后移动一个位置
       const PageNum next_page_num = left_node.next_page();
@@ -1923,7 +2342,7 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
 
     char *fixed_right_key          = const_cast<char *>(right_user_key);
     bool  should_include_after_fix = false;
-    if (tree_handler_.file_header_.attr_type == AttrType::CHARS) {
+    if (!multi_attr && tree_handler_.file_header_.attr_type == AttrType::CHARS) {
       rc = fix_user_key(right_user_key, right_len, false /*want_greater*/, &fixed_right_key, &should_include_after_fix);
       if (OB_FAIL(rc)) {
         LOG_WARN("failed to fix right user key. rc=%s", strrc(rc));
@@ -1934,10 +2353,11 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
         right_inclusive = true;
       }
     }
-    if (right_inclusive) {
-      right_key_ = tree_handler_.make_key(fixed_right_key, *RID::max());
+    const RID &right_rid = right_inclusive ? *RID::max() : *RID::min();
+    if (multi_attr) {
+      right_key_ = tree_handler_.make_key(fixed_right_key, right_len, right_rid);
     } else {
-      right_key_ = tree_handler_.make_key(fixed_right_key, *RID::min());
+      right_key_ = tree_handler_.make_key(fixed_right_key, right_rid);
     }
 
     if (fixed_right_key != right_user_key) {
@@ -1953,10 +2373,13 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
   return RC::SUCCESS;
 }
 
-void BplusTreeScanner::fetch_item(RID &rid)
+void BplusTreeScanner::fetch_item(RID &rid, char *user_key)
 {
   LeafIndexNodeHandler node(mtr_, tree_handler_.file_header_, current_frame_);
   memcpy(&rid, node.value_at(iter_index_), sizeof(rid));
+  if (user_key != nullptr) {
+    memcpy(user_key, node.key_at(iter_index_), tree_handler_.file_header_.attr_length);
+  }
 }
 
 bool BplusTreeScanner::touch_end()
@@ -1968,18 +2391,19 @@ bool BplusTreeScanner::touch_end()
   LeafIndexNodeHandler node(mtr_, tree_handler_.file_header_, current_frame_);
 
   const char *this_key       = node.key_at(iter_index_);
-  int         compare_result = tree_handler_.key_comparator_(this_key, static_cast<char *>(right_key_.get()));
+  int         compare_result =
+      tree_handler_.key_comparator_.compare(this_key, static_cast<char *>(right_key_.get()), right_attr_num_);
   return compare_result > 0;
 }
 
-RC BplusTreeScanner::next_entry(RID &rid)
+RC BplusTreeScanner::next_entry(RID &rid, char *user_key)
 {
   if (nullptr == current_frame_) {
     return RC::RECORD_EOF;
   }
 
   if (!first_emitted_) {
-    fetch_item(rid);
+    fetch_item(rid, user_key);
     first_emitted_ = true;
     return RC::SUCCESS;
   }
@@ -1992,7 +2416,7 @@ RC BplusTreeScanner::next_entry(RID &rid)
       return RC::RECORD_EOF;
     }
 
-    fetch_item(rid);
+    fetch_item(rid, user_key);
     return RC::SUCCESS;
   }
 
@@ -2023,7 +2447,7 @@ RC BplusTreeScanner::next_entry(RID &rid)
 
   latch_memo.release_to(memo_point);
   iter_index_ = -1;  // `next` will add 1
-  return next_entry(rid);
+  return next_entry(rid, user_key);
 }
 
 RC BplusTreeScanner::close()
@@ -23,6 +23,8 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/memory.h"
 #include "common/lang/sstream.h"
 #include "common/lang/functional.h"
+#include "common/lang/span.h"
+#include "common/lang/vector.h"
 #include "common/log/log.h"
 #include "sql/parser/parse_defs.h"
 #include "storage/buffer/disk_buffer_pool.h"
@@ -52,50 +54,104 @@ enum class BplusTreeOperationType
 /**
  * @brief 属性比较(BplusTree)
  * @ingroup BPlusTree
+ * @details 属性可以由多个字段组成，各个字段依次存放，按照字段的顺序逐个比较。
  */
 class AttrComparator
 {
 public:
-  void init(AttrType type, int length)
+  void init(AttrType type, int length) { init(span<const AttrType>(&type, 1), span<const int32_t>(&length, 1)); }
+  void init(span<const AttrType> types, span<const int32_t> lengths)
   {
-    attr_type_   = type;
-    attr_length_ = length;
+    attr_types_.assign(types.begin(), types.end());
+    attr_offsets_.clear();
+    attr_length_ = 0;
+    for (int32_t length : lengths) {
+      attr_offsets_.push_back(attr_length_);
+      attr_length_ += length;
+    }
+    attr_offsets_.push_back(attr_length_);
   }
 
+  int attr_num() const { return static_cast<int>(attr_types_.size()); }
   int attr_length() const { return attr_length_; }
 
-  int operator()(const char *v1, const char *v2) const
+  /// 前 attr_num 个字段的长度之和
+  int attr_length(int attr_num) const { return attr_offsets_[attr_num]; }
+
+  /**
+   * @brief 找到长度之和刚好是 length 的前几个字段
+   * @return 字段的个数。如果长度不是某几个字段的长度之和，返回-1
+   */
+  int attr_num_of_length(int length) const
   {
-    // TODO: optimized the comparison
-    Value left;
-    left.set_type(attr_type_);
-    left.set_data(v1, attr_length_);
-    Value right;
-    right.set_type(attr_type_);
-    right.set_data(v2, attr_length_);
-    return DataType::type_instance(attr_type_)->compare(left, right);
+    for (int i = 1; i <= attr_num(); i++) {
+      if (attr_offsets_[i] == length) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  int operator()(const char *v1, const char *v2) const { return compare(v1, v2, attr_num()); }
+
+  /// 只比较前 attr_num 个字段
+  int compare(const char *v1, const char *v2, int attr_num) const
+  {
+    for (int i = 0; i < attr_num; i++) {
+      // TODO: optimized the comparison
+      const int offset = attr_offsets_[i];
+      const int length = attr_offsets_[i + 1] - offset;
+      Value     left;
+      left.set_type(attr_types_[i]);
+      left.set_data(v1 + offset, length);
+      Value right;
+      right.set_type(attr_types_[i]);
+      right.set_data(v2 + offset, length);
+      const int result = DataType::type_instance(attr_types_[i])->compare(left, right);
+      if (result != 0) {
+        return result;
+      }
+    }
+    return 0;
   }
 
 private:
-  AttrType attr_type_;
-  int      attr_length_;
+  vector<AttrType> attr_types_;
+  vector<int>      attr_offsets_;  ///< 每个字段的起始位置，最后一个是所有字段的总长度
+  int              attr_length_ = 0;
 };
 
 /**
  * @brief 键值比较(BplusTree)
  * @details BplusTree的键值除了字段属性，还有RID，是为了避免属性值重复而增加的。
+ * 在多字段索引中按照前几个字段查找时，可以只比较这几个字段，字段相同时再比较RID。
+ * 查找使用的键值的RID是最小或最大值，就可以定位到这个前缀的开始或结束位置。
  * @ingroup BPlusTree
  */
 class KeyComparator
 {
 public:
-  void init(AttrType type, int length) { attr_comparator_.init(type, length); }
+  void init(AttrType type, int length)
+  {
+    attr_comparator_.init(type, length);
+    prefix_attr_num_ = attr_comparator_.attr_num();
+  }
+  void init(span<const AttrType> types, span<const int32_t> lengths)
+  {
+    attr_comparator_.init(types, lengths);
+    prefix_attr_num_ = attr_comparator_.attr_num();
+  }
 
   const AttrComparator &attr_comparator() const { return attr_comparator_; }
 
-  int operator()(const char *v1, const char *v2) const
+  /// 只比较前 attr_num 个字段和RID
+  void set_prefix_attr_num(int attr_num) { prefix_attr_num_ = attr_num; }
+
+  int operator()(const char *v1, const char *v2) const { return compare(v1, v2, prefix_attr_num_); }
+
+  int compare(const char *v1, const char *v2, int attr_num) const
   {
-    int result = attr_comparator_(v1, v2);
+    int result = attr_comparator_.compare(v1, v2, attr_num);
     if (result != 0) {
       return result;
     }
@@ -107,6 +163,7 @@ public:
 
 private:
   AttrComparator attr_comparator_;
+  int            prefix_attr_num_ = 0;
 };
 
 /**
@@ -116,23 +173,44 @@ private:
 class AttrPrinter
 {
 public:
-  void init(AttrType type, int length)
+  void init(AttrType type, int length) { init(span<const AttrType>(&type, 1), span<const int32_t>(&length, 1)); }
+  void init(span<const AttrType> types, span<const int32_t> lengths)
   {
-    attr_type_   = type;
-    attr_length_ = length;
+    attr_types_.assign(types.begin(), types.end());
+    attr_lengths_.assign(lengths.begin(), lengths.end());
+    attr_length_ = 0;
+    for (int32_t length : lengths) {
+      attr_length_ += length;
+    }
   }
 
   int attr_length() const { return attr_length_; }
 
   string operator()(const char *v) const
   {
-    Value value(attr_type_, const_cast<char *>(v), attr_length_);
-    return value.to_string();
+    if (attr_types_.size() == 1) {
+      Value value(attr_types_[0], const_cast<char *>(v), attr_lengths_[0]);
+      return value.to_string();
+    }
+
+    stringstream ss;
+    ss << "(";
+    for (size_t i = 0; i < attr_types_.size(); i++) {
+      if (i > 0) {
+        ss << ",";
+      }
+      Value value(attr_types_[i], const_cast<char *>(v), attr_lengths_[i]);
+      ss << value.to_string();
+      v += attr_lengths_[i];
+    }
+    ss << ")";
+    return ss.str();
   }
 
 private:
-  AttrType attr_type_;
-  int      attr_length_;
+  vector<AttrType> attr_types_;
+  vector<int32_t>  attr_lengths_;
+  int              attr_length_ = 0;
 };
 
 /**
@@ -143,6 +221,7 @@ class KeyPrinter
 {
 public:
   void init(AttrType type, int length) { attr_printer_.init(type, length); }
+  void init(span<const AttrType> types, span<const int32_t> lengths) { attr_printer_.init(types, lengths); }
 
   const AttrPrinter &attr_printer() const { return attr_printer_; }
 
@@ -164,21 +243,43 @@ private:
  * @brief the meta information of bplus tree
  * @ingroup BPlusTree
  * @details this is the first page of bplus tree.
- * only one field can be supported, can you extend it to multi-fields?
+ * the key may consist of several fields, which are stored one by one in the key.
+ * attr_type and attr_length describe the whole key for compatibility with files
+ * created before multi-field keys are supported, in which attr_num is zero.
  */
 struct IndexFileHeader
 {
+  static constexpr int MAX_ATTR_NUM = 8;  ///< 一个键值最多包含的字段数
+
   IndexFileHeader()
   {
     memset(this, 0, sizeof(IndexFileHeader));
     root_page = BP_INVALID_PAGE_NUM;
   }
-  PageNum  root_page;          ///< 根节点在磁盘中的页号
-  int32_t  internal_max_size;  ///< 内部节点最大的键值对数
-  int32_t  leaf_max_size;      ///< 叶子节点最大的键值对数
-  int32_t  attr_length;        ///< 键值的长度
-  int32_t  key_length;         ///< attr length + sizeof(RID)
-  AttrType attr_type;          ///< 键值的类型
+  PageNum  root_page;                   ///< 根节点在磁盘中的页号
+  int32_t  internal_max_size;           ///< 内部节点最大的键值对数
+  int32_t  leaf_max_size;               ///< 叶子节点最大的键值对数
+  int32_t  attr_length;                 ///< 键值的长度，所有字段的长度之和
+  int32_t  key_length;                  ///< attr length + sizeof(RID)
+  AttrType attr_type;                   ///< 键值的类型，多字段时是第一个字段的类型
+  int32_t  attr_num;                    ///< 键值包含的字段数
+  AttrType attr_types[MAX_ATTR_NUM];    ///< 每个字段的类型
+  int32_t  attr_lengths[MAX_ATTR_NUM];  ///< 每个字段的长度
+
+  /**
+   * @brief 旧版本的文件没有记录字段列表，把整个键值当做一个字段
+   */
+  void fix_attr_list()
+  {
+    if (attr_num <= 0 || attr_num > MAX_ATTR_NUM) {
+      attr_num        = 1;
+      attr_types[0]   = attr_type;
+      attr_lengths[0] = attr_length;
+    }
+  }
+
+  span<const AttrType> attr_type_list() const { return span<const AttrType>(attr_types, attr_num); }
+  span<const int32_t>  attr_length_list() const { return span<const int32_t>(attr_lengths, attr_num); }
 
   const string to_string() const
   {
@@ -187,6 +288,7 @@ struct IndexFileHeader
     ss << "attr_length:" << attr_length << ","
        << "key_length:" << key_length << ","
        << "attr_type:" << attr_type_to_string(attr_type) << ","
+       << "attr_num:" << attr_num << ","
        << "root_page:" << root_page << ","
        << "internal_max_size:" << internal_max_size << ","
        << "leaf_max_size:" << leaf_max_size << ";";
@@ -464,6 +566,16 @@ public:
   RC create(LogHandler &log_handler, DiskBufferPool &buffer_pool, AttrType attr_type, int attr_length,
       int internal_max_size = -1, int leaf_max_size = -1);
 
+  /**
+   * @brief 创建一个键值包含多个字段的B+树
+   * @param attr_types 每个字段的类型
+   * @param attr_lengths 每个字段的长度
+   */
+  RC create(LogHandler &log_handler, BufferPoolManager &bpm, const char *file_name, span<const AttrType> attr_types,
+      span<const int32_t> attr_lengths, int internal_max_size = -1, int leaf_max_size = -1);
+  RC create(LogHandler &log_handler, DiskBufferPool &buffer_pool, span<const AttrType> attr_types,
+      span<const int32_t> attr_lengths, int internal_max_size = -1, int leaf_max_size = -1);
+
   /**
    * @brief 打开一个B+树
    * @param log_handler 记录日志
@@ -502,6 +614,25 @@ public:
    */
   RC get_entry(const char *user_key, int key_len, list<RID> &rids);
 
+  /**
+   * @brief 等值查找，找出所有字段都等于 user_key 的索引项
+   * @details 给唯一索引的点查和唯一性检查使用。不创建扫描器，直接定位到叶子节点，
+   * 再沿着叶子节点向后收集，直到键值不相等。rids 由调用者提供，可以在多次查找之间复用
+   * @param key_len user_key的长度，不足 attr_length 的部分按0填充
+   */
+  RC get_entries(const char *user_key, int key_len, vector<RID> &rids);
+
+  /**
+   * @brief 用排好序的索引项自底向上构建B+树
+   * @details 只能用在刚创建的空树上。按照数据量先算出每一层的节点个数，每个节点平均分配，
+   * 尽量不超过 fill_factor，但除了根节点每个节点都不少于最小的元素个数。叶子节点按顺序写入，每一层只保留最右边一个正在填充的节点。
+   * 节点的修改不记录日志，构建完成后直接把所有页面刷到磁盘，与 create 中元数据页面的做法一样
+   * @param next 依次返回排好序的索引项(键值和RID)，没有更多数据时返回 RECORD_EOF
+   * @param entry_num 索引项的总数
+   * @param fill_factor 节点填充的百分比
+   */
+  RC bulk_load(const function<RC(const char *&key)> &next, int64_t entry_num, int fill_factor);
+
   RC sync();
 
   /**
@@ -511,6 +642,13 @@ public:
    */
   bool validate_tree();
 
+  /**
+   * @brief 是否使用乐观的方式查找叶子节点，默认打开
+   * @details 打开时，查找、插入和删除先不加锁地从根节点走到叶子节点，只在叶子节点上加锁。
+   * 遇到并发修改，或者叶子节点需要分裂、合并时，再使用 crabing protocol 加锁重新查找
+   */
+  void set_optimistic_latch(bool enable) { optimistic_latch_ = enable; }
+
 public:
   const IndexFileHeader &file_header() const { return file_header_; }
   DiskBufferPool        &buffer_pool() const { return *disk_buffer_pool_; }
@@ -554,6 +692,13 @@ protected:
    */
   RC find_leaf(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op, const char *key, Frame *&frame);
 
+  /**
+   * @brief 使用指定的比较器查找叶子节点
+   * @details 按照多字段键值的前缀查找时，比较器只比较前缀中的字段
+   */
+  RC find_leaf(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op, const KeyComparator &comparator,
+      const char *key, Frame *&frame);
+
   /**
    * @brief 找到最左边的叶子节点
    */
@@ -568,6 +713,24 @@ protected:
   RC find_leaf_internal(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op,
       const function<PageNum(InternalIndexNodeHandler &)> &child_page_getter, Frame *&frame);
 
+  /**
+   * @brief 使用乐观锁(Optimistic Lock Coupling)查找叶子节点
+   * @details 内部节点不加锁，只 pin 住页面，用页帧的版本号校验读到的内容：
+   * 读取孩子节点的页面号以后，校验当前节点的版本号，再取孩子节点的版本号，再校验一次当前节点。
+   * 这样拿到的孩子节点一定还是这条路径上的节点。叶子节点按照 op 加读锁或写锁，再校验它的版本号。
+   * 不会修改 root_lock_ 和内部节点的锁，查找的线程之间互相没有影响。
+   * @return RC::LOCKED_CONCURRENCY_CONFLICT 路径上的节点被并发修改了，可以重试；
+   *         RC::LOCKED_NEED_WAIT 叶子节点不安全，操作可能会导致分裂或合并，需要加锁查找；
+   *         这两种情况下 mtr 中不会留下任何页面
+   */
+  RC optimistic_find_leaf(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op,
+      const function<PageNum(InternalIndexNodeHandler &)> &child_page_getter, Frame *&frame);
+
+  /**
+   * @brief 不加锁读取根节点的页面号，乐观查找时使用
+   */
+  PageNum root_page_num() const;
+
   /**
    * @brief 使用crabing protocol 获取页面
    */
@@ -635,6 +798,13 @@ protected:
 private:
   common::MemPoolItem::item_unique_ptr make_key(const char *user_key, const RID &rid);
 
+  /**
+   * @brief 使用键值的前缀构造一个键值
+   * @details 前缀之外的字段填充为0，查找时也不会比较这些字段
+   * @param user_key_len 前缀的长度
+   */
+  common::MemPoolItem::item_unique_ptr make_key(const char *user_key, int user_key_len, const RID &rid);
+
 protected:
   LogHandler     *log_handler_      = nullptr;  /// 日志处理器
   DiskBufferPool *disk_buffer_pool_ = nullptr;  /// 磁盘缓冲池
@@ -645,6 +815,10 @@ protected:
   // 这个锁可以使用递归读写锁，但是这里偷懒先不改
   common::SharedMutex root_lock_;
 
+  /// 乐观查找时遇到并发修改，最多重试的次数，之后加锁查找
+  static constexpr int OPTIMISTIC_RETRY_TIMES = 4;
+  bool                 optimistic_latch_      = true;
+
   KeyComparator key_comparator_;
   KeyPrinter    key_printer_;
 
@@ -667,6 +841,9 @@ public:
 
   /**
    * @brief 扫描指定范围的数据
+   * @details 多字段的键值可以只给出前面几个字段，通过边界的长度判断包含了几个字段，
+   * 没有给出的字段不做限制。比如键值是(a,b)，左右边界都是 a=1，就会扫描 a=1 的所有数据。
+   * 范围为空时也返回成功，扫描不到任何数据。
    * @param left_user_key 扫描范围的左边界，如果是null，则没有左边界
    * @param left_len left_user_key 的内存大小(只有在变长字段中才会关注)
    * @param left_inclusive 左边界的值是否包含在内
@@ -682,12 +859,12 @@ public:
    * @brief 获取下一条记录
    *
    * @param rid 当前默认所有值都是RID类型。对B+树来说并不是一个好的抽象
+   * @param user_key 不为空时，同时复制出这条记录的键值，不包含RID，长度是 attr_length
    * @return RC RECORD_EOF 表示遍历完成
-   * TODO 需要增加返回 key 的接口
    * @warning 不要在遍历时删除数据。删除数据会导致遍历器失效。
    * 当前默认的走索引删除的逻辑就是这样做的，所以删除逻辑有BUG。
    */
-  RC next_entry(RID &rid);
+  RC next_entry(RID &rid, char *user_key = nullptr);
 
   /**
    * @brief 关闭当前扫描器
@@ -701,7 +878,7 @@ private:
    */
   RC fix_user_key(const char *user_key, int key_len, bool want_greater, char **fixed_key, bool *should_inclusive);
 
-  void fetch_item(RID &rid);
+  void fetch_item(RID &rid, char *user_key);
 
   /**
    * @brief 判断是否到了扫描的结束位置
@@ -718,6 +895,7 @@ private:
   Frame *current_frame_ = nullptr;
 
   common::MemPoolItem::item_unique_ptr right_key_;
-  int                                  iter_index_    = -1;
-  bool                                 first_emitted_ = false;
+  int                                  right_attr_num_ = 0;  ///< 右边界包含的字段数
+  int                                  iter_index_     = -1;
+  bool                                 first_emitted_  = false;
 };
@@ -0,0 +1,364 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/index/bplus_tree_bulk_loader.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/filesystem.h"
+#include "common/lang/fstream.h"
+#include "common/lang/queue.h"
+#include "common/log/log.h"
+
+/**
+ * @brief 按顺序读取一段排好序的数据
+ */
+class BplusTreeBulkLoader::RunReader
+{
+public:
+  static constexpr int64_t MAX_READ_BUFFER_SIZE = 1024 * 1024;
+
+  RunReader(const Run &run, int key_length) : run_(run), key_length_(key_length) {}
+
+  /**
+   * @param buffer_size 读取临时文件的缓冲区大小，至少能放下一个索引项
+   */
+  RC open(int64_t buffer_size)
+  {
+    if (run_.file.empty()) {
+      data_     = run_.data.data();
+      data_end_ = data_ + run_.data.size();
+      return RC::SUCCESS;
+    }
+
+    file_.open(run_.file, ios::in | ios::binary);
+    if (!file_.is_open()) {
+      LOG_WARN("failed to open bulk load run file. file=%s", run_.file.c_str());
+      return RC::IOERR_OPEN;
+    }
+    buffer_.resize(max<int64_t>(1, min(buffer_size, MAX_READ_BUFFER_SIZE) / key_length_) * key_length_);
+    return fill();
+  }
+
+  /// 当前的索引项，读完以后返回空
+  const char *current() const { return data_ < data_end_ ? data_ : nullptr; }
+
+  RC next()
+  {
+    data_ += key_length_;
+    if (data_ >= data_end_ && !run_.file.empty()) {
+      return fill();
+    }
+    return RC::SUCCESS;
+  }
+
+private:
+  RC fill()
+  {
+    const int64_t left = (run_.entry_num - read_num_) * key_length_;
+    const int64_t size = min(left, static_cast<int64_t>(buffer_.size()));
+    data_              = buffer_.data();
+    data_end_          = data_ + size;
+    if (size == 0) {
+      return RC::SUCCESS;
+    }
+
+    file_.read(buffer_.data(), size);
+    if (file_.gcount() != size) {
+      LOG_WARN("failed to read bulk load run file. file=%s, expected=%ld, read=%ld",
+               run_.file.c_str(), size, static_cast<int64_t>(file_.gcount()));
+      data_end_ = data_;
+      return RC::IOERR_READ;
+    }
+    read_num_ += size / key_length_;
+    return RC::SUCCESS;
+  }
+
+private:
+  const Run   &run_;
+  int          key_length_ = 0;
+  ifstream     file_;
+  vector<char> buffer_;
+  int64_t      read_num_ = 0;  ///< 已经从文件中读出的索引项个数
+  const char  *data_     = nullptr;
+  const char  *data_end_ = nullptr;
+};
+
+/**
+ * @brief 把所有段归并成一个有序的序列
+ */
+class BplusTreeBulkLoader::Merger
+{
+public:
+  explicit Merger(const BplusTreeBulkLoader &loader) : loader_(loader), heap_(ReaderGreater{loader.key_comparator_}) {}
+
+  RC open()
+  {
+    // 所有临时文件的读缓冲区平分排序缓冲区的大小，段很多时内存也不会超出限制
+    const int64_t file_num = count_if(
+        loader_.runs_.begin(), loader_.runs_.end(), [](const unique_ptr<Run> &run) { return !run->file.empty(); });
+    const int64_t buffer_size = loader_.options_.sort_buffer_size / max<int64_t>(1, file_num);
+
+    for (const unique_ptr<Run> &run : loader_.runs_) {
+      auto reader = make_unique<RunReader>(*run, loader_.key_length_);
+      RC   rc     = reader->open(buffer_size);
+      if (OB_FAIL(rc)) {
+        return rc;
+      }
+      if (reader->current() != nullptr) {
+        heap_.push(reader.get());
+      }
+      readers_.push_back(std::move(reader));
+    }
+    return RC::SUCCESS;
+  }
+
+  /**
+   * @brief 取下一个索引项
+   * @details 返回的指针在下一次调用之前有效
+   */
+  RC next(const char *&key)
+  {
+    // 上一次返回的索引项现在才可以丢弃
+    if (last_reader_ != nullptr) {
+      RC rc = last_reader_->next();
+      if (OB_FAIL(rc)) {
+        return rc;
+      }
+      if (last_reader_->current() != nullptr) {
+        heap_.push(last_reader_);
+      }
+      last_reader_ = nullptr;
+    }
+
+    if (heap_.empty()) {
+      return RC::RECORD_EOF;
+    }
+
+    last_reader_ = heap_.top();
+    heap_.pop();
+    key = last_reader_->current();
+    return RC::SUCCESS;
+  }
+
+private:
+  struct ReaderGreater
+  {
+    const KeyComparator &comparator;
+
+    bool operator()(const RunReader *left, const RunReader *right) const
+    {
+      return comparator(left->current(), right->current()) > 0;
+    }
+  };
+
+  const BplusTreeBulkLoader                                        &loader_;
+  vector<unique_ptr<RunReader>>                                     readers_;
+  priority_queue<RunReader *, vector<RunReader *>, ReaderGreater> heap_;
+  RunReader                                                        *last_reader_ = nullptr;
+};
+
+BplusTreeBulkLoader::BplusTreeBulkLoader(const BplusTreeBulkLoadOptions &options, span<const AttrType> attr_types,
+    span<const int32_t> attr_lengths, const string &tmp_file_prefix)
+    : options_(options), tmp_file_prefix_(tmp_file_prefix)
+{
+  options_.thread_num = max(1, options_.thread_num);
+  if (options_.sort_buffer_size <= 0) {
+    options_.sort_buffer_size = BplusTreeBulkLoadOptions::DEFAULT_SORT_BUFFER_SIZE;
+  }
+
+  key_comparator_.init(attr_types, attr_lengths);
+  attr_length_        = key_comparator_.attr_comparator().attr_length();
+  key_length_         = attr_length_ + static_cast<int>(sizeof(RID));
+  run_entry_capacity_ = max<int64_t>(1, options_.sort_buffer_size / options_.thread_num / key_length_);
+}
+
+BplusTreeBulkLoader::~BplusTreeBulkLoader()
+{
+  for (thread &sort_thread : sort_threads_) {
+    sort_thread.join();
+  }
+  sort_threads_.clear();
+
+  for (const unique_ptr<Run> &run : runs_) {
+    if (!run->file.empty()) {
+      error_code ec;
+      filesystem::remove(run->file, ec);
+      if (ec) {
+        LOG_WARN("failed to remove bulk load run file. file=%s, error=%s", run->file.c_str(), ec.message().c_str());
+      }
+    }
+  }
+}
+
+RC BplusTreeBulkLoader::add(const char *user_key, const RID &rid)
+{
+  if (finished_) {
+    LOG_WARN("cannot add entry to a finished bulk loader");
+    return RC::INTERNAL;
+  }
+
+  if (current_run_ == nullptr) {
+    current_run_ = make_unique<Run>();
+    current_run_->data.reserve(static_cast<size_t>(run_entry_capacity_) * key_length_);
+  }
+
+  vector<char> &data = current_run_->data;
+  data.insert(data.end(), user_key, user_key + attr_length_);
+  data.insert(data.end(), reinterpret_cast<const char *>(&rid), reinterpret_cast<const char *>(&rid) + sizeof(rid));
+  current_run_->entry_num++;
+  entry_num_++;
+
+  if (current_run_->entry_num >= run_entry_capacity_) {
+    return submit_run();
+  }
+  return RC::SUCCESS;
+}
+
+RC BplusTreeBulkLoader::submit_run()
+{
+  if (current_run_ == nullptr || current_run_->entry_num == 0) {
+    return RC::SUCCESS;
+  }
+
+  unique_ptr<Run> run  = std::move(current_run_);
+  const int64_t   size = static_cast<int64_t>(run->data.size());
+  if (memory_size_ + size > options_.sort_buffer_size) {
+    run->file = tmp_file_prefix_ + "." + std::to_string(runs_.size());
+  } else {
+    memory_size_ += size;
+  }
+
+  // 限制同时排序的段数，否则等待排序的段会占用太多内存
+  while (static_cast<int>(sort_threads_.size()) >= options_.thread_num) {
+    sort_threads_.front().join();
+    sort_threads_.pop_front();
+  }
+
+  Run *run_ptr = run.get();
+  runs_.push_back(std::move(run));
+  sort_threads_.emplace_back([this, run_ptr]() { sort_run(*run_ptr); });
+  return RC::SUCCESS;
+}
+
+void BplusTreeBulkLoader::sort_run(Run &run)
+{
+  vector<const char *> entries;
+  entries.reserve(run.entry_num);
+  for (int64_t i = 0; i < run.entry_num; i++) {
+    entries.push_back(run.data.data() + i * key_length_);
+  }
+
+  std::sort(entries.begin(), entries.end(), [this](const char *left, const char *right) {
+    return key_comparator_(left, right) < 0;
+  });
+
+  if (run.file.empty()) {
+    vector<char> sorted;
+    sorted.reserve(run.data.size());
+    for (const char *entry : entries) {
+      sorted.insert(sorted.end(), entry, entry + key_length_);
+    }
+    run.data.swap(sorted);
+    return;
+  }
+
+  ofstream file(run.file, ios::out | ios::binary | ios::trunc);
+  if (!file.is_open()) {
+    LOG_WARN("failed to create bulk load run file. file=%s", run.file.c_str());
+    run.rc = RC::IOERR_OPEN;
+    return;
+  }
+
+  for (const char *entry : entries) {
+    file.write(entry, key_length_);
+  }
+  file.close();
+  if (file.fail()) {
+    LOG_WARN("failed to write bulk load run file. file=%s", run.file.c_str());
+    run.rc = RC::IOERR_WRITE;
+    return;
+  }
+
+  vector<char>().swap(run.data);
+}
+
+RC BplusTreeBulkLoader::finish()
+{
+  if (finished_) {
+    return RC::SUCCESS;
+  }
+
+  RC rc = submit_run();
+  for (thread &sort_thread : sort_threads_) {
+    sort_thread.join();
+  }
+  sort_threads_.clear();
+  finished_ = true;
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  int file_num = 0;
+  for (const unique_ptr<Run> &run : runs_) {
+    if (OB_FAIL(run->rc)) {
+      return run->rc;
+    }
+    file_num += run->file.empty() ? 0 : 1;
+  }
+
+  LOG_INFO("bulk loader sorted entries. entry num=%ld, run num=%d, file num=%d",
+           entry_num_, static_cast<int>(runs_.size()), file_num);
+  return RC::SUCCESS;
+}
+
+RC BplusTreeBulkLoader::check_unique()
+{
+  if (!finished_) {
+    LOG_WARN("bulk loader is not finished");
+    return RC::INTERNAL;
+  }
+
+  Merger merger(*this);
+  RC     rc = merger.open();
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  // 排好序后字段值相同的索引项是相邻的
+  const AttrComparator &attr_comparator = key_comparator_.attr_comparator();
+  vector<char>          last_key(attr_length_);
+  bool                  has_last = false;
+  const char           *key      = nullptr;
+  while (OB_SUCC(rc = merger.next(key))) {
+    if (has_last && attr_comparator(last_key.data(), key) == 0) {
+      LOG_INFO("duplicate key found while building unique index");
+      return RC::RECORD_DUPLICATE_KEY;
+    }
+    memcpy(last_key.data(), key, attr_length_);
+    has_last = true;
+  }
+
+  return rc == RC::RECORD_EOF ? RC::SUCCESS : rc;
+}
+
+RC BplusTreeBulkLoader::build(BplusTreeHandler &handler)
+{
+  if (!finished_) {
+    LOG_WARN("bulk loader is not finished");
+    return RC::INTERNAL;
+  }
+
+  Merger merger(*this);
+  RC     rc = merger.open();
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  return handler.bulk_load([&merger](const char *&key) { return merger.next(key); }, entry_num_, options_.fill_factor);
+}
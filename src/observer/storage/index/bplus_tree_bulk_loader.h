@@ -0,0 +1,118 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/deque.h"
+#include "common/lang/memory.h"
+#include "common/lang/span.h"
+#include "common/lang/string.h"
+#include "common/lang/thread.h"
+#include "common/lang/vector.h"
+#include "storage/index/bplus_tree.h"
+
+/**
+ * @brief 批量构建B+树的参数
+ * @ingroup BPlusTree
+ */
+struct BplusTreeBulkLoadOptions
+{
+  static constexpr int     DEFAULT_FILL_FACTOR      = 90;
+  static constexpr int     DEFAULT_THREAD_NUM       = 4;
+  static constexpr int64_t DEFAULT_SORT_BUFFER_SIZE = 64 * 1024 * 1024;
+  static constexpr int64_t MIN_SORT_BUFFER_SIZE     = 1024 * 1024;  ///< 配置项允许的最小值
+
+  int     fill_factor = DEFAULT_FILL_FACTOR;  ///< 节点填充的百分比，50~100
+  int     thread_num  = DEFAULT_THREAD_NUM;   ///< 排序使用的线程数
+
+  /// 放在内存中排序的数据大小(字节)，超过的部分写到临时文件中。归并时读取临时文件的缓冲区总共也不超过这个大小。
+  /// 不大于0时使用默认值
+  int64_t sort_buffer_size = DEFAULT_SORT_BUFFER_SIZE;
+};
+
+/**
+ * @brief 批量构建B+树
+ * @ingroup BPlusTree
+ * @details 在已经有数据的表上创建索引时，逐条插入每一条都要从根节点查找、加锁并记录日志。
+ * 批量构建先取出所有的索引项排序，再按顺序写满叶子节点，同时自底向上构建内部节点。
+ * 索引项按照B+树中键值的格式存放，即键值后面跟着RID。
+ * 添加的索引项分成多段，每段由一个后台线程排序。内存中的数据超过 sort_buffer_size 以后，
+ * 后面的段排好序后写到临时文件中。最后把所有的段归并起来。
+ */
+class BplusTreeBulkLoader
+{
+public:
+  /**
+   * @param tmp_file_prefix 临时文件的路径前缀，后面加上段的编号
+   */
+  BplusTreeBulkLoader(const BplusTreeBulkLoadOptions &options, span<const AttrType> attr_types,
+      span<const int32_t> attr_lengths, const string &tmp_file_prefix);
+  ~BplusTreeBulkLoader();
+
+  /**
+   * @brief 添加一个索引项
+   * @param user_key 各个字段的值依次存放，长度是所有字段长度之和
+   */
+  RC add(const char *user_key, const RID &rid);
+
+  /**
+   * @brief 所有的索引项都已经添加，等待所有段排序完成
+   */
+  RC finish();
+
+  /**
+   * @brief 检查是否有字段值都相同的索引项，用于唯一索引
+   * @return 有重复时返回 RECORD_DUPLICATE_KEY
+   */
+  RC check_unique();
+
+  /**
+   * @brief 把排好序的索引项写到刚创建的空B+树中
+   */
+  RC build(BplusTreeHandler &handler);
+
+  int64_t entry_num() const { return entry_num_; }
+
+private:
+  /**
+   * @brief 一段数据。排好序以后，要么还在内存中，要么写到了临时文件中
+   */
+  struct Run
+  {
+    vector<char> data;
+    string       file;  ///< 不为空表示数据在这个临时文件中
+    int64_t      entry_num = 0;
+    RC           rc        = RC::SUCCESS;
+  };
+
+  class RunReader;
+  class Merger;
+
+  /// 把正在填充的段交给后台线程排序
+  RC submit_run();
+
+  void sort_run(Run &run);
+
+private:
+  BplusTreeBulkLoadOptions options_;
+  KeyComparator            key_comparator_;
+  int                      attr_length_ = 0;
+  int                      key_length_  = 0;  ///< 索引项的长度，attr_length + sizeof(RID)
+  string                   tmp_file_prefix_;
+
+  int64_t run_entry_capacity_ = 0;  ///< 每一段最多存放的索引项个数
+  int64_t entry_num_          = 0;
+  int64_t memory_size_        = 0;  ///< 留在内存中的段的大小
+
+  unique_ptr<Run>        current_run_;  ///< 正在填充的段
+  deque<unique_ptr<Run>> runs_;
+  deque<thread>          sort_threads_;  ///< 还没有结束的排序线程
+  bool                   finished_ = false;
+};
@@ -16,10 +16,12 @@ See the Mulan PSL v2 for more details. */
 #include "common/log/log.h"
 #include "storage/table/table.h"
 #include "storage/db/db.h"
+#include "storage/trx/trx.h"
 
 BplusTreeIndex::~BplusTreeIndex() noexcept { close(); }
 
-RC BplusTreeIndex::create(Table *table, const char *file_name, const IndexMeta &index_meta, const FieldMeta &field_meta)
+RC BplusTreeIndex::create(
+    Table *table, const char *file_name, const IndexMeta &index_meta, const vector<FieldMeta> &field_metas)
 {
   if (inited_) {
     LOG_WARN("Failed to create index due to the index has been created before. file_name:%s, index:%s, field:%s",
@@ -27,10 +29,17 @@ RC BplusTreeIndex::create(Table *table, const char *file_name, const IndexMeta &
     return RC::RECORD_OPENNED;
   }
 
-  Index::init(index_meta, field_meta);
+  Index::init(index_meta, field_metas);
+
+  vector<AttrType> attr_types;
+  vector<int>      attr_lengths;
+  for (const FieldMeta &field_meta : field_metas) {
+    attr_types.push_back(field_meta.type());
+    attr_lengths.push_back(field_meta.len());
+  }
 
   BufferPoolManager &bpm = table->db()->buffer_pool_manager();
-  RC rc = index_handler_.create(table->db()->log_handler(), bpm, file_name, field_meta.type(), field_meta.len());
+  RC rc = index_handler_.create(table->db()->log_handler(), bpm, file_name, attr_types, attr_lengths);
   if (RC::SUCCESS != rc) {
     LOG_WARN("Failed to create index_handler, file_name:%s, index:%s, field:%s, rc:%s",
         file_name, index_meta.name(), index_meta.field(), strrc(rc));
@@ -44,7 +53,8 @@ RC BplusTreeIndex::create(Table *table, const char *file_name, const IndexMeta &
   return RC::SUCCESS;
 }
 
-RC BplusTreeIndex::open(Table *table, const char *file_name, const IndexMeta &index_meta, const FieldMeta &field_meta)
+RC BplusTreeIndex::open(
+    Table *table, const char *file_name, const IndexMeta &index_meta, const vector<FieldMeta> &field_metas)
 {
   if (inited_) {
     LOG_WARN("Failed to open index due to the index has been initedd before. file_name:%s, index:%s, field:%s",
@@ -52,7 +62,7 @@ RC BplusTreeIndex::open(Table *table, const char *file_name, const IndexMeta &in
     return RC::RECORD_OPENNED;
   }
 
-  Index::init(index_meta, field_meta);
+  Index::init(index_meta, field_metas);
 
   BufferPoolManager &bpm = table->db()->buffer_pool_manager();
   RC                 rc  = index_handler_.open(table->db()->log_handler(), bpm, file_name);
@@ -62,6 +72,14 @@ RC BplusTreeIndex::open(Table *table, const char *file_name, const IndexMeta &in
     return rc;
   }
 
+  if (index_handler_.file_header().attr_num != static_cast<int>(field_metas.size()) ||
+      index_handler_.file_header().attr_length != key_length()) {
+    LOG_WARN("index file does not match the index meta. file_name:%s, index:%s, file attr num:%d, field num:%d",
+        file_name, index_meta.name(), index_handler_.file_header().attr_num, static_cast<int>(field_metas.size()));
+    index_handler_.close();
+    return RC::INTERNAL;
+  }
+
   inited_ = true;
   table_  = table;
   LOG_INFO("Successfully open index, file_name:%s, index:%s, field:%s",
@@ -82,12 +100,60 @@ RC BplusTreeIndex::close()
 
 RC BplusTreeIndex::insert_entry(const char *record, const RID *rid)
 {
-  return index_handler_.insert_entry(record + field_meta_.offset(), rid);
+  vector<char> key_buffer;
+  const char  *user_key = make_user_key(record, key_buffer);
+  if (!index_meta_.unique()) {
+    return index_handler_.insert_entry(user_key, rid);
+  }
+
+  lock_guard guard(unique_lock_);
+
+  RC rc = check_unique(user_key, record, *rid);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+  return index_handler_.insert_entry(user_key, rid);
+}
+
+RC BplusTreeIndex::check_unique(const char *user_key, const char *record, const RID &rid)
+{
+  vector<RID> rids;
+  RC          rc = index_handler_.get_entries(user_key, key_length(), rids);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to get entries from unique index. index=%s, rc=%s", index_meta_.name(), strrc(rc));
+    return rc;
+  }
+
+  TrxKit &trx_kit = table_->db()->trx_kit();
+  for (const RID &existing_rid : rids) {
+    if (existing_rid == rid) {
+      continue;
+    }
+
+    Record existing_record;
+    rc = table_->get_record(existing_rid, existing_record);
+    if (rc == RC::RECORD_NOT_EXIST) {
+      continue;
+    }
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to get record of index entry. index=%s, rid=%s, rc=%s",
+               index_meta_.name(), existing_rid.to_string().c_str(), strrc(rc));
+      return rc;
+    }
+
+    if (trx_kit.is_duplicate(table_, existing_record, record)) {
+      LOG_TRACE("duplicate key in unique index. index=%s, existing rid=%s",
+                index_meta_.name(), existing_rid.to_string().c_str());
+      return RC::RECORD_DUPLICATE_KEY;
+    }
+  }
+  return RC::SUCCESS;
 }
 
 RC BplusTreeIndex::delete_entry(const char *record, const RID *rid)
 {
-  return index_handler_.delete_entry(record + field_meta_.offset(), rid);
+  vector<char> key_buffer;
+  return index_handler_.delete_entry(make_user_key(record, key_buffer), rid);
 }
 
 IndexScanner *BplusTreeIndex::create_scanner(
@@ -103,6 +169,13 @@ IndexScanner *BplusTreeIndex::create_scanner(
   return index_scanner;
 }
 
+RC BplusTreeIndex::get_entries(const char *key, int key_len, vector<RID> &rids)
+{
+  return index_handler_.get_entries(key, key_len, rids);
+}
+
+RC BplusTreeIndex::bulk_load(BplusTreeBulkLoader &loader) { return loader.build(index_handler_); }
+
 RC BplusTreeIndex::sync() { return index_handler_.sync(); }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -118,6 +191,8 @@ RC BplusTreeIndexScanner::open(
 
 RC BplusTreeIndexScanner::next_entry(RID *rid) { return tree_scanner_.next_entry(*rid); }
 
+RC BplusTreeIndexScanner::next_entry(RID *rid, char *key) { return tree_scanner_.next_entry(*rid, key); }
+
 RC BplusTreeIndexScanner::destroy()
 {
   delete this;
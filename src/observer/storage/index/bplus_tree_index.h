@@ -14,7 +14,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/lang/mutex.h"
 #include "storage/index/bplus_tree.h"
+#include "storage/index/bplus_tree_bulk_loader.h"
 #include "storage/index/index.h"
 
 /**
@@ -27,8 +29,10 @@ public:
   BplusTreeIndex() = default;
   virtual ~BplusTreeIndex() noexcept;
 
-  RC create(Table *table, const char *file_name, const IndexMeta &index_meta, const FieldMeta &field_meta) override;
-  RC open(Table *table, const char *file_name, const IndexMeta &index_meta, const FieldMeta &field_meta) override;
+  RC create(
+      Table *table, const char *file_name, const IndexMeta &index_meta, const vector<FieldMeta> &field_metas) override;
+  RC open(
+      Table *table, const char *file_name, const IndexMeta &index_meta, const vector<FieldMeta> &field_metas) override;
   RC close();
 
   RC insert_entry(const char *record, const RID *rid) override;
@@ -40,12 +44,27 @@ public:
   IndexScanner *create_scanner(const char *left_key, int left_len, bool left_inclusive, const char *right_key,
       int right_len, bool right_inclusive) override;
 
+  RC get_entries(const char *key, int key_len, vector<RID> &rids) override;
+
+  /**
+   * @brief 用排好序的索引项构建刚创建的空索引
+   */
+  RC bulk_load(BplusTreeBulkLoader &loader);
+
   RC sync() override;
 
+private:
+  /**
+   * @brief 唯一索引插入前检查是否已经有相同键值的记录
+   * @details 索引中可能还保留着旧版本的记录，由事务模块判断已有的记录是否构成冲突
+   */
+  RC check_unique(const char *user_key, const char *record, const RID &rid);
+
 private:
   bool             inited_ = false;
   Table           *table_  = nullptr;
   BplusTreeHandler index_handler_;
+  common::Mutex    unique_lock_;  ///< 唯一索引的检查和插入需要原子地完成
 };
 
 /**
@@ -59,6 +78,7 @@ public:
   ~BplusTreeIndexScanner() noexcept override;
 
   RC next_entry(RID *rid) override;
+  RC next_entry(RID *rid, char *key) override;
   RC destroy() override;
 
   RC open(const char *left_key, int left_len, bool left_inclusive, const char *right_key, int right_len,
@@ -70,11 +70,11 @@ RC LogEntryHandler::serialize_header(Serializer &buffer) const
   int32_t type     = this->operation_type().index();
   PageNum page_num = frame_->page_num();
 
-  int ret = buffer.write_int32(type);
+  int ret = buffer.write_varint32(type);
   if (ret < 0) {
     return RC::INTERNAL;
   }
-  ret = buffer.write_int32(page_num);
+  ret = buffer.write_varint32(page_num);
   if (ret < 0) {
     return RC::INTERNAL;
   }
@@ -111,7 +111,7 @@ RC LogEntryHandler::from_buffer(
 {
   int32_t type     = -1;
   PageNum page_num = -1;
-  int     ret      = buffer.read_int32(type);
+  int     ret      = buffer.read_varint32(type);
   if (ret != 0) {
     return RC::INVALID_ARGUMENT;
   }
@@ -120,7 +120,7 @@ RC LogEntryHandler::from_buffer(
     return RC::INVALID_ARGUMENT;
   }
 
-  ret = buffer.read_int32(page_num);
+  ret = buffer.read_varint32(page_num);
   if (ret != 0) {
     return RC::INVALID_ARGUMENT;
   }
@@ -237,7 +237,7 @@ SetParentPageLogEntryHandler::SetParentPageLogEntryHandler(
 
 RC SetParentPageLogEntryHandler::serialize_body(Serializer &buffer) const
 {
-  int ret = buffer.write_int32(parent_page_num_);
+  int ret = buffer.write_varint32(parent_page_num_);
   return ret == 0 ? RC::SUCCESS : RC::INTERNAL;
 }
 
@@ -252,7 +252,7 @@ RC SetParentPageLogEntryHandler::deserialize(Frame *frame, Deserializer &buffer,
 {
   int     ret             = 0;
   int32_t parent_page_num = -1;
-  if ((ret = buffer.read_int32(parent_page_num)) < 0) {
+  if ((ret = buffer.read_varint32(parent_page_num)) < 0) {
     return RC::INTERNAL;
   }
 
@@ -286,8 +286,8 @@ RC NormalOperationLogEntryHandler::serialize_body(Serializer &buffer) const
 {
   int     ret        = 0;
   int32_t item_bytes = static_cast<int32_t>(items_.size());
-  if ((ret = buffer.write_int32(index_)) < 0 || (ret = buffer.write_int32(item_num_) < 0) ||
-      (ret = buffer.write_int32(item_bytes) < 0) || (ret = buffer.write(items_) < 0)) {
+  if ((ret = buffer.write_varint32(index_)) < 0 || (ret = buffer.write_varint32(item_num_)) < 0 ||
+      (ret = buffer.write_varint32(item_bytes)) < 0 || (ret = buffer.write(items_)) < 0) {
     return RC::INTERNAL;
   }
 
@@ -309,8 +309,8 @@ RC NormalOperationLogEntryHandler::deserialize(
   int32_t index      = -1;
   int32_t item_num   = -1;
   int32_t item_bytes = -1;
-  if ((ret = buffer.read_int32(index)) < 0 || (ret = buffer.read_int32(item_num)) < 0 ||
-      (ret = buffer.read_int32(item_bytes)) < 0) {
+  if ((ret = buffer.read_varint32(index)) < 0 || (ret = buffer.read_varint32(item_num)) < 0 ||
+      (ret = buffer.read_varint32(item_bytes)) < 0) {
     return RC::INTERNAL;
   }
 
@@ -383,7 +383,7 @@ LeafSetNextPageLogEntryHandler::LeafSetNextPageLogEntryHandler(Frame *frame, Pag
 
 RC LeafSetNextPageLogEntryHandler::serialize_body(Serializer &buffer) const
 {
-  buffer.write_int32(new_page_num_);
+  buffer.write_varint32(new_page_num_);
   return RC::SUCCESS;
 }
 
@@ -398,7 +398,7 @@ RC LeafSetNextPageLogEntryHandler::deserialize(Frame *frame, Deserializer &buffe
 {
   int     ret      = 0;
   int32_t page_num = -1;
-  if ((ret = buffer.read_int32(page_num)) < 0) {
+  if ((ret = buffer.read_varint32(page_num)) < 0) {
     return RC::INTERNAL;
   }
 
@@ -455,9 +455,9 @@ InternalCreateNewRootLogEntryHandler::InternalCreateNewRootLogEntryHandler(
 
 RC InternalCreateNewRootLogEntryHandler::serialize_body(Serializer &buffer) const
 {
-  buffer.write_int32(first_page_num_);
-  buffer.write_int32(page_num_);
-  buffer.write_int32(static_cast<int32_t>(key_.size()));
+  buffer.write_varint32(first_page_num_);
+  buffer.write_varint32(page_num_);
+  buffer.write_varint32(static_cast<int32_t>(key_.size()));
   buffer.write(key_);
   return RC::SUCCESS;
 }
@@ -477,8 +477,8 @@ RC InternalCreateNewRootLogEntryHandler::deserialize(
   int32_t first_page_num = -1;
   int32_t page_num       = -1;
   int32_t key_size       = -1;
-  if ((ret = buffer.read_int32(first_page_num)) < 0 || (ret = buffer.read_int32(page_num)) < 0 ||
-      (ret = buffer.read_int32(key_size)) < 0) {
+  if ((ret = buffer.read_varint32(first_page_num)) < 0 || (ret = buffer.read_varint32(page_num)) < 0 ||
+      (ret = buffer.read_varint32(key_size)) < 0) {
     return RC::INTERNAL;
   }
 
@@ -510,8 +510,8 @@ InternalUpdateKeyLogEntryHandler::InternalUpdateKeyLogEntryHandler(
 
 RC InternalUpdateKeyLogEntryHandler::serialize_body(Serializer &buffer) const
 {
-  buffer.write_int32(index_);
-  buffer.write_int32(static_cast<int32_t>(key_.size()));
+  buffer.write_varint32(index_);
+  buffer.write_varint32(static_cast<int32_t>(key_.size()));
   buffer.write(key_);
   return RC::SUCCESS;
 }
@@ -530,7 +530,7 @@ RC InternalUpdateKeyLogEntryHandler::deserialize(
 
   int32_t index    = -1;
   int32_t key_size = -1;
-  if ((ret = buffer.read_int32(index)) < 0 || (ret = buffer.read_int32(key_size)) < 0) {
+  if ((ret = buffer.read_varint32(index)) < 0 || (ret = buffer.read_varint32(key_size)) < 0) {
     return RC::INTERNAL;
   }
 
@@ -572,7 +572,7 @@ UpdateRootPageLogEntryHandler::UpdateRootPageLogEntryHandler(Frame *frame, PageN
 
 RC UpdateRootPageLogEntryHandler::serialize_body(Serializer &buffer) const
 {
-  buffer.write_int32(root_page_num_);
+  buffer.write_varint32(root_page_num_);
   return RC::SUCCESS;
 }
 
@@ -587,7 +587,7 @@ RC UpdateRootPageLogEntryHandler::deserialize(Frame *frame, Deserializer &buffer
 {
   int     ret           = 0;
   int32_t root_page_num = -1;
-  if ((ret = buffer.read_int32(root_page_num)) < 0) {
+  if ((ret = buffer.read_varint32(root_page_num)) < 0) {
     return RC::INTERNAL;
   }
 
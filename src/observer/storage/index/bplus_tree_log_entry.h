@@ -71,6 +71,7 @@ private:
  * @brief B+树日志处理辅助类
  * @ingroup CLog
  * @details 每种操作类型的日志，都有一个具体的实现类。
+ * 操作类型、页面编号、下标和长度这些整数都很小，使用变长编码(write_varint32)序列化，通常只占一两个字节。
  */
 class LogEntryHandler
 {
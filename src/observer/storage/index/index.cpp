@@ -14,9 +14,33 @@ See the Mulan PSL v2 for more details. */
 
 #include "storage/index/index.h"
 
-RC Index::init(const IndexMeta &index_meta, const FieldMeta &field_meta)
+RC Index::init(const IndexMeta &index_meta, const vector<FieldMeta> &field_metas)
 {
-  index_meta_ = index_meta;
-  field_meta_ = field_meta;
+  index_meta_  = index_meta;
+  field_metas_ = field_metas;
   return RC::SUCCESS;
 }
+
+int Index::key_length() const
+{
+  int length = 0;
+  for (const FieldMeta &field_meta : field_metas_) {
+    length += field_meta.len();
+  }
+  return length;
+}
+
+const char *Index::make_user_key(const char *record, vector<char> &buffer) const
+{
+  if (field_metas_.size() == 1) {
+    return record + field_metas_[0].offset();
+  }
+
+  buffer.resize(key_length());
+  char *key = buffer.data();
+  for (const FieldMeta &field_meta : field_metas_) {
+    memcpy(key, record + field_meta.offset(), field_meta.len());
+    key += field_meta.len();
+  }
+  return buffer.data();
+}
@@ -15,7 +15,8 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include <stddef.h>
-#include <vector>
+
+#include "common/lang/vector.h"
 
 #include "common/sys/rc.h"
 #include "storage/field/field_meta.h"
@@ -40,18 +41,26 @@ public:
   Index()          = default;
   virtual ~Index() = default;
 
-  virtual RC create(Table *table, const char *file_name, const IndexMeta &index_meta, const FieldMeta &field_meta)
+  /**
+   * @brief 创建索引
+   * @param field_metas 索引包含的字段，顺序与 index_meta 中的字段顺序一致
+   */
+  virtual RC create(Table *table, const char *file_name, const IndexMeta &index_meta, const vector<FieldMeta> &field_metas)
   {
     return RC::UNSUPPORTED;
   }
-  virtual RC open(Table *table, const char *file_name, const IndexMeta &index_meta, const FieldMeta &field_meta)
+  virtual RC open(Table *table, const char *file_name, const IndexMeta &index_meta, const vector<FieldMeta> &field_metas)
   {
     return RC::UNSUPPORTED;
   }
 
   virtual bool is_vector_index() { return false; }
 
-  const IndexMeta &index_meta() const { return index_meta_; }
+  const IndexMeta         &index_meta() const { return index_meta_; }
+  const vector<FieldMeta> &field_metas() const { return field_metas_; }
+
+  /// 索引键值的长度，即所有字段长度之和
+  int key_length() const;
 
   /**
    * @brief 插入一条数据
@@ -71,6 +80,8 @@ public:
 
   /**
    * @brief 创建一个索引数据的扫描器
+   * @details 多字段索引的边界可以只包含前面几个字段，此时每个字段都按照字段定义的长度存放，
+   * 边界的长度就是这几个字段的长度之和。没有给出的字段可以是任意值。
    *
    * @param left_key 要扫描的左边界
    * @param left_len 左边界的长度
@@ -82,6 +93,14 @@ public:
   virtual IndexScanner *create_scanner(const char *left_key, int left_len, bool left_inclusive, const char *right_key,
       int right_len, bool right_inclusive) = 0;
 
+  /**
+   * @brief 等值查找，找出键值等于 key 的所有记录
+   * @details 唯一索引的点查使用，不需要创建扫描器。rids 可以在多次查找之间复用
+   * @param key 所有字段的值，按照字段定义的长度依次存放
+   * @param key_len 键值的长度，单字段的字符串可以比字段短
+   */
+  virtual RC get_entries(const char *key, int key_len, vector<RID> &rids) { return RC::UNIMPLEMENTED; }
+
   /**
    * @brief 同步索引数据到磁盘
    *
@@ -89,11 +108,18 @@ public:
   virtual RC sync() = 0;
 
 protected:
-  RC init(const IndexMeta &index_meta, const FieldMeta &field_meta);
+  RC init(const IndexMeta &index_meta, const vector<FieldMeta> &field_metas);
+
+  /**
+   * @brief 从记录中取出索引的各个字段，拼接成索引的键值
+   * @details 单字段索引直接返回记录中字段的位置，不需要拷贝
+   * @param buffer 多字段索引时用来存放键值
+   */
+  const char *make_user_key(const char *record, vector<char> &buffer) const;
 
 protected:
-  IndexMeta index_meta_;  ///< 索引的元数据
-  FieldMeta field_meta_;  ///< 当前实现仅考虑一个字段的索引
+  IndexMeta         index_meta_;   ///< 索引的元数据
+  vector<FieldMeta> field_metas_;  ///< 索引包含的字段，按照键值中的顺序排列
 };
 
 /**
@@ -112,4 +138,11 @@ public:
    */
   virtual RC next_entry(RID *rid) = 0;
   virtual RC destroy()            = 0;
+
+  /**
+   * @brief 遍历元素数据，同时返回索引的键值
+   * @details 覆盖索引扫描时，直接从键值中取出各个字段，不再回表
+   * @param key 存放键值，长度是索引各个字段的长度之和
+   */
+  virtual RC next_entry(RID *rid, char *key) { return RC::UNIMPLEMENTED; }
 };
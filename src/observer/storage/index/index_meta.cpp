@@ -21,51 +21,103 @@ See the Mulan PSL v2 for more details. */
 
 const static Json::StaticString FIELD_NAME("name");
 const static Json::StaticString FIELD_FIELD_NAME("field_name");
+const static Json::StaticString FIELD_FIELD_NAMES("field_names");
+const static Json::StaticString FIELD_UNIQUE("unique");
 
-RC IndexMeta::init(const char *name, const FieldMeta &field)
+RC IndexMeta::init(const char *name, const vector<const FieldMeta *> &fields, bool unique)
 {
   if (common::is_blank(name)) {
     LOG_ERROR("Failed to init index, name is empty.");
     return RC::INVALID_ARGUMENT;
   }
 
-  name_  = name;
-  field_ = field.name();
+  if (fields.empty()) {
+    LOG_ERROR("Failed to init index, no field. name=%s", name);
+    return RC::INVALID_ARGUMENT;
+  }
+
+  name_   = name;
+  unique_ = unique;
+  fields_.clear();
+  for (const FieldMeta *field : fields) {
+    fields_.emplace_back(field->name());
+  }
   return RC::SUCCESS;
 }
 
 void IndexMeta::to_json(Json::Value &json_value) const
 {
-  json_value[FIELD_NAME]       = name_;
-  json_value[FIELD_FIELD_NAME] = field_;
+  json_value[FIELD_NAME] = name_;
+  // field_name 是只支持单字段索引时的格式，保留下来以便旧版本可以读取单字段索引
+  json_value[FIELD_FIELD_NAME] = fields_.front();
+
+  Json::Value fields_value(Json::arrayValue);
+  for (const string &field : fields_) {
+    fields_value.append(field);
+  }
+  json_value[FIELD_FIELD_NAMES] = std::move(fields_value);
+  json_value[FIELD_UNIQUE]      = unique_;
 }
 
 RC IndexMeta::from_json(const TableMeta &table, const Json::Value &json_value, IndexMeta &index)
 {
-  const Json::Value &name_value  = json_value[FIELD_NAME];
-  const Json::Value &field_value = json_value[FIELD_FIELD_NAME];
+  const Json::Value &name_value = json_value[FIELD_NAME];
   if (!name_value.isString()) {
     LOG_ERROR("Index name is not a string. json value=%s", name_value.toStyledString().c_str());
     return RC::INTERNAL;
   }
 
-  if (!field_value.isString()) {
-    LOG_ERROR("Field name of index [%s] is not a string. json value=%s",
-        name_value.asCString(), field_value.toStyledString().c_str());
-    return RC::INTERNAL;
+  // 旧版本的元数据文件中只有 field_name
+  vector<Json::Value> field_values;
+  if (json_value.isMember(FIELD_FIELD_NAMES)) {
+    const Json::Value &fields_value = json_value[FIELD_FIELD_NAMES];
+    if (!fields_value.isArray()) {
+      LOG_ERROR("Field names of index [%s] is not an array. json value=%s",
+          name_value.asCString(), fields_value.toStyledString().c_str());
+      return RC::INTERNAL;
+    }
+    for (const Json::Value &field_value : fields_value) {
+      field_values.push_back(field_value);
+    }
+  } else {
+    field_values.push_back(json_value[FIELD_FIELD_NAME]);
   }
 
-  const FieldMeta *field = table.field(field_value.asCString());
-  if (nullptr == field) {
-    LOG_ERROR("Deserialize index [%s]: no such field: %s", name_value.asCString(), field_value.asCString());
-    return RC::SCHEMA_FIELD_MISSING;
+  vector<const FieldMeta *> fields;
+  for (const Json::Value &field_value : field_values) {
+    if (!field_value.isString()) {
+      LOG_ERROR("Field name of index [%s] is not a string. json value=%s",
+          name_value.asCString(), field_value.toStyledString().c_str());
+      return RC::INTERNAL;
+    }
+
+    const FieldMeta *field = table.field(field_value.asCString());
+    if (nullptr == field) {
+      LOG_ERROR("Deserialize index [%s]: no such field: %s", name_value.asCString(), field_value.asCString());
+      return RC::SCHEMA_FIELD_MISSING;
+    }
+    fields.push_back(field);
   }
 
-  return index.init(name_value.asCString(), *field);
+  // 旧版本的元数据文件中没有 unique，都是普通索引
+  const bool unique = json_value.isMember(FIELD_UNIQUE) && json_value[FIELD_UNIQUE].asBool();
+  return index.init(name_value.asCString(), fields, unique);
 }
 
 const char *IndexMeta::name() const { return name_.c_str(); }
 
-const char *IndexMeta::field() const { return field_.c_str(); }
+const char *IndexMeta::field() const { return fields_.front().c_str(); }
 
-void IndexMeta::desc(ostream &os) const { os << "index name=" << name_ << ", field=" << field_; }
\ No newline at end of file
+void IndexMeta::desc(ostream &os) const
+{
+  os << "index name=" << name_ << ", field=";
+  for (size_t i = 0; i < fields_.size(); i++) {
+    if (i > 0) {
+      os << ",";
+    }
+    os << fields_[i];
+  }
+  if (unique_) {
+    os << ", unique";
+  }
+}
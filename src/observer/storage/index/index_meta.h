@@ -16,6 +16,7 @@ See the Mulan PSL v2 for more details. */
 
 #include "common/sys/rc.h"
 #include "common/lang/string.h"
+#include "common/lang/vector.h"
 
 class TableMeta;
 class FieldMeta;
@@ -28,6 +29,7 @@ class Value;
  * @brief 描述一个索引
  * @ingroup Index
  * @details 一个索引包含了表的哪些字段，索引的名称等。
+ * 多个字段的索引，键值按照字段的顺序依次比较。
  * 如果以后实现了多种类型的索引，还需要记录索引的类型，对应类型的一些元数据等
  */
 class IndexMeta
@@ -35,12 +37,21 @@ class IndexMeta
 public:
   IndexMeta() = default;
 
-  RC init(const char *name, const FieldMeta &field);
+  /**
+   * @param unique 是否是唯一索引，唯一索引中同一个键值只能有一条有效的记录
+   */
+  RC init(const char *name, const vector<const FieldMeta *> &fields, bool unique = false);
 
 public:
   const char *name() const;
+
+  /// 索引的第一个字段
   const char *field() const;
 
+  const vector<string> &fields() const { return fields_; }
+  int                   field_num() const { return static_cast<int>(fields_.size()); }
+  bool                  unique() const { return unique_; }
+
   void desc(ostream &os) const;
 
 public:
@@ -48,6 +59,7 @@ public:
   static RC from_json(const TableMeta &table, const Json::Value &json_value, IndexMeta &index);
 
 protected:
-  string name_;   // index's name
-  string field_;  // field's name
+  string         name_;    // index's name
+  vector<string> fields_;  // fields' name, in key order
+  bool           unique_ = false;
 };
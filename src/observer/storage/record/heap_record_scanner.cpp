@@ -17,7 +17,7 @@ RC HeapRecordScanner::open_scan()
   ASSERT(disk_buffer_pool_ != nullptr, "disk buffer pool is null");
   ASSERT(log_handler_ != nullptr, "log handler is null");
 
-  RC rc = bp_iterator_.init(*disk_buffer_pool_, 1);
+  RC rc = bp_iterator_.init(*disk_buffer_pool_, 1, true /*read_ahead*/);
   if (rc != RC::SUCCESS) {
     LOG_WARN("failed to init bp iterator. rc=%d:%s", rc, strrc(rc));
     return rc;
@@ -57,10 +57,12 @@ string RecordLogHeader::to_string() const
       ss << ", record_size:" << record_size;
     } break;
     case RecordOperation::Type::INSERT:
-    case RecordOperation::Type::DELETE:
-    case RecordOperation::Type::UPDATE: {
+    case RecordOperation::Type::DELETE: {
       ss << ", slot_num:" << slot_num;
     } break;
+    case RecordOperation::Type::UPDATE: {
+      ss << ", slot_num:" << slot_num << ", update_offset:" << update_offset;
+    } break;
     default: {
       ss << ", unknown operation type";
     } break;
@@ -129,9 +131,23 @@ RC RecordLogHandler::insert_record(Frame *frame, const RID &rid, const char *rec
   return rc;
 }
 
-RC RecordLogHandler::update_record(Frame *frame, const RID &rid, const char *record)
+RC RecordLogHandler::update_record(Frame *frame, const RID &rid, const char *old_record, const char *record)
 {
-  const int        log_payload_size = RecordLogHeader::SIZE + record_size_;
+  int begin = 0;
+  int end   = record_size_;
+  if (old_record != nullptr) {
+    while (begin < end && old_record[begin] == record[begin]) {
+      begin++;
+    }
+    while (end > begin && old_record[end - 1] == record[end - 1]) {
+      end--;
+    }
+    if (begin == end) {
+      return RC::SUCCESS;  // 没有任何修改，不需要记录日志
+    }
+  }
+
+  const int        log_payload_size = RecordLogHeader::SIZE + (end - begin);
   vector<char>     log_payload(log_payload_size);
   RecordLogHeader *header = reinterpret_cast<RecordLogHeader *>(log_payload.data());
   header->buffer_pool_id  = buffer_pool_id_;
@@ -139,7 +155,8 @@ RC RecordLogHandler::update_record(Frame *frame, const RID &rid, const char *rec
   header->page_num        = rid.page_num;
   header->slot_num        = rid.slot_num;
   header->storage_format  = static_cast<int>(storage_format_);
-  memcpy(log_payload.data() + RecordLogHeader::SIZE, record, record_size_);
+  header->update_offset   = begin;
+  memcpy(log_payload.data() + RecordLogHeader::SIZE, record + begin, end - begin);
 
   LSN lsn = 0;
   RC  rc  = log_handler_->append(lsn, LogModule::Id::RECORD_MANAGER, std::move(log_payload));
@@ -224,7 +241,7 @@ RC RecordLogReplayer::replay(const LogEntry &entry)
       rc = replay_delete(*buffer_pool, *log_header);
     } break;
     case RecordOperation::Type::UPDATE: {
-      rc = replay_update(*buffer_pool, *log_header);
+      rc = replay_update(*buffer_pool, *log_header, entry.payload_size() - RecordLogHeader::SIZE);
     } break;
     default: {
       LOG_WARN("unknown record operation type: %d", log_header->operation_type);
@@ -308,7 +325,7 @@ RC RecordLogReplayer::replay_delete(DiskBufferPool &buffer_pool, const RecordLog
   return rc;
 }
 
-RC RecordLogReplayer::replay_update(DiskBufferPool &buffer_pool, const RecordLogHeader &header)
+RC RecordLogReplayer::replay_update(DiskBufferPool &buffer_pool, const RecordLogHeader &header, int32_t data_size)
 {
   VacuousLogHandler             vacuous_log_handler;
   unique_ptr<RecordPageHandler> record_page_handler(RecordPageHandler::create(StorageFormat(header.storage_format)));
@@ -319,8 +336,25 @@ RC RecordLogReplayer::replay_update(DiskBufferPool &buffer_pool, const RecordLog
     return rc;
   }
 
-  RID rid(header.page_num, header.slot_num);
-  rc = record_page_handler->update_record(rid, header.data);
+  // 日志中只有修改过的那一段数据，在当前记录上打补丁
+  RID    rid(header.page_num, header.slot_num);
+  Record record;
+  rc = record_page_handler->get_record(rid, record);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("fail to get record to recover update. page num=%d, slot num=%d, rc=%s",
+             header.page_num, header.slot_num, strrc(rc));
+    return rc;
+  }
+
+  if (header.update_offset < 0 || data_size < 0 || header.update_offset + data_size > record.len()) {
+    LOG_WARN("invalid update record log. %s, data size=%d, record size=%d",
+             header.to_string().c_str(), data_size, record.len());
+    return RC::INVALID_ARGUMENT;
+  }
+
+  vector<char> new_record(record.data(), record.data() + record.len());
+  memcpy(new_record.data() + header.update_offset, header.data, data_size);
+  rc = record_page_handler->update_record(rid, new_record.data());
   if (OB_FAIL(rc)) {
     LOG_WARN("fail to recover update record. page num=%d, slot num=%d, rc=%s", 
              header.page_num, header.slot_num, strrc(rc));
@@ -58,13 +58,23 @@ private:
   Type type_;
 };
 
+/**
+ * @brief 记录管理器日志的头部，后面紧跟着日志数据
+ * @details INIT_PAGE 的数据是列索引，INSERT 的数据是完整的记录。
+ * UPDATE 只记录修改过的那一段字节，从记录的 update_offset 开始，长度是日志数据的长度。
+ * 比如事务提交时只修改记录中4个字节的事务ID，日志中也只有这4个字节。
+ */
 struct RecordLogHeader
 {
   int32_t buffer_pool_id;
   int32_t operation_type;
   PageNum page_num;
   int32_t storage_format;
-  int32_t column_num;
+  union
+  {
+    int32_t column_num;     /// INIT_PAGE
+    int32_t update_offset;  /// UPDATE
+  };
   union
   {
     SlotNum slot_num;
@@ -118,12 +128,14 @@ public:
 
   /**
    * @brief 更新一条记录
+   * @details 更新数据时，通常只更新其中几个字段，所以只记录新旧数据中第一个不同的字节到最后一个不同的字节。
+   * 不需要做回滚，所以不用记录原先的数据。
    * @param frame 页帧
    * @param rid 记录的位置
-   * @param record 更新后的记录。不需要做回滚，所以不用记录原先的数据
-   * @details 更新数据时，通常只更新其中几个字段，这里记录所有数据，是可以优化的。
+   * @param old_record 更新前的记录。为空时记录完整的新记录
+   * @param record 更新后的记录
    */
-  RC update_record(Frame *frame, const RID &rid, const char *record);
+  RC update_record(Frame *frame, const RID &rid, const char *old_record, const char *record);
 
 private:
   LogHandler   *log_handler_    = nullptr;
@@ -148,7 +160,7 @@ private:
   RC replay_init_page(DiskBufferPool &buffer_pool, const RecordLogHeader &log_header);
   RC replay_insert(DiskBufferPool &buffer_pool, const RecordLogHeader &log_header);
   RC replay_delete(DiskBufferPool &buffer_pool, const RecordLogHeader &log_header);
-  RC replay_update(DiskBufferPool &buffer_pool, const RecordLogHeader &log_header);
+  RC replay_update(DiskBufferPool &buffer_pool, const RecordLogHeader &log_header, int32_t data_size);
 
 private:
   BufferPoolManager &bpm_;
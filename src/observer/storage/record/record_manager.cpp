@@ -371,14 +371,13 @@ RC RowRecordPageHandler::update_record(const RID &rid, const char *data)
   if (bitmap.get_bit(rid.slot_num)) {
     frame_->mark_dirty();
 
+    // 先记日志再覆盖数据，日志中只需要记录和旧数据不同的部分。原地修改的数据已经没有旧数据可以比较了
     char *record_data = get_record_data(rid.slot_num);
-    if (record_data == data) {
-      // nothing to do
-    } else {
+    RC    rc          = log_handler_.update_record(frame_, rid, record_data == data ? nullptr : record_data, data);
+    if (record_data != data) {
       memcpy(record_data, data, page_header_->record_real_size);
     }
 
-    RC rc = log_handler_.update_record(frame_, rid, data);
     if (OB_FAIL(rc)) {
       LOG_ERROR("Failed to update record. page_num %d:%d. rc=%s", 
                 disk_buffer_pool_->file_desc(), frame_->page_num(), strrc(rc));
@@ -580,6 +579,7 @@ void RecordFileHandler::close()
 {
   if (disk_buffer_pool_ != nullptr) {
     free_pages_.clear();
+    visibility_map_.reset();
     disk_buffer_pool_ = nullptr;
     log_handler_      = nullptr;
     table_meta_       = nullptr;
@@ -595,7 +595,7 @@ RC RecordFileHandler::init_free_pages()
   RC rc = RC::SUCCESS;
 
   BufferPoolIterator bp_iterator;
-  bp_iterator.init(*disk_buffer_pool_, 1);
+  bp_iterator.init(*disk_buffer_pool_, 1, true /*read_ahead*/);
   unique_ptr<RecordPageHandler> record_page_handler(RecordPageHandler::create(storage_format_));
   PageNum                       current_page_num = 0;
 
@@ -680,6 +680,7 @@ RC RecordFileHandler::insert_record(const char *data, int record_size, RID *rid)
   }
 
   // 找到空闲位置
+  visibility_map_.clear(current_page_num);
   return record_page_handler->insert_record(data, rid);
 }
 
@@ -701,6 +702,7 @@ RC RecordFileHandler::recover_insert_record(const char *data, int record_size, c
     return ret;
   }
 
+  visibility_map_.clear(rid.page_num);
   return record_page_handler->recover_insert_record(data, rid);
 }
 
@@ -716,6 +718,7 @@ RC RecordFileHandler::delete_record(const RID *rid)
     return rc;
   }
 
+  visibility_map_.clear(rid->page_num);
   rc = record_page_handler->delete_record(rid);
   // 📢 这里注意要清理掉资源，否则会与insert_record中的加锁顺序冲突而可能出现死锁
   // delete record的加锁逻辑是拿到页面锁，删除指定记录，然后加上和释放record manager锁
@@ -779,11 +782,53 @@ RC RecordFileHandler::visit_record(const RID &rid, function<bool(Record &)> upda
 
   bool updated = updater(record);
   if (updated) {
+    visibility_map_.clear(rid.page_num);
     rc = page_handler->update_record(rid, record.data());
   }
   return rc;
 }
 
+RC RecordFileHandler::mark_all_visible_pages(function<bool(const Record &)> all_visible, int &page_count)
+{
+  page_count = 0;
+
+  RC rc = RC::SUCCESS;
+
+  BufferPoolIterator bp_iterator;
+  bp_iterator.init(*disk_buffer_pool_, 1, true /*read_ahead*/);
+  unique_ptr<RecordPageHandler> record_page_handler(RecordPageHandler::create(storage_format_));
+
+  while (bp_iterator.has_next()) {
+    const PageNum page_num = bp_iterator.next();
+    if (visibility_map_.is_all_visible(page_num)) {
+      continue;
+    }
+
+    rc = record_page_handler->init(*disk_buffer_pool_, *log_handler_, page_num, ReadWriteMode::READ_ONLY);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to init record page handler. page num=%d, rc=%s", page_num, strrc(rc));
+      return rc;
+    }
+
+    RecordPageIterator record_iterator;
+    record_iterator.init(record_page_handler.get());
+
+    bool   visible = true;
+    Record record;
+    while (visible && record_iterator.has_next()) {
+      visible = OB_SUCC(record_iterator.next(record)) && all_visible(record);
+    }
+
+    // 持有页面读锁时标记，修改页面的操作要拿写锁，会等到这里结束以后再清除标记
+    if (visible) {
+      visibility_map_.set_all_visible(page_num);
+      page_count++;
+    }
+    record_page_handler->cleanup();
+  }
+  return RC::SUCCESS;
+}
+
 ChunkFileScanner::~ChunkFileScanner() { close_scan(); }
 
 RC ChunkFileScanner::close_scan()
@@ -811,7 +856,7 @@ RC ChunkFileScanner::open_scan_chunk(
   log_handler_      = &log_handler;
   rw_mode_          = mode;
 
-  RC rc = bp_iterator_.init(buffer_pool, 1);
+  RC rc = bp_iterator_.init(buffer_pool, 1, true /*read_ahead*/);
   if (rc != RC::SUCCESS) {
     LOG_WARN("failed to init bp iterator. rc=%d:%s", rc, strrc(rc));
     return rc;
@@ -16,11 +16,13 @@ See the Mulan PSL v2 for more details. */
 
 #include "common/lang/bitmap.h"
 #include "common/lang/sstream.h"
+#include "common/lang/unordered_set.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/common/chunk.h"
 #include "storage/record/record.h"
 #include "storage/record/record_log.h"
 #include "storage/record/lob_handler.h"
+#include "storage/record/visibility_map.h"
 #include "common/types.h"
 
 class LogHandler;
@@ -413,6 +415,20 @@ public:
 
   RC visit_record(const RID &rid, function<bool(Record &)> updater);
 
+  /**
+   * @brief 页面上的记录是否对所有事务都可见
+   * @details 只有清理线程检查过并且之后没有修改过的页面才会返回true
+   */
+  bool is_all_visible(PageNum page_num) const { return visibility_map_.is_all_visible(page_num); }
+
+  /**
+   * @brief 检查所有页面，把所有记录都满足条件的页面标记为全部可见
+   * @details 检查时持有页面的读锁，检查和标记之间页面不会被修改
+   * @param all_visible 判断一条记录是否对所有事务可见
+   * @param page_count 返回标记为全部可见的页面数
+   */
+  RC mark_all_visible_pages(function<bool(const Record &)> all_visible, int &page_count);
+
 private:
   /**
    * @brief 初始化当前没有填满记录的页面，初始化free_pages_成员
@@ -427,6 +443,7 @@ private:
   StorageFormat          storage_format_;
   TableMeta             *table_meta_;
   LobFileHandler        *lob_handler_ = nullptr;
+  VisibilityMap          visibility_map_;  ///< 哪些页面上的记录对所有事务都可见
 };
 
 /**
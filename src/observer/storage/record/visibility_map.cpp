@@ -0,0 +1,67 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/record/visibility_map.h"
+
+static constexpr int WORD_BITS = 64;
+
+bool VisibilityMap::is_all_visible(PageNum page_num) const
+{
+  if (page_num < 0) {
+    return false;
+  }
+
+  const size_t   word = page_num / WORD_BITS;
+  const uint64_t mask = 1ULL << (page_num % WORD_BITS);
+
+  lock_.lock_shared();
+  const bool visible = word < bits_.size() && (bits_[word] & mask) != 0;
+  lock_.unlock_shared();
+  return visible;
+}
+
+void VisibilityMap::set_all_visible(PageNum page_num)
+{
+  if (page_num < 0) {
+    return;
+  }
+
+  const size_t   word = page_num / WORD_BITS;
+  const uint64_t mask = 1ULL << (page_num % WORD_BITS);
+
+  lock_.lock();
+  if (word >= bits_.size()) {
+    bits_.resize(word + 1, 0);
+  }
+  bits_[word] |= mask;
+  lock_.unlock();
+}
+
+void VisibilityMap::clear(PageNum page_num)
+{
+  // 绝大多数页面都没有标记，先用读锁检查，避免每次修改记录都去抢写锁
+  if (!is_all_visible(page_num)) {
+    return;
+  }
+
+  const size_t   word = page_num / WORD_BITS;
+  const uint64_t mask = 1ULL << (page_num % WORD_BITS);
+
+  lock_.lock();
+  bits_[word] &= ~mask;
+  lock_.unlock();
+}
+
+void VisibilityMap::reset()
+{
+  lock_.lock();
+  bits_.clear();
+  lock_.unlock();
+}
@@ -0,0 +1,50 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/mutex.h"
+#include "common/lang/vector.h"
+#include "common/types.h"
+
+/**
+ * @brief 记录文件的可见性位图
+ * @ingroup RecordManager
+ * @details 每个页面一位，置位表示这个页面上的所有记录对所有事务都可见，读取时不需要再检查记录上的事务信息。
+ * 覆盖索引扫描依赖它来跳过回表。
+ * 位图只在内存中维护，重启以后全部为空，等待清理线程重新标记，这样做只是少了一些优化，不会出错。
+ * 标记页面时需要持有页面的读锁，修改页面时持有页面的写锁并清除标记，所以两者不会交错。
+ */
+class VisibilityMap
+{
+public:
+  VisibilityMap()  = default;
+  ~VisibilityMap() = default;
+
+  bool is_all_visible(PageNum page_num) const;
+
+  /**
+   * @brief 标记页面上的记录全部可见
+   * @details 调用者需要持有页面的读锁
+   */
+  void set_all_visible(PageNum page_num);
+
+  /**
+   * @brief 页面即将被修改，清除标记
+   * @details 调用者需要持有页面的写锁
+   */
+  void clear(PageNum page_num);
+
+  void reset();
+
+private:
+  mutable common::SharedMutex lock_;
+  vector<uint64_t>            bits_;
+};
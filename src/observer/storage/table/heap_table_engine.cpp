@@ -10,7 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #include "storage/table/heap_table_engine.h"
 #include "storage/record/heap_record_scanner.h"
+#include "common/lang/algorithm.h"
 #include "common/log/log.h"
+#include "storage/index/bplus_tree_bulk_loader.h"
 #include "storage/index/bplus_tree_index.h"
 #include "storage/common/meta_util.h"
 #include "storage/db/db.h"
@@ -78,6 +80,13 @@ RC HeapTableEngine::visit_record(const RID &rid, function<bool(Record &)> visito
   return record_handler_->visit_record(rid, visitor);
 }
 
+bool HeapTableEngine::is_all_visible(const RID &rid) const { return record_handler_->is_all_visible(rid.page_num); }
+
+RC HeapTableEngine::mark_all_visible_pages(function<bool(const Record &)> all_visible, int &page_count)
+{
+  return record_handler_->mark_all_visible_pages(all_visible, page_count);
+}
+
 RC HeapTableEngine::get_record(const RID &rid, Record &record)
 {
   RC rc = record_handler_->get_record(rid, record);
@@ -121,61 +130,68 @@ RC HeapTableEngine::get_chunk_scanner(ChunkFileScanner &scanner, Trx *trx, ReadW
   return rc;
 }
 
-RC HeapTableEngine::create_index(Trx *trx, const FieldMeta *field_meta, const char *index_name)
+RC HeapTableEngine::create_index(
+    Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, bool unique)
 {
-  if (common::is_blank(index_name) || nullptr == field_meta) {
+  if (common::is_blank(index_name) || field_metas.empty() ||
+      find(field_metas.begin(), field_metas.end(), nullptr) != field_metas.end()) {
     LOG_INFO("Invalid input arguments, table name is %s, index_name is blank or attribute_name is blank", table_meta_->name());
     return RC::INVALID_ARGUMENT;
   }
 
   IndexMeta new_index_meta;
 
-  RC rc = new_index_meta.init(index_name, *field_meta);
+  RC rc = new_index_meta.init(index_name, field_metas, unique);
   if (rc != RC::SUCCESS) {
     LOG_INFO("Failed to init IndexMeta in table:%s, index_name:%s, field_name:%s", 
-             table_meta_->name(), index_name, field_meta->name());
+             table_meta_->name(), index_name, field_metas[0]->name());
     return rc;
   }
 
-  // 创建索引相关数据
-  BplusTreeIndex *index      = new BplusTreeIndex();
-  string          index_file = table_index_file(db_->path().c_str(), table_meta_->name(), index_name);
-
-  rc = index->create(table_, index_file.c_str(), new_index_meta, *field_meta);
-  if (rc != RC::SUCCESS) {
-    delete index;
-    LOG_ERROR("Failed to create bplus tree index. file name=%s, rc=%d:%s", index_file.c_str(), rc, strrc(rc));
-    return rc;
+  vector<FieldMeta> index_fields;
+  vector<AttrType>  attr_types;
+  vector<int32_t>   attr_lengths;
+  for (const FieldMeta *field_meta : field_metas) {
+    index_fields.push_back(*field_meta);
+    attr_types.push_back(field_meta->type());
+    attr_lengths.push_back(field_meta->len());
   }
 
-  // 遍历当前的所有数据，插入这个索引
-  RecordScanner *scanner = nullptr;
-  rc                     = get_record_scanner(scanner, trx, ReadWriteMode::READ_ONLY);
-  if (rc != RC::SUCCESS) {
-    LOG_WARN("failed to create scanner while creating index. table=%s, index=%s, rc=%s", 
-             table_meta_->name(), index_name, strrc(rc));
+  string index_file = table_index_file(db_->path().c_str(), table_meta_->name(), index_name);
+
+  // 先取出所有的索引项排好序，唯一索引在创建索引文件之前检查，有重复时不会留下半成品的索引文件
+  BplusTreeBulkLoader loader(db_->index_build_options(), attr_types, attr_lengths, index_file + ".sort");
+  rc = collect_index_entries(trx, field_metas, index_name, loader);
+  if (OB_FAIL(rc)) {
     return rc;
   }
 
-  Record record;
-  while (OB_SUCC(rc = scanner->next(record))) {
-    rc = index->insert_entry(record.data(), &record.rid());
-    if (rc != RC::SUCCESS) {
-      LOG_WARN("failed to insert record into index while creating index. table=%s, index=%s, rc=%s",
-               table_meta_->name(), index_name, strrc(rc));
+  if (unique) {
+    rc = loader.check_unique();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to create unique index. table=%s, index=%s, rc=%s", table_meta_->name(), index_name, strrc(rc));
       return rc;
     }
   }
-  if (RC::RECORD_EOF == rc) {
-    rc = RC::SUCCESS;
-  } else {
-    LOG_WARN("failed to insert record into index while creating index. table=%s, index=%s, rc=%s",
-             table_meta_->name(), index_name, strrc(rc));
+
+  // 创建索引相关数据
+  BplusTreeIndex *index = new BplusTreeIndex();
+
+  rc = index->create(table_, index_file.c_str(), new_index_meta, index_fields);
+  if (rc != RC::SUCCESS) {
+    delete index;
+    LOG_ERROR("Failed to create bplus tree index. file name=%s, rc=%d:%s", index_file.c_str(), rc, strrc(rc));
     return rc;
   }
-  scanner->close_scan();
-  delete scanner;
-  LOG_INFO("inserted all records into new index. table=%s, index=%s", table_meta_->name(), index_name);
+
+  rc = index->bulk_load(loader);
+  if (OB_FAIL(rc)) {
+    delete index;
+    LOG_WARN("failed to bulk load index. table=%s, index=%s, rc=%s", table_meta_->name(), index_name, strrc(rc));
+    return rc;
+  }
+  LOG_INFO("loaded all records into new index. table=%s, index=%s, entry num=%ld",
+           table_meta_->name(), index_name, loader.entry_num());
 
   indexes_.push_back(index);
 
@@ -220,6 +236,41 @@ RC HeapTableEngine::create_index(Trx *trx, const FieldMeta *field_meta, const ch
   return rc;
 }
 
+RC HeapTableEngine::collect_index_entries(
+    Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, BplusTreeBulkLoader &loader)
+{
+  RecordScanner *scanner = nullptr;
+  RC             rc      = get_record_scanner(scanner, trx, ReadWriteMode::READ_ONLY);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to create scanner while creating index. table=%s, index=%s, rc=%s",
+             table_meta_->name(), index_name, strrc(rc));
+    return rc;
+  }
+
+  string key;
+  Record record;
+  while (OB_SUCC(rc = scanner->next(record))) {
+    key.clear();
+    for (const FieldMeta *field_meta : field_metas) {
+      key.append(record.data() + field_meta->offset(), field_meta->len());
+    }
+    rc = loader.add(key.data(), record.rid());
+    if (OB_FAIL(rc)) {
+      break;
+    }
+  }
+
+  scanner->close_scan();
+  delete scanner;
+  if (rc != RC::RECORD_EOF) {
+    LOG_WARN("failed to collect index entries while creating index. table=%s, index=%s, rc=%s",
+             table_meta_->name(), index_name, strrc(rc));
+    return rc;
+  }
+
+  return loader.finish();
+}
+
 RC HeapTableEngine::insert_entry_of_indexes(const char *record, const RID &rid)
 {
   RC rc = RC::SUCCESS;
@@ -314,20 +365,24 @@ RC HeapTableEngine::open()
   init();
   const int index_num = table_meta_->index_num();
   for (int i = 0; i < index_num; i++) {
-    const IndexMeta *index_meta = table_meta_->index(i);
-    const FieldMeta *field_meta = table_meta_->field(index_meta->field());
-    if (field_meta == nullptr) {
-      LOG_ERROR("Found invalid index meta info which has a non-exists field. table=%s, index=%s, field=%s",
-                table_meta_->name(), index_meta->name(), index_meta->field());
-      // skip cleanup
-      //  do all cleanup action in destructive Table function
-      return RC::INTERNAL;
+    const IndexMeta  *index_meta = table_meta_->index(i);
+    vector<FieldMeta> index_fields;
+    for (const string &field_name : index_meta->fields()) {
+      const FieldMeta *field_meta = table_meta_->field(field_name.c_str());
+      if (field_meta == nullptr) {
+        LOG_ERROR("Found invalid index meta info which has a non-exists field. table=%s, index=%s, field=%s",
+                  table_meta_->name(), index_meta->name(), field_name.c_str());
+        // skip cleanup
+        //  do all cleanup action in destructive Table function
+        return RC::INTERNAL;
+      }
+      index_fields.push_back(*field_meta);
     }
 
     BplusTreeIndex *index      = new BplusTreeIndex();
     string          index_file = table_index_file(db_->path().c_str(), table_meta_->name(), index_meta->name());
 
-    rc = index->open(table_, index_file.c_str(), *index_meta, *field_meta);
+    rc = index->open(table_, index_file.c_str(), *index_meta, index_fields);
     if (rc != RC::SUCCESS) {
       delete index;
       LOG_ERROR("Failed to open index. table=%s, index=%s, file=%s, rc=%s",
@@ -16,6 +16,7 @@ See the Mulan PSL v2 for more details. */
 #include "storage/db/db.h"
 
 class Table;
+class BplusTreeBulkLoader;
 /**
  * @brief table engine
  */
@@ -37,10 +38,14 @@ public:
   }
   RC get_record(const RID &rid, Record &record) override;
 
-  RC create_index(Trx *trx, const FieldMeta *field_meta, const char *index_name) override;
+  RC create_index(
+      Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, bool unique) override;
   RC get_record_scanner(RecordScanner *&scanner, Trx *trx, ReadWriteMode mode) override;
   RC get_chunk_scanner(ChunkFileScanner &scanner, Trx *trx, ReadWriteMode mode) override;
   RC visit_record(const RID &rid, function<bool(Record &)> visitor) override;
+
+  bool is_all_visible(const RID &rid) const override;
+  RC   mark_all_visible_pages(function<bool(const Record &)> all_visible, int &page_count) override;
   RC sync() override;
 
   Index *find_index(const char *index_name) const override;
@@ -53,6 +58,12 @@ private:
   RC insert_entry_of_indexes(const char *record, const RID &rid);
   RC delete_entry_of_indexes(const char *record, const RID &rid, bool error_on_not_exists);
 
+  /**
+   * @brief 创建索引时，把当前可见的记录的索引项交给 loader 排序
+   */
+  RC collect_index_entries(
+      Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, BplusTreeBulkLoader &loader);
+
 private:
   DiskBufferPool    *data_buffer_pool_ = nullptr;  /// 数据文件关联的buffer pool
   RecordFileHandler *record_handler_   = nullptr;  /// 记录操作
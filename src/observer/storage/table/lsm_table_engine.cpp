@@ -18,17 +18,59 @@ See the Mulan PSL v2 for more details. */
 #include "storage/common/codec.h"
 #include "storage/trx/lsm_mvcc_trx.h"
 
-RC LsmTableEngine::insert_record(Record &record)
+RC LsmTableEngine::next_key(bytes &lsm_key)
 {
-  RC rc = RC::SUCCESS;
   // TODO: set auto increment id, and keep durability.
   // TODO: support set primary key as a part of lsm_key.
+  return Codec::encode(table_->table_id(), inc_id_.fetch_add(1), lsm_key);
+}
+
+RC LsmTableEngine::insert_record(Record &record)
+{
   bytes lsm_key;
-  Codec::encode(table_->table_id(), inc_id_.fetch_add(1), lsm_key);
+  RC    rc = next_key(lsm_key);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
   rc = lsm_->put(string_view((char *)lsm_key.data(), lsm_key.size()), string_view(record.data(), record.len()));
   return rc;
 }
 
+/**
+ * 事务中的修改先缓存在 oblsm 事务中，提交时一次性写入
+ */
+static ObLsmTransaction *lsm_transaction(Trx *trx)
+{
+  auto *lsm_trx = static_cast<LsmMvccTrx *>(trx);
+  lsm_trx->start_if_need();
+  return lsm_trx->get_trx();
+}
+
+RC LsmTableEngine::insert_record_with_trx(Record &record, Trx *trx)
+{
+  bytes lsm_key;
+  RC    rc = next_key(lsm_key);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+  string key((char *)lsm_key.data(), lsm_key.size());
+  rc = lsm_transaction(trx)->put(key, string_view(record.data(), record.len()));
+  if (OB_SUCC(rc)) {
+    record.set_key(key);
+  }
+  return rc;
+}
+
+RC LsmTableEngine::delete_record_with_trx(const Record &record, Trx *trx)
+{
+  return lsm_transaction(trx)->remove(record.key());
+}
+
+RC LsmTableEngine::update_record_with_trx(const Record &old_record, const Record &new_record, Trx *trx)
+{
+  return lsm_transaction(trx)->put(old_record.key(), string_view(new_record.data(), new_record.len()));
+}
+
 RC LsmTableEngine::get_record_scanner(RecordScanner *&scanner, Trx *trx, ReadWriteMode mode)
 {
   scanner = new LsmRecordScanner(table_, db_->lsm(), trx);
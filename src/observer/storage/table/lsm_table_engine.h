@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 #include "storage/index/index.h"
 #include "storage/record/record_manager.h"
 #include "storage/db/db.h"
+#include "storage/common/codec.h"
 #include "oblsm/include/ob_lsm.h"
 using namespace oceanbase;
 
@@ -31,15 +32,16 @@ public:
   RC insert_record(Record &record) override;
   RC insert_chunk(const Chunk &chunk) override { return RC::UNIMPLEMENTED; }
   RC delete_record(const Record &record) override { return RC::UNIMPLEMENTED; }
-  RC insert_record_with_trx(Record &record, Trx *trx) override { return RC::UNIMPLEMENTED; }
-  RC delete_record_with_trx(const Record &record, Trx *trx) override { return RC::UNIMPLEMENTED; }
-  RC update_record_with_trx(const Record &old_record, const Record &new_record, Trx *trx) override
+  RC insert_record_with_trx(Record &record, Trx *trx) override;
+  RC delete_record_with_trx(const Record &record, Trx *trx) override;
+  RC update_record_with_trx(const Record &old_record, const Record &new_record, Trx *trx) override;
+  RC get_record(const RID &rid, Record &record) override { return RC::UNIMPLEMENTED; }
+
+  RC create_index(
+      Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, bool unique) override
   {
     return RC::UNIMPLEMENTED;
   }
-  RC get_record(const RID &rid, Record &record) override { return RC::UNIMPLEMENTED; }
-
-  RC create_index(Trx *trx, const FieldMeta *field_meta, const char *index_name) override { return RC::UNIMPLEMENTED; }
   RC get_record_scanner(RecordScanner *&scanner, Trx *trx, ReadWriteMode mode) override;
   RC get_chunk_scanner(ChunkFileScanner &scanner, Trx *trx, ReadWriteMode mode) override { return RC::UNIMPLEMENTED; }
   RC visit_record(const RID &rid, function<bool(Record &)> visitor) override { return RC::UNIMPLEMENTED; }
@@ -50,6 +52,10 @@ public:
   RC     open() override;
   RC     init() override { return RC::UNIMPLEMENTED; }
 
+private:
+  /// @brief 为新插入的记录分配一个 lsm key
+  RC next_key(bytes &lsm_key);
+
 private:
   Db              *db_;
   Table           *table_;
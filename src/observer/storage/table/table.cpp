@@ -228,6 +228,13 @@ RC Table::update_record_with_trx(const Record &old_record, const Record &new_rec
 
 RC Table::get_record(const RID &rid, Record &record) { return engine_->get_record(rid, record); }
 
+bool Table::is_all_visible(const RID &rid) const { return engine_->is_all_visible(rid); }
+
+RC Table::mark_all_visible_pages(function<bool(const Record &)> all_visible, int &page_count)
+{
+  return engine_->mark_all_visible_pages(all_visible, page_count);
+}
+
 const char *Table::name() const { return table_meta_.name(); }
 
 const TableMeta &Table::table_meta() const { return table_meta_; }
@@ -296,9 +303,9 @@ RC Table::get_chunk_scanner(ChunkFileScanner &scanner, Trx *trx, ReadWriteMode m
   return engine_->get_chunk_scanner(scanner, trx, mode);
 }
 
-RC Table::create_index(Trx *trx, const FieldMeta *field_meta, const char *index_name)
+RC Table::create_index(Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, bool unique)
 {
-  return engine_->create_index(trx, field_meta, index_name);
+  return engine_->create_index(trx, field_metas, index_name, unique);
 }
 
 RC Table::delete_record(const Record &record) { return engine_->delete_record(record); }
@@ -21,6 +21,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/types.h"
 #include "common/lang/span.h"
 #include "common/lang/functional.h"
+#include "common/lang/atomic.h"
 
 struct RID;
 class Record;
@@ -94,7 +95,7 @@ public:
   RC get_record(const RID &rid, Record &record);
 
   // TODO refactor
-  RC create_index(Trx *trx, const FieldMeta *field_meta, const char *index_name);
+  RC create_index(Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, bool unique);
 
   RC get_record_scanner(RecordScanner *&scanner, Trx *trx, ReadWriteMode mode);
 
@@ -109,6 +110,29 @@ public:
    */
   RC visit_record(const RID &rid, function<bool(Record &)> visitor);
 
+  /**
+   * @brief 记录所在的页面是否对所有事务都可见
+   * @details 覆盖索引扫描时用来判断能否跳过回表。不维护可见性信息的存储引擎总是返回false
+   */
+  bool is_all_visible(const RID &rid) const;
+
+  /**
+   * @brief 把所有记录都满足条件的页面标记为全部可见
+   * @details 由清理线程调用，判断条件由事务模块给出
+   */
+  RC mark_all_visible_pages(function<bool(const Record &)> all_visible, int &page_count);
+
+  /**
+   * @brief 登记清理线程需要处理的版本数
+   * @details 事务提交删除、插入或者回滚删除时调用，清理线程看到没有待处理的版本就跳过这张表
+   */
+  void add_vacuum_pending(int64_t count = 1) { vacuum_pending_.fetch_add(count); }
+
+  /**
+   * @brief 取走待清理的版本数并清零
+   */
+  int64_t take_vacuum_pending() { return vacuum_pending_.exchange(0); }
+
 public:
   int32_t     table_id() const { return table_meta_.table_id(); }
   const char *name() const;
@@ -147,4 +171,7 @@ private:
   // vector<Index *>    indexes_;
   unique_ptr<TableEngine> engine_      = nullptr;
   LobFileHandler         *lob_handler_ = nullptr;
+
+  /// 清理线程还没有处理的版本数。打开表时不知道上次退出前的情况，所以从1开始，保证至少清理一次
+  atomic<int64_t> vacuum_pending_{1};
 };
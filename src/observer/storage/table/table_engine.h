@@ -46,14 +46,27 @@ public:
   virtual RC update_record_with_trx(const Record &old_record, const Record &new_record, Trx *trx) = 0;
   virtual RC get_record(const RID &rid, Record &record)                                           = 0;
 
-  virtual RC     create_index(Trx *trx, const FieldMeta *field_meta, const char *index_name) = 0;
-  virtual RC     get_record_scanner(RecordScanner *&scanner, Trx *trx, ReadWriteMode mode)   = 0;
-  virtual RC     get_chunk_scanner(ChunkFileScanner &scanner, Trx *trx, ReadWriteMode mode)  = 0;
-  virtual RC     visit_record(const RID &rid, function<bool(Record &)> visitor)              = 0;
-  virtual RC     sync()                                                                      = 0;
-  virtual Index *find_index(const char *index_name) const                                    = 0;
-  virtual Index *find_index_by_field(const char *field_name) const                           = 0;
-  virtual RC     open()                                                                      = 0;
+  virtual RC     create_index(
+      Trx *trx, const vector<const FieldMeta *> &field_metas, const char *index_name, bool unique)           = 0;
+  virtual RC     get_record_scanner(RecordScanner *&scanner, Trx *trx, ReadWriteMode mode)                   = 0;
+  virtual RC     get_chunk_scanner(ChunkFileScanner &scanner, Trx *trx, ReadWriteMode mode)                  = 0;
+  virtual RC     visit_record(const RID &rid, function<bool(Record &)> visitor)                              = 0;
+  virtual RC     sync()                                                                                      = 0;
+
+  /**
+   * @brief 记录所在的页面是否对所有事务都可见
+   * @details 不维护可见性信息的引擎总是返回false，使用者需要自己检查记录
+   */
+  virtual bool is_all_visible(const RID &rid) const { return false; }
+  virtual RC   mark_all_visible_pages(function<bool(const Record &)> all_visible, int &page_count)
+  {
+    page_count = 0;
+    return RC::SUCCESS;
+  }
+
+  virtual Index *find_index(const char *index_name) const                                                    = 0;
+  virtual Index *find_index_by_field(const char *field_name) const                                           = 0;
+  virtual RC     open()                                                                                      = 0;
   // TODO: remove this function
   virtual RC init() = 0;
 
@@ -49,15 +49,30 @@ RC LsmMvccTrx::start_if_need()
   return RC::SUCCESS;
 }
 
+/**
+ * 提交或回滚以后释放 oblsm 的事务，下一个事务开始时重新获取快照
+ */
 RC LsmMvccTrx::commit()
 {
   if (trx_ == nullptr) {
     return RC::SUCCESS;
   }
-  return trx_->commit();
+  RC rc = trx_->commit();
+  delete trx_;
+  trx_ = nullptr;
+  return rc;
 }
 
-RC LsmMvccTrx::rollback() { return trx_->rollback(); }
+RC LsmMvccTrx::rollback()
+{
+  if (trx_ == nullptr) {
+    return RC::SUCCESS;
+  }
+  RC rc = trx_->rollback();
+  delete trx_;
+  trx_ = nullptr;
+  return rc;
+}
 
 /**
  * 实际没有使用
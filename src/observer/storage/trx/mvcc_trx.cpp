@@ -15,16 +15,20 @@ See the Mulan PSL v2 for more details. */
 #include "storage/trx/mvcc_trx.h"
 #include "storage/db/db.h"
 #include "storage/field/field.h"
+#include "storage/record/record_scanner.h"
 #include "storage/trx/mvcc_trx_log.h"
 #include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
 
 MvccTrxKit::~MvccTrxKit()
 {
-  vector<Trx *> tmp_trxes;
-  tmp_trxes.swap(trxes_);
+  for (Shard &shard : shards_) {
+    vector<Trx *> tmp_trxes;
+    tmp_trxes.swap(shard.trxes);
 
-  for (Trx *trx : tmp_trxes) {
-    delete trx;
+    for (Trx *trx : tmp_trxes) {
+      delete trx;
+    }
   }
 }
 
@@ -51,9 +55,9 @@ Trx *MvccTrxKit::create_trx(LogHandler &log_handler)
 {
   Trx *trx = new MvccTrx(*this, log_handler);
   if (trx != nullptr) {
-    lock_.lock();
-    trxes_.push_back(trx);
-    lock_.unlock();
+    Shard     &shard = trx_shard(trx);
+    lock_guard guard(shard.lock);
+    shard.trxes.push_back(trx);
   }
   return trx;
 }
@@ -62,35 +66,302 @@ Trx *MvccTrxKit::create_trx(LogHandler &log_handler, int32_t trx_id)
 {
   Trx *trx = new MvccTrx(*this, log_handler, trx_id);
   if (trx != nullptr) {
-    lock_.lock();
-    trxes_.push_back(trx);
-    if (current_trx_id_ < trx_id) {
-      current_trx_id_ = trx_id;
+    {
+      Shard     &shard = trx_shard(trx);
+      lock_guard guard(shard.lock);
+      shard.trxes.push_back(trx);
     }
-    lock_.unlock();
+
+    advance_trx_id(trx_id);
   }
   return trx;
 }
 
+void MvccTrxKit::advance_trx_id(int32_t trx_id)
+{
+  int32_t current_trx_id = current_trx_id_.load();
+  while (current_trx_id < trx_id && !current_trx_id_.compare_exchange_weak(current_trx_id, trx_id)) {
+  }
+}
+
 void MvccTrxKit::destroy_trx(Trx *trx)
 {
-  lock_.lock();
-  for (auto iter = trxes_.begin(), itend = trxes_.end(); iter != itend; ++iter) {
-    if (*iter == trx) {
-      trxes_.erase(iter);
-      break;
+  {
+    Shard     &shard = trx_shard(trx);
+    lock_guard guard(shard.lock);
+    for (auto iter = shard.trxes.begin(), itend = shard.trxes.end(); iter != itend; ++iter) {
+      if (*iter == trx) {
+        shard.trxes.erase(iter);
+        break;
+      }
     }
   }
-  lock_.unlock();
 
   delete trx;
 }
 
 void MvccTrxKit::all_trxes(vector<Trx *> &trxes)
 {
-  lock_.lock();
-  trxes = trxes_;
-  lock_.unlock();
+  trxes.clear();
+  for (Shard &shard : shards_) {
+    lock_guard guard(shard.lock);
+    trxes.insert(trxes.end(), shard.trxes.begin(), shard.trxes.end());
+  }
+}
+
+LSN MvccTrxKit::min_active_lsn()
+{
+  LSN min_lsn = 0;
+  for (Shard &shard : shards_) {
+    lock_guard guard(shard.lock);
+    for (Trx *trx : shard.trxes) {
+      const LSN first_lsn = static_cast<MvccTrx *>(trx)->first_lsn();
+      if (first_lsn != 0 && (min_lsn == 0 || first_lsn < min_lsn)) {
+        min_lsn = first_lsn;
+      }
+    }
+  }
+  return min_lsn;
+}
+
+int32_t MvccTrxKit::register_trx()
+{
+  while (true) {
+    const int64_t epoch  = collect_epoch_.load();
+    const int32_t trx_id = next_trx_id();
+
+    Shard &shard = xid_shard(trx_id);
+    {
+      lock_guard guard(shard.lock);
+      shard.running_trxes[trx_id] = 0;
+    }
+
+    // 事务号是在收集活跃事务之前分配的，但是登记晚了，可能没有被收集到。
+    // 这个事务还没有读过任何数据，换一个比那次收集看到的都大的事务号就可以了
+    if (collect_epoch_.load() == epoch) {
+      return trx_id;
+    }
+
+    lock_guard guard(shard.lock);
+    shard.running_trxes.erase(trx_id);
+  }
+}
+
+int32_t MvccTrxKit::active_xids(vector<int32_t> &xids)
+{
+  xids.clear();
+  const int32_t max_xid = current_trx_id_.load();
+  ++collect_epoch_;
+
+  for (Shard &shard : shards_) {
+    lock_guard guard(shard.lock);
+    for (const auto &pair : shard.running_trxes) {
+      xids.push_back(pair.first);
+    }
+  }
+  std::sort(xids.begin(), xids.end());
+  return max_xid;
+}
+
+int32_t MvccTrxKit::prepare_commit(int32_t trx_id)
+{
+  Shard     &shard = xid_shard(trx_id);
+  lock_guard guard(shard.lock);
+  int32_t    commit_xid       = next_trx_id();
+  shard.running_trxes[trx_id] = commit_xid;
+  return commit_xid;
+}
+
+void MvccTrxKit::unregister_trx(int32_t trx_id)
+{
+  Shard &shard = xid_shard(trx_id);
+  {
+    lock_guard guard(shard.lock);
+    shard.running_trxes.erase(trx_id);
+  }
+  shard.cond.notify_all();
+}
+
+bool MvccTrxKit::committing_xid(int32_t trx_id, int32_t &commit_xid)
+{
+  Shard     &shard = xid_shard(trx_id);
+  lock_guard guard(shard.lock);
+  auto       iter = shard.running_trxes.find(trx_id);
+  if (iter == shard.running_trxes.end() || iter->second == 0) {
+    return false;
+  }
+  commit_xid = iter->second;
+  return true;
+}
+
+RC MvccTrxKit::wait_trx(int32_t waiter_id, int32_t holder_id)
+{
+#ifdef CONCURRENCY
+  if (lock_wait_timeout_ms_ <= 0) {
+    return RC::LOCKED_CONCURRENCY_CONFLICT;
+  }
+
+  {
+    lock_guard guard(waits_lock_);
+    // 每个事务最多在等待一个事务，沿着等待关系走下去，如果回到了自己就是死锁
+    for (auto iter = waits_for_.find(holder_id); iter != waits_for_.end(); iter = waits_for_.find(iter->second)) {
+      if (iter->second == waiter_id) {
+        LOG_INFO("deadlock detected. trx %d is waiting for trx %d", waiter_id, holder_id);
+        return RC::LOCKED_CONCURRENCY_CONFLICT;
+      }
+    }
+    waits_for_[waiter_id] = holder_id;
+  }
+
+  Shard &shard = xid_shard(holder_id);
+  bool   finished = false;
+  {
+    unique_lock lock(shard.lock);
+    finished = shard.cond.wait_for(lock, chrono::milliseconds(lock_wait_timeout_ms_), [&shard, holder_id] {
+      return shard.running_trxes.find(holder_id) == shard.running_trxes.end();
+    });
+  }
+
+  {
+    lock_guard guard(waits_lock_);
+    waits_for_.erase(waiter_id);
+  }
+
+  if (!finished) {
+    LOG_INFO("lock wait timeout. trx %d is waiting for trx %d", waiter_id, holder_id);
+    return RC::LOCKED_CONCURRENCY_CONFLICT;
+  }
+  return RC::SUCCESS;
+#else
+  return RC::LOCKED_CONCURRENCY_CONFLICT;
+#endif
+}
+
+RC MvccTrxKit::vacuum(Table *table, int &purged_count)
+{
+  purged_count = 0;
+
+  // 上次清理之后没有事务提交过修改，既没有旧版本可以回收，也没有新页面可以标记为全部可见
+  const int64_t pending = table->take_vacuum_pending();
+  if (pending <= 0) {
+    return RC::SUCCESS;
+  }
+
+  vector<int32_t> xids;
+  const int32_t   max_xid = active_xids(xids);
+  // 创建版本的事务在所有活跃事务开始之前就提交了，并且没有被删除，那么现在和以后的事务都能看到它。
+  // 活跃事务号是递增分配的，之后开始的事务事务号一定更大
+  const int32_t min_xid = xids.empty() ? max_xid + 1 : xids.front();
+  // 因为还有活跃事务能看到而这次处理不了的版本，要留给下一轮
+  bool has_deferred = false;
+
+  span<const FieldMeta> trx_fields = table->table_meta().trx_fields();
+  Field                 begin_xid_field;
+  Field                 end_xid_field;
+  begin_xid_field.set_table(table);
+  begin_xid_field.set_field(&trx_fields[0]);
+  end_xid_field.set_table(table);
+  end_xid_field.set_field(&trx_fields[1]);
+
+  RecordScanner *scanner = nullptr;
+  RC             rc      = table->get_record_scanner(scanner, nullptr /*trx*/, ReadWriteMode::READ_ONLY);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to open scanner. table=%s, rc=%s", table->name(), strrc(rc));
+    table->add_vacuum_pending(pending);
+    return rc;
+  }
+
+  vector<Record> dead_records;
+  Record         record;
+  while (OB_SUCC(rc = scanner->next(record))) {
+    const int32_t begin_xid = begin_xid_field.get_int(record);
+    const int32_t end_xid   = end_xid_field.get_int(record);
+    if (begin_xid <= 0 || end_xid <= 0) {
+      // 还没有提交的修改，提交或回滚时会再登记
+      continue;
+    }
+    if (end_xid == max_trx_id()) {
+      has_deferred = has_deferred || begin_xid >= min_xid;
+      continue;
+    }
+    if (end_xid > max_xid) {
+      has_deferred = true;
+      continue;
+    }
+
+    // 创建和删除这个版本的事务都已经提交，并且没有活跃事务在这中间开始
+    auto iter = std::upper_bound(xids.begin(), xids.end(), begin_xid);
+    if (iter == xids.end() || *iter > end_xid) {
+      Record &dead_record = dead_records.emplace_back();
+      dead_record.set_rid(record.rid());
+      dead_record.copy_data(record.data(), record.len());
+    } else {
+      has_deferred = true;
+    }
+  }
+  delete scanner;
+
+  if (rc != RC::RECORD_EOF) {
+    LOG_WARN("failed to scan table. table=%s, rc=%s", table->name(), strrc(rc));
+    table->add_vacuum_pending(pending);
+    return rc;
+  }
+
+  for (Record &dead_record : dead_records) {
+    rc = table->delete_record(dead_record);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to purge record. table=%s, rid=%s, rc=%s",
+               table->name(), dead_record.rid().to_string().c_str(), strrc(rc));
+      table->add_vacuum_pending(pending);
+      return rc;
+    }
+    purged_count++;
+  }
+
+  int visible_page_count = 0;
+  rc = table->mark_all_visible_pages(
+      [&begin_xid_field, &end_xid_field, min_xid, this](const Record &record) {
+        const int32_t begin_xid = begin_xid_field.get_int(record);
+        const int32_t end_xid   = end_xid_field.get_int(record);
+        return begin_xid > 0 && begin_xid < min_xid && end_xid == max_trx_id();
+      },
+      visible_page_count);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to mark all visible pages. table=%s, rc=%s", table->name(), strrc(rc));
+    table->add_vacuum_pending(pending);
+    return rc;
+  }
+
+  if (has_deferred) {
+    table->add_vacuum_pending();
+  }
+
+  LOG_TRACE("vacuum table done. table=%s, active trx num=%d, purged=%d, all visible pages=%d, deferred=%d",
+            table->name(), static_cast<int>(xids.size()), purged_count, visible_page_count, has_deferred);
+  return RC::SUCCESS;
+}
+
+bool MvccTrxKit::is_duplicate(Table *table, const Record &existing_record, const char *new_record)
+{
+  span<const FieldMeta> trx_fields = table->table_meta().trx_fields();
+  Field                 begin_xid_field;
+  Field                 end_xid_field;
+  begin_xid_field.set_table(table);
+  begin_xid_field.set_field(&trx_fields[0]);
+  end_xid_field.set_table(table);
+  end_xid_field.set_field(&trx_fields[1]);
+
+  const int32_t end_xid = end_xid_field.get_int(existing_record);
+  if (end_xid == max_trx_id()) {
+    return true;
+  }
+  if (end_xid > 0) {
+    return false;
+  }
+
+  Record record;
+  record.set_data(const_cast<char *>(new_record));
+  return end_xid != begin_xid_field.get_int(record);
 }
 
 LogReplayer *MvccTrxKit::create_log_replayer(Db &db, LogHandler &log_handler)
@@ -122,6 +393,7 @@ RC MvccTrx::insert_record(Table *table, Record &record)
   begin_field.set_int(record, -trx_id_);
   end_field.set_int(record, trx_kit_.max_trx_id());
 
+  mark_first_lsn();
   RC rc = table->insert_record(record);
   if (rc != RC::SUCCESS) {
     LOG_WARN("failed to insert record into table. rc=%s", strrc(rc));
@@ -142,30 +414,54 @@ RC MvccTrx::delete_record(Table *table, Record &record)
   Field end_field;
   trx_fields(table, begin_field, end_field);
 
-  RC delete_result = RC::SUCCESS;
+  mark_first_lsn();
+
+  int32_t waited_holder_id = 0;
+  while (true) {
+    RC      delete_result = RC::SUCCESS;
+    int32_t holder_id     = 0;
+
+    RC rc = table->visit_record(
+        record.rid(), [this, table, &delete_result, &holder_id, &end_field](Record &inplace_record) -> bool {
+          delete_result = this->check_write(table, inplace_record, holder_id);
+          if (OB_FAIL(delete_result)) {
+            return false;
+          }
+
+          end_field.set_int(inplace_record, -trx_id_);
+          return true;
+        });
 
-  RC rc = table->visit_record(record.rid(), [this, table, &delete_result, &end_field](Record &inplace_record) -> bool {
-    RC rc = this->visit_record(table, inplace_record, ReadWriteMode::READ_WRITE);
     if (OB_FAIL(rc)) {
-      delete_result = rc;
-      return false;
+      LOG_WARN("failed to visit record. rc=%s", strrc(rc));
+      return rc;
     }
 
-    end_field.set_int(inplace_record, -trx_id_);
-    return true;
-  });
+    if (delete_result != RC::LOCKED_NEED_WAIT) {
+      if (OB_FAIL(delete_result)) {
+        LOG_TRACE("failed to delete record. rid=%s, rc=%s", record.rid().to_string().c_str(), strrc(delete_result));
+        return delete_result;
+      }
+      break;
+    }
 
-  if (OB_FAIL(rc)) {
-    LOG_WARN("failed to visit record. rc=%s", strrc(rc));
-    return rc;
-  }
+    // 等待的事务结束以后，它在记录上的标记就会被改掉。如果还是同一个事务，说明这个标记没有人会再处理了
+    if (holder_id == waited_holder_id) {
+      LOG_WARN("record is still locked by a finished trx. trx id=%d, holder id=%d, rid=%s",
+               trx_id_, holder_id, record.rid().to_string().c_str());
+      return RC::LOCKED_CONCURRENCY_CONFLICT;
+    }
 
-  if (OB_FAIL(delete_result)) {
-    LOG_TRACE("record is not visible. rid=%s, rc=%s", record.rid().to_string().c_str(), strrc(delete_result));
-    return delete_result;
+    // 等待时不能持有页面的锁，否则持有行锁的事务没有办法提交或回滚
+    rc = trx_kit_.wait_trx(trx_id_, holder_id);
+    if (OB_FAIL(rc)) {
+      LOG_TRACE("failed to wait for trx. trx id=%d, holder id=%d, rc=%s", trx_id_, holder_id, strrc(rc));
+      return rc;
+    }
+    waited_holder_id = holder_id;
   }
 
-  rc = log_handler_.delete_record(trx_id_, table, record.rid());
+  RC rc = log_handler_.delete_record(trx_id_, table, record.rid());
   ASSERT(rc == RC::SUCCESS, "failed to append delete record log. trx id=%d, table id=%d, rid=%s, record len=%d, rc=%s",
       trx_id_, table->table_id(), record.rid().to_string().c_str(), record.len(), strrc(rc));
 
@@ -174,6 +470,21 @@ RC MvccTrx::delete_record(Table *table, Record &record)
   return RC::SUCCESS;
 }
 
+RC MvccTrx::update_record(Table *table, Record &old_record, Record &new_record)
+{
+  RC rc = delete_record(table, old_record);
+  if (OB_FAIL(rc)) {
+    LOG_TRACE("failed to delete the old version. rid=%s, rc=%s", old_record.rid().to_string().c_str(), strrc(rc));
+    return rc;
+  }
+
+  rc = insert_record(table, new_record);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to insert the new version. rc=%s", strrc(rc));
+  }
+  return rc;
+}
+
 RC MvccTrx::visit_record(Table *table, Record &record, ReadWriteMode mode)
 {
   Field begin_field;
@@ -183,50 +494,98 @@ RC MvccTrx::visit_record(Table *table, Record &record, ReadWriteMode mode)
   int32_t begin_xid = begin_field.get_int(record);
   int32_t end_xid   = end_field.get_int(record);
 
-  RC rc = RC::SUCCESS;
-  if (begin_xid > 0 && end_xid > 0) {
-    if (trx_id_ >= begin_xid && trx_id_ <= end_xid) {
-      rc = RC::SUCCESS;
-    } else {
-      LOG_TRACE("record invisible. trx id=%d, begin xid=%d, end xid=%d", trx_id_, begin_xid, end_xid);
-      rc = RC::RECORD_INVISIBLE;
+  // 先看这个版本的创建对当前事务是否可见：自己创建的，或者在当前事务开始之前就提交了
+  int32_t commit_xid = 0;
+  switch (resolve_xid(begin_xid, commit_xid)) {
+    case XidState::SELF: break;
+    case XidState::COMMITTED: {
+      if (trx_id_ < commit_xid) {
+        LOG_TRACE("record invisible. trx id=%d, begin xid=%d, commit xid=%d", trx_id_, begin_xid, commit_xid);
+        return RC::RECORD_INVISIBLE;
+      }
+    } break;
+    case XidState::UNCOMMITTED: {
+      LOG_TRACE("record invisible. someone is inserting this record right now. trx id=%d, begin xid=%d, end xid=%d",
+                trx_id_, begin_xid, end_xid);
+      return RC::RECORD_INVISIBLE;
     }
-  } else if (begin_xid < 0) {
-    // begin xid 小于0说明是刚插入而且没有提交的数据
-    if (-begin_xid == trx_id_) {
-      rc = RC::SUCCESS;
-    } else {
-      LOG_TRACE("record invisible. someone is updating this record right now. trx id=%d, begin xid=%d, end xid=%d",
+  }
+
+  if (end_xid == trx_kit_.max_trx_id()) {
+    return RC::SUCCESS;
+  }
+
+  // 再看这个版本的删除对当前事务是否可见。其它事务正在删除或者在当前事务开始之后才删除的版本，仍然可以读到
+  switch (resolve_xid(end_xid, commit_xid)) {
+    case XidState::SELF: {
+      LOG_TRACE("record invisible. self has deleted this record. trx id=%d, begin xid=%d, end xid=%d",
                 trx_id_, begin_xid, end_xid);
-      rc = RC::RECORD_INVISIBLE;
+      return RC::RECORD_INVISIBLE;
     }
-  } else if (end_xid < 0) {
-    // end xid 小于0 说明是正在删除但是还没有提交的数据
-    if (mode == ReadWriteMode::READ_ONLY) {
-      // 如果 -end_xid 就是当前事务的事务号，说明是当前事务删除的
-      if (-end_xid != trx_id_) {
-        rc = RC::SUCCESS;
-      } else {
-        LOG_TRACE("record invisible. self has deleted this record. trx id=%d, begin xid=%d, end xid=%d",
-                  trx_id_, begin_xid, end_xid);
-        rc = RC::RECORD_INVISIBLE;
-      }
-    } else {
-      // 如果当前想要修改此条数据，并且不是当前事务删除的，简单的报错
-      // 这是事务并发处理的一种方式，非常简单粗暴。其它的并发处理方法，可以等待，或者让客户端重试
-      // 或者等事务结束后，再检测修改的数据是否有冲突
-      if (-end_xid != trx_id_) {
-        LOG_TRACE("concurrency conflit. someone is deleting this record right now. trx id=%d, begin xid=%d, end xid=%d",
-                  trx_id_, begin_xid, end_xid);
-        rc = RC::LOCKED_CONCURRENCY_CONFLICT;
-      } else {
-        LOG_TRACE("record invisible. self has deleted this record. trx id=%d, begin xid=%d, end xid=%d",
-                  trx_id_, begin_xid, end_xid);
-        rc = RC::RECORD_INVISIBLE;
+    case XidState::COMMITTED: {
+      if (trx_id_ > commit_xid) {
+        LOG_TRACE("record invisible. trx id=%d, end xid=%d, commit xid=%d", trx_id_, end_xid, commit_xid);
+        return RC::RECORD_INVISIBLE;
       }
+    } break;
+    case XidState::UNCOMMITTED: break;
+  }
+  return RC::SUCCESS;
+}
+
+bool MvccTrx::is_visible_without_record(Table *table, const RID &rid, ReadWriteMode mode)
+{
+  return mode == ReadWriteMode::READ_ONLY && table->is_all_visible(rid);
+}
+
+MvccTrx::XidState MvccTrx::resolve_xid(int32_t xid, int32_t &commit_xid)
+{
+  if (xid > 0) {
+    commit_xid = xid;
+    return XidState::COMMITTED;
+  }
+
+  // 小于0的事务号是还没有结束的事务打上的标记。如果那个事务已经拿到了提交事务号，就按照提交事务号来判断
+  if (-xid == trx_id_) {
+    return XidState::SELF;
+  }
+  if (trx_kit_.committing_xid(-xid, commit_xid)) {
+    return XidState::COMMITTED;
+  }
+  return XidState::UNCOMMITTED;
+}
+
+RC MvccTrx::check_write(Table *table, Record &record, int32_t &holder_id)
+{
+  RC rc = visit_record(table, record, ReadWriteMode::READ_WRITE);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  Field begin_field;
+  Field end_field;
+  trx_fields(table, begin_field, end_field);
+
+  const int32_t end_xid = end_field.get_int(record);
+  if (end_xid == trx_kit_.max_trx_id()) {
+    return RC::SUCCESS;
+  }
+
+  int32_t commit_xid = 0;
+  switch (resolve_xid(end_xid, commit_xid)) {
+    case XidState::COMMITTED: {
+      // 版本可见但是已经被删除，说明另一个事务在当前事务开始之后修改了它并且已经提交，当前事务不能再修改旧版本
+      LOG_TRACE("concurrency conflict. record was modified after trx started. trx id=%d, end xid=%d, commit xid=%d",
+                trx_id_, end_xid, commit_xid);
+      return RC::LOCKED_CONCURRENCY_CONFLICT;
+    }
+    case XidState::UNCOMMITTED: {
+      holder_id = -end_xid;
+      return RC::LOCKED_NEED_WAIT;
     }
+    case XidState::SELF: break;  // 自己删除的版本在上面就已经不可见了
   }
-  return rc;
+  return RC::SUCCESS;
 }
 
 /**
@@ -248,26 +607,47 @@ void MvccTrx::trx_fields(Table *table, Field &begin_xid_field, Field &end_xid_fi
   end_xid_field.set_field(&trx_fields[1]);
 }
 
+void MvccTrx::mark_first_lsn()
+{
+  // 记录数据的修改日志在事务日志之前写入，所以要在修改数据之前记录
+  if (first_lsn_.load() == 0 && !recovering_) {
+    first_lsn_.store(log_handler_.current_lsn() + 1);
+  }
+}
+
 RC MvccTrx::start_if_need()
 {
   if (!started_) {
     ASSERT(operations_.empty(), "try to start a new trx while operations is not empty");
-    trx_id_ = trx_kit_.next_trx_id();
+    trx_id_ = trx_kit_.register_trx();
     LOG_DEBUG("current thread change to new trx with %d", trx_id_);
     started_ = true;
   }
   return RC::SUCCESS;
 }
 
-RC MvccTrx::commit()
+RC MvccTrx::commit() { return do_commit(false /*group_commit*/); }
+
+RC MvccTrx::autocommit() { return do_commit(trx_kit_.commit_group().enabled()); }
+
+RC MvccTrx::do_commit(bool group_commit)
 {
-  int32_t commit_id = trx_kit_.next_trx_id();
-  return commit_with_trx_id(commit_id);
+  if (operations_.empty()) {
+    // 只读事务没有修改任何记录，不需要提交事务号，也不需要写日志等待落盘
+    started_ = false;
+    first_lsn_.store(0);
+    trx_kit_.unregister_trx(trx_id_);
+    return RC::SUCCESS;
+  }
+
+  int32_t commit_id = trx_kit_.prepare_commit(trx_id_);
+  return commit_with_trx_id(commit_id, group_commit);
 }
 
-RC MvccTrx::commit_with_trx_id(int32_t commit_xid)
+RC MvccTrx::commit_with_trx_id(int32_t commit_xid, bool group_commit)
 {
-  // TODO 原子性提交BUG：这里存在一个很大的问题，不能让其他事务一次性看到当前事务更新到的数据或同时看不到
+  // 提交事务号已经登记在事务管理器中，其它事务遇到还没有改成提交事务号的记录时，会查询到它，
+  // 所以其它事务要么同时看到当前事务的所有修改，要么都看不到
   RC rc    = RC::SUCCESS;
   started_ = false;
 
@@ -293,6 +673,8 @@ RC MvccTrx::commit_with_trx_id(int32_t commit_xid)
         rc = operation.table()->visit_record(rid, record_updater);
         ASSERT(rc == RC::SUCCESS, "failed to get record while committing. rid=%s, rc=%s",
                rid.to_string().c_str(), strrc(rc));
+        // 新插入的版本等所有活跃事务结束后由清理线程标记为全部可见
+        table->add_vacuum_pending();
       } break;
 
       case Operation::Type::DELETE: {
@@ -315,6 +697,8 @@ RC MvccTrx::commit_with_trx_id(int32_t commit_xid)
         rc = operation.table()->visit_record(rid, record_updater);
         ASSERT(rc == RC::SUCCESS, "failed to get record while committing. rid=%s, rc=%s",
                rid.to_string().c_str(), strrc(rc));
+        // 删除的旧版本等没有事务能看到时由清理线程回收
+        table->add_vacuum_pending();
       } break;
 
       default: {
@@ -324,10 +708,13 @@ RC MvccTrx::commit_with_trx_id(int32_t commit_xid)
   }
 
   if (!recovering_) {
-    rc = log_handler_.commit(trx_id_, commit_xid);
+    rc = group_commit ? trx_kit_.commit_group().commit(log_handler_, trx_id_, commit_xid)
+                      : log_handler_.commit(trx_id_, commit_xid);
   }
 
   operations_.clear();
+  first_lsn_.store(0);
+  trx_kit_.unregister_trx(trx_id_);
 
   LOG_TRACE("append trx commit log. trx id=%d, commit_xid=%d, rc=%s", trx_id_, commit_xid, strrc(rc));
   return rc;
@@ -394,6 +781,8 @@ RC MvccTrx::rollback()
         rc = table->visit_record(rid, record_updater);
         ASSERT(rc == RC::SUCCESS, "failed to get record while committing. rid=%s, rc=%s",
                rid.to_string().c_str(), strrc(rc));
+        // 删除时清掉了页面的全部可见标记，恢复后的记录需要重新标记
+        table->add_vacuum_pending();
       } break;
 
       default: {
@@ -402,11 +791,13 @@ RC MvccTrx::rollback()
     }
   }
 
-  operations_.clear();
-
-  if (!recovering_) {
+  // 没有修改过记录的事务也没有写过日志，不需要记录回滚
+  if (!recovering_ && !operations_.empty()) {
     rc = log_handler_.rollback(trx_id_);
   }
+  operations_.clear();
+  first_lsn_.store(0);
+  trx_kit_.unregister_trx(trx_id_);
   LOG_TRACE("append trx rollback log. trx id=%d, rc=%s", trx_id_, strrc(rc));
   return rc;
 }
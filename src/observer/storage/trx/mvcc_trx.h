@@ -14,6 +14,11 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/lang/array.h"
+#include "common/lang/atomic.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/mutex.h"
+#include "common/lang/unordered_map.h"
 #include "common/lang/vector.h"
 #include "storage/trx/trx.h"
 #include "storage/trx/mvcc_trx_log.h"
@@ -22,8 +27,22 @@ class CLogManager;
 class LogHandler;
 class MvccTrxLogHandler;
 
+/**
+ * @brief 多版本并发事务的管理器
+ * @ingroup Transaction
+ * @details 除了分配事务号，还记录正在运行的事务，用来实现写冲突时的等待。
+ * 事务修改记录时，会把自己的事务号取负数写在记录上，相当于给记录加了行锁。
+ * 另一个事务想修改同一条记录时，就在这里等待前一个事务结束，而不是直接报错。
+ * 等待关系构成一个等待图，每个事务最多等待一个事务，沿着等待关系走下去能回到自己就是死锁。
+ *
+ * 每个连接上的每次开始和提交事务都要访问这里，所以事务号使用原子变量分配，
+ * 事务对象和运行中的事务分散到多个分片上，每个分片有自己的锁，不同连接之间很少竞争。
+ */
 class MvccTrxKit : public TrxKit
 {
+public:
+  static constexpr int DEFAULT_LOCK_WAIT_TIMEOUT_MS = 5000;
+
 public:
   MvccTrxKit() = default;
   virtual ~MvccTrxKit();
@@ -39,9 +58,82 @@ public:
 
   LogReplayer *create_log_replayer(Db &db, LogHandler &log_handler) override;
 
+  LSN min_active_lsn() override;
+
+  int32_t current_trx_id() const override { return current_trx_id_.load(); }
+  void    advance_trx_id(int32_t trx_id) override;
+
+  /**
+   * @brief 物理删除所有事务都看不到的旧版本，包括它们的索引项
+   * @details 先遍历表找到这些版本，再逐个删除，删除时不持有遍历时的页面锁。
+   * 删除这些版本的事务已经提交，这些版本对所有事务都不可见，所以不会有事务再修改它们。
+   * 除了比最老的活跃事务更早删除的版本，两个活跃事务之间被创建又被删除的中间版本也会被清理。
+   * 删除记录以后，页面会回到记录管理器的空闲页面集合中，被新插入的记录复用。
+   * 最后把记录都对所有事务可见的页面标记出来，覆盖索引扫描读到这些页面上的记录时不需要回表。
+   */
+  RC vacuum(Table *table, int &purged_count) override;
+
+  /**
+   * @brief 已经被删除的旧版本不算重复
+   * @details 删除已经提交的版本，以后开始的事务都看不到；正在插入新记录的事务自己删除的版本，
+   * 比如更新时保留了键值，也不算。其它事务插入或删除了还没有结束的版本，都当作冲突，不等待
+   */
+  bool is_duplicate(Table *table, const Record &existing_record, const char *new_record) override;
+
+  void set_lock_wait_timeout(int timeout_ms) override { lock_wait_timeout_ms_ = timeout_ms; }
+  void set_group_commit_delay(int delay_us) override { commit_group_.set_delay_us(delay_us); }
+
+  /// 单语句事务合并提交使用的提交组
+  MvccTrxCommitGroup &commit_group() { return commit_group_; }
+
 public:
   int32_t next_trx_id();
 
+  /**
+   * @brief 事务开始时分配事务号并登记，其它事务才能等待它结束
+   * @details 事务号分配以后才登记到分片上，中间如果有人在收集活跃事务，可能会漏掉这个事务，
+   * 所以登记完以后检查一下，有人收集过就换一个新的事务号重新登记
+   */
+  int32_t register_trx();
+
+  /**
+   * @brief 所有活跃事务的事务号，从小到大排列
+   * @details 一个版本的创建和删除都已经提交，并且没有活跃事务的事务号落在这两者之间，
+   * 就没有事务能看到它了。以后开始的事务，事务号比所有已经提交的事务都大，也看不到它。
+   * 开始事务时只需要分配一个事务号，不需要查询活跃事务，只有清理旧版本时才需要遍历所有分片
+   * @return 目前为止分配的最大的事务号。之后提交的删除，可能有还没有列出来的事务能看到
+   */
+  int32_t active_xids(vector<int32_t> &xids);
+
+  /**
+   * @brief 给要提交的事务分配提交事务号
+   * @details 在事务所在分片的锁内分配和登记。这样其它事务遇到这个事务标记过的记录时，
+   * 即使记录上的标记还没有改成提交事务号，也能判断出这些修改在自己的快照中是否可见，
+   * 从而一次性地看到或者看不到这个事务的所有修改。
+   */
+  int32_t prepare_commit(int32_t trx_id);
+
+  /**
+   * @brief 事务的修改都已经提交或回滚到记录上，唤醒等待它的事务
+   */
+  void unregister_trx(int32_t trx_id);
+
+  /**
+   * @brief 查询正在提交的事务的提交事务号
+   * @return 事务已经分配了提交事务号时返回true
+   */
+  bool committing_xid(int32_t trx_id, int32_t &commit_xid);
+
+  /**
+   * @brief 等待另一个事务结束
+   * @details waiter 要修改的记录已经被 holder 修改，但是 holder 还没有结束。
+   * 等待前先检测死锁，如果 holder 直接或间接地在等待 waiter，当前事务就不再等待。
+   * 没有打开 CONCURRENCY 编译选项时，所有事务都在同一个线程中交替执行，不能等待。
+   * @return RC::SUCCESS holder 已经结束，可以重新检查记录；
+   *         RC::LOCKED_CONCURRENCY_CONFLICT 发生死锁、等待超时或者不支持等待
+   */
+  RC wait_trx(int32_t waiter_id, int32_t holder_id);
+
 public:
   int32_t max_trx_id() const;
 
@@ -50,14 +142,46 @@ private:
 
   atomic<int32_t> current_trx_id_{0};
 
-  common::Mutex lock_;
-  vector<Trx *> trxes_;
+  /**
+   * @brief 事务登记表的一个分片
+   * @details 事务对象按照地址，运行中的事务按照事务号，分散到不同的分片上
+   */
+  struct alignas(64) Shard
+  {
+    mutex              lock;
+    condition_variable cond;   ///< 这个分片上有事务结束时，唤醒等待的事务
+    vector<Trx *>      trxes;  ///< 事务对象
+    /// 正在运行的事务。value 是提交事务号，还没有开始提交时为0
+    unordered_map<int32_t, int32_t> running_trxes;
+  };
+
+  static constexpr int SHARD_NUM = 64;
+
+  Shard &trx_shard(const Trx *trx) { return shards_[(reinterpret_cast<uintptr_t>(trx) >> 4) % SHARD_NUM]; }
+  Shard &xid_shard(int32_t trx_id) { return shards_[static_cast<uint32_t>(trx_id) % SHARD_NUM]; }
+
+  array<Shard, SHARD_NUM> shards_;
+
+  /// 收集活跃事务的次数，登记事务时用来检查有没有被漏掉
+  atomic<int64_t> collect_epoch_{0};
+
+  mutex                           waits_lock_;  /// 保护等待关系，只有发生写冲突时才会用到
+  unordered_map<int32_t, int32_t> waits_for_;   /// 等待关系，key 在等待 value 结束
+
+  int lock_wait_timeout_ms_ = DEFAULT_LOCK_WAIT_TIMEOUT_MS;
+
+  MvccTrxCommitGroup commit_group_;
 };
 
 /**
  * @brief 多版本并发事务
  * @ingroup Transaction
- * TODO 没有垃圾回收
+ * @details 每条记录带有 begin xid 和 end xid，表示记录这个版本的生命周期。
+ * 修改记录时不会覆盖旧的版本，而是将旧版本的 end xid 标记为当前事务，再插入一个新的版本，
+ * 同一行数据的多个版本一起构成版本链。读事务按照自己的快照选择可见的版本，不会阻塞也不会失败。
+ * 写事务遇到其它未结束事务修改过的记录时，等待它结束。如果它提交了，说明当前事务要修改的版本已经过期，
+ * 返回写冲突；如果它回滚了，就继续修改。
+ * 已经没有事务能看到的旧版本由 MvccTrxKit::vacuum 清理。
  */
 class MvccTrx : public Trx
 {
@@ -73,7 +197,12 @@ public:
 
   RC insert_record(Table *table, Record &record) override;
   RC delete_record(Table *table, Record &record) override;
-  RC update_record(Table *table, Record &old_record, Record &new_record) override { return RC::UNIMPLEMENTED; };
+  /**
+   * @brief 更新记录
+   * @details 将 old_record 这个版本标记为删除，再插入 new_record 作为新的版本。
+   * 旧的版本会保留在表中，快照更早的事务仍然可以读到它。
+   */
+  RC update_record(Table *table, Record &old_record, Record &new_record) override;
 
   /**
    * @brief 当访问到某条数据时，使用此函数来判断是否可见，或者是否有访问冲突
@@ -83,20 +212,56 @@ public:
    * @param mode     是否只读访问
    * @return RC      - SUCCESS 成功
    *                 - RECORD_INVISIBLE 此数据对当前事务不可见，应该跳过
-   *                 - LOCKED_CONCURRENCY_CONFLICT 与其它事务有冲突
+   * @note 这里只判断可见性，即使以读写模式访问也不会因为其它事务而失败。写冲突在修改记录时处理
    */
   RC visit_record(Table *table, Record &record, ReadWriteMode mode) override;
 
+  /**
+   * @brief 只读访问时，清理线程标记为全部可见的页面上的记录一定可见
+   * @details 标记之后任何修改都会先清除标记，包括当前事务自己的修改
+   */
+  bool is_visible_without_record(Table *table, const RID &rid, ReadWriteMode mode) override;
+
   RC start_if_need() override;
   RC commit() override;
   RC rollback() override;
 
+  /// @brief 打开了合并提交时，提交日志和其它会话的单语句事务一起写
+  RC autocommit() override;
+
   RC redo(Db *db, const LogEntry &log_entry) override;
 
   int32_t id() const override { return trx_id_; }
 
+  /**
+   * @brief 当前事务写下的第一条日志的LSN(的下界)
+   * @details 事务第一次修改数据前记录，提交或回滚的日志写完以后清零。检查点线程会并发读取。
+   */
+  LSN first_lsn() const { return first_lsn_.load(); }
+
 private:
-  RC   commit_with_trx_id(int32_t commit_id);
+  /**
+   * @brief 记录上的事务号在当前事务看来的状态
+   */
+  enum class XidState
+  {
+    SELF,         ///< 当前事务自己的修改
+    COMMITTED,    ///< 已经提交的修改，提交事务号通过参数返回
+    UNCOMMITTED,  ///< 其它事务还没有提交的修改
+  };
+
+  XidState resolve_xid(int32_t xid, int32_t &commit_xid);
+
+  /**
+   * @brief 当前事务要修改记录时，检查记录是否可见以及是否有写冲突
+   * @param holder_id 记录被其它未结束的事务修改时，返回那个事务的事务号
+   * @return RC::LOCKED_NEED_WAIT 需要等待 holder_id 结束
+   */
+  RC check_write(Table *table, Record &record, int32_t &holder_id);
+
+  RC   do_commit(bool group_commit);
+  RC   commit_with_trx_id(int32_t commit_id, bool group_commit = false);
+  void mark_first_lsn();
   void trx_fields(Table *table, Field &begin_xid_field, Field &end_xid_field) const;
 
 private:
@@ -112,4 +277,5 @@ private:
   bool              started_    = false;
   bool              recovering_ = false;
   OperationSet      operations_;
+  atomic<LSN>       first_lsn_{0};
 };
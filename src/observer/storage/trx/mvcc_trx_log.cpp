@@ -31,6 +31,7 @@ string MvccTrxLogOperation::to_string() const
     case Type::DELETE_RECORD: return ret + "DELETE_RECORD";
     case Type::COMMIT: return ret + "COMMIT";
     case Type::ROLLBACK: return ret + "ROLLBACK";
+    case Type::GROUP_COMMIT: return ret + "GROUP_COMMIT";
     default: return ret + "UNKNOWN";
   }
 }
@@ -62,12 +63,27 @@ string MvccTrxCommitLogEntry::to_string() const
   return ss.str();
 }
 
+const int32_t MvccTrxGroupCommitLogEntry::SIZE = sizeof(MvccTrxGroupCommitLogEntry);
+
+string MvccTrxGroupCommitLogEntry::to_string() const
+{
+  stringstream ss;
+  ss << header.to_string() << ", trx_count: " << trx_count << ", trxes: [";
+  for (int32_t i = 0; i < trx_count; i++) {
+    ss << (i == 0 ? "" : ", ") << members()[i].trx_id << ":" << members()[i].commit_trx_id;
+  }
+  ss << "]";
+  return ss.str();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 MvccTrxLogHandler::MvccTrxLogHandler(LogHandler &log_handler) : log_handler_(log_handler) {}
 
 MvccTrxLogHandler::~MvccTrxLogHandler() {}
 
+LSN MvccTrxLogHandler::current_lsn() const { return log_handler_.current_lsn(); }
+
 RC MvccTrxLogHandler::insert_record(int32_t trx_id, Table *table, const RID &rid)
 {
   ASSERT(trx_id > 0, "invalid trx_id:%d", trx_id);
@@ -119,6 +135,33 @@ RC MvccTrxLogHandler::commit(int32_t trx_id, int32_t commit_trx_id)
   return log_handler_.wait_lsn(lsn);
 }
 
+RC MvccTrxLogHandler::group_commit(const vector<pair<int32_t, int32_t>> &trxes)
+{
+  ASSERT(!trxes.empty(), "empty commit group");
+
+  vector<char> data(MvccTrxGroupCommitLogEntry::SIZE + trxes.size() * sizeof(MvccTrxGroupCommitLogEntry::Member));
+  auto        *log_entry            = reinterpret_cast<MvccTrxGroupCommitLogEntry *>(data.data());
+  log_entry->header.operation_type = MvccTrxLogOperation(MvccTrxLogOperation::Type::GROUP_COMMIT).index();
+  log_entry->header.trx_id         = trxes.front().first;
+  log_entry->trx_count             = static_cast<int32_t>(trxes.size());
+
+  auto *members = reinterpret_cast<MvccTrxGroupCommitLogEntry::Member *>(log_entry + 1);
+  for (size_t i = 0; i < trxes.size(); i++) {
+    ASSERT(trxes[i].first > 0 && trxes[i].second > trxes[i].first, 
+           "invalid trx_id:%d, commit_trx_id:%d", trxes[i].first, trxes[i].second);
+    members[i].trx_id        = trxes[i].first;
+    members[i].commit_trx_id = trxes[i].second;
+  }
+
+  LSN lsn = 0;
+  RC  rc  = log_handler_.append(lsn, LogModule::Id::TRANSACTION, std::move(data));
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  return log_handler_.wait_lsn(lsn);
+}
+
 RC MvccTrxLogHandler::rollback(int32_t trx_id)
 {
   ASSERT(trx_id > 0, "invalid trx_id:%d", trx_id);
@@ -132,6 +175,46 @@ RC MvccTrxLogHandler::rollback(int32_t trx_id)
       lsn, LogModule::Id::TRANSACTION, span<const char>(reinterpret_cast<const char *>(&log_entry), sizeof(log_entry)));
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+RC MvccTrxCommitGroup::commit(MvccTrxLogHandler &log_handler, int32_t trx_id, int32_t commit_trx_id)
+{
+  unique_lock lock(mutex_);
+
+  shared_ptr<Group> group  = current_;
+  const bool        leader = (group == nullptr);
+  if (leader) {
+    group    = make_shared<Group>();
+    current_ = group;
+  }
+  group->trxes.emplace_back(trx_id, commit_trx_id);
+
+  if (!leader) {
+    if (group->trxes.size() >= MAX_GROUP_SIZE) {
+      current_ = nullptr;
+      full_cond_.notify_all();
+    }
+    done_cond_.wait(lock, [&group] { return group->done; });
+    return group->rc;
+  }
+
+  full_cond_.wait_for(
+      lock, chrono::microseconds(delay_us_), [&group] { return group->trxes.size() >= MAX_GROUP_SIZE; });
+  if (current_ == group) {
+    current_ = nullptr;
+  }
+  // 这一组已经关闭，不会再有事务加入，写日志时不需要持有锁
+  lock.unlock();
+
+  RC rc = log_handler.group_commit(group->trxes);
+
+  lock.lock();
+  group->rc   = rc;
+  group->done = true;
+  lock.unlock();
+  done_cond_.notify_all();
+  return rc;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 MvccTrxLogReplayer::MvccTrxLogReplayer(Db &db, MvccTrxKit &trx_kit, LogHandler &log_handler)
     : db_(db), trx_kit_(trx_kit), log_handler_(log_handler)
@@ -150,12 +233,16 @@ RC MvccTrxLogReplayer::replay(const LogEntry &entry)
     return RC::LOG_ENTRY_INVALID;
   }
 
-  auto    *header   = reinterpret_cast<const MvccTrxLogHeader *>(entry.data());
+  auto *header = reinterpret_cast<const MvccTrxLogHeader *>(entry.data());
+  if (MvccTrxLogOperation(header->operation_type).type() == MvccTrxLogOperation::Type::GROUP_COMMIT) {
+    return replay_group_commit(entry);
+  }
+
   MvccTrx *trx      = nullptr;
   auto     trx_iter = trx_map_.find(header->trx_id);
   if (trx_iter == trx_map_.end()) {
     trx = static_cast<MvccTrx *>(trx_kit_.create_trx(log_handler_, header->trx_id));
-    // trx = new MvccTrx(trx_kit_, log_handler_, header->trx_id);
+    trx_map_.emplace(header->trx_id, trx);
   } else {
     trx = trx_iter->second;
   }
@@ -163,10 +250,14 @@ RC MvccTrxLogReplayer::replay(const LogEntry &entry)
   /// 直接调用事务代码自己的重放函数
   rc = trx->redo(&db_, entry);
 
+  /// 提交事务号也已经写到了记录上，以后分配的事务号要比它大
+  if (MvccTrxLogOperation(header->operation_type).type() == MvccTrxLogOperation::Type::COMMIT) {
+    trx_kit_.advance_trx_id(reinterpret_cast<const MvccTrxCommitLogEntry *>(entry.data())->commit_trx_id);
+  }
+
   /// 如果事务结束了，需要从内存中把它删除
   if (MvccTrxLogOperation(header->operation_type).type() == MvccTrxLogOperation::Type::ROLLBACK ||
       MvccTrxLogOperation(header->operation_type).type() == MvccTrxLogOperation::Type::COMMIT) {
-    Trx *trx = trx_map_[header->trx_id];
     trx_kit_.destroy_trx(trx);
     trx_map_.erase(header->trx_id);
   }
@@ -174,13 +265,35 @@ RC MvccTrxLogReplayer::replay(const LogEntry &entry)
   return rc;
 }
 
+RC MvccTrxLogReplayer::replay_group_commit(const LogEntry &entry)
+{
+  auto *log_entry = reinterpret_cast<const MvccTrxGroupCommitLogEntry *>(entry.data());
+  if (entry.payload_size() < MvccTrxGroupCommitLogEntry::SIZE ||
+      entry.payload_size() < MvccTrxGroupCommitLogEntry::SIZE +
+                                 log_entry->trx_count * static_cast<int32_t>(sizeof(MvccTrxGroupCommitLogEntry::Member))) {
+    LOG_WARN("invalid group commit log entry size: %d", entry.payload_size());
+    return RC::LOG_ENTRY_INVALID;
+  }
+
+  /// 和单独提交的日志一样，组里的每个事务都结束了
+  for (int32_t i = 0; i < log_entry->trx_count; i++) {
+    trx_kit_.advance_trx_id(log_entry->members()[i].commit_trx_id);
+    auto trx_iter = trx_map_.find(log_entry->members()[i].trx_id);
+    if (trx_iter != trx_map_.end()) {
+      trx_kit_.destroy_trx(trx_iter->second);
+      trx_map_.erase(trx_iter);
+    }
+  }
+  return RC::SUCCESS;
+}
+
 RC MvccTrxLogReplayer::on_done()
 {
   /// 日志回放已经完成，需要把没有提交的事务，回滚掉
   for (auto &pair : trx_map_) {
     MvccTrx *trx = pair.second;
     trx->rollback();  // 恢复时的rollback，可能遇到之前已经回滚一半的事务又再次调用回滚的情况
-    delete pair.second;
+    trx_kit_.destroy_trx(trx);
   }
   trx_map_.clear();
 
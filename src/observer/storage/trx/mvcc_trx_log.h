@@ -16,8 +16,13 @@ See the Mulan PSL v2 for more details. */
 
 #include "common/sys/rc.h"
 #include "common/types.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
 #include "common/lang/string.h"
 #include "common/lang/unordered_map.h"
+#include "common/lang/utility.h"
+#include "common/lang/vector.h"
 #include "storage/record/record.h"
 #include "storage/clog/log_replayer.h"
 
@@ -40,7 +45,8 @@ public:
     INSERT_RECORD,  ///< 插入一条记录
     DELETE_RECORD,  ///< 删除一条记录
     COMMIT,         ///< 提交事务
-    ROLLBACK        ///< 回滚事务
+    ROLLBACK,       ///< 回滚事务
+    GROUP_COMMIT    ///< 一组事务一起提交
   };
 
 public:
@@ -102,6 +108,30 @@ struct MvccTrxCommitLogEntry
   string to_string() const;
 };
 
+/**
+ * @brief 一组事务一起提交的日志
+ * @ingroup CLog
+ * @details 变长的日志。固定部分后面紧跟着 trx_count 个 Member。
+ * 头部中的事务ID是第一个事务的ID。
+ */
+struct MvccTrxGroupCommitLogEntry
+{
+  struct Member
+  {
+    int32_t trx_id;         ///< 事务ID
+    int32_t commit_trx_id;  ///< 提交的事务ID
+  };
+
+  MvccTrxLogHeader header;     ///< 日志头部
+  int32_t          trx_count;  ///< 这一组中事务的个数
+
+  static const int32_t SIZE;  ///< 固定部分的大小
+
+  const Member *members() const { return reinterpret_cast<const Member *>(this + 1); }
+
+  string to_string() const;
+};
+
 /**
  * @brief 处理事务日志的辅助类
  * @ingroup CLog
@@ -128,16 +158,71 @@ public:
    */
   RC commit(int32_t trx_id, int32_t commit_trx_id);
 
+  /**
+   * @brief 记录一组事务一起提交的日志
+   * @details 只写一条日志，会等待日志落地
+   * @param trxes 每个事务的事务ID和提交事务ID
+   */
+  RC group_commit(const vector<pair<int32_t, int32_t>> &trxes);
+
   /**
    * @brief 记录回滚事务的日志
    * @details 不会等待日志落地
    */
   RC rollback(int32_t trx_id);
 
+  /// @brief 当前日志的LSN，事务开始写日志前记录下来
+  LSN current_lsn() const;
+
 private:
   LogHandler &log_handler_;
 };
 
+/**
+ * @brief 把并发提交的单语句事务合并成一组，共用一条提交日志和一次刷盘
+ * @ingroup Transaction
+ * @details 第一个到达的事务成为这一组的组长，它等待一小段时间，让其它事务加入，
+ * 然后关闭这一组，写一条组提交日志并等待它落地，再唤醒组里的其它事务。
+ * 组长写日志的时候，新到达的事务会组成下一组。
+ * 每个事务的修改已经各自提交到了记录上，这里只负责提交日志，所以每条语句仍然是一个独立的事务。
+ * 代价是提交要多等待最多 delay_us 微秒。
+ */
+class MvccTrxCommitGroup final
+{
+public:
+  static constexpr int MAX_GROUP_SIZE = 128;  ///< 一组中最多的事务个数，达到以后组长不再等待
+
+public:
+  MvccTrxCommitGroup()  = default;
+  ~MvccTrxCommitGroup() = default;
+
+  /// @brief 设置组长等待其它事务加入的时间，0表示不合并提交
+  void set_delay_us(int delay_us) { delay_us_ = delay_us; }
+  bool enabled() const { return delay_us_ > 0; }
+
+  /**
+   * @brief 加入一组提交，等待这一组的提交日志落地
+   * @param log_handler 组长使用它写日志。同一个事务管理器中的事务写的是同一个日志
+   * @return 这一组提交日志的结果
+   */
+  RC commit(MvccTrxLogHandler &log_handler, int32_t trx_id, int32_t commit_trx_id);
+
+private:
+  struct Group
+  {
+    vector<pair<int32_t, int32_t>> trxes;        ///< 事务ID和提交事务ID
+    bool                           done = false;  ///< 提交日志已经落地
+    RC                             rc   = RC::SUCCESS;
+  };
+
+  int delay_us_ = 0;
+
+  mutex              mutex_;
+  condition_variable full_cond_;  ///< 这一组满了，唤醒组长
+  condition_variable done_cond_;  ///< 提交日志落地了，唤醒组里的事务
+  shared_ptr<Group>  current_;    ///< 还在接受事务加入的组
+};
+
 /**
  * @brief 事务日志回放器
  * @ingroup CLog
@@ -154,6 +239,9 @@ public:
   //! @copydoc LogReplayer::on_done
   RC on_done() override;
 
+private:
+  RC replay_group_commit(const LogEntry &entry);
+
 private:
   Db         &db_;           ///< 所属数据库
   MvccTrxKit &trx_kit_;      ///< 事务管理器
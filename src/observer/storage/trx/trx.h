@@ -129,6 +129,59 @@ public:
 
   virtual LogReplayer *create_log_replayer(Db &db, LogHandler &log_handler) = 0;
 
+  /**
+   * @brief 所有活跃事务写下的第一条日志中，最小的LSN
+   * @details 做检查点时使用。恢复时需要从这个位置开始回放，才能找到这些事务的所有操作，
+   * 进而在恢复完成时提交或回滚它们。
+   * @return 没有活跃事务或者事务不写日志时返回0
+   */
+  virtual LSN min_active_lsn() { return 0; }
+
+  /**
+   * @brief 目前为止分配过的最大的事务号，包括提交事务号
+   * @details 做检查点时记录到数据库的元数据中。检查点之前的日志会被回收，重启后回放日志时就看不到
+   * 这些事务号了，但是它们可能还记录在数据页面上
+   * @return 不分配事务号的事务管理器返回0
+   */
+  virtual int32_t current_trx_id() const { return 0; }
+
+  /**
+   * @brief 保证以后分配的事务号都比 trx_id 大
+   * @details 重启时在回放日志之前用检查点记录的事务号调用，回放提交日志时用提交事务号调用
+   */
+  virtual void advance_trx_id(int32_t trx_id) {}
+
+  /**
+   * @brief 设置写冲突时等待其它事务结束的最长时间
+   * @details 不支持等待的事务管理器忽略这个参数
+   */
+  virtual void set_lock_wait_timeout(int timeout_ms) {}
+
+  /**
+   * @brief 设置合并提交时等待其它事务加入的最长时间
+   * @details 0表示每个事务单独提交。不写提交日志的事务管理器忽略这个参数
+   */
+  virtual void set_group_commit_delay(int delay_us) {}
+
+  /**
+   * @brief 清理表中已经没有任何事务能看到的旧版本记录
+   * @details 后台线程周期性地调用。不保留旧版本的事务管理器什么都不做
+   * @param purged_count 返回清理掉的记录数
+   */
+  virtual RC vacuum(Table *table, int &purged_count)
+  {
+    purged_count = 0;
+    return RC::SUCCESS;
+  }
+
+  /**
+   * @brief 唯一索引中已经有相同键值的记录时，判断它是否与正在插入的记录冲突
+   * @details 不保留旧版本的事务管理器中，索引里的记录都是有效的，总是冲突
+   * @param existing_record 索引中已有的键值相同的记录
+   * @param new_record      正在插入的记录
+   */
+  virtual bool is_duplicate(Table *table, const Record &existing_record, const char *new_record) { return true; }
+
 public:
   static TrxKit *create(const char *name, Db *db);
 };
@@ -148,10 +201,24 @@ public:
   virtual RC update_record(Table *table, Record &old_record, Record &new_record) = 0;
   virtual RC visit_record(Table *table, Record &record, ReadWriteMode mode)      = 0;
 
+  /**
+   * @brief 不读取记录，判断指定位置上的记录是否可见
+   * @details 覆盖索引扫描时使用，返回true时可以直接使用索引中的数据，不需要回表。
+   * 返回false表示无法确定，需要读取记录以后再调用 visit_record
+   */
+  virtual bool is_visible_without_record(Table *table, const RID &rid, ReadWriteMode mode) { return false; }
+
   virtual RC start_if_need() = 0;
   virtual RC commit()        = 0;
   virtual RC rollback()      = 0;
 
+  /**
+   * @brief 提交一条语句自动开启的事务
+   * @details 和 commit 的语义相同。事务管理器可以把多个会话并发提交的单语句事务合并到一起，
+   * 共用一次提交日志的刷盘
+   */
+  virtual RC autocommit() { return commit(); }
+
   virtual RC redo(Db *db, const LogEntry &log_entry) = 0;
 
   virtual int32_t id() const = 0;
@@ -47,6 +47,7 @@ public:
   RC delete_record(Table *table, Record &record) override;
   RC update_record(Table *table, Record &old_record, Record &new_record) override { return RC::UNIMPLEMENTED; }
   RC visit_record(Table *table, Record &record, ReadWriteMode mode) override;
+  bool is_visible_without_record(Table *table, const RID &rid, ReadWriteMode mode) override { return true; }
   RC start_if_need() override;
   RC commit() override;
   RC rollback() override;
@@ -50,7 +50,7 @@ public:
              << "payload size = " << entry.payload_size() << ", expected size = " << RecordLogHeader::SIZE;
         } else {
           auto *record_log_header = reinterpret_cast<const RecordLogHeader *>(entry.data());
-          ss << record_log_header->to_string();
+          ss << record_log_header->to_string() << ", data_size:" << entry.payload_size() - RecordLogHeader::SIZE;
         }
       } break;
       case LogModule::Id::BPLUS_TREE: {
@@ -68,6 +68,9 @@ public:
         } else if (operation_type.type() == MvccTrxLogOperation::Type::COMMIT) {
           auto *commit_log = reinterpret_cast<const MvccTrxCommitLogEntry *>(entry.data());
           ss << commit_log->to_string();
+        } else if (operation_type.type() == MvccTrxLogOperation::Type::GROUP_COMMIT) {
+          auto *group_commit_log = reinterpret_cast<const MvccTrxGroupCommitLogEntry *>(entry.data());
+          ss << group_commit_log->to_string();
         } else {
           ss << header->to_string();
         }
@@ -67,6 +67,35 @@ TEST(test_bitmap, test_bitmap)
   ASSERT_EQ(16, bitmap3.next_setted_bit(8));
 }
 
+TEST(test_bitmap, test_bitmap_words)
+{
+  // 跨越多个64位字的查找，与逐位检查的结果比较
+  const int size = 1000;
+  char      buf[(size + 7) / 8];
+  memset(buf, 0, sizeof(buf));
+  Bitmap bitmap(buf, size);
+  for (int i = 0; i < size; i++) {
+    if (i % 7 == 0 || i % 64 == 63 || (i > 300 && i < 700)) {
+      bitmap.set_bit(i);
+    }
+  }
+
+  for (int start = 0; start <= size; start++) {
+    int expected_setted   = -1;
+    int expected_unsetted = -1;
+    for (int i = start; i < size; i++) {
+      if (expected_setted == -1 && bitmap.get_bit(i)) {
+        expected_setted = i;
+      }
+      if (expected_unsetted == -1 && !bitmap.get_bit(i)) {
+        expected_unsetted = i;
+      }
+    }
+    ASSERT_EQ(expected_setted, bitmap.next_setted_bit(start));
+    ASSERT_EQ(expected_unsetted, bitmap.next_unsetted_bit(start));
+  }
+}
+
 int main(int argc, char **argv)
 {
   // 分析gtest程序的命令行参数
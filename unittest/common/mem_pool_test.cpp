@@ -65,6 +65,43 @@ struct Frame
   void reset() {}
 };
 
+TEST(test_mem_pool_mapped, test_mem_pool_mapped_basic)
+{
+  MemPoolMapped<Frame> pool("test_mapped", true /*numa_interleave*/);
+
+  ASSERT_EQ(0, pool.init(true, 2, 3));
+  ASSERT_FALSE(pool.is_dynamic());
+  ASSERT_EQ(6, pool.get_size());
+  ASSERT_GE(pool.get_mapped_size(), 6 * sizeof(Frame));
+  ASSERT_EQ(0UL, pool.get_mapped_size() % (2UL << 20));
+
+  list<Frame *> used_list;
+  for (int i = 0; i < 6; i++) {
+    Frame *frame = pool.alloc();
+    ASSERT_NE(nullptr, frame);
+    memset(frame->buf, i, sizeof(frame->buf));
+    used_list.push_back(frame);
+  }
+
+  // 内存是一次性预留的，不能再扩展
+  ASSERT_EQ(nullptr, pool.alloc());
+
+  pool.free(used_list.front());
+  used_list.pop_front();
+  Frame *frame = pool.alloc();
+  ASSERT_NE(nullptr, frame);
+  used_list.push_back(frame);
+  ASSERT_EQ(6, pool.get_used_num());
+
+  for (Frame *frame : used_list) {
+    pool.free(frame);
+  }
+  ASSERT_EQ(0, pool.get_used_num());
+
+  pool.cleanup();
+  ASSERT_EQ(0, pool.get_size());
+}
+
 #ifdef ENABLE_ASAN
 TEST(mm, mm_illegal_access)
 {
@@ -58,6 +58,41 @@ TEST(Serializer, serializer)
   ASSERT_NE(ret, 0);
 }
 
+TEST(Serializer, varint32)
+{
+  const int32_t values[] = {0, 1, -1, 63, -64, 64, 127, 128, 300, -300, 1 << 20, INT32_MAX, INT32_MIN};
+
+  Serializer serializer;
+  for (int32_t value : values) {
+    serializer.write_varint32(value);
+  }
+  serializer.write_int32(12345);
+
+  Deserializer deserializer(serializer.data());
+  for (int32_t value : values) {
+    int32_t read_value = 0;
+    ASSERT_EQ(0, deserializer.read_varint32(read_value));
+    ASSERT_EQ(value, read_value);
+  }
+  int32_t tail = 0;
+  ASSERT_EQ(0, deserializer.read_int32(tail));
+  ASSERT_EQ(12345, tail);
+
+  // 小数字只占一个字节
+  Serializer small;
+  small.write_varint32(-1);
+  small.write_varint32(63);
+  ASSERT_EQ(2, small.size());
+
+  // 前5个数字各占一个字节，64和127各占两个字节，128只剩下一个字节
+  int32_t      value = 0;
+  Deserializer truncated(span<const char>(serializer.data().data(), 5 + 2 + 2 + 1));
+  for (int i = 0; i < 7; i++) {
+    ASSERT_EQ(0, truncated.read_varint32(value));
+  }
+  ASSERT_NE(0, truncated.read_varint32(value));
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -82,6 +82,128 @@ TEST_F(ObLsmTransactionTest, DISABLED_oblsm_test_basic1)
   delete txn3;
 }
 
+TEST_F(ObLsmTransactionTest, DISABLED_oblsm_test_get_and_remove)
+{
+  db->put("key1", "value1");
+  db->put("key2", "value2");
+
+  auto   txn1 = db->begin_transaction();
+  string value;
+  ASSERT_EQ(RC::SUCCESS, txn1->get("key1", &value));
+  ASSERT_EQ("value1", value);
+
+  txn1->put("key1", "valuetxn1");
+  txn1->remove("key2");
+  ASSERT_EQ(RC::SUCCESS, txn1->get("key1", &value));
+  ASSERT_EQ("valuetxn1", value);
+  ASSERT_EQ(RC::NOT_EXIST, txn1->get("key2", &value));
+
+  auto iter_txn1 = txn1->new_iterator(ObLsmReadOptions());
+  ASSERT_TRUE(check_lsm_scan_result_by_value(iter_txn1, {"valuetxn1"}));
+  delete iter_txn1;
+
+  // uncommitted changes are invisible to others
+  ASSERT_EQ(RC::SUCCESS, db->get("key1", &value));
+  ASSERT_EQ("value1", value);
+
+  ASSERT_EQ(RC::SUCCESS, txn1->commit());
+  ASSERT_EQ(RC::SUCCESS, db->get("key1", &value));
+  ASSERT_EQ("valuetxn1", value);
+  ASSERT_EQ(RC::NOT_EXIST, db->get("key2", &value));
+
+  auto txn2 = db->begin_transaction();
+  txn2->put("key3", "value3");
+  ASSERT_EQ(RC::SUCCESS, txn2->rollback());
+  ASSERT_EQ(RC::NOT_EXIST, db->get("key3", &value));
+
+  delete txn1;
+  delete txn2;
+}
+
+TEST_F(ObLsmTransactionTest, DISABLED_oblsm_test_conflict)
+{
+  db->put("key1", "value1");
+  db->put("key2", "value2");
+
+  auto txn1 = db->begin_transaction();
+  auto txn2 = db->begin_transaction();
+  auto txn3 = db->begin_transaction();
+  txn1->put("key1", "valuetxn1");
+  txn2->put("key1", "valuetxn2");
+  txn3->put("key2", "valuetxn3");
+
+  // the first committer wins, later transactions writing the same key fail
+  ASSERT_EQ(RC::SUCCESS, txn1->commit());
+  ASSERT_EQ(RC::LOCKED_CONCURRENCY_CONFLICT, txn2->commit());
+  ASSERT_EQ(RC::SUCCESS, txn3->commit());
+
+  string value;
+  ASSERT_EQ(RC::SUCCESS, db->get("key1", &value));
+  ASSERT_EQ("valuetxn1", value);
+  ASSERT_EQ(RC::SUCCESS, db->get("key2", &value));
+  ASSERT_EQ("valuetxn3", value);
+
+  // a transaction keeps reading its snapshot
+  auto txn4 = db->begin_transaction();
+  db->put("key1", "value4");
+  ASSERT_EQ(RC::SUCCESS, txn4->get("key1", &value));
+  ASSERT_EQ("valuetxn1", value);
+  txn4->put("key1", "valuetxn4");
+  ASSERT_EQ(RC::LOCKED_CONCURRENCY_CONFLICT, txn4->commit());
+
+  delete txn1;
+  delete txn2;
+  delete txn3;
+  delete txn4;
+}
+
+TEST(ObLsmTransactionIteratorTest, trx_iterator_merge)
+{
+  // removed keys have empty values in the transaction's store
+  map<string, string> trx_store{{"key0", "trx0"}, {"key2", "trx2"}, {"key3", ""}, {"key6", ""}, {"key7", "trx7"}};
+  map<string, string> db_store{{"key1", "db1"}, {"key2", "db2"}, {"key3", "db3"}, {"key4", "db4"}, {"key6", "db6"}};
+
+  TrxIterator iter(new TrxInnerMapIterator(trx_store), new TrxInnerMapIterator(db_store));
+  vector<pair<string, string>> expected{{"key0", "trx0"}, {"key1", "db1"}, {"key2", "trx2"}, {"key4", "db4"}, {"key7", "trx7"}};
+
+  iter.seek_to_first();
+  for (const auto &[key, value] : expected) {
+    ASSERT_TRUE(iter.valid());
+    ASSERT_EQ(key, iter.key());
+    ASSERT_EQ(value, iter.value());
+    iter.next();
+  }
+  ASSERT_FALSE(iter.valid());
+
+  iter.seek("key3");
+  ASSERT_TRUE(iter.valid());
+  ASSERT_EQ("key4", iter.key());
+  ASSERT_EQ("db4", iter.value());
+
+  iter.seek_to_last();
+  ASSERT_TRUE(iter.valid());
+  ASSERT_EQ("key7", iter.key());
+  ASSERT_EQ("trx7", iter.value());
+  iter.next();
+  ASSERT_FALSE(iter.valid());
+
+  // the last key of the database is removed and the transaction writes nothing after it
+  trx_store.erase("key7");
+  iter.seek_to_last();
+  ASSERT_TRUE(iter.valid());
+  ASSERT_EQ("key4", iter.key());
+  ASSERT_EQ("db4", iter.value());
+  iter.next();
+  ASSERT_FALSE(iter.valid());
+
+  trx_store.clear();
+  db_store.clear();
+  iter.seek_to_first();
+  ASSERT_FALSE(iter.valid());
+  iter.seek_to_last();
+  ASSERT_FALSE(iter.valid());
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
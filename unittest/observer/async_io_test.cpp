@@ -0,0 +1,97 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "common/log/log.h"
+#include "common/lang/vector.h"
+#include "storage/buffer/async_io.h"
+#include "storage/buffer/page.h"
+
+using namespace std;
+using namespace common;
+
+void test_write_read(const char *engine)
+{
+  const char *filename = "async_io_test.data";
+  ::remove(filename);
+
+  int fd = open(filename, O_CREAT | O_RDWR, 0644);
+  ASSERT_GE(fd, 0);
+
+  unique_ptr<AsyncIo> async_io;
+  ASSERT_EQ(RC::SUCCESS, AsyncIo::create(engine, 8, async_io));
+
+  // 请求的个数比队列深度多，需要分多轮提交
+  const int         page_num = 100;
+  vector<Page>      pages(page_num);
+  vector<IoRequest> requests(page_num);
+  for (int i = 0; i < page_num; i++) {
+    memset(&pages[i], i, sizeof(Page));
+    pages[i].lsn = i;
+
+    // 倒序写入，检查偏移量是否正确
+    const int page_num_in_file = page_num - 1 - i;
+    requests[i].type           = IoRequest::Type::WRITE;
+    requests[i].fd             = fd;
+    requests[i].buf            = &pages[i];
+    requests[i].size           = sizeof(Page);
+    requests[i].offset         = static_cast<int64_t>(page_num_in_file) * sizeof(Page);
+  }
+  ASSERT_EQ(RC::SUCCESS, async_io->execute(requests));
+  for (const IoRequest &request : requests) {
+    ASSERT_EQ(RC::SUCCESS, request.rc);
+  }
+
+  vector<Page> read_pages(page_num);
+  for (int i = 0; i < page_num; i++) {
+    requests[i].type   = IoRequest::Type::READ;
+    requests[i].buf    = &read_pages[i];
+    requests[i].offset = static_cast<int64_t>(i) * sizeof(Page);
+    requests[i].rc     = RC::INTERNAL;
+  }
+  ASSERT_EQ(RC::SUCCESS, async_io->execute(requests));
+  for (int i = 0; i < page_num; i++) {
+    ASSERT_EQ(RC::SUCCESS, requests[i].rc);
+    ASSERT_EQ(0, memcmp(&read_pages[i], &pages[page_num - 1 - i], sizeof(Page)));
+  }
+
+  // 读到文件尾
+  IoRequest eof_request;
+  eof_request.type   = IoRequest::Type::READ;
+  eof_request.fd     = fd;
+  eof_request.buf    = &read_pages[0];
+  eof_request.size   = sizeof(Page);
+  eof_request.offset = static_cast<int64_t>(page_num) * sizeof(Page);
+  ASSERT_EQ(RC::SUCCESS, async_io->execute(span<IoRequest>(&eof_request, 1)));
+  ASSERT_EQ(RC::IOERR_READ, eof_request.rc);
+
+  close(fd);
+  ::remove(filename);
+}
+
+TEST(AsyncIo, posix) { test_write_read("posix"); }
+
+TEST(AsyncIo, io_uring) { test_write_read("io_uring"); }
+
+TEST(AsyncIo, unknown)
+{
+  unique_ptr<AsyncIo> async_io;
+  ASSERT_EQ(RC::INVALID_ARGUMENT, AsyncIo::create("unknown", 8, async_io));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  LoggerFactory::init_default("async_io_test.log", LOG_LEVEL_TRACE);
+  return RUN_ALL_TESTS();
+}
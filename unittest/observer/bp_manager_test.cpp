@@ -12,6 +12,7 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai.wyl on 2021
 //
 
+#include "common/lang/thread.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "gtest/gtest.h"
 
@@ -125,6 +126,170 @@ TEST(test_frame_manager, test_frame_manager_simple_lru)
   frame_manager.cleanup();
 }
 
+TEST(test_frame_manager, test_frame_manager_partitions)
+{
+  BPFrameManager frame_manager("Test");
+  frame_manager.init(2, 7);
+  ASSERT_EQ(7, frame_manager.partition_num());
+
+  test_get(frame_manager);
+
+  test_alloc(frame_manager);
+
+  frame_manager.cleanup();
+}
+
+TEST(test_frame_manager, test_frame_manager_2q)
+{
+  BPFrameManager frame_manager("Test");
+  ASSERT_EQ(RC::SUCCESS, frame_manager.init(2, BPFrameManager::DEFAULT_PARTITION_NUM, "2q"));
+  ASSERT_STREQ("2q", frame_manager.replacer_name());
+
+  test_get(frame_manager);
+
+  test_alloc(frame_manager);
+
+  frame_manager.cleanup();
+
+  BPFrameManager invalid_frame_manager("Test");
+  ASSERT_EQ(RC::INVALID_ARGUMENT, invalid_frame_manager.init(2, BPFrameManager::DEFAULT_PARTITION_NUM, "unknown"));
+}
+
+TEST(test_frame_manager, test_frame_manager_mmap)
+{
+  BPFrameManager frame_manager("Test");
+  ASSERT_EQ(RC::SUCCESS, frame_manager.init(2, BPFrameManager::DEFAULT_PARTITION_NUM, nullptr, "mmap_interleave"));
+  ASSERT_STREQ("mmap_interleave", frame_manager.allocator_name());
+  ASSERT_EQ(static_cast<size_t>(2 * DEFAULT_ITEM_NUM_PER_POOL), frame_manager.total_frame_num());
+
+  test_get(frame_manager);
+
+  test_alloc(frame_manager);
+
+  frame_manager.cleanup();
+
+  BPFrameManager invalid_frame_manager("Test");
+  ASSERT_EQ(RC::INVALID_ARGUMENT,
+      invalid_frame_manager.init(2, BPFrameManager::DEFAULT_PARTITION_NUM, nullptr, "unknown"));
+}
+
+TEST(test_frame_manager, test_frame_manager_hit_ratio)
+{
+  BPFrameManager frame_manager("Test");
+  frame_manager.init(2);
+
+  const int buffer_pool_id = 1;
+  Frame    *frame          = frame_manager.alloc(buffer_pool_id, 1);
+  ASSERT_NE(frame, nullptr);
+  frame->unpin();
+
+  for (int i = 0; i < 3; i++) {
+    frame = frame_manager.get(buffer_pool_id, 1);
+    ASSERT_NE(frame, nullptr);
+    frame->unpin();
+  }
+  ASSERT_EQ(nullptr, frame_manager.get(buffer_pool_id, 2));
+
+  ASSERT_EQ(3, frame_manager.hit_count());
+  ASSERT_EQ(1, frame_manager.miss_count());
+  ASSERT_DOUBLE_EQ(0.75, frame_manager.hit_ratio());
+
+  frame_manager.reset_stat();
+  ASSERT_EQ(0, frame_manager.hit_count());
+  ASSERT_DOUBLE_EQ(0.0, frame_manager.hit_ratio());
+
+  frame = frame_manager.get(buffer_pool_id, 1);
+  frame_manager.free(buffer_pool_id, 1, frame);
+  frame_manager.cleanup();
+}
+
+TEST(test_frame_manager, test_frame_manager_prefetch)
+{
+  // 只有一个分区，淘汰顺序完全由 2Q 决定
+  BPFrameManager frame_manager("Test");
+  ASSERT_EQ(RC::SUCCESS, frame_manager.init(1, 1, "2q"));
+
+  const int     buffer_pool_id = 1;
+  const PageNum hot_page       = 0;
+  Frame        *frame          = frame_manager.alloc(buffer_pool_id, hot_page);
+  ASSERT_NE(frame, nullptr);
+  frame->unpin();
+  frame = frame_manager.get(buffer_pool_id, hot_page);
+  ASSERT_NE(frame, nullptr);
+  frame->unpin();
+
+  // 带预读的扫描：先预读页面，再访问一次。扫描的页面比页帧多得多
+  frame_manager.reset_stat();
+  const int scan_page_num = static_cast<int>(frame_manager.total_frame_num()) * 4;
+  for (PageNum page = 1; page <= scan_page_num; page++) {
+    frame = frame_manager.alloc(buffer_pool_id, page, true /*prefetch*/);
+    while (frame == nullptr) {
+      ASSERT_EQ(1, frame_manager.purge_frames(1, [](Frame *) { return RC::SUCCESS; }));
+      frame = frame_manager.alloc(buffer_pool_id, page, true /*prefetch*/);
+    }
+    frame->unpin();
+
+    frame = frame_manager.get(buffer_pool_id, page);
+    ASSERT_NE(frame, nullptr);
+    frame->unpin();
+  }
+
+  // 预读的页面第一次访问不算命中，也不会把它们当成热点页面挤掉真正的热点页面
+  ASSERT_EQ(0, frame_manager.hit_count());
+  ASSERT_EQ(0, frame_manager.miss_count());
+  ASSERT_EQ(scan_page_num, static_cast<int>(frame_manager.prefetch_hit_count()));
+  ASSERT_DOUBLE_EQ(0.0, frame_manager.hit_ratio());
+
+  frame = frame_manager.get(buffer_pool_id, hot_page);
+  ASSERT_NE(frame, nullptr);
+  frame->unpin();
+  ASSERT_EQ(1, frame_manager.hit_count());
+
+  // 再次访问预读的页面就是普通的命中
+  frame = frame_manager.get(buffer_pool_id, scan_page_num);
+  ASSERT_NE(frame, nullptr);
+  frame->unpin();
+  ASSERT_EQ(2, frame_manager.hit_count());
+
+  frame_manager.purge_frames(frame_manager.frame_num(), [](Frame *) { return RC::SUCCESS; });
+  frame_manager.cleanup();
+}
+
+TEST(test_frame_manager, test_frame_manager_concurrent_get)
+{
+  BPFrameManager frame_manager("Test");
+  frame_manager.init(4);
+
+  const int    buffer_pool_id = 1;
+  const size_t page_num       = frame_manager.total_frame_num();
+  for (size_t i = 0; i < page_num; i++) {
+    Frame *frame = frame_manager.alloc(buffer_pool_id, i);
+    ASSERT_NE(frame, nullptr);
+    frame->unpin();
+  }
+  ASSERT_EQ(page_num, frame_manager.frame_num());
+
+  vector<thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&frame_manager, page_num, t]() {
+      for (size_t i = 0; i < page_num * 10; i++) {
+        PageNum page  = static_cast<PageNum>((i * 7 + t) % page_num);
+        Frame  *frame = frame_manager.get(buffer_pool_id, page);
+        ASSERT_NE(frame, nullptr);
+        ASSERT_EQ(page, frame->page_num());
+        frame->unpin();
+      }
+    });
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+
+  ASSERT_EQ(static_cast<int>(page_num), frame_manager.purge_frames(page_num, [](Frame *) { return RC::SUCCESS; }));
+  ASSERT_EQ(0, frame_manager.frame_num());
+  frame_manager.cleanup();
+}
+
 int main(int argc, char **argv)
 {
 
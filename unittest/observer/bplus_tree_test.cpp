@@ -12,9 +12,13 @@ See the Mulan PSL v2 for more details. */
 // Created by longda on 2022
 //
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <list>
+#include <random>
 #include <filesystem>
+#include <thread>
 
 #include "common/log/log.h"
 #include "common/lang/memory.h"
@@ -22,6 +26,7 @@ See the Mulan PSL v2 for more details. */
 #include "sql/parser/parse_defs.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/index/bplus_tree.h"
+#include "storage/index/bplus_tree_bulk_loader.h"
 #include "storage/clog/vacuous_log_handler.h"
 #include "storage/buffer/double_write_buffer.h"
 #include "gtest/gtest.h"
@@ -568,6 +573,192 @@ TEST(test_bplus_tree, test_chars)
   ASSERT_EQ(2, count);
 }
 
+TEST(test_bplus_tree, test_get_entries)
+{
+  LoggerFactory::init_default("test_get_entries.log");
+
+  VacuousLogHandler log_handler;
+
+  filesystem::path test_directory("bplus_tree");
+  filesystem::path buffer_pool_file = test_directory / "get_entries.btree";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  BplusTreeHandler handler;
+  ASSERT_EQ(RC::SUCCESS, handler.create(log_handler, *buffer_pool, AttrType::CHARS, 8, ORDER, ORDER));
+
+  vector<RID> rids;
+  ASSERT_EQ(RC::SUCCESS, handler.get_entries("abc", 3, rids));
+  ASSERT_TRUE(rids.empty());
+
+  // 相同的键值跨越多个叶子节点
+  const char *keys[] = {"aaaaaaaa", "abc", "zzzzzzzz"};
+  const int   dup_num = ORDER * 4;
+  RID         rid;
+  for (int i = 0; i < dup_num; i++) {
+    for (int k = 0; k < 3; k++) {
+      rid.page_num = k;
+      rid.slot_num = i;
+      ASSERT_EQ(RC::SUCCESS, handler.insert_entry(keys[k], &rid));
+    }
+  }
+
+  for (int k = 0; k < 3; k++) {
+    ASSERT_EQ(RC::SUCCESS, handler.get_entries(keys[k], strlen(keys[k]), rids));
+    ASSERT_EQ(dup_num, static_cast<int>(rids.size()));
+    for (const RID &found : rids) {
+      ASSERT_EQ(k, found.page_num);
+    }
+  }
+  ASSERT_EQ(RC::SUCCESS, handler.get_entries("abcd", 4, rids));
+  ASSERT_TRUE(rids.empty());
+}
+
+TEST(test_bplus_tree, test_bulk_load)
+{
+  LoggerFactory::init_default("test_bulk_load.log");
+
+  VacuousLogHandler log_handler;
+
+  filesystem::path test_directory("bplus_tree");
+  filesystem::path buffer_pool_file = test_directory / "bulk_load.btree";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  BplusTreeHandler handler;
+  ASSERT_EQ(RC::SUCCESS, handler.create(log_handler, *buffer_pool, AttrType::INTS, sizeof(int), ORDER, ORDER));
+
+  // 内存只能放下两段，剩下的段都要写到临时文件中
+  const int      entry_num = 1000;
+  const int      key_num   = 200;
+  const AttrType attr_type = AttrType::INTS;
+  const int32_t  attr_len  = sizeof(int);
+
+  BplusTreeBulkLoadOptions options;
+  options.thread_num       = 2;
+  options.sort_buffer_size = 2 * 100 * (sizeof(int) + sizeof(RID));
+
+  const string tmp_file_prefix = (test_directory / "bulk_load.sort").string();
+  {
+    BplusTreeBulkLoader loader(
+        options, span<const AttrType>(&attr_type, 1), span<const int32_t>(&attr_len, 1), tmp_file_prefix);
+
+    vector<int> order(entry_num);
+    for (int i = 0; i < entry_num; i++) {
+      order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(entry_num));
+    for (int i : order) {
+      const int key = i % key_num;
+      RID       rid(i, i);
+      ASSERT_EQ(RC::SUCCESS, loader.add(reinterpret_cast<const char *>(&key), rid));
+    }
+    ASSERT_EQ(RC::SUCCESS, loader.finish());
+    ASSERT_TRUE(filesystem::exists(tmp_file_prefix + ".9"));
+
+    ASSERT_EQ(RC::RECORD_DUPLICATE_KEY, loader.check_unique());
+    ASSERT_EQ(RC::SUCCESS, loader.build(handler));
+  }
+  ASSERT_FALSE(filesystem::exists(tmp_file_prefix + ".9"));
+  ASSERT_EQ(true, handler.validate_tree());
+
+  {
+    BplusTreeScanner scanner(handler);
+    ASSERT_EQ(RC::SUCCESS, scanner.open(nullptr, 0, true, nullptr, 0, true));
+
+    int count    = 0;
+    int last_key = -1;
+    int key      = 0;
+    RID rid;
+    while (RC::SUCCESS == scanner.next_entry(rid, reinterpret_cast<char *>(&key))) {
+      ASSERT_LE(last_key, key);
+      ASSERT_EQ(key, rid.page_num % key_num);
+      last_key = key;
+      count++;
+    }
+    ASSERT_EQ(entry_num, count);
+  }
+
+  vector<RID> rids;
+  for (int key = 0; key < key_num; key++) {
+    ASSERT_EQ(RC::SUCCESS, handler.get_entries(reinterpret_cast<const char *>(&key), sizeof(key), rids));
+    ASSERT_EQ(entry_num / key_num, static_cast<int>(rids.size()));
+  }
+
+  // 批量构建以后还可以正常插入和删除
+  for (int i = 0; i < entry_num; i += 2) {
+    const int key = i % key_num;
+    RID       rid(i, i);
+    ASSERT_EQ(RC::SUCCESS, handler.delete_entry(reinterpret_cast<const char *>(&key), &rid));
+    rid.slot_num = entry_num + i;
+    ASSERT_EQ(RC::SUCCESS, handler.insert_entry(reinterpret_cast<const char *>(&key), &rid));
+  }
+  ASSERT_EQ(true, handler.validate_tree());
+
+  // 没有重复键值的数据
+  BplusTreeHandler unique_handler;
+  filesystem::path unique_file = test_directory / "bulk_load_unique.btree";
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(unique_file.c_str()));
+  DiskBufferPool *unique_buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, unique_file.c_str(), unique_buffer_pool));
+  ASSERT_EQ(RC::SUCCESS, unique_handler.create(log_handler, *unique_buffer_pool, attr_type, attr_len, ORDER, ORDER));
+
+  options.fill_factor = 100;
+  BplusTreeBulkLoader loader(
+      options, span<const AttrType>(&attr_type, 1), span<const int32_t>(&attr_len, 1), tmp_file_prefix);
+  for (int i = entry_num - 1; i >= 0; i--) {
+    RID rid(i, i);
+    ASSERT_EQ(RC::SUCCESS, loader.add(reinterpret_cast<const char *>(&i), rid));
+  }
+  ASSERT_EQ(RC::SUCCESS, loader.finish());
+  ASSERT_EQ(RC::SUCCESS, loader.check_unique());
+  ASSERT_EQ(RC::SUCCESS, loader.build(unique_handler));
+  ASSERT_EQ(true, unique_handler.validate_tree());
+
+  for (int i = 0; i < entry_num; i++) {
+    ASSERT_EQ(RC::SUCCESS, unique_handler.get_entries(reinterpret_cast<const char *>(&i), sizeof(i), rids));
+    ASSERT_EQ(1, static_cast<int>(rids.size()));
+    ASSERT_EQ(i, rids[0].page_num);
+  }
+
+  // 填充比例最低时，数据量很小的树里除了根节点，每个节点也不能少于最小的元素个数
+  options.fill_factor = 50;
+  for (int num = 1; num <= 64; num++) {
+    BplusTreeHandler small_handler;
+    filesystem::path small_file = test_directory / ("bulk_load_small_" + to_string(num) + ".btree");
+    ASSERT_EQ(RC::SUCCESS, bpm.create_file(small_file.c_str()));
+    DiskBufferPool *small_buffer_pool = nullptr;
+    ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, small_file.c_str(), small_buffer_pool));
+    ASSERT_EQ(RC::SUCCESS, small_handler.create(log_handler, *small_buffer_pool, attr_type, attr_len, ORDER, ORDER));
+
+    BplusTreeBulkLoader small_loader(
+        options, span<const AttrType>(&attr_type, 1), span<const int32_t>(&attr_len, 1), tmp_file_prefix);
+    for (int i = 0; i < num; i++) {
+      RID rid(i, i);
+      ASSERT_EQ(RC::SUCCESS, small_loader.add(reinterpret_cast<const char *>(&i), rid));
+    }
+    ASSERT_EQ(RC::SUCCESS, small_loader.finish());
+    ASSERT_EQ(RC::SUCCESS, small_loader.build(small_handler));
+    ASSERT_EQ(true, small_handler.validate_tree()) << "entry num=" << num;
+  }
+}
+
 TEST(test_bplus_tree, test_scanner)
 {
   LoggerFactory::init_default("test.log");
@@ -731,10 +922,22 @@ TEST(test_bplus_tree, test_scanner)
 
   scanner.close();
 
+  // 范围为空
   begin = 300;
   end   = 201;
   rc    = scanner.open((const char *)&begin, 4, true, (const char *)&end, 4, true /*inclusive*/);
-  ASSERT_EQ(RC::INVALID_ARGUMENT, rc);
+  ASSERT_EQ(RC::SUCCESS, rc);
+  rc = scanner.next_entry(rid);
+  ASSERT_EQ(RC::RECORD_EOF, rc);
+
+  scanner.close();
+
+  begin = 201;
+  end   = 201;
+  rc    = scanner.open((const char *)&begin, 4, false, (const char *)&end, 4, false);
+  ASSERT_EQ(RC::SUCCESS, rc);
+  rc = scanner.next_entry(rid);
+  ASSERT_EQ(RC::RECORD_EOF, rc);
 
   scanner.close();
 
@@ -793,6 +996,121 @@ TEST(test_bplus_tree, test_scanner)
   handler.close();
 }
 
+TEST(test_bplus_tree, test_multi_attr_scanner)
+{
+  LoggerFactory::init_default("test.log");
+
+  filesystem::path test_directory("bplus_tree");
+  filesystem::path buffer_pool_file = test_directory / "multi_attr_scanner.btree";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  VacuousLogHandler log_handler;
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  // 键值是 (tenant_id, created_at)
+  vector<AttrType> attr_types   = {AttrType::INTS, AttrType::INTS};
+  vector<int>      attr_lengths = {sizeof(int), sizeof(int)};
+
+  BplusTreeHandler handler;
+  ASSERT_EQ(RC::SUCCESS, handler.create(log_handler, *buffer_pool, attr_types, attr_lengths, ORDER, ORDER));
+
+  // 倒序插入，slot_num 记录了键值
+  RID rid;
+  for (int tenant_id = 9; tenant_id >= 0; tenant_id--) {
+    for (int created_at = 99; created_at >= 0; created_at--) {
+      int key[2]   = {tenant_id, created_at};
+      rid.page_num = 1;
+      rid.slot_num = tenant_id * 1000 + created_at;
+      ASSERT_EQ(RC::SUCCESS, handler.insert_entry(reinterpret_cast<const char *>(key), &rid));
+    }
+  }
+
+  // 返回扫描到的数据，同时检查是否有序
+  auto scan = [&handler](const int *left, int left_len, bool left_inclusive, const int *right, int right_len,
+                  bool right_inclusive, vector<int> &slots) {
+    slots.clear();
+    BplusTreeScanner scanner(handler);
+    RC               rc = scanner.open(reinterpret_cast<const char *>(left),
+        left_len,
+        left_inclusive,
+        reinterpret_cast<const char *>(right),
+        right_len,
+        right_inclusive);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    RID rid;
+    while (OB_SUCC(rc = scanner.next_entry(rid))) {
+      EXPECT_TRUE(slots.empty() || slots.back() < rid.slot_num);
+      slots.push_back(rid.slot_num);
+    }
+    return rc == RC::RECORD_EOF ? RC::SUCCESS : rc;
+  };
+
+  vector<int> slots;
+
+  // tenant_id = 3
+  int tenant = 3;
+  ASSERT_EQ(RC::SUCCESS, scan(&tenant, 4, true, &tenant, 4, true, slots));
+  ASSERT_EQ(100, static_cast<int>(slots.size()));
+  ASSERT_EQ(3000, slots.front());
+  ASSERT_EQ(3099, slots.back());
+
+  // tenant_id = 3 and created_at >= 10 and created_at < 20
+  int left[2]  = {3, 10};
+  int right[2] = {3, 20};
+  ASSERT_EQ(RC::SUCCESS, scan(left, 8, true, right, 8, false, slots));
+  ASSERT_EQ(10, static_cast<int>(slots.size()));
+  ASSERT_EQ(3010, slots.front());
+  ASSERT_EQ(3019, slots.back());
+
+  // tenant_id = 3 and created_at > 90
+  left[1] = 90;
+  ASSERT_EQ(RC::SUCCESS, scan(left, 8, false, &tenant, 4, true, slots));
+  ASSERT_EQ(9, static_cast<int>(slots.size()));
+  ASSERT_EQ(3091, slots.front());
+  ASSERT_EQ(3099, slots.back());
+
+  // tenant_id = 3 and created_at < 5
+  right[1] = 5;
+  ASSERT_EQ(RC::SUCCESS, scan(&tenant, 4, true, right, 8, false, slots));
+  ASSERT_EQ(5, static_cast<int>(slots.size()));
+  ASSERT_EQ(3000, slots.front());
+  ASSERT_EQ(3004, slots.back());
+
+  // tenant_id > 7
+  int tenant_bound = 7;
+  ASSERT_EQ(RC::SUCCESS, scan(&tenant_bound, 4, false, nullptr, 0, true, slots));
+  ASSERT_EQ(200, static_cast<int>(slots.size()));
+  ASSERT_EQ(8000, slots.front());
+
+  // tenant_id < 1
+  tenant_bound = 1;
+  ASSERT_EQ(RC::SUCCESS, scan(nullptr, 0, true, &tenant_bound, 4, false, slots));
+  ASSERT_EQ(100, static_cast<int>(slots.size()));
+  ASSERT_EQ(99, slots.back());
+
+  // tenant_id = 3 and created_at > 20 and created_at < 10
+  left[1]  = 20;
+  right[1] = 10;
+  ASSERT_EQ(RC::SUCCESS, scan(left, 8, false, right, 8, false, slots));
+  ASSERT_TRUE(slots.empty());
+
+  // 边界的长度不是前几个字段的长度之和
+  ASSERT_EQ(RC::INVALID_ARGUMENT, scan(left, 6, true, right, 8, true, slots));
+
+  handler.close();
+}
+
 TEST(test_bplus_tree, test_bplus_tree_insert)
 {
   LoggerFactory::init_default("test.log");
@@ -826,6 +1144,95 @@ TEST(test_bplus_tree, test_bplus_tree_insert)
   handler = nullptr;
 }
 
+#ifdef CONCURRENCY
+TEST(test_bplus_tree, test_optimistic_concurrency)
+{
+  LoggerFactory::init_default("test_optimistic_concurrency.log", LOG_LEVEL_WARN);
+
+  filesystem::path test_directory("bplus_tree");
+  filesystem::path buffer_pool_file = test_directory / "test_optimistic_concurrency.btree";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  VacuousLogHandler log_handler;
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  // 节点很小，插入删除时经常分裂合并，查找时经常遇到并发修改
+  BplusTreeHandler handler;
+  ASSERT_EQ(RC::SUCCESS, handler.create(log_handler, *buffer_pool, AttrType::INTS, sizeof(int), ORDER, ORDER));
+
+  // 偶数在测试过程中一直存在，奇数由写线程插入，再删除一半
+  const int key_num = 2000;
+  for (int i = 0; i < key_num; i += 2) {
+    RID rid(i, i);
+    ASSERT_EQ(RC::SUCCESS, handler.insert_entry(reinterpret_cast<const char *>(&i), &rid));
+  }
+
+  const int           writer_num = 4;
+  const int           reader_num = 4;
+  atomic<int>         running_writers(writer_num);
+  atomic<int>         missing_count(0);
+  atomic<int>         writer_failed_count(0);
+  vector<std::thread> threads;
+  for (int t = 0; t < writer_num; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 1 + 2 * t; i < key_num; i += 2 * writer_num) {
+        RID rid(i, i);
+        if (handler.insert_entry(reinterpret_cast<const char *>(&i), &rid) != RC::SUCCESS) {
+          writer_failed_count++;
+        }
+      }
+      for (int i = 1 + 2 * t; i < key_num; i += 4 * writer_num) {
+        RID rid(i, i);
+        if (handler.delete_entry(reinterpret_cast<const char *>(&i), &rid) != RC::SUCCESS) {
+          writer_failed_count++;
+        }
+      }
+      running_writers--;
+    });
+  }
+  for (int t = 0; t < reader_num; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 2 * t; running_writers.load() > 0; i = (i + 2 * reader_num) % key_num) {
+        // 扫描器移动到下一个叶子节点时不等待锁，拿不到锁就返回 LOCKED_NEED_WAIT 让调用者重试
+        list<RID> rids;
+        RC        rc = RC::SUCCESS;
+        do {
+          rids.clear();
+          rc = handler.get_entry(reinterpret_cast<const char *>(&i), sizeof(i), rids);
+        } while (rc == RC::LOCKED_NEED_WAIT);
+        if (rc != RC::SUCCESS || rids.size() != 1) {
+          missing_count++;
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  ASSERT_EQ(0, writer_failed_count.load());
+  ASSERT_EQ(0, missing_count.load());
+  ASSERT_TRUE(handler.validate_tree());
+
+  for (int i = 0; i < key_num; i++) {
+    list<RID> rids;
+    ASSERT_EQ(RC::SUCCESS, handler.get_entry(reinterpret_cast<const char *>(&i), sizeof(i), rids));
+    const bool deleted = (i % 2 == 1) && ((i - 1) % (4 * writer_num) < 2 * writer_num);
+    ASSERT_EQ(deleted ? 0 : 1, static_cast<int>(rids.size())) << "key=" << i;
+  }
+
+  handler.close();
+}
+#endif  // CONCURRENCY
+
 int main(int argc, char **argv)
 {
 
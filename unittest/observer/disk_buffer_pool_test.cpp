@@ -12,10 +12,13 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai on 2024/02/01
 //
 
+#include <fcntl.h>
 #include <filesystem>
 
 #include "gtest/gtest.h"
 #include "common/log/log.h"
+#include "common/lang/thread.h"
+#include "common/io/io.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/clog/vacuous_log_handler.h"
 #include "storage/buffer/double_write_buffer.h"
@@ -102,6 +105,29 @@ TEST(DiskBufferPool, allocate_dispose)
   ASSERT_NE(buffer_pool, nullptr);
   ASSERT_EQ(buffer_pool_page_count(buffer_pool), allocate_page_num + allocate_page_num2 - deallocate_page_num);
 
+  // 8. 重启后释放的页面可以被重新分配，编号小的先分配
+  PageNum last_page_num = BP_HEADER_PAGE;
+  for (int i = 0; i < deallocate_page_num + 10; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    ASSERT_GT(frame->page_num(), last_page_num);
+    last_page_num = frame->page_num();
+    ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  }
+
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(120));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(60));
+  for (PageNum expected : {60, 120}) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    ASSERT_EQ(expected, frame->page_num());
+    ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  }
+
+  // 9. 文件是按照extent预留空间的，不是每次增长一个页面
+  ASSERT_GT(filesystem::file_size(buffer_pool_filename),
+      static_cast<uintmax_t>(allocate_page_num + allocate_page_num2 - deallocate_page_num) * BP_PAGE_SIZE);
+
   ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
 }
 
@@ -132,6 +158,215 @@ TEST(BufferPool, create)
   ASSERT_EQ(buffer_pool->id(), buffer_pool2->id());
 }
 
+TEST(DiskBufferPool, concurrent_get_this_page)
+{
+  filesystem::path directory("buffer_pool");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path buffer_pool_filename = directory / "concurrent_get.bp";
+
+  const int page_num = 200;
+  {
+    BufferPoolManager buffer_pool_manager;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.init(make_unique<VacuousDoubleWriteBuffer>()));
+    ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.create_file(buffer_pool_filename.c_str()));
+
+    VacuousLogHandler log_handler;
+    DiskBufferPool   *buffer_pool = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+
+    for (int i = 0; i < page_num; ++i) {
+      Frame *frame = nullptr;
+      ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+      *reinterpret_cast<PageNum *>(frame->data()) = frame->page_num();
+      frame->mark_dirty();
+      ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+    }
+    ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
+  }
+
+  // 内存只能放下一部分页面，多个线程同时读取时会不停地发生缺页和淘汰
+  BufferPoolManager buffer_pool_manager(BP_PAGE_SIZE * DEFAULT_ITEM_NUM_PER_POOL);
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.init(make_unique<VacuousDoubleWriteBuffer>()));
+
+  VacuousLogHandler log_handler;
+  DiskBufferPool   *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+
+  atomic<int>    mismatch_count{0};
+  vector<thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([buffer_pool, &mismatch_count, t]() {
+      for (int i = 0; i < page_num * 5; i++) {
+        PageNum page  = (i * 13 + t * 7) % page_num + 1;
+        Frame  *frame = nullptr;
+        if (buffer_pool->get_this_page(page, &frame) != RC::SUCCESS) {
+          mismatch_count++;
+          continue;
+        }
+        if (*reinterpret_cast<PageNum *>(frame->data()) != page) {
+          mismatch_count++;
+        }
+        buffer_pool->unpin_page(frame);
+      }
+    });
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+
+  ASSERT_EQ(0, mismatch_count.load());
+  ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
+}
+
+TEST(DiskBufferPool, read_ahead)
+{
+  filesystem::path directory("buffer_pool");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path buffer_pool_filename = directory / "read_ahead.bp";
+
+  const int page_num = 200;
+
+  BufferPoolManager   buffer_pool_manager;
+  unique_ptr<AsyncIo> async_io;
+  ASSERT_EQ(RC::SUCCESS, AsyncIo::create("io_uring", AsyncIo::DEFAULT_QUEUE_DEPTH, async_io));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.init(make_unique<VacuousDoubleWriteBuffer>(), std::move(async_io)));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.create_file(buffer_pool_filename.c_str()));
+
+  VacuousLogHandler log_handler;
+  DiskBufferPool   *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+  for (int i = 0; i < page_num; ++i) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    *reinterpret_cast<PageNum *>(frame->data()) = frame->page_num();
+    frame->mark_dirty();
+    ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  }
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(page_num / 2));
+
+  BPFrameManager &frame_manager = buffer_pool_manager.get_frame_manager();
+
+  // 使用迭代器预读，扫描时所有的页面都已经在内存中了
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+  frame_manager.reset_stat();
+
+  int                count = 0;
+  BufferPoolIterator iterator;
+  iterator.init(*buffer_pool, 1, true /*read_ahead*/);
+  while (iterator.has_next()) {
+    PageNum page  = iterator.next();
+    Frame  *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page, &frame));
+    ASSERT_EQ(page, *reinterpret_cast<PageNum *>(frame->data()));
+    buffer_pool->unpin_page(frame);
+    count++;
+  }
+  ASSERT_EQ(page_num - 1, count);
+  ASSERT_EQ(0, frame_manager.miss_count());
+  ASSERT_EQ(0, frame_manager.hit_count());
+  ASSERT_EQ(page_num - 1, static_cast<int>(frame_manager.prefetch_hit_count()));
+
+  // 按照页面编号顺序访问，连续缺页几次以后开始预读
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+  frame_manager.reset_stat();
+  for (PageNum page = 1; page <= page_num; page++) {
+    if (page == page_num / 2) {
+      continue;
+    }
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page, &frame));
+    ASSERT_EQ(page, *reinterpret_cast<PageNum *>(frame->data()));
+    buffer_pool->unpin_page(frame);
+  }
+  ASSERT_LT(frame_manager.miss_count(), page_num / 10);
+
+  // 关闭预读
+  buffer_pool_manager.set_read_ahead_pages(0);
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+  frame_manager.reset_stat();
+  for (PageNum page = 1; page <= 10; page++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page, &frame));
+    buffer_pool->unpin_page(frame);
+  }
+  ASSERT_EQ(10, frame_manager.miss_count());
+
+  ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
+}
+
+TEST(DiskBufferPool, space_map)
+{
+  /*
+  文件头中的位图已经用完时，文件可以继续增长，后面的页面由空间位图页管理。
+  直接修改文件头，假装文件中已经有 PAGES_PER_GROUP 个页面，不需要真的写这么多页面。
+  */
+  filesystem::path directory("buffer_pool");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path buffer_pool_filename = directory / "space_map.bp";
+
+  BufferPoolManager buffer_pool_manager;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.create_file(buffer_pool_filename.c_str()));
+
+  const PageNum group_pages = BPFileHeader::PAGES_PER_GROUP;
+  {
+    int fd = open(buffer_pool_filename.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    Page page;
+    ASSERT_EQ(0, preadn(fd, &page, BP_PAGE_SIZE, 0));
+    BPFileHeader *file_header    = reinterpret_cast<BPFileHeader *>(page.data);
+    file_header->page_count      = group_pages;
+    file_header->allocated_pages = group_pages;
+    memset(file_header->bitmap, 0xFF, group_pages / 8);
+    ASSERT_EQ(0, pwriten(fd, &page, BP_PAGE_SIZE, 0));
+    close(fd);
+  }
+
+  VacuousLogHandler log_handler;
+  DiskBufferPool   *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+
+  // 第一个组已经满了，新的页面要跳过第二个组的空间位图页
+  ASSERT_TRUE(DiskBufferPool::is_space_map_page(group_pages));
+  for (PageNum expected : {group_pages + 1, group_pages + 2}) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    ASSERT_EQ(expected, frame->page_num());
+    *reinterpret_cast<PageNum *>(frame->data()) = frame->page_num();
+    frame->mark_dirty();
+    ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  }
+
+  ASSERT_NE(RC::SUCCESS, buffer_pool->dispose_page(group_pages));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(group_pages + 1));
+  ASSERT_EQ(buffer_pool_page_count(buffer_pool), group_pages);
+
+  ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
+
+  // 重启以后从空间位图页中恢复页面的分配情况
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+  ASSERT_EQ(buffer_pool_page_count(buffer_pool), group_pages);
+
+  Frame *frame = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(group_pages + 2, &frame));
+  ASSERT_EQ(group_pages + 2, *reinterpret_cast<PageNum *>(frame->data()));
+  ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+
+  for (PageNum expected : {group_pages + 1, group_pages + 3}) {
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    ASSERT_EQ(expected, frame->page_num());
+    ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  }
+
+  ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
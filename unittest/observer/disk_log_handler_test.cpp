@@ -20,6 +20,7 @@ See the Mulan PSL v2 for more details. */
 #include "storage/clog/disk_log_handler.h"
 #include "storage/clog/log_replayer.h"
 #include "common/thread/thread_pool_executor.h"
+#include "common/lang/chrono.h"
 
 using namespace std;
 using namespace common;
@@ -151,6 +152,57 @@ TEST(DiskLogHandler, test_replay)
   // filesystem::remove_all(path);
 }
 
+TEST(DiskLogHandler, recycle)
+{
+  const char *path = "test_log_handler_recycle";
+  filesystem::remove_all(path);
+
+  DiskLogHandler  handler;
+  TestLogReplayer replayer;
+  ASSERT_EQ(RC::SUCCESS, handler.init(path));
+  ASSERT_EQ(RC::SUCCESS, handler.replay(replayer, 0));
+  ASSERT_EQ(RC::SUCCESS, handler.start());
+
+  // 每个日志文件1000条日志，LSN从1开始，一共4个文件
+  const int times = 3500;
+  for (int i = 0; i < times; ++i) {
+    LSN          lsn = 0;
+    vector<char> data(10);
+    ASSERT_EQ(handler.append(lsn, LogModule::Id::BUFFER_POOL, std::move(data)), RC::SUCCESS);
+  }
+  ASSERT_EQ(RC::SUCCESS, handler.stop());
+  ASSERT_EQ(RC::SUCCESS, handler.await_termination());
+
+  auto file_count = [path]() {
+    return distance(filesystem::directory_iterator(path), filesystem::directory_iterator());
+  };
+  ASSERT_EQ(4, file_count());
+
+  // 前两个文件中的日志都小于2500
+  ASSERT_EQ(RC::SUCCESS, handler.recycle(2500));
+  ASSERT_EQ(2, file_count());
+
+  DiskLogHandler  handler2;
+  TestLogReplayer replayer2;
+  ASSERT_EQ(RC::SUCCESS, handler2.init(path));
+  ASSERT_EQ(RC::SUCCESS, handler2.replay(replayer2, 2500));
+  ASSERT_EQ(times - 2500 + 1, replayer2.count());
+  ASSERT_EQ(times, handler2.current_lsn());
+
+  // 最后一个文件永远不会被删除。检查点之后没有日志时，LSN 也要接着检查点继续分配
+  ASSERT_EQ(RC::SUCCESS, handler2.recycle(times + 1));
+  ASSERT_EQ(1, file_count());
+
+  DiskLogHandler  handler3;
+  TestLogReplayer replayer3;
+  ASSERT_EQ(RC::SUCCESS, handler3.init(path));
+  ASSERT_EQ(RC::SUCCESS, handler3.replay(replayer3, times + 1));
+  ASSERT_EQ(0, replayer3.count());
+  ASSERT_EQ(times, handler3.current_lsn());
+
+  filesystem::remove_all(path);
+}
+
 TEST(DiskLogHandler, multi_thread)
 {
   const char *directory = "test_log_handler_multi_thread";
@@ -180,6 +232,50 @@ TEST(DiskLogHandler, multi_thread)
   ASSERT_EQ(RC::SUCCESS, handler.await_termination());
 }
 
+TEST(DiskLogHandler, group_commit)
+{
+  // 多个线程同时提交，每次提交都等待日志刷盘。等待的线程由刷盘线程唤醒，不需要轮询
+  const char *directory = "test_log_handler_group_commit";
+  filesystem::remove_all(directory);
+
+  DiskLogHandler  handler;
+  TestLogReplayer replayer;
+  ASSERT_EQ(RC::SUCCESS, handler.init(directory));
+  ASSERT_EQ(RC::SUCCESS, handler.replay(replayer, 0));
+  ASSERT_EQ(RC::SUCCESS, handler.start());
+
+  const int   thread_num = 8;
+  const int   times      = 100;
+  atomic<int> failed_count{0};
+
+  auto           start_time = chrono::steady_clock::now();
+  vector<thread> threads;
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&handler, &failed_count]() {
+      for (int i = 0; i < times; i++) {
+        LSN lsn = 0;
+        if (OB_FAIL(handler.append(lsn, LogModule::Id::TRANSACTION, vector<char>(10))) ||
+            OB_FAIL(handler.wait_lsn(lsn)) || handler.current_flushed_lsn() < lsn) {
+          failed_count++;
+        }
+      }
+    });
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+  auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start_time);
+
+  ASSERT_EQ(0, failed_count.load());
+  ASSERT_EQ(handler.current_lsn(), handler.current_flushed_lsn());
+  // 以前每次等待至少要100ms
+  ASSERT_LT(elapsed.count(), times * 100 / 2);
+
+  ASSERT_EQ(RC::SUCCESS, handler.stop());
+  ASSERT_EQ(RC::SUCCESS, handler.await_termination());
+  filesystem::remove_all(directory);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
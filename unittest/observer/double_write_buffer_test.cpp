@@ -12,10 +12,13 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai on 2024/04/19
 //
 
+#include <fcntl.h>
 #include <filesystem>
 
 #include "gtest/gtest.h"
 
+#include "common/io/io.h"
+
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/buffer/double_write_buffer.h"
 #include "storage/clog/vacuous_log_handler.h"
@@ -201,6 +204,92 @@ TEST(DoubleWriteBuffer, single_file_exception)
   bpm  = nullptr;
 }
 
+TEST(DoubleWriteBuffer, batch_recover)
+{
+  /*
+  一批页面写入double write buffer文件后，写回数据文件时异常停止，数据文件中的页面不完整。
+  重启后应该可以从double write buffer文件中恢复这些页面
+  */
+  filesystem::path directory("double_write_buffer_test_batch_recover_dir");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path buffer_pool_filename         = directory / "buffer_pool.bp";
+  filesystem::path double_write_buffer_filename = directory / "double_write_buffer.dwb";
+
+  auto              bpm = make_unique<BufferPoolManager>();
+  VacuousLogHandler log_handler;
+  auto              double_write_buffer = make_unique<DiskDoubleWriteBuffer>(*bpm);
+  ASSERT_EQ(RC::SUCCESS, double_write_buffer->open_file(double_write_buffer_filename.c_str()));
+  ASSERT_EQ(bpm->init(std::move(double_write_buffer)), RC::SUCCESS);
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm->create_file(buffer_pool_filename.c_str()));
+  ASSERT_EQ(RC::SUCCESS, bpm->open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+
+  const int       page_num = 8;
+  vector<PageNum> page_nums;
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    memset(frame->data(), 'a' + i, BP_PAGE_DATA_SIZE);
+    frame->mark_dirty();
+    page_nums.push_back(frame->page_num());
+    frame->unpin();
+  }
+
+  // 所有页面在一批中写入
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->flush_all_pages());
+  DiskDoubleWriteBuffer *disk_double_write_buffer = static_cast<DiskDoubleWriteBuffer *>(bpm->get_dblwr_buffer());
+  ASSERT_EQ(RC::SUCCESS, disk_double_write_buffer->flush_page());
+  bpm = nullptr;
+
+  // 写回数据文件之后，double write buffer文件的文件头会被清空，但是页面还在
+  int fd = open(double_write_buffer_filename.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  DoubleWriteBufferHeader header;
+  ASSERT_EQ(0, preadn(fd, &header, sizeof(header), 0));
+  ASSERT_EQ(0, header.page_cnt);
+
+  // 模拟写回数据文件时异常停止：文件头还没有清空，数据文件中的页面写了一半
+  header.page_cnt = page_num + 1;
+  ASSERT_EQ(0, pwriten(fd, &header, sizeof(header), 0));
+  close(fd);
+
+  fd = open(buffer_pool_filename.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  char garbage[BP_PAGE_SIZE / 2];
+  memset(garbage, 'x', sizeof(garbage));
+  for (PageNum page : page_nums) {
+    ASSERT_EQ(0, pwriten(fd, garbage, sizeof(garbage), static_cast<int64_t>(page) * BP_PAGE_SIZE));
+  }
+  close(fd);
+
+  bpm                 = make_unique<BufferPoolManager>();
+  double_write_buffer = make_unique<DiskDoubleWriteBuffer>(*bpm);
+  ASSERT_EQ(RC::SUCCESS, double_write_buffer->open_file(double_write_buffer_filename.c_str()));
+  ASSERT_EQ(bpm->init(std::move(double_write_buffer)), RC::SUCCESS);
+  ASSERT_EQ(RC::SUCCESS, bpm->open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+  disk_double_write_buffer = static_cast<DiskDoubleWriteBuffer *>(bpm->get_dblwr_buffer());
+  ASSERT_EQ(RC::SUCCESS, disk_double_write_buffer->recover());
+  bpm = nullptr;
+
+  // 恢复之后，直接从数据文件中读取的页面是完整的
+  bpm                 = make_unique<BufferPoolManager>();
+  double_write_buffer = make_unique<DiskDoubleWriteBuffer>(*bpm);
+  ASSERT_EQ(RC::SUCCESS, double_write_buffer->open_file(double_write_buffer_filename.c_str()));
+  ASSERT_EQ(bpm->init(std::move(double_write_buffer)), RC::SUCCESS);
+  ASSERT_EQ(RC::SUCCESS, bpm->open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums[i], &frame));
+    ASSERT_EQ('a' + i, frame->data()[0]);
+    ASSERT_EQ('a' + i, frame->data()[BP_PAGE_DATA_SIZE - 1]);
+    frame->unpin();
+  }
+  bpm = nullptr;
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
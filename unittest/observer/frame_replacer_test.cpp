@@ -0,0 +1,130 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "gtest/gtest.h"
+#include "common/lang/vector.h"
+#include "storage/buffer/frame_replacer.h"
+
+using namespace std;
+
+static vector<Frame *> victims(FrameReplacer &replacer)
+{
+  vector<Frame *> frames;
+  replacer.foreach_victim([&frames](Frame *frame) {
+    frames.push_back(frame);
+    return true;
+  });
+  return frames;
+}
+
+class FrameReplacerTest : public testing::Test
+{
+public:
+  static constexpr int HOT_NUM  = 4;
+  static constexpr int SCAN_NUM = 16;
+
+  void SetUp() override
+  {
+    for (int i = 0; i < HOT_NUM + SCAN_NUM; i++) {
+      frames_[i].set_buffer_pool_id(1);
+      frames_[i].set_page_num(i);
+    }
+  }
+
+  Frame *hot(int i) { return &frames_[i]; }
+  Frame *scan(int i) { return &frames_[HOT_NUM + i]; }
+
+protected:
+  Frame frames_[HOT_NUM + SCAN_NUM];
+};
+
+TEST_F(FrameReplacerTest, create)
+{
+  unique_ptr<FrameReplacer> replacer;
+  ASSERT_EQ(RC::SUCCESS, FrameReplacer::create(nullptr, 16, replacer));
+  ASSERT_STREQ("lru", replacer->name());
+  ASSERT_EQ(RC::SUCCESS, FrameReplacer::create("2Q", 16, replacer));
+  ASSERT_STREQ("2q", replacer->name());
+  ASSERT_EQ(RC::INVALID_ARGUMENT, FrameReplacer::create("unknown", 16, replacer));
+}
+
+TEST_F(FrameReplacerTest, lru)
+{
+  LruFrameReplacer replacer;
+  for (int i = 0; i < HOT_NUM; i++) {
+    replacer.on_insert(hot(i));
+  }
+  replacer.on_access(hot(0));
+
+  vector<Frame *> frames = victims(replacer);
+  ASSERT_EQ(HOT_NUM, static_cast<int>(frames.size()));
+  ASSERT_EQ(hot(1), frames.front());
+  ASSERT_EQ(hot(0), frames.back());
+
+  // 扫描过后，最先被淘汰的是之前的热点页面
+  for (int i = 0; i < SCAN_NUM; i++) {
+    replacer.on_insert(scan(i));
+  }
+  frames = victims(replacer);
+  ASSERT_EQ(hot(1), frames.front());
+
+  replacer.on_remove(hot(1)->frame_id(), hot(1));
+  frames = victims(replacer);
+  ASSERT_EQ(HOT_NUM + SCAN_NUM - 1, static_cast<int>(frames.size()));
+  ASSERT_EQ(hot(2), frames.front());
+}
+
+TEST_F(FrameReplacerTest, two_queue_scan_resistant)
+{
+  TwoQueueFrameReplacer replacer(HOT_NUM * 2);
+
+  // 再次命中的页面，或者被淘汰过又很快被访问的页面才会进入热点队列
+  for (int i = 0; i < HOT_NUM; i++) {
+    replacer.on_insert(hot(i));
+    if (i % 2 == 0) {
+      replacer.on_access(hot(i));
+    } else {
+      replacer.on_remove(hot(i)->frame_id(), hot(i));
+      replacer.on_insert(hot(i));
+    }
+  }
+
+  for (int i = 0; i < SCAN_NUM; i++) {
+    replacer.on_insert(scan(i));
+  }
+
+  vector<Frame *> frames = victims(replacer);
+  ASSERT_EQ(HOT_NUM + SCAN_NUM, static_cast<int>(frames.size()));
+  for (int i = 0; i < SCAN_NUM; i++) {
+    ASSERT_EQ(scan(i), frames[i]);
+  }
+  for (int i = 0; i < HOT_NUM; i++) {
+    ASSERT_EQ(hot(i), frames[SCAN_NUM + i]);
+  }
+
+  // 扫描的页面被淘汰之后，热点队列按照LRU的顺序淘汰
+  for (int i = 0; i < SCAN_NUM; i++) {
+    replacer.on_remove(scan(i)->frame_id(), scan(i));
+  }
+  replacer.on_access(hot(0));
+  frames = victims(replacer);
+  ASSERT_EQ(HOT_NUM, static_cast<int>(frames.size()));
+  ASSERT_EQ(hot(1), frames.front());
+  ASSERT_EQ(hot(0), frames.back());
+
+  replacer.clear();
+  ASSERT_TRUE(victims(replacer).empty());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,63 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "gtest/gtest.h"
+#include "storage/buffer/free_page_index.h"
+
+using namespace std;
+
+TEST(FreePageIndex, find_free)
+{
+  FreePageIndex index;
+  index.reset(100);
+  ASSERT_EQ(0, index.free_count());
+  ASSERT_EQ(BP_INVALID_PAGE_NUM, index.find_free());
+
+  index.set_free(70);
+  index.set_free(5);
+  ASSERT_EQ(2, index.free_count());
+  ASSERT_EQ(5, index.find_free());
+
+  index.set_allocated(5);
+  ASSERT_EQ(70, index.find_free());
+  index.set_allocated(70);
+  ASSERT_EQ(BP_INVALID_PAGE_NUM, index.find_free());
+
+  // 重复设置不影响计数
+  index.set_allocated(70);
+  ASSERT_EQ(0, index.free_count());
+}
+
+TEST(FreePageIndex, resize)
+{
+  // 超过第二层一个字覆盖的范围(64 * 64 个页面)
+  const int page_count = 64 * 64 * 3 + 10;
+
+  FreePageIndex index;
+  index.reset(10);
+  index.resize(page_count);
+  ASSERT_EQ(page_count, index.page_count());
+  ASSERT_EQ(BP_INVALID_PAGE_NUM, index.find_free());
+
+  index.set_free(page_count - 1);
+  index.set_free(64 * 64 + 1);
+  ASSERT_EQ(64 * 64 + 1, index.find_free());
+  ASSERT_TRUE(index.is_free(page_count - 1));
+  ASSERT_FALSE(index.is_free(page_count));
+
+  index.set_allocated(64 * 64 + 1);
+  ASSERT_EQ(page_count - 1, index.find_free());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -18,6 +18,8 @@ See the Mulan PSL v2 for more details. */
 #define protected public
 #include "storage/clog/log_buffer.h"
 #include "storage/clog/log_file.h"
+#include "storage/clog/log_entry.h"
+#include "common/lang/thread.h"
 
 using namespace std;
 using namespace common;
@@ -66,6 +68,112 @@ TEST(LogEntryBuffer, test_append)
   filesystem::remove("test_log_entry_buffer.log");
 }
 
+TEST(LogEntryBuffer, concurrent_append)
+{
+  // 追加的日志比缓冲区大，追加日志的线程需要等待刷盘
+  const int      thread_num = 4;
+  const int      entry_num  = 2000;
+  const int      entry_size = 1024;
+  const LSN      total      = thread_num * entry_num;
+  const char    *filename   = "test_log_entry_buffer_concurrent.log";
+  LogEntryBuffer buffer;
+  ASSERT_EQ(RC::SUCCESS, buffer.init(0, 1024 * 1024));
+
+  filesystem::remove(filename);
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, total));
+
+  vector<thread> threads;
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < entry_num; i++) {
+        LSN lsn = 0;
+        ASSERT_EQ(RC::SUCCESS, buffer.append(lsn, LogModule::Id::BUFFER_POOL, vector<char>(entry_size, 'a' + t)));
+      }
+    });
+  }
+
+  while (buffer.flushed_lsn() < total) {
+    int count = 0;
+    ASSERT_EQ(RC::SUCCESS, buffer.flush(writer, count));
+  }
+
+  for (thread &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(buffer.current_lsn(), total);
+  ASSERT_EQ(buffer.entry_number(), 0);
+  ASSERT_EQ(buffer.bytes(), 0);
+  writer.close();
+
+  LogFileReader reader;
+  ASSERT_EQ(RC::SUCCESS, reader.open(filename));
+  LSN expected_lsn = 1;
+  ASSERT_EQ(RC::SUCCESS, reader.iterate([&](LogEntry &entry) {
+    EXPECT_EQ(entry.lsn(), expected_lsn++);
+    EXPECT_EQ(entry.payload_size(), entry_size);
+    EXPECT_EQ(entry.data()[0], entry.data()[entry_size - 1]);
+    return RC::SUCCESS;
+  }));
+  ASSERT_EQ(expected_lsn, total + 1);
+  reader.close();
+  filesystem::remove(filename);
+}
+
+TEST(LogEntryBuffer, lsn_beyond_32_bits)
+{
+  // LSN 越过 2^32 以后继续递增，不会回绕
+  const int      thread_num = 4;
+  const int      entry_num  = 1000;
+  const LSN      start_lsn  = static_cast<LSN>(UINT32_MAX) - 100;
+  const LSN      end_lsn    = start_lsn + thread_num * entry_num;
+  const char    *filename   = "test_log_entry_buffer_lsn.log";
+  LogEntryBuffer buffer;
+  ASSERT_EQ(RC::SUCCESS, buffer.init(start_lsn, 64 * 1024));
+  ASSERT_EQ(buffer.current_lsn(), start_lsn);
+
+  filesystem::remove(filename);
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, end_lsn));
+
+  vector<thread> threads;
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&]() {
+      LSN last_lsn = 0;
+      for (int i = 0; i < entry_num; i++) {
+        LSN lsn = 0;
+        ASSERT_EQ(RC::SUCCESS, buffer.append(lsn, LogModule::Id::BUFFER_POOL, vector<char>(100)));
+        ASSERT_GT(lsn, start_lsn);
+        ASSERT_GT(lsn, last_lsn);
+        last_lsn = lsn;
+      }
+    });
+  }
+
+  while (buffer.flushed_lsn() < end_lsn) {
+    int count = 0;
+    ASSERT_EQ(RC::SUCCESS, buffer.flush(writer, count));
+  }
+
+  for (thread &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(buffer.current_lsn(), end_lsn);
+  ASSERT_EQ(buffer.entry_number(), 0);
+  writer.close();
+
+  LogFileReader reader;
+  ASSERT_EQ(RC::SUCCESS, reader.open(filename));
+  LSN expected_lsn = start_lsn + 1;
+  ASSERT_EQ(RC::SUCCESS, reader.iterate([&](LogEntry &entry) {
+    EXPECT_EQ(entry.lsn(), expected_lsn++);
+    return RC::SUCCESS;
+  }));
+  ASSERT_EQ(expected_lsn, end_lsn + 1);
+  reader.close();
+  filesystem::remove(filename);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -178,6 +178,73 @@ TEST(LogFileReadWrite, test_read_write)
   // filesystem::remove(log_file);
 }
 
+TEST(LogFileReadWrite, format_version)
+{
+  const char *log_file = "test_log_file_format_version.log";
+
+  filesystem::remove(log_file);
+
+  LogFileWriter writer;
+  LSN           end_lsn = 1000 - 1;
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file, end_lsn));
+  ASSERT_EQ(LogFileHeader::SIZE, static_cast<int32_t>(filesystem::file_size(log_file)));
+
+  LogEntry     entry;
+  vector<char> data(10);
+  ASSERT_EQ(RC::SUCCESS, entry.init(1, LogModule::Id::BUFFER_POOL, std::move(data)));
+  ASSERT_EQ(RC::SUCCESS, writer.write(entry));
+  writer.close();
+
+  // 再次打开时不会重复写文件头
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file, end_lsn));
+  writer.close();
+  ASSERT_EQ(LogFileHeader::SIZE + entry.total_size(), static_cast<int32_t>(filesystem::file_size(log_file)));
+
+  int           count    = 0;
+  auto          callback = [&count](LogEntry &) -> RC {
+    count++;
+    return RC::SUCCESS;
+  };
+  LogFileReader reader;
+  ASSERT_EQ(RC::SUCCESS, reader.open(log_file));
+  ASSERT_EQ(RC::SUCCESS, reader.iterate(callback));
+  ASSERT_EQ(1, count);
+  reader.close();
+
+  // 版本号不同的日志文件不能读也不能写
+  LogFileHeader header;
+  header.magic   = LogFileHeader::MAGIC;
+  header.version = LogFileHeader::VERSION + 1;
+  {
+    fstream fs(log_file, ios::in | ios::out | ios::binary);
+    fs.write(reinterpret_cast<const char *>(&header), LogFileHeader::SIZE);
+  }
+  ASSERT_EQ(RC::LOG_FILE_VERSION_MISMATCH, reader.open(log_file));
+  ASSERT_EQ(RC::LOG_FILE_VERSION_MISMATCH, writer.open(log_file, end_lsn));
+  ASSERT_FALSE(writer.valid());
+
+  // 没有文件头的旧格式日志文件，开头就是第一条日志
+  {
+    ofstream ofs(log_file, ios::binary | ios::trunc);
+    ofs.write(reinterpret_cast<const char *>(&entry.header()), LogHeader::SIZE);
+    ofs.write(entry.data(), entry.payload_size());
+  }
+  ASSERT_EQ(RC::LOG_FILE_VERSION_MISMATCH, reader.open(log_file));
+
+  // 只写了一部分文件头的文件当作空文件
+  filesystem::resize_file(log_file, LogFileHeader::SIZE / 2);
+  count = 0;
+  ASSERT_EQ(RC::SUCCESS, reader.open(log_file));
+  ASSERT_EQ(RC::SUCCESS, reader.iterate(callback));
+  ASSERT_EQ(0, count);
+  reader.close();
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file, end_lsn));
+  writer.close();
+  ASSERT_EQ(LogFileHeader::SIZE, static_cast<int32_t>(filesystem::file_size(log_file)));
+
+  filesystem::remove(log_file);
+}
+
 TEST(LogFileManager, get_lsn_from_filename)
 {
   const char *file_prefix = LogFileManager::file_prefix_;
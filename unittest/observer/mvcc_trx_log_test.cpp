@@ -155,6 +155,118 @@ TEST(MvccTrxLog, wal)
   db.reset();
 }
 
+TEST(MvccTrxLog, wal_group_commit)
+{
+  /*
+  打开合并提交，多个线程并发地用单语句事务插入数据，每个事务都应该提交成功。
+  另外留一个插入了数据但是没有提交的事务。
+  然后使用日志恢复一个新的数据库，提交的数据都可见，没有提交的事务被回滚。
+  */
+  filesystem::path test_directory("mvcc_trx_log_test_group_commit");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  const char      *dbname           = "test_db";
+  filesystem::path db_path          = test_directory / dbname;
+  filesystem::path db_path2         = test_directory / "test_db2";
+  const char      *trx_kit_name     = "mvcc";
+  const char      *log_handler_name = "disk";
+
+  filesystem::create_directories(db_path);
+
+  auto db = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
+  db->trx_kit().set_group_commit_delay(1000);
+
+  vector<AttrInfoSqlNode> attr_infos(2);
+  for (size_t i = 0; i < attr_infos.size(); i++) {
+    attr_infos[i].name   = string("field_") + to_string(i);
+    attr_infos[i].type   = AttrType::INTS;
+    attr_infos[i].length = 4;
+  }
+  const char *table_name = "table_0";
+  ASSERT_EQ(RC::SUCCESS, db->create_table(table_name, attr_infos, {}));
+  ASSERT_EQ(RC::SUCCESS, db->sync());
+
+  ThreadPoolExecutor executor;
+  ASSERT_EQ(0, executor.init("Trx", 8, 8, 60 * 1000));
+
+  TrxKit   &trx_kit    = db->trx_kit();
+  Table    *table      = db->find_table(table_name);
+  const int insert_num = 1000;
+  auto      insert     = [table](Trx *trx, int i) {
+    Record record;
+    Value  values[2];
+    values[0].set_int(i);
+    values[1].set_int(i);
+    ASSERT_EQ(RC::SUCCESS, table->make_record(2, values, record));
+    ASSERT_EQ(RC::SUCCESS, trx->insert_record(table, record));
+  };
+  for (int i = 0; i < insert_num; i++) {
+    auto trx_task = [&trx_kit, &db, &insert, i] {
+      Trx *trx = trx_kit.create_trx(db->log_handler());
+      ASSERT_NE(trx, nullptr);
+      trx->start_if_need();
+      insert(trx, i);
+      ASSERT_EQ(RC::SUCCESS, trx->autocommit());
+      trx_kit.destroy_trx(trx);
+    };
+
+    ASSERT_EQ(0, executor.execute(trx_task));
+  }
+
+  ASSERT_EQ(0, executor.shutdown());
+  ASSERT_EQ(0, executor.await_termination());
+
+  // 这个事务的插入日志落地了，但是没有提交
+  const int unfinished_insert_num = 10;
+  Trx      *unfinished_trx        = trx_kit.create_trx(db->log_handler());
+  unfinished_trx->start_if_need();
+  for (int i = 0; i < unfinished_insert_num; i++) {
+    insert(unfinished_trx, insert_num + i);
+  }
+
+  DiskLogHandler &log_handler = static_cast<DiskLogHandler &>(db->log_handler());
+  ASSERT_EQ(RC::SUCCESS, log_handler.wait_lsn(log_handler.current_lsn()));
+
+  // 模拟宕机。元数据文件以数据库的名字命名，所以用同一个名字打开
+  filesystem::copy(db_path, db_path2, filesystem::copy_options::recursive);
+  ASSERT_EQ(RC::SUCCESS, unfinished_trx->rollback());
+  trx_kit.destroy_trx(unfinished_trx);
+  db.reset();
+
+  auto db2 = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db2->init(dbname, db_path2.c_str(), trx_kit_name, log_handler_name));
+
+  Table *table2 = db2->find_table(table_name);
+  ASSERT_NE(table2, nullptr);
+
+  Trx *trx2 = db2->trx_kit().create_trx(db2->log_handler());
+  trx2->start_if_need();
+  RecordScanner *scanner2 = nullptr;
+  ASSERT_EQ(RC::SUCCESS, table2->get_record_scanner(scanner2, nullptr, ReadWriteMode::READ_ONLY));
+  int    record_count  = 0;
+  int    visible_count = 0;
+  RC     rc            = RC::SUCCESS;
+  Record record;
+  while (OB_SUCC(rc = scanner2->next(record))) {
+    record_count++;
+    if (OB_SUCC(trx2->visit_record(table2, record, ReadWriteMode::READ_ONLY))) {
+      visible_count++;
+    }
+  }
+  delete scanner2;
+  ASSERT_EQ(RC::RECORD_EOF, rc);
+  ASSERT_EQ(RC::SUCCESS, trx2->commit());
+  db2->trx_kit().destroy_trx(trx2);
+
+  // 没有提交的事务插入的记录在恢复时被删除了
+  ASSERT_EQ(insert_num, visible_count);
+  ASSERT_EQ(insert_num, record_count);
+
+  db2.reset();
+}
+
 TEST(MvccTrxLog, wal2)
 {
   /*
@@ -729,6 +841,217 @@ TEST(MvccTrxLog, wal_rollback_abnormal)
   db.reset();
 }
 
+TEST(MvccTrxLog, fuzzy_checkpoint)
+{
+  /*
+  不停止事务做检查点。页面刷盘以后检查点会推进，之前的日志文件被回收；
+  有活跃事务时检查点不会越过它的第一条日志，恢复时才能找到这个事务的所有操作。
+  */
+  filesystem::path test_directory("mvcc_trx_log_test");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  const char      *dbname           = "test_db";
+  const char      *dbname2          = "test_db2";
+  filesystem::path db_path          = test_directory / dbname;
+  filesystem::path db_path2         = test_directory / dbname2;
+  const char      *trx_kit_name     = "mvcc";
+  const char      *log_handler_name = "disk";
+
+  filesystem::create_directories(db_path);
+
+  auto db = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
+
+  vector<AttrInfoSqlNode> attr_infos(1);
+  attr_infos[0].name   = "field_0";
+  attr_infos[0].type   = AttrType::INTS;
+  attr_infos[0].length = 4;
+  ASSERT_EQ(RC::SUCCESS, db->create_table("t", attr_infos, {}));
+  ASSERT_EQ(RC::SUCCESS, db->sync());
+
+  Table *table = db->find_table("t");
+  ASSERT_NE(table, nullptr);
+
+  TrxKit &trx_kit = db->trx_kit();
+  auto    insert  = [&](Trx *trx, int value) {
+    Record        record;
+    vector<Value> values(1);
+    values[0].set_int(value);
+    ASSERT_EQ(RC::SUCCESS, table->make_record(values.size(), values.data(), record));
+    ASSERT_EQ(RC::SUCCESS, trx->insert_record(table, record));
+  };
+  auto insert_committed = [&](int num) {
+    for (int i = 0; i < num; i++) {
+      Trx *trx = trx_kit.create_trx(db->log_handler());
+      trx->start_if_need();
+      insert(trx, i);
+      ASSERT_EQ(RC::SUCCESS, trx->commit());
+      trx_kit.destroy_trx(trx);
+    }
+  };
+  filesystem::path clog_path  = db_path / "clog";
+  auto             file_count = [&clog_path]() {
+    return distance(filesystem::directory_iterator(clog_path), filesystem::directory_iterator());
+  };
+
+  // 每个事务写3条日志，会写满好几个日志文件
+  const int insert_num = 2000;
+  insert_committed(insert_num);
+  const auto files_before = file_count();
+  ASSERT_GT(files_before, 3);
+
+  // 脏页没有刷盘时，检查点停留在脏页的recLSN上
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_EQ(files_before, file_count());
+
+  // 页面刷盘以后，检查点只受上一轮开始时的LSN限制
+  ASSERT_EQ(RC::SUCCESS, table->sync());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_LT(file_count(), files_before);
+
+  // 一个活跃事务，在它之后又写了很多日志，页面也都刷盘了
+  Trx *active_trx = trx_kit.create_trx(db->log_handler());
+  active_trx->start_if_need();
+  insert(active_trx, -1);
+  const LSN active_lsn = static_cast<MvccTrx *>(active_trx)->first_lsn();
+  ASSERT_GT(active_lsn, 0);
+
+  const int insert_num2 = 1000;
+  insert_committed(insert_num2);
+  ASSERT_EQ(RC::SUCCESS, table->sync());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_LE(db->check_point_lsn(), active_lsn);
+
+  DiskLogHandler &log_handler = static_cast<DiskLogHandler &>(db->log_handler());
+  ASSERT_EQ(RC::SUCCESS, log_handler.wait_lsn(log_handler.current_lsn()));
+
+  // 模拟宕机，从回收后剩下的日志文件恢复
+  filesystem::copy(db_path, db_path2, filesystem::copy_options::recursive);
+
+  auto db2 = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db2->init(dbname2, db_path2.c_str(), trx_kit_name, log_handler_name));
+  Table *table2 = db2->find_table("t");
+  ASSERT_NE(table2, nullptr);
+
+  Trx *trx2 = db2->trx_kit().create_trx(db2->log_handler());
+  trx2->start_if_need();
+  RecordScanner *scanner = nullptr;
+  ASSERT_EQ(RC::SUCCESS, table2->get_record_scanner(scanner, nullptr, ReadWriteMode::READ_ONLY));
+  int    visible_count = 0;
+  Record record;
+  while (OB_SUCC(scanner->next(record))) {
+    if (OB_SUCC(trx2->visit_record(table2, record, ReadWriteMode::READ_ONLY))) {
+      visible_count++;
+    }
+  }
+  delete scanner;
+  ASSERT_EQ(insert_num + insert_num2, visible_count);
+  db2->trx_kit().destroy_trx(trx2);
+
+  db2.reset();
+  ASSERT_EQ(RC::SUCCESS, active_trx->rollback());
+  trx_kit.destroy_trx(active_trx);
+  db.reset();
+}
+
+TEST(MvccTrxLog, checkpoint_keeps_trx_id)
+{
+  /*
+  检查点越过了所有日志，回收日志文件以后重启，回放日志时看不到任何事务号。
+  新的事务号要从检查点记录的事务号之后分配，否则新事务看不到已经提交的记录。
+  */
+  filesystem::path test_directory("mvcc_trx_log_test");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  const char      *dbname           = "test_db";
+  filesystem::path db_path          = test_directory / dbname;
+  const char      *trx_kit_name     = "mvcc";
+  const char      *log_handler_name = "disk";
+
+  filesystem::create_directories(db_path);
+
+  auto db = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
+
+  vector<AttrInfoSqlNode> attr_infos(1);
+  attr_infos[0].name   = "field_0";
+  attr_infos[0].type   = AttrType::INTS;
+  attr_infos[0].length = 4;
+  ASSERT_EQ(RC::SUCCESS, db->create_table("t", attr_infos, {}));
+  ASSERT_EQ(RC::SUCCESS, db->sync());
+
+  auto insert_committed = [](Db &db, int num) {
+    Table *table = db.find_table("t");
+    ASSERT_NE(table, nullptr);
+    for (int i = 0; i < num; i++) {
+      Trx *trx = db.trx_kit().create_trx(db.log_handler());
+      trx->start_if_need();
+      Record        record;
+      vector<Value> values(1);
+      values[0].set_int(i);
+      ASSERT_EQ(RC::SUCCESS, table->make_record(values.size(), values.data(), record));
+      ASSERT_EQ(RC::SUCCESS, trx->insert_record(table, record));
+      ASSERT_EQ(RC::SUCCESS, trx->commit());
+      db.trx_kit().destroy_trx(trx);
+    }
+  };
+  auto visible_count = [](Db &db) {
+    Table *table = db.find_table("t");
+    Trx   *trx   = db.trx_kit().create_trx(db.log_handler());
+    trx->start_if_need();
+    RecordScanner *scanner = nullptr;
+    EXPECT_EQ(RC::SUCCESS, table->get_record_scanner(scanner, nullptr, ReadWriteMode::READ_ONLY));
+    int    count = 0;
+    Record record;
+    while (OB_SUCC(scanner->next(record))) {
+      if (OB_SUCC(trx->visit_record(table, record, ReadWriteMode::READ_ONLY))) {
+        count++;
+      }
+    }
+    delete scanner;
+    trx->commit();
+    db.trx_kit().destroy_trx(trx);
+    return count;
+  };
+
+  const int insert_num = 2000;
+  insert_committed(*db, insert_num);
+
+  filesystem::path clog_path  = db_path / "clog";
+  auto             file_count = [&clog_path]() {
+    return distance(filesystem::directory_iterator(clog_path), filesystem::directory_iterator());
+  };
+  const auto files_before = file_count();
+
+  // 页面都刷盘以后，第二轮检查点越过所有日志，之前的日志文件被回收
+  ASSERT_EQ(RC::SUCCESS, db->find_table("t")->sync());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_LT(file_count(), files_before);
+  ASSERT_EQ(db->log_handler().current_lsn() + 1, db->check_point_lsn());
+
+  // 模拟宕机，从检查点之后的日志恢复。元数据文件以数据库的名字命名，所以用同一个名字打开
+  filesystem::path db_path2 = test_directory / "test_db2";
+  filesystem::copy(db_path, db_path2, filesystem::copy_options::recursive);
+  db.reset();
+
+  auto db2 = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db2->init(dbname, db_path2.c_str(), trx_kit_name, log_handler_name));
+  ASSERT_GT(db2->check_point_lsn(), 0);
+  ASSERT_EQ(insert_num, visible_count(*db2));
+
+  // 重启后提交的记录也都能看到
+  const int insert_num2 = 10;
+  insert_committed(*db2, insert_num2);
+  ASSERT_EQ(insert_num + insert_num2, visible_count(*db2));
+  db2.reset();
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
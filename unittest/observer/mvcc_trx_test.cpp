@@ -0,0 +1,513 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "storage/db/db.h"
+#include "storage/index/index.h"
+#include "storage/table/table.h"
+#include "storage/record/record.h"
+#include "storage/record/record_scanner.h"
+#include "storage/trx/mvcc_trx.h"
+
+using namespace std;
+using namespace common;
+
+class MvccTrxTest : public testing::Test
+{
+public:
+  void SetUp() override
+  {
+    filesystem::remove_all(test_directory_);
+    filesystem::create_directories(test_directory_);
+
+    db_ = make_unique<Db>();
+    ASSERT_EQ(RC::SUCCESS, db_->init("test_db", test_directory_.c_str(), "mvcc", "disk"));
+
+    vector<AttrInfoSqlNode> attr_infos(2);
+    for (size_t i = 0; i < attr_infos.size(); i++) {
+      attr_infos[i].name   = "field_" + to_string(i);
+      attr_infos[i].type   = AttrType::INTS;
+      attr_infos[i].length = 4;
+    }
+    ASSERT_EQ(RC::SUCCESS, db_->create_table("t", attr_infos, {}));
+    table_ = db_->find_table("t");
+    ASSERT_NE(table_, nullptr);
+  }
+
+  void TearDown() override
+  {
+    db_.reset();
+    filesystem::remove_all(test_directory_);
+  }
+
+  Trx *begin_trx()
+  {
+    Trx *trx = db_->trx_kit().create_trx(db_->log_handler());
+    trx->start_if_need();
+    return trx;
+  }
+
+  void end_trx(Trx *trx) { db_->trx_kit().destroy_trx(trx); }
+
+  RC make_record(int key, int value, Record &record)
+  {
+    vector<Value> values(2);
+    values[0].set_int(key);
+    values[1].set_int(value);
+    return table_->make_record(values.size(), values.data(), record);
+  }
+
+  /// 插入一行数据并提交，返回它的RID
+  RID insert_committed(int key, int value)
+  {
+    Trx   *trx = begin_trx();
+    Record record;
+    EXPECT_EQ(RC::SUCCESS, make_record(key, value, record));
+    EXPECT_EQ(RC::SUCCESS, trx->insert_record(table_, record));
+    EXPECT_EQ(RC::SUCCESS, trx->commit());
+    end_trx(trx);
+    return record.rid();
+  }
+
+  /// 在事务中找到 key 对应的可见版本
+  RC find(Trx *trx, int key, Record &found)
+  {
+    RecordScanner *scanner = nullptr;
+    RC             rc      = table_->get_record_scanner(scanner, trx, ReadWriteMode::READ_ONLY);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    int    found_count = 0;
+    Record record;
+    while (OB_SUCC(rc = scanner->next(record))) {
+      if (field_value(record, "field_0") == key) {
+        found = record;
+        found_count++;
+      }
+    }
+    delete scanner;
+    EXPECT_LE(found_count, 1);
+    return found_count == 0 ? RC::RECORD_NOT_EXIST : RC::SUCCESS;
+  }
+
+  /// 在事务中把 key 对应的值改成 value
+  RC update(Trx *trx, int key, int value)
+  {
+    Record old_record;
+    RC     rc = find(trx, key, old_record);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    Record new_record;
+    rc = make_record(key, value, new_record);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    return trx->update_record(table_, old_record, new_record);
+  }
+
+  /// 表中所有版本的记录数，包括已经删除的旧版本
+  int physical_count()
+  {
+    RecordScanner *scanner = nullptr;
+    EXPECT_EQ(RC::SUCCESS, table_->get_record_scanner(scanner, nullptr, ReadWriteMode::READ_ONLY));
+    int    count = 0;
+    Record record;
+    while (OB_SUCC(scanner->next(record))) {
+      count++;
+    }
+    delete scanner;
+    return count;
+  }
+
+  /// 索引中 key 对应的索引项个数
+  int index_count(Index *index, int key)
+  {
+    const char   *key_data = reinterpret_cast<const char *>(&key);
+    IndexScanner *scanner  = index->create_scanner(key_data, sizeof(key), true, key_data, sizeof(key), true);
+    int           count    = 0;
+    RID           rid;
+    while (OB_SUCC(scanner->next_entry(&rid))) {
+      count++;
+    }
+    scanner->destroy();
+    return count;
+  }
+
+  int field_value(const Record &record, const char *field_name)
+  {
+    const FieldMeta *field_meta = table_->table_meta().field(field_name);
+    return *reinterpret_cast<const int *>(record.data() + field_meta->offset());
+  }
+
+protected:
+  filesystem::path test_directory_{"mvcc_trx_test"};
+  unique_ptr<Db>   db_;
+  Table           *table_ = nullptr;
+};
+
+TEST_F(MvccTrxTest, snapshot_read)
+{
+  insert_committed(1, 100);
+
+  Trx *reader = begin_trx();
+  Trx *writer = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer, 1, 200));
+
+  // 没有提交的修改，只有自己能看到
+  Record record;
+  ASSERT_EQ(RC::SUCCESS, find(writer, 1, record));
+  ASSERT_EQ(200, field_value(record, "field_1"));
+  ASSERT_EQ(RC::SUCCESS, find(reader, 1, record));
+  ASSERT_EQ(100, field_value(record, "field_1"));
+
+  ASSERT_EQ(RC::SUCCESS, writer->commit());
+  end_trx(writer);
+
+  // 提交以后，之前开始的事务仍然读到旧的版本，之后开始的事务读到新的版本
+  ASSERT_EQ(RC::SUCCESS, find(reader, 1, record));
+  ASSERT_EQ(100, field_value(record, "field_1"));
+
+  Trx *reader2 = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, find(reader2, 1, record));
+  ASSERT_EQ(200, field_value(record, "field_1"));
+
+  // 旧的快照上不能再修改已经被别人修改过的数据
+  ASSERT_EQ(RC::LOCKED_CONCURRENCY_CONFLICT, update(reader, 1, 300));
+  ASSERT_EQ(RC::SUCCESS, reader->rollback());
+  end_trx(reader);
+
+  ASSERT_EQ(RC::SUCCESS, update(reader2, 1, 300));
+  ASSERT_EQ(RC::SUCCESS, reader2->commit());
+  end_trx(reader2);
+}
+
+TEST_F(MvccTrxTest, rollback_update)
+{
+  insert_committed(1, 100);
+
+  Trx *writer = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer, 1, 200));
+  ASSERT_EQ(RC::SUCCESS, update(writer, 1, 300));
+  ASSERT_EQ(RC::SUCCESS, writer->rollback());
+  end_trx(writer);
+
+  Trx   *reader = begin_trx();
+  Record record;
+  ASSERT_EQ(RC::SUCCESS, find(reader, 1, record));
+  ASSERT_EQ(100, field_value(record, "field_1"));
+  ASSERT_EQ(RC::SUCCESS, reader->commit());
+  end_trx(reader);
+}
+
+TEST_F(MvccTrxTest, vacuum)
+{
+  ASSERT_EQ(RC::SUCCESS, table_->create_index(nullptr, {table_->table_meta().field("field_0")}, "idx_field_0", false));
+  Index *index = table_->find_index("idx_field_0");
+  ASSERT_NE(index, nullptr);
+
+  const int row_num = 10;
+  for (int key = 0; key < row_num; key++) {
+    insert_committed(key, 0);
+  }
+
+  // 老的事务还在运行时，它能看到的版本不能被清理
+  Trx *old_reader = begin_trx();
+
+  const int update_num = 5;
+  for (int i = 1; i <= update_num; i++) {
+    for (int key = 0; key < row_num; key++) {
+      Trx *writer = begin_trx();
+      ASSERT_EQ(RC::SUCCESS, update(writer, key, i));
+      ASSERT_EQ(RC::SUCCESS, writer->commit());
+      end_trx(writer);
+    }
+  }
+  ASSERT_EQ(row_num * (update_num + 1), physical_count());
+
+  int purged_count = 0;
+  ASSERT_EQ(RC::SUCCESS, db_->vacuum(purged_count));
+  // 每行数据只有老事务看到的版本和最新的版本需要保留
+  ASSERT_EQ(row_num * 2, physical_count());
+  Record record;
+  for (int key = 0; key < row_num; key++) {
+    ASSERT_EQ(RC::SUCCESS, find(old_reader, key, record));
+    ASSERT_EQ(0, field_value(record, "field_1"));
+    ASSERT_EQ(2, index_count(index, key));
+  }
+  ASSERT_EQ(RC::SUCCESS, old_reader->commit());
+  end_trx(old_reader);
+
+  ASSERT_EQ(RC::SUCCESS, db_->vacuum(purged_count));
+  ASSERT_EQ(row_num, physical_count());
+
+  Trx *reader = begin_trx();
+  for (int key = 0; key < row_num; key++) {
+    ASSERT_EQ(RC::SUCCESS, find(reader, key, record));
+    ASSERT_EQ(update_num, field_value(record, "field_1"));
+    ASSERT_EQ(1, index_count(index, key));
+  }
+  ASSERT_EQ(RC::SUCCESS, reader->commit());
+  end_trx(reader);
+}
+
+TEST_F(MvccTrxTest, vacuum_pending)
+{
+  int purged_count = 0;
+  ASSERT_EQ(RC::SUCCESS, db_->vacuum(purged_count));
+  // 没有新的修改，清理线程不需要再扫描这张表
+  ASSERT_EQ(0, table_->take_vacuum_pending());
+
+  insert_committed(1, 100);
+  insert_committed(2, 100);
+  ASSERT_GT(table_->take_vacuum_pending(), 0);
+  table_->add_vacuum_pending();
+
+  // 老事务还能看到旧版本，这一轮清理不掉的要留给下一轮
+  Trx *old_reader = begin_trx();
+  Trx *writer     = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer, 1, 200));
+  ASSERT_EQ(RC::SUCCESS, writer->commit());
+  end_trx(writer);
+
+  ASSERT_EQ(RC::SUCCESS, db_->vacuum(purged_count));
+  ASSERT_EQ(0, purged_count);
+  ASSERT_EQ(3, physical_count());
+  ASSERT_GT(table_->take_vacuum_pending(), 0);
+  table_->add_vacuum_pending();
+
+  ASSERT_EQ(RC::SUCCESS, old_reader->commit());
+  end_trx(old_reader);
+
+  ASSERT_EQ(RC::SUCCESS, db_->vacuum(purged_count));
+  ASSERT_EQ(1, purged_count);
+  ASSERT_EQ(2, physical_count());
+  ASSERT_EQ(0, table_->take_vacuum_pending());
+
+  // 回滚删除也要重新标记页面
+  writer = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer, 2, 300));
+  ASSERT_EQ(RC::SUCCESS, writer->rollback());
+  end_trx(writer);
+  ASSERT_GT(table_->take_vacuum_pending(), 0);
+}
+
+TEST_F(MvccTrxTest, unique_index)
+{
+  insert_committed(1, 100);
+  insert_committed(2, 100);
+
+  // 已有的数据中有重复的值，不能创建唯一索引
+  ASSERT_EQ(RC::RECORD_DUPLICATE_KEY,
+      table_->create_index(nullptr, {table_->table_meta().field("field_1")}, "idx_field_1", true));
+  ASSERT_EQ(nullptr, table_->find_index("idx_field_1"));
+
+  ASSERT_EQ(RC::SUCCESS, table_->create_index(nullptr, {table_->table_meta().field("field_0")}, "idx_field_0", true));
+  Index *index = table_->find_index("idx_field_0");
+  ASSERT_NE(index, nullptr);
+  ASSERT_TRUE(index->index_meta().unique());
+
+  Trx   *trx = begin_trx();
+  Record record;
+  ASSERT_EQ(RC::SUCCESS, make_record(1, 200, record));
+  ASSERT_EQ(RC::RECORD_DUPLICATE_KEY, trx->insert_record(table_, record));
+  ASSERT_EQ(RC::SUCCESS, trx->rollback());
+  end_trx(trx);
+
+  // 更新时键值不变，自己删除的旧版本不算重复。其它事务还没有提交的删除要算
+  Trx *writer = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer, 1, 101));
+  trx = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, make_record(1, 200, record));
+  ASSERT_EQ(RC::RECORD_DUPLICATE_KEY, trx->insert_record(table_, record));
+  ASSERT_EQ(RC::SUCCESS, trx->rollback());
+  end_trx(trx);
+  ASSERT_EQ(RC::SUCCESS, writer->commit());
+  end_trx(writer);
+
+  // 删除已经提交的记录不算重复
+  trx = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, find(trx, 2, record));
+  ASSERT_EQ(RC::SUCCESS, trx->delete_record(table_, record));
+  ASSERT_EQ(RC::SUCCESS, trx->commit());
+  end_trx(trx);
+  insert_committed(2, 200);
+
+  // 旧版本还在索引中，点查会返回所有的版本
+  vector<RID> rids;
+  int         key = 2;
+  ASSERT_EQ(RC::SUCCESS, index->get_entries(reinterpret_cast<const char *>(&key), sizeof(key), rids));
+  ASSERT_EQ(2, static_cast<int>(rids.size()));
+
+  int purged_count = 0;
+  ASSERT_EQ(RC::SUCCESS, db_->vacuum(purged_count));
+  for (key = 1; key <= 2; key++) {
+    ASSERT_EQ(RC::SUCCESS, index->get_entries(reinterpret_cast<const char *>(&key), sizeof(key), rids));
+    ASSERT_EQ(1, static_cast<int>(rids.size()));
+  }
+  key = 3;
+  ASSERT_EQ(RC::SUCCESS, index->get_entries(reinterpret_cast<const char *>(&key), sizeof(key), rids));
+  ASSERT_TRUE(rids.empty());
+}
+
+TEST_F(MvccTrxTest, concurrent_begin)
+{
+  auto &trx_kit = static_cast<MvccTrxKit &>(db_->trx_kit());
+
+  // 多个线程同时开始和提交事务，同时还在收集活跃事务，分配的事务号不能重复
+  const int               thread_num = 8;
+  const int               trx_num    = 1000;
+  vector<vector<int32_t>> trx_ids(thread_num);
+  atomic<bool>            stopped(false);
+
+  thread collector([&] {
+    vector<int32_t> xids;
+    while (!stopped.load()) {
+      trx_kit.active_xids(xids);
+      EXPECT_TRUE(is_sorted(xids.begin(), xids.end()));
+    }
+  });
+
+  vector<thread> threads;
+  for (int i = 0; i < thread_num; i++) {
+    threads.emplace_back([&, i] {
+      Trx *trx = db_->trx_kit().create_trx(db_->log_handler());
+      for (int j = 0; j < trx_num; j++) {
+        trx->start_if_need();
+        trx_ids[i].push_back(trx->id());
+        EXPECT_EQ(RC::SUCCESS, trx->commit());
+      }
+      end_trx(trx);
+    });
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+  stopped.store(true);
+  collector.join();
+
+  vector<int32_t> all_ids;
+  for (const vector<int32_t> &ids : trx_ids) {
+    all_ids.insert(all_ids.end(), ids.begin(), ids.end());
+  }
+  sort(all_ids.begin(), all_ids.end());
+  ASSERT_EQ(all_ids.end(), adjacent_find(all_ids.begin(), all_ids.end()));
+  ASSERT_EQ(static_cast<size_t>(thread_num * trx_num), all_ids.size());
+
+  vector<int32_t> xids;
+  trx_kit.active_xids(xids);
+  ASSERT_TRUE(xids.empty());
+}
+
+#ifdef CONCURRENCY
+TEST_F(MvccTrxTest, wait_for_writer)
+{
+  insert_committed(1, 100);
+  db_->trx_kit().set_lock_wait_timeout(10000);
+
+  Trx *writer1 = begin_trx();
+  Trx *writer2 = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer1, 1, 200));
+
+  // writer2 等待 writer1 结束。writer1 回滚以后，writer2 可以继续修改
+  RC     rc2 = RC::INTERNAL;
+  thread waiter([&] { rc2 = update(writer2, 1, 300); });
+  this_thread::sleep_for(chrono::milliseconds(200));
+  ASSERT_EQ(RC::SUCCESS, writer1->rollback());
+  waiter.join();
+  ASSERT_EQ(RC::SUCCESS, rc2);
+  ASSERT_EQ(RC::SUCCESS, writer2->commit());
+
+  // writer3 等待 writer4 结束。writer4 提交以后，writer3 修改的就是旧的版本了
+  Trx *writer3 = begin_trx();
+  Trx *writer4 = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer4, 1, 400));
+  RC     rc3 = RC::INTERNAL;
+  thread waiter2([&] { rc3 = update(writer3, 1, 500); });
+  this_thread::sleep_for(chrono::milliseconds(200));
+  ASSERT_EQ(RC::SUCCESS, writer4->commit());
+  waiter2.join();
+  ASSERT_EQ(RC::LOCKED_CONCURRENCY_CONFLICT, rc3);
+  ASSERT_EQ(RC::SUCCESS, writer3->rollback());
+
+  end_trx(writer1);
+  end_trx(writer2);
+  end_trx(writer3);
+  end_trx(writer4);
+}
+
+TEST_F(MvccTrxTest, deadlock)
+{
+  insert_committed(1, 100);
+  insert_committed(2, 100);
+  db_->trx_kit().set_lock_wait_timeout(10000);
+
+  // 两个事务以相反的顺序修改两行数据，其中一个会检测到死锁
+  Trx *trx1 = begin_trx();
+  Trx *trx2 = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(trx1, 1, 200));
+  ASSERT_EQ(RC::SUCCESS, update(trx2, 2, 200));
+
+  auto run = [this](Trx *trx, int key) {
+    RC rc = update(trx, key, 300);
+    if (OB_SUCC(rc)) {
+      EXPECT_EQ(RC::SUCCESS, trx->commit());
+    } else {
+      EXPECT_EQ(RC::SUCCESS, trx->rollback());
+    }
+    return rc;
+  };
+
+  RC     rc1 = RC::INTERNAL;
+  RC     rc2 = RC::INTERNAL;
+  thread thread1([&] { rc1 = run(trx1, 2); });
+  thread thread2([&] { rc2 = run(trx2, 1); });
+  thread1.join();
+  thread2.join();
+
+  ASSERT_TRUE((rc1 == RC::SUCCESS && rc2 == RC::LOCKED_CONCURRENCY_CONFLICT) ||
+              (rc2 == RC::SUCCESS && rc1 == RC::LOCKED_CONCURRENCY_CONFLICT));
+
+  end_trx(trx1);
+  end_trx(trx2);
+}
+#else
+TEST_F(MvccTrxTest, no_wait)
+{
+  insert_committed(1, 100);
+
+  // 所有事务在同一个线程中交替执行，不能等待
+  Trx *writer1 = begin_trx();
+  Trx *writer2 = begin_trx();
+  ASSERT_EQ(RC::SUCCESS, update(writer1, 1, 200));
+  ASSERT_EQ(RC::LOCKED_CONCURRENCY_CONFLICT, update(writer2, 1, 300));
+  ASSERT_EQ(RC::SUCCESS, writer1->commit());
+  ASSERT_EQ(RC::SUCCESS, writer2->rollback());
+  end_trx(writer1);
+  end_trx(writer2);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  filesystem::path log_filename = filesystem::path(argv[0]).filename();
+  LoggerFactory::init_default(log_filename.string() + ".log", LOG_LEVEL_INFO);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,165 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <filesystem>
+
+#include "gtest/gtest.h"
+#include "common/log/log.h"
+#include "storage/buffer/disk_buffer_pool.h"
+#include "storage/buffer/double_write_buffer.h"
+#include "storage/clog/vacuous_log_handler.h"
+
+using namespace std;
+using namespace common;
+
+static size_t dirty_frame_count(BPFrameManager &frame_manager)
+{
+  vector<Frame *> frames;
+  size_t          count = frame_manager.find_dirty_frames(frames);
+  for (Frame *frame : frames) {
+    frame->unpin();
+  }
+  return count;
+}
+
+TEST(PageCleaner, watermark)
+{
+  filesystem::path directory("page_cleaner");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path filename = directory / "page_cleaner.bp";
+
+  const int         frame_num = DEFAULT_ITEM_NUM_PER_POOL;
+  BufferPoolManager buffer_pool_manager(BP_PAGE_SIZE * frame_num);
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.create_file(filename.c_str()));
+
+  VacuousLogHandler log_handler;
+  DiskBufferPool   *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, filename.c_str(), buffer_pool));
+
+  PageCleaner &page_cleaner = buffer_pool_manager.page_cleaner();
+  ASSERT_EQ(RC::INVALID_ARGUMENT, page_cleaner.init(100, 60, 50, 16));
+  // 间隔设置得足够长，后台线程不会自己醒来，下面每一轮都由测试调用 run_once 触发
+  ASSERT_EQ(RC::SUCCESS, page_cleaner.init(3600 * 1000, 10 /*low*/, 50 /*high*/, 16 /*batch*/));
+  ASSERT_EQ(RC::SUCCESS, page_cleaner.start());
+
+  BPFrameManager &frame_manager = buffer_pool_manager.get_frame_manager();
+
+  const int  page_num = 100;
+  vector<PageNum> page_nums;
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    *reinterpret_cast<PageNum *>(frame->data()) = frame->page_num();
+    frame->set_lsn(page_num - i);
+    frame->mark_dirty();
+    page_nums.push_back(frame->page_num());
+    buffer_pool->unpin_page(frame);
+  }
+
+  // 超过高水位时，一轮就刷到低水位以下
+  const size_t low_count = frame_num * 10 / 100;
+  ASSERT_GT(dirty_frame_count(frame_manager), static_cast<size_t>(frame_num / 2));
+  ASSERT_GT(page_cleaner.run_once(), 0);
+  ASSERT_LE(dirty_frame_count(frame_manager), low_count);
+
+  // LSN 小的页面先刷盘
+  Frame *frame = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums.back(), &frame));
+  ASSERT_FALSE(frame->dirty());
+  buffer_pool->unpin_page(frame);
+
+  // 在两个水位之间时，每一轮最多刷一批
+  for (int i = 0; i < 30; i++) {
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums[i], &frame));
+    frame->mark_dirty();
+    buffer_pool->unpin_page(frame);
+  }
+  const size_t dirty_count = dirty_frame_count(frame_manager);
+  ASSERT_GT(dirty_count, low_count + 16);
+  ASSERT_EQ(16, page_cleaner.run_once());
+  ASSERT_EQ(dirty_count, page_cleaner.dirty_page_count());
+  ASSERT_EQ(dirty_count - 16, dirty_frame_count(frame_manager));
+
+  while (page_cleaner.run_once() > 0) {
+  }
+  ASSERT_LE(dirty_frame_count(frame_manager), low_count);
+  ASSERT_GT(page_cleaner.flushed_page_count(), static_cast<uint64_t>(page_num - low_count));
+
+  page_cleaner.stop();
+
+  // 刷下去的数据可以正确地读出来
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.close_file(filename.c_str()));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, filename.c_str(), buffer_pool));
+  for (PageNum page : page_nums) {
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page, &frame));
+    ASSERT_EQ(page, *reinterpret_cast<PageNum *>(frame->data()));
+    buffer_pool->unpin_page(frame);
+  }
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.close_file(filename.c_str()));
+}
+
+TEST(PageCleaner, flush_full_double_write_batch)
+{
+  filesystem::path directory("page_cleaner_dblwr");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path filename       = directory / "page_cleaner.bp";
+  filesystem::path dblwr_filename = directory / "dblwr.db";
+
+  // 批次很小，一轮要刷的页面会多次写满 double write buffer
+  const int         batch_pages = 4;
+  BufferPoolManager buffer_pool_manager(BP_PAGE_SIZE * DEFAULT_ITEM_NUM_PER_POOL);
+  auto              dblwr_buffer = make_unique<DiskDoubleWriteBuffer>(buffer_pool_manager, batch_pages);
+  ASSERT_EQ(RC::SUCCESS, dblwr_buffer->open_file(dblwr_filename.c_str()));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.init(std::move(dblwr_buffer)));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.create_file(filename.c_str()));
+
+  VacuousLogHandler log_handler;
+  DiskBufferPool   *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, filename.c_str(), buffer_pool));
+
+  PageCleaner &page_cleaner = buffer_pool_manager.page_cleaner();
+  ASSERT_EQ(RC::SUCCESS, page_cleaner.init(3600 * 1000, 0 /*low*/, 1 /*high*/, 16 /*batch*/));
+
+  const int       page_num = batch_pages * 8;
+  vector<PageNum> page_nums;
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    *reinterpret_cast<PageNum *>(frame->data()) = frame->page_num();
+    frame->mark_dirty();
+    page_nums.push_back(frame->page_num());
+    buffer_pool->unpin_page(frame);
+  }
+
+  ASSERT_GE(page_cleaner.run_once(), page_num);
+
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.close_file(filename.c_str()));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, filename.c_str(), buffer_pool));
+  for (PageNum page : page_nums) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page, &frame));
+    ASSERT_EQ(page, *reinterpret_cast<PageNum *>(frame->data()));
+    buffer_pool->unpin_page(frame);
+  }
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.close_file(filename.c_str()));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  filesystem::path log_filename = filesystem::path(argv[0]).filename();
+  LoggerFactory::init_default(log_filename.string() + ".log", LOG_LEVEL_TRACE);
+  return RUN_ALL_TESTS();
+}
@@ -27,6 +27,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/thread/thread_pool_executor.h"
 #include "storage/clog/integrated_log_replayer.h"
 #include "storage/record/heap_record_scanner.h"
+#include "storage/record/record_log.h"
 #include "gtest/gtest.h"
 
 using namespace std;
@@ -363,6 +364,263 @@ TEST(RecordManager, durability)
   bpm2.close_file(record_manager_file.c_str());
 }
 
+TEST(RecordManager, compact_update_log)
+{
+  // 更新记录时，日志中只有修改过的字节
+  filesystem::path directory("record_manager_compact_update_log");
+  filesystem::remove_all(directory);
+  ASSERT_TRUE(filesystem::create_directories(directory));
+
+  filesystem::path record_manager_file = directory / "record_manager.bp";
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(bpm.init(make_unique<VacuousDoubleWriteBuffer>()), RC::SUCCESS);
+
+  DiskLogHandler        log_handler;
+  IntegratedLogReplayer log_replayer(bpm);
+  ASSERT_EQ(log_handler.init(directory.c_str()), RC::SUCCESS);
+  ASSERT_EQ(log_handler.replay(log_replayer, 0), RC::SUCCESS);
+  ASSERT_EQ(log_handler.start(), RC::SUCCESS);
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(bpm.create_file(record_manager_file.c_str()), RC::SUCCESS);
+  ASSERT_EQ(bpm.open_file(log_handler, record_manager_file.c_str(), buffer_pool), RC::SUCCESS);
+
+  RecordFileHandler record_file_handler(StorageFormat::ROW_FORMAT);
+  ASSERT_EQ(record_file_handler.init(*buffer_pool, log_handler, nullptr, nullptr), RC::SUCCESS);
+
+  const int    record_size = 1000;
+  vector<char> record_data(record_size, 'a');
+  RID          rid;
+  ASSERT_EQ(record_file_handler.insert_record(record_data.data(), record_size, &rid), RC::SUCCESS);
+
+  const int update_offset = 100;
+  ASSERT_EQ(record_file_handler.visit_record(rid,
+                [&](Record &record) {
+                  memcpy(record.data() + update_offset, "bcd", 3);
+                  record.data()[update_offset + 5] = 'e';
+                  return true;
+                }),
+      RC::SUCCESS);
+  // 没有修改数据，不会记录日志
+  ASSERT_EQ(record_file_handler.visit_record(rid, [](Record &) { return true; }), RC::SUCCESS);
+
+  ASSERT_EQ(log_handler.stop(), RC::SUCCESS);
+  ASSERT_EQ(log_handler.await_termination(), RC::SUCCESS);
+
+  int  update_count   = 0;
+  auto update_checker = [&](LogEntry &entry) -> RC {
+    if (entry.module().id() != LogModule::Id::RECORD_MANAGER) {
+      return RC::SUCCESS;
+    }
+    auto *header = reinterpret_cast<const RecordLogHeader *>(entry.data());
+    if (RecordOperation(header->operation_type).type() == RecordOperation::Type::UPDATE) {
+      update_count++;
+      EXPECT_EQ(update_offset, header->update_offset);
+      EXPECT_EQ(RecordLogHeader::SIZE + 6, entry.payload_size());
+      EXPECT_EQ(0, memcmp(header->data, "bcdaae", 6));
+    }
+    return RC::SUCCESS;
+  };
+  ASSERT_EQ(log_handler.iterate(update_checker, 0), RC::SUCCESS);
+  ASSERT_EQ(1, update_count);
+
+  bpm.close_file(record_manager_file.c_str());
+}
+
+TEST(RecordManager, visibility_map)
+{
+  filesystem::path directory("record_manager_visibility_map");
+  filesystem::remove_all(directory);
+  ASSERT_TRUE(filesystem::create_directories(directory));
+
+  filesystem::path record_manager_file = directory / "record_manager.bp";
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(bpm.init(make_unique<VacuousDoubleWriteBuffer>()), RC::SUCCESS);
+
+  VacuousLogHandler log_handler;
+  DiskBufferPool   *buffer_pool = nullptr;
+  ASSERT_EQ(bpm.create_file(record_manager_file.c_str()), RC::SUCCESS);
+  ASSERT_EQ(bpm.open_file(log_handler, record_manager_file.c_str(), buffer_pool), RC::SUCCESS);
+
+  RecordFileHandler record_file_handler(StorageFormat::ROW_FORMAT);
+  ASSERT_EQ(record_file_handler.init(*buffer_pool, log_handler, nullptr, nullptr), RC::SUCCESS);
+
+  const int    record_size = 100;
+  vector<char> record_data(record_size, 'a');
+  RID          rid1, rid2;
+  ASSERT_EQ(record_file_handler.insert_record(record_data.data(), record_size, &rid1), RC::SUCCESS);
+  ASSERT_EQ(record_file_handler.insert_record(record_data.data(), record_size, &rid2), RC::SUCCESS);
+  ASSERT_EQ(rid1.page_num, rid2.page_num);
+  ASSERT_FALSE(record_file_handler.is_all_visible(rid1.page_num));
+
+  auto all_a      = [](const Record &record) { return record.data()[0] == 'a'; };
+  int  page_count = 0;
+  ASSERT_EQ(record_file_handler.mark_all_visible_pages(all_a, page_count), RC::SUCCESS);
+  ASSERT_EQ(1, page_count);
+  ASSERT_TRUE(record_file_handler.is_all_visible(rid1.page_num));
+
+  // 只读访问不会清除标记，修改记录会
+  ASSERT_EQ(record_file_handler.visit_record(rid1, [](Record &) { return false; }), RC::SUCCESS);
+  ASSERT_TRUE(record_file_handler.is_all_visible(rid1.page_num));
+  ASSERT_EQ(record_file_handler.visit_record(rid1,
+                [](Record &record) {
+                  record.data()[0] = 'b';
+                  return true;
+                }),
+      RC::SUCCESS);
+  ASSERT_FALSE(record_file_handler.is_all_visible(rid1.page_num));
+
+  // 有一条记录不满足条件，整个页面都不能标记
+  ASSERT_EQ(record_file_handler.mark_all_visible_pages(all_a, page_count), RC::SUCCESS);
+  ASSERT_EQ(0, page_count);
+  ASSERT_FALSE(record_file_handler.is_all_visible(rid1.page_num));
+
+  ASSERT_EQ(record_file_handler.delete_record(&rid1), RC::SUCCESS);
+  ASSERT_EQ(record_file_handler.mark_all_visible_pages(all_a, page_count), RC::SUCCESS);
+  ASSERT_EQ(1, page_count);
+  ASSERT_TRUE(record_file_handler.is_all_visible(rid2.page_num));
+
+  ASSERT_EQ(record_file_handler.insert_record(record_data.data(), record_size, &rid1), RC::SUCCESS);
+  ASSERT_FALSE(record_file_handler.is_all_visible(rid1.page_num));
+
+  record_file_handler.close();
+  bpm.close_file(record_manager_file.c_str());
+}
+
+TEST(RecordManager, parallel_recovery)
+{
+  /*
+   * 测试场景：
+   * 1. 创建几个文件，保存一份只有文件头的副本
+   * 2. 在每个文件中插入、更新、删除一些记录
+   * 3. 使用副本和日志，多个线程并行回放日志，检查记录是否恢复
+   */
+  filesystem::path directory("record_manager_parallel_recovery");
+  filesystem::path copy_directory = directory / "copy";
+  filesystem::remove_all(directory);
+  ASSERT_TRUE(filesystem::create_directories(copy_directory));
+
+  const int file_num = 4;
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(bpm.init(make_unique<VacuousDoubleWriteBuffer>()), RC::SUCCESS);
+
+  DiskLogHandler        log_handler;
+  IntegratedLogReplayer log_replayer(bpm);
+  ASSERT_EQ(log_handler.init((directory / "clog").c_str()), RC::SUCCESS);
+  ASSERT_EQ(log_handler.replay(log_replayer, 0), RC::SUCCESS);
+  ASSERT_EQ(log_handler.start(), RC::SUCCESS);
+
+  vector<filesystem::path>              files;
+  vector<unique_ptr<RecordFileHandler>> handlers;
+  for (int i = 0; i < file_num; i++) {
+    filesystem::path file = directory / ("record" + to_string(i) + ".bp");
+    ASSERT_EQ(bpm.create_file(file.c_str()), RC::SUCCESS);
+    filesystem::copy_file(file, copy_directory / file.filename());
+
+    DiskBufferPool *buffer_pool = nullptr;
+    ASSERT_EQ(bpm.open_file(log_handler, file.c_str(), buffer_pool), RC::SUCCESS);
+    auto handler = make_unique<RecordFileHandler>(StorageFormat::ROW_FORMAT);
+    ASSERT_EQ(handler->init(*buffer_pool, log_handler, nullptr, nullptr), RC::SUCCESS);
+    files.push_back(file);
+    handlers.push_back(std::move(handler));
+  }
+
+  // 记录比较大，每个文件会有很多页面
+  const int                                   record_size = 1000;
+  const int                                   record_num  = 2000;
+  vector<unordered_map<RID, string, RIDHash>> record_maps(file_num);
+  for (int i = 0; i < file_num; i++) {
+    for (int j = 0; j < record_num; j++) {
+      string data = to_string(i) + ":" + to_string(j);
+      data.resize(record_size, 'r');
+      RID rid;
+      ASSERT_EQ(handlers[i]->insert_record(data.c_str(), record_size, &rid), RC::SUCCESS);
+      record_maps[i].emplace(rid, data);
+    }
+
+    int index = 0;
+    for (auto iter = record_maps[i].begin(); iter != record_maps[i].end(); index++) {
+      if (index % 3 == 0) {
+        RID rid = iter->first;
+        ASSERT_EQ(handlers[i]->delete_record(&rid), RC::SUCCESS);
+        iter = record_maps[i].erase(iter);
+        continue;
+      }
+
+      if (index % 5 == 0) {
+        string &data = iter->second;
+        data[0]      = 'u';
+        ASSERT_EQ(handlers[i]->visit_record(iter->first,
+                      [&data](Record &record) {
+                        memcpy(record.data(), data.c_str(), data.size());
+                        return true;
+                      }),
+            RC::SUCCESS);
+      }
+      ++iter;
+    }
+  }
+
+  ASSERT_EQ(log_handler.stop(), RC::SUCCESS);
+  ASSERT_EQ(log_handler.await_termination(), RC::SUCCESS);
+  handlers.clear();
+  for (const filesystem::path &file : files) {
+    bpm.close_file(file.c_str());
+  }
+
+  // 使用文件的副本，所有的修改都要从日志中恢复
+  BufferPoolManager bpm2;
+  ASSERT_EQ(bpm2.init(make_unique<VacuousDoubleWriteBuffer>()), RC::SUCCESS);
+  DiskLogHandler           log_handler2;
+  vector<DiskBufferPool *> buffer_pools2;
+  for (const filesystem::path &file : files) {
+    filesystem::copy_file(copy_directory / file.filename(), file, filesystem::copy_options::overwrite_existing);
+    DiskBufferPool *buffer_pool = nullptr;
+    ASSERT_EQ(bpm2.open_file(log_handler2, file.c_str(), buffer_pool), RC::SUCCESS);
+    buffer_pools2.push_back(buffer_pool);
+  }
+
+  IntegratedLogReplayer log_replayer2(bpm2, nullptr, 4 /*redo_thread_num*/);
+  ASSERT_EQ(log_handler2.init((directory / "clog").c_str()), RC::SUCCESS);
+  ASSERT_EQ(log_handler2.replay(log_replayer2, 0), RC::SUCCESS);
+  ASSERT_EQ(log_handler2.start(), RC::SUCCESS);
+  ASSERT_EQ(log_replayer2.on_done(), RC::SUCCESS);
+
+  for (int i = 0; i < file_num; i++) {
+    RecordFileHandler handler(StorageFormat::ROW_FORMAT);
+    ASSERT_EQ(handler.init(*buffer_pools2[i], log_handler2, nullptr, nullptr), RC::SUCCESS);
+    for (const auto &[rid, data] : record_maps[i]) {
+      Record record;
+      ASSERT_EQ(handler.get_record(rid, record), RC::SUCCESS);
+      ASSERT_EQ(memcmp(record.data(), data.c_str(), data.size()), 0);
+    }
+
+    // 删除的记录也不能恢复出来
+    VacuousTrx        trx;
+    HeapRecordScanner file_scanner(
+        nullptr /*table*/, *buffer_pools2[i], &trx, log_handler2, ReadWriteMode::READ_ONLY, nullptr /*condition_filter*/);
+    ASSERT_EQ(file_scanner.open_scan(), RC::SUCCESS);
+    Record record;
+    size_t count = 0;
+    RC     rc    = RC::SUCCESS;
+    while (OB_SUCC(rc = file_scanner.next(record))) {
+      count++;
+    }
+    ASSERT_EQ(rc, RC::RECORD_EOF);
+    file_scanner.close_scan();
+    ASSERT_EQ(count, record_maps[i].size());
+  }
+
+  ASSERT_EQ(log_handler2.stop(), RC::SUCCESS);
+  ASSERT_EQ(log_handler2.await_termination(), RC::SUCCESS);
+  for (const filesystem::path &file : files) {
+    bpm2.close_file(file.c_str());
+  }
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);